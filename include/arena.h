@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+
+namespace cache {
+
+// A block of anonymous memory mapped straight from the OS, bypassing the
+// heap. Pages are not touched until used (unless prefaulted), so nothing is
+// zeroed up front. With huge_pages the mapping is 2MB-aligned and backed by
+// reserved huge pages (MAP_HUGETLB) when the system has them, otherwise by
+// transparent huge pages (MADV_HUGEPAGE), so a large cache needs far fewer
+// TLB entries. Throws std::bad_alloc when the mapping fails.
+class Arena {
+public:
+    static constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+    
+    struct Options {
+        size_t arena_size = 8 * 1024 * 1024;
+        bool huge_pages = false;
+        bool prefault = false;      // Fault every page in when mapping (MAP_POPULATE)
+    };
+    
+    // size is rounded up to the page size, or the huge page size. data() is
+    // aligned to alignment when that is larger than the page size.
+    Arena(size_t size, bool huge_pages = false, bool prefault = false, size_t alignment = 0);
+    ~Arena();
+    
+    // Non-copyable, non-movable
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&&) = delete;
+    Arena& operator=(Arena&&) = delete;
+    
+    char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool huge_pages() const { return huge_pages_; }
+    bool hugetlb() const { return hugetlb_; }
+    
+    // Hands the physical pages back to the OS (MADV_DONTNEED). The range
+    // stays mapped and reads as zeros when next touched.
+    void release();
+    // The same for part of the range; begin and length must be page-aligned
+    static void release(char* begin, size_t length);
+
+private:
+    char* data_ = nullptr;
+    size_t size_ = 0;
+    char* mapping_ = nullptr;       // Includes the alignment slack, for munmap
+    size_t mapping_size_ = 0;
+    bool huge_pages_ = false;
+    bool hugetlb_ = false;
+};
+
+} // namespace cache
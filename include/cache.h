@@ -7,17 +7,31 @@
 #include <unordered_map>
 #include <atomic>
 #include <chrono>
+#include <limits>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
 
-#include "lru_cache.h"
-#include "memory_allocator.h"
-#include "object_pool.h"
+#include "item.h"
+#include "slab_allocator.h"
+#include "hot_keys.h"
+#include "miss_ratio_curve.h"
+#include "lock_stats.h"
 
 namespace cache {
 
+class WriteLog;
+class FlashTier;
+class InvalidationTracker;
+class ReplicationPrimary;
+class Reclaimer;
+
 class Cache {
 public:
-    explicit Cache(size_t max_capacity = 1024 * 1024 * 1024); // 1GB default
-    ~Cache() = default;
+    explicit Cache(size_t max_capacity = 1024 * 1024 * 1024, // 1GB default
+                   size_t num_shards = 16);
+    ~Cache();
 
     // Non-copyable, non-movable
     Cache(const Cache&) = delete;
@@ -31,16 +45,142 @@ public:
     bool remove(const std::string& key);
     void clear();
 
+    // Atomic read-modify-write operations
+    enum class CasResult {
+        STORED,     // Version matched, value replaced
+        EXISTS,     // Entry was modified since the given version was read
+        NOT_FOUND,  // No entry for the key
+        REJECTED    // New value does not fit in the cache, or was not logged
+    };
+
+    struct VersionedValue {
+        std::string value;
+        uint64_t version;
+    };
+
+    // Adds delta to the 64-bit integer stored at key, creating it from 0 if
+    // missing. Returns nullopt if the value is not an integer or would overflow.
+    std::optional<int64_t> incr(const std::string& key, int64_t delta = 1);
+    std::optional<int64_t> decr(const std::string& key, int64_t delta = 1);
+    std::optional<VersionedValue> get_versioned(const std::string& key);
+    CasResult cas(const std::string& key, const std::string& value, uint64_t expected_version);
+
     // Statistics
     size_t size() const;
     size_t capacity() const;
     double hit_ratio() const;
     size_t hits() const;
     size_t misses() const;
+    size_t ram_hits() const;
+    size_t flash_hits() const;
+    size_t evictions() const;
+    size_t background_evictions() const;    // By reclaim()
+    size_t inline_evictions() const;        // By writes making room for themselves
+    uint64_t inline_eviction_time_us() const;
+    // Nanoseconds the calling thread has spent blocked on shard locks, ever
+    static uint64_t lock_wait_ns();
+    size_t compressed_values() const;
+    double compression_ratio() const;
+    uint64_t compress_time_us() const;
+    uint64_t decompress_time_us() const;
+
+    // Hot and big keys, sampled on every access (see HotKeys)
+    std::vector<HotKeys::KeyCount> hot_keys(size_t count) const;
+    // Stored sizes, re-read from the cache; keys since removed are dropped
+    std::vector<HotKeys::KeyCount> big_keys(size_t count) const;
+    uint64_t key_samples() const;
+    // Predicted hit ratio at other capacities, from sampled reuse distances
+    const MissRatioCurve& miss_ratio_curve() const;
 
     // Memory management
-    size_t memory_usage() const;
+    size_t memory_usage() const;        // Slab chunks of the stored items
+    size_t reserved_memory() const;     // Slab pages, large items and index buckets held
+    size_t mapped_memory() const;       // Arenas mapped for slab pages, carved or not
+    // Safe to call while serving, from any number of threads; evicts down to
+    // the new capacity before returning. Namespace quotas shrink in
+    // proportion while the capacity is below what they were added against.
     void set_max_capacity(size_t capacity);
+    // Arena size and huge pages for each shard's slab memory. With prefault,
+    // the capacity is mapped and faulted in now rather than on first use.
+    // Call before storing anything.
+    void set_memory_options(const Arena::Options& options);
+
+    // Defragmentation: in each shard, moves the items off slab pages at most
+    // max_occupancy full onto other pages of their class, so the emptied
+    // pages can serve any class. While a shard is evicting and has no free
+    // page left, it also takes a page from the class with the most free
+    // chunks (rebalancing). The shard lock is held for one page at a time.
+    // Returns the pages freed; Compactor calls it in the background.
+    size_t compact(double max_occupancy, size_t max_pages_per_shard);
+    // Per size class, summed over the shards
+    std::vector<SlabAllocator::ClassStats> slab_stats() const;
+    // Share of the slab pages not holding items
+    double fragmentation_ratio() const;
+    size_t pages_compacted() const;
+    size_t pages_rebalanced() const;
+    size_t items_relocated() const;
+    
+    // Namespaces: a key "name:rest" belongs to namespace name once it has
+    // been added, and any other key to the default namespace. Each namespace
+    // has its own LRU lists and is evicted down on its own past its quota, so
+    // one tenant's burst cannot evict another's entries. The default
+    // namespace gets the capacity the quotas leave. Add namespaces before
+    // serving traffic; fails for a taken or malformed name, or if the quotas
+    // would exceed the capacity.
+    static constexpr char kNamespaceSeparator = ':';
+    static constexpr const char* kDefaultNamespace = "default";
+    bool add_namespace(const std::string& name, size_t quota);
+    // Index into namespace_stats(); 0 is the default namespace
+    size_t namespace_of(std::string_view key) const;
+    size_t num_namespaces() const;
+    
+    struct NamespaceStats {
+        std::string name;
+        size_t quota;
+        size_t memory_usage;
+        size_t items;
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+    };
+    std::vector<NamespaceStats> namespace_stats() const;
+    
+    // Durability: once attached, set/incr/cas/remove/clear are appended to
+    // the log. Attach before serving traffic; the log must outlive the cache.
+    // Once the log has failed, set/incr/cas still apply in memory but report
+    // failure; remove and clear cannot, so callers check WriteLog::failed().
+    void attach_write_log(WriteLog* log);
+
+    // Tiering: once attached, evicted entries are demoted to flash and
+    // promoted back on access. The tier must outlive the cache.
+    void attach_flash_tier(FlashTier* tier);
+
+    // Client-side caching: once attached, set/incr/cas/remove invalidate the
+    // key and clear invalidates everything, after the change is visible.
+    // Evictions do not. The tracker must outlive the cache.
+    void attach_invalidation_tracker(InvalidationTracker* tracker);
+    
+    // Background eviction: once attached, the reclaimer is woken when free
+    // memory drops below its low watermark and evicts ahead of demand (see
+    // reclaim), and writes evict inline only past the capacity itself, and
+    // then only down to it. The reclaimer must outlive the cache.
+    void attach_reclaimer(Reclaimer* reclaimer);
+    // Evicts from each shard with less than low_watermark of its share of
+    // the capacity free until high_watermark is free, least recently used
+    // first, batch_size items per shard lock hold. Namespaces using more than
+    // high_watermark leaves of their quota are evicted from first. Returns
+    // the items evicted.
+    size_t reclaim(double low_watermark, double high_watermark, size_t batch_size);
+
+    // Replication: once attached, set/incr/cas/remove/clear are appended to
+    // the primary's backlog under the shard lock. The primary must outlive
+    // the cache.
+    void attach_replication(ReplicationPrimary* primary);
+    
+    // Compression: values of at least min_size bytes are stored LZ4-compressed
+    // when that saves space, and expanded again on read. 0 disables it.
+    void set_compression_threshold(size_t min_size);
+    size_t compression_threshold() const;
 
 public:
     struct CacheEntry {
@@ -48,28 +188,134 @@ public:
         std::string value;
         std::chrono::steady_clock::time_point timestamp;
         size_t access_count;
+        uint64_t version;       // Stamped from Cache::next_version_ on every mutation
+        int64_t int_value;      // Native storage for INCR/DECR counters
+        bool is_integer;
+        bool is_compressed;     // value holds the Compression form
         
         CacheEntry() = default;
-        CacheEntry(const std::string& k, const std::string& v)
-            : key(k), value(v), timestamp(std::chrono::steady_clock::now()), access_count(0) {}
+        CacheEntry(const std::string& k, const std::string& v, uint64_t ver = 0)
+            : key(k), value(v), timestamp(std::chrono::steady_clock::now()), access_count(0),
+              version(ver), int_value(0), is_integer(false), is_compressed(false) {}
+        CacheEntry(const std::string& k, int64_t n, uint64_t ver)
+            : key(k), timestamp(std::chrono::steady_clock::now()), access_count(0),
+              version(ver), int_value(n), is_integer(true), is_compressed(false) {}
+
+        // Stored form; compressed entries still need Cache::expand
+        std::string value_string() const {
+            return is_integer ? std::to_string(int_value) : value;
+        }
     };
 
+    // Persistence support
+    size_t num_shards() const;
+    size_t shard_index(const std::string& key) const;
+    // Copies one shard's entries, least recently used first, holding only that shard's lock
+    std::vector<CacheEntry> export_shard(size_t shard) const;
+    // Inserts an entry as most recently used, keeping its version, timestamp and native integer
+    bool restore(CacheEntry entry);
+
 private:
+    // Entries are stored as packed Items carved from the shard's slab
+    // allocator and indexed by the shard's ItemTables; CacheEntry is only
+    // built when an entry leaves RAM (export, logs, flash).
+    struct Shard {
+        mutable SharedMutex mutex{CACHE_LOCK_NAME("cache_shard")};
+        SlabAllocator allocator;        // Guarded by mutex
+        // One table per namespace, indexed like namespaces_; bounded by bytes via make_room
+        std::vector<std::unique_ptr<ItemTable>> tables;
+        size_t memory_usage = 0;  // Guarded by mutex
+        size_t evictions = 0;     // Guarded by mutex
+        size_t evictions_seen = 0;  // By the last compact(); guarded by mutex
+        
+        Shard() {
+            tables.push_back(std::make_unique<ItemTable>());
+        }
+    };
+    
+    struct Namespace {
+        std::string name;
+        size_t quota = 0;               // Unused for the default namespace
+        std::atomic<size_t> memory_usage{0};
+        
+        // Statistics
+        std::atomic<size_t> hits{0};
+        std::atomic<size_t> misses{0};
+        std::atomic<size_t> evictions{0};
+        
+        explicit Namespace(std::string n, size_t q = 0) : name(std::move(n)), quota(q) {}
+    };
 
-    mutable std::shared_mutex mutex_;
-    LRUCache<std::string, CacheEntry> lru_cache_;
-    std::unique_ptr<MemoryAllocator> allocator_;
-    std::unique_ptr<ObjectPool<CacheEntry>> entry_pool_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    // Fixed once traffic starts, so lookups take no lock
+    std::vector<std::unique_ptr<Namespace>> namespaces_;
+    std::unordered_map<std::string_view, size_t> namespace_ids_;   // Views of Namespace::name
+    size_t max_namespace_length_ = 0;
+    size_t namespace_quotas_ = 0;       // Sum over the named namespaces
+    size_t quota_capacity_ = 0;         // Capacity when the last namespace was added
+    Mutex resize_mutex_{CACHE_LOCK_NAME("cache_resize")};
     
     // Statistics
     mutable std::atomic<size_t> hits_{0};
     mutable std::atomic<size_t> misses_{0};
+    mutable std::atomic<size_t> flash_hits_{0};
     std::atomic<size_t> max_capacity_;
     std::atomic<size_t> current_memory_usage_{0};
+    std::atomic<uint64_t> next_version_{1};
+    std::atomic<size_t> compression_threshold_{0};
+    std::atomic<size_t> compressed_values_{0};
+    std::atomic<uint64_t> compress_input_bytes_{0};
+    std::atomic<uint64_t> compress_output_bytes_{0};
+    mutable std::atomic<uint64_t> compress_time_ns_{0};
+    mutable std::atomic<uint64_t> decompress_time_ns_{0};
+    std::atomic<size_t> evictions_{0};
+    std::atomic<size_t> background_evictions_{0};
+    std::atomic<uint64_t> inline_eviction_ns_{0};
+    std::atomic<size_t> pages_rebalanced_{0};
+    std::atomic<size_t> items_relocated_{0};
+    mutable HotKeys hot_keys_;
+    MissRatioCurve miss_ratio_curve_;
+    WriteLog* write_log_ = nullptr;
+    FlashTier* flash_tier_ = nullptr;
+    InvalidationTracker* invalidation_tracker_ = nullptr;
+    ReplicationPrimary* replication_ = nullptr;
+    Reclaimer* reclaimer_ = nullptr;
+    double reclaim_low_watermark_ = 0.0;
 
     // Helper methods
+    // Chunk bytes an item takes; SIZE_MAX if it cannot be stored at all
+    static size_t item_size(size_t key_len, size_t value_len);
+    static size_t item_size(const CacheEntry& entry);
+    static uint64_t hash_key(const std::string& key);
+    static uint32_t item_hash(uint64_t hash);
+    static CacheEntry to_entry(const Item& item, uint32_t now,
+                               std::chrono::steady_clock::time_point now_time);
+    static Item* make_item(Shard& shard, const CacheEntry& entry, uint32_t hash);
+    // The compressed form when compression is on and pays off
+    std::optional<std::string> compress(const std::string& value);
+    std::string expand(std::string_view stored) const;
+    Shard& shard_at(uint64_t hash) const;
+    // Inserts item, or puts it in place of old, which is freed
+    void store(Shard& shard, size_t ns, Item* item, Item* old);
+    void release(Shard& shard, size_t ns, Item* item);
+    size_t namespace_quota(size_t ns) const;
+    bool fits(size_t ns, size_t size) const;
+    void charge(Shard& shard, size_t ns, size_t added, size_t released);
+    uint64_t log_set(const Item& item);
+    bool commit(uint64_t lsn);
+    void invalidate(const std::string& key);
+    std::optional<CacheEntry> promote(const std::string& key);
+    // Evicts the namespace down past its quota, then the cache past its capacity
+    void make_room(size_t ns);
     bool evict_if_needed();
-    void update_statistics(bool hit);
+    // Evicts from namespaces [first_ns, last_ns), oldest table tail first,
+    // until usage is at most target_usage
+    bool evict(size_t first_ns, size_t last_ns, const std::atomic<size_t>& usage, size_t target_usage);
+    // Demotes victim to flash if attached, then frees it; under the shard lock
+    void evict_item(Shard& shard, size_t ns, Item* victim, uint32_t now,
+                    std::chrono::steady_clock::time_point now_time);
+    void update_statistics(size_t ns, bool hit);
+    size_t compact_shard(Shard& shard, double max_occupancy, size_t max_pages);
 };
 
 } // namespace cache
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <optional>
+#include <functional>
+#include <utility>
+#include <chrono>
+#include <cstdint>
+#include <sys/socket.h>
+
+#include "near_cache.h"
+
+namespace cache {
+
+// Client for the server's line protocol, for embedding in services.
+//
+// Requests go to a pool of non-blocking connections driven by one I/O
+// thread. A request is appended to a connection's output buffer and its
+// callback to the connection's queue. The server answers each connection in
+// order, so replies are matched to callbacks first in, first out. A caller
+// finding the connection idle writes its request itself; requests made
+// while a write is pending leave together in one send(). Either way
+// concurrent callers are pipelined instead of waiting out each other's
+// round trips.
+//
+// When a connection fails, or its oldest request outlives the timeout, its
+// outstanding requests complete with an "ERROR ..." reply. The connection is
+// reopened for the next request, at most once per reconnect_delay. Requests
+// are never resent, since INCR and friends are not idempotent.
+//
+// With near_cache.capacity set, get() and mget() answer from an in-process
+// NearCache when they can. Each connection starts with TRACKING ON, so the
+// server pushes "INVALIDATE key" lines for keys read through it; these are
+// applied as they arrive and are never matched to requests. A failed
+// connection loses its pushes, so it empties the near cache. set() and
+// remove() drop their key before sending and again on the reply, so a
+// client reads its own writes.
+class CacheClient {
+public:
+    struct Options {
+        std::string host = "127.0.0.1";
+        int port = 8080;
+        size_t connections = 1;
+        std::chrono::milliseconds timeout{5000};            // Connect and reply timeout
+        std::chrono::milliseconds reconnect_delay{100};     // Between attempts on one connection
+        bool require_server = true;     // Otherwise connect() succeeds while the server is down,
+                                        // and connections open when requests arrive
+        NearCache::Options near_cache;  // Off unless capacity is set
+    };
+    
+    // Receives the reply line without its newline, e.g. "OK value" or "ERROR NOT_FOUND"
+    using Callback = std::function<void(const std::string& reply)>;
+    
+    CacheClient();
+    explicit CacheClient(Options options);
+    ~CacheClient();
+    
+    // Non-copyable, non-movable
+    CacheClient(const CacheClient&) = delete;
+    CacheClient& operator=(const CacheClient&) = delete;
+    CacheClient(CacheClient&&) = delete;
+    CacheClient& operator=(CacheClient&&) = delete;
+    
+    // Opens the pool and starts the I/O thread; false if the server is
+    // unreachable (and require_server is set) or the host does not resolve
+    bool connect();
+    // Completes outstanding requests with an error and closes the pool
+    void close();
+    bool is_connected() const;
+    
+    // Callbacks run on the I/O thread, so they must not wait on other requests
+    void send(const std::string& command, Callback callback);
+    std::future<std::string> send(const std::string& command);
+    // Blocks for the reply; not for use from a callback
+    std::string send_command(const std::string& command);
+    // Writes the commands together on one connection; callbacks[i] receives the reply to commands[i]
+    void send_batch(const std::vector<std::string>& commands, std::vector<Callback> callbacks);
+    
+    std::future<bool> set(const std::string& key, const std::string& value);
+    // nullopt on a miss or error
+    std::future<std::optional<std::string>> get(const std::string& key);
+    std::future<bool> remove(const std::string& key);
+    // One GET per key, written together on one connection: a single round trip
+    std::future<std::vector<std::optional<std::string>>> mget(const std::vector<std::string>& keys);
+    
+    // nullptr unless near_cache.capacity was set
+    NearCache* near_cache();
+    
+    // Statistics
+    uint64_t requests_sent() const;
+    uint64_t writes() const;        // send() calls; fewer than requests when pipelined
+    uint64_t reconnects() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    
+    struct Pending {
+        Callback callback;
+        Clock::time_point queued_at;
+    };
+    
+    struct Connection {
+        int fd = -1;
+        bool connecting = false;        // Non-blocking connect in progress
+        bool opened_before = false;
+        bool want_write = false;        // EPOLLOUT registered
+        std::string output;             // Requests not yet written
+        std::string input;              // Partial reply
+        std::deque<Pending> pending;    // Written or queued, oldest first
+        Clock::time_point connect_started;
+        Clock::time_point retry_at;     // Earliest reconnect after a failure
+    };
+    
+    // A reply to deliver once mutex_ is released
+    struct Completion {
+        Callback callback;
+        std::string reply;
+    };
+    
+    Options options_;
+    sockaddr_storage address_{};
+    socklen_t address_length_ = 0;
+    
+    mutable std::mutex mutex_;
+    std::vector<Connection> connections_;   // Guarded by mutex_, as are their sockets
+    bool running_ = false;                  // Guarded by mutex_
+    std::atomic<size_t> next_connection_{0};
+    
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::thread io_thread_;
+    std::unique_ptr<NearCache> near_cache_;
+    
+    // Statistics
+    std::atomic<uint64_t> requests_sent_{0};
+    std::atomic<uint64_t> writes_{0};
+    std::atomic<uint64_t> reconnects_{0};
+    
+    // Appends commands to one connection; callbacks of rejected commands go to completions
+    void enqueue(const std::vector<std::string>& commands, std::vector<Callback>& callbacks,
+                 std::vector<Completion>& completions);
+    void wake();
+    void io_loop();
+    void start_connect(size_t index, Clock::time_point now);
+    void finish_connect(size_t index, std::vector<Completion>& completions);
+    void flush(size_t index, std::vector<Completion>& completions);
+    void receive(size_t index, std::vector<Completion>& completions);
+    void fail(size_t index, const std::string& reply, std::vector<Completion>& completions);
+    void update_events(Connection& connection, size_t index);
+    // Puts TRACKING ON ahead of everything queued on a new connection
+    void start_tracking(Connection& connection);
+    // Opens every connection to address_ with blocking waits; all or nothing
+    bool open_pool(std::vector<Connection>& connections);
+    std::vector<std::pair<sockaddr_storage, socklen_t>> resolve() const;
+    static void run(std::vector<Completion>& completions);
+};
+
+} // namespace cache
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+#include "cache.h"
+
+namespace cache {
+
+// Periodically defragments a cache's slab memory in the background (see
+// Cache::compact), so pages freed by deletes and size churn go back to the
+// classes that need them instead of the cache mapping ever more memory.
+class Compactor {
+public:
+    struct Options {
+        std::chrono::milliseconds interval{1000};
+        double max_occupancy = 0.5;     // Emptier pages are evacuated
+        size_t max_pages = 64;          // Per shard and pass, bounding the work
+    };
+    
+    Compactor(Cache& cache, Options options);
+    ~Compactor();
+    
+    // Non-copyable, non-movable
+    Compactor(const Compactor&) = delete;
+    Compactor& operator=(const Compactor&) = delete;
+    Compactor(Compactor&&) = delete;
+    Compactor& operator=(Compactor&&) = delete;
+    
+    void start();
+    void stop();
+    
+    // Statistics
+    size_t passes() const;
+    size_t pages_freed() const;
+    double last_duration_ms() const;
+
+private:
+    Cache& cache_;
+    Options options_;
+    
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stop_requested_{false};
+    
+    std::atomic<size_t> passes_{0};
+    std::atomic<size_t> pages_freed_{0};
+    std::atomic<double> last_duration_ms_{0.0};
+    
+    void run();
+};
+
+} // namespace cache
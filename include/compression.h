@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <optional>
+
+namespace cache {
+
+// LZ4 block compression for large values.
+//
+// Compressed form: uint32 uncompressed_len followed by one LZ4 block, so a
+// value can be expanded without any side information.
+class Compression {
+public:
+    // Returns the compressed form, or nullopt if it would not be smaller
+    static std::optional<std::string> compress(std::string_view value);
+
+    // Returns the original value, or nullopt if data is not a valid block
+    static std::optional<std::string> decompress(std::string_view data);
+};
+
+} // namespace cache
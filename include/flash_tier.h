@@ -0,0 +1,117 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <optional>
+
+#include "cache.h"
+
+namespace cache {
+
+// Second-level store for entries evicted from RAM, kept in a log-structured
+// file on local flash.
+//
+// The file is a ring of fixed-size segments. Demoted entries are appended to
+// an in-memory segment buffer; full buffers are written out by a background
+// thread with one large pwrite, so eviction never waits on the device.
+// Segments are reclaimed FIFO: when the ring wraps, the oldest segment is
+// overwritten and index entries that still point into it are dropped.
+//
+// The index maps a 64-bit key hash to a 16-byte location. Records carry the
+// full key and a checksum, so a hash collision or a torn read shows up as a
+// miss rather than a wrong value.
+//
+// Record: uint32 checksum, uint32 key_len, uint32 value_len, uint8 flags,
+//         uint64 version, key bytes, value bytes
+class FlashTier {
+public:
+    struct Options {
+        std::string path;
+        size_t segment_size = 16 * 1024 * 1024;  // 16MB segments
+        size_t num_segments = 64;                // 1GB file by default
+        size_t max_pending_segments = 4;         // Write-back depth before demotions are dropped
+    };
+
+    // Opaque position of a record, used to detect that a key was overwritten
+    // or removed between find() and erase_if()
+    struct Location {
+        uint64_t segment;
+        uint32_t offset;
+        uint32_t length;
+        
+        bool operator==(const Location& other) const {
+            return segment == other.segment && offset == other.offset && length == other.length;
+        }
+    };
+
+    struct Lookup {
+        Cache::CacheEntry entry;
+        Location location;
+    };
+
+    explicit FlashTier(Options options);
+    ~FlashTier();
+
+    // Non-copyable, non-movable
+    FlashTier(const FlashTier&) = delete;
+    FlashTier& operator=(const FlashTier&) = delete;
+    FlashTier(FlashTier&&) = delete;
+    FlashTier& operator=(FlashTier&&) = delete;
+
+    bool open();
+    void close();
+
+    // Buffers an evicted entry. Returns false if it was dropped instead.
+    bool insert(const Cache::CacheEntry& entry);
+    // Reads key without holding the index lock during I/O
+    std::optional<Lookup> find(const std::string& key);
+    // Removes key only if it is still stored at location
+    bool erase_if(const std::string& key, const Location& location);
+    // Reads the record to confirm the full key before removing it
+    bool erase(const std::string& key);
+    // Hash-only check; a collision shows up later as a miss in find()
+    bool contains(const std::string& key) const;
+    void clear();
+
+    // Statistics
+    size_t size() const;
+    size_t bytes_written() const;
+    size_t reads() const;
+    size_t dropped() const;
+
+private:
+    Options options_;
+    int fd_{-1};
+    
+    mutable std::mutex mutex_;
+    std::unordered_map<uint64_t, Location> index_;
+    std::vector<std::vector<uint64_t>> segment_keys_;  // Key hashes written to each ring slot
+    uint64_t active_segment_{0};
+    std::shared_ptr<std::string> active_buffer_;
+    // Sealed and active segments not yet on disk, readable from memory
+    std::unordered_map<uint64_t, std::shared_ptr<std::string>> in_memory_;
+    std::deque<uint64_t> flush_queue_;
+    
+    std::condition_variable flush_condition_;
+    bool stop_{false};
+    std::thread flusher_;
+    
+    std::atomic<size_t> bytes_written_{0};
+    std::atomic<size_t> reads_{0};
+    std::atomic<size_t> dropped_{0};
+
+    // Copies out the record indexed under key's hash and verifies it
+    std::optional<Location> read_record(const std::string& key, std::string& record);
+    bool roll_segment();
+    bool is_live(uint64_t segment) const;
+    void run_flusher();
+};
+
+} // namespace cache
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+
+namespace cache {
+
+// Ketama-style consistent hashing. Each node owns virtual_nodes points on a
+// 64-bit ring and a key belongs to the first point at or after its hash, so
+// adding or removing one of N nodes moves only about 1/N of the keys. The
+// hash is FNV-1a with a finalizer rather than std::hash, so every client
+// places keys the same way whatever it was built with.
+class HashRing {
+public:
+    explicit HashRing(size_t virtual_nodes = 160);
+    
+    // Returns the node's index; nodes are identified by name, e.g. "host:port"
+    size_t add(const std::string& node);
+    size_t size() const;
+    bool empty() const;
+    const std::string& node_name(size_t index) const;
+    
+    // Index of the node owning the key; the ring must not be empty
+    size_t node_for(const std::string& key) const;
+    // The first node in ring order from the key for which usable(index) is
+    // true, i.e. the owner or its failover; the owner if none is
+    template <typename Usable>
+    size_t node_for(const std::string& key, Usable usable) const;
+    // Up to count distinct nodes in ring order from the key, owner first
+    std::vector<size_t> preference_list(const std::string& key, size_t count) const;
+    
+    static uint64_t hash(const std::string& data);
+
+private:
+    size_t virtual_nodes_;
+    std::vector<std::string> nodes_;
+    std::vector<std::pair<uint64_t, uint32_t>> points_;     // (hash, node), sorted
+    
+    size_t first_point(const std::string& key) const;
+};
+
+template <typename Usable>
+size_t HashRing::node_for(const std::string& key, Usable usable) const {
+    size_t start = first_point(key);
+    for (size_t i = 0; i < points_.size(); ++i) {
+        uint32_t node = points_[(start + i) % points_.size()].second;
+        if (usable(node)) {
+            return node;
+        }
+    }
+    return points_[start].second;
+}
+
+} // namespace cache
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cache {
+
+// High dynamic range histogram of non-negative integer values.
+//
+// Values are grouped into power-of-two buckets, each split into linear
+// sub-buckets, so every recorded value is kept to the requested number of
+// significant decimal digits while the whole range fits in a few tens of KB.
+// Not thread-safe: record into one histogram per thread and merge().
+class HdrHistogram {
+public:
+    // Values above highest_trackable are clamped to it
+    explicit HdrHistogram(uint64_t highest_trackable = 3600ULL * 1000 * 1000,
+                          int significant_digits = 3);
+
+    void record(uint64_t value, uint64_t count = 1);
+    // Closed-loop coordinated omission correction: a response that took longer
+    // than the expected interval between requests also stands in for the
+    // requests that would have been issued while it was outstanding.
+    void record_corrected(uint64_t value, uint64_t expected_interval);
+    // Both histograms must have been created with the same parameters
+    void merge(const HdrHistogram& other);
+    void reset();
+
+    // Statistics
+    uint64_t count() const;
+    uint64_t min() const;
+    uint64_t max() const;
+    double mean() const;
+    // Highest value at or below which percentile percent of recorded values lie
+    uint64_t percentile(double percentile) const;
+    // Recorded values at or below value, to the histogram's precision
+    uint64_t count_at_or_below(uint64_t value) const;
+
+private:
+    uint64_t highest_trackable_;
+    int sub_bucket_half_count_magnitude_;
+    uint64_t sub_bucket_half_count_;
+    uint64_t sub_bucket_mask_;
+    std::vector<uint64_t> counts_;
+    
+    uint64_t total_count_ = 0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+    double sum_ = 0.0;
+
+    size_t index_for(uint64_t value) const;
+    uint64_t highest_equivalent_value(size_t index) const;
+};
+
+} // namespace cache
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+namespace cache {
+
+// Always-on detection of hot (frequently accessed) and big keys.
+//
+// One access in sample_rate is counted in a count-min sketch of relaxed
+// atomic counters. A sampled key whose estimate beats the smallest of the
+// current top-K takes a short try_lock to enter the top-K list; everything
+// else stays lock-free. Every decay_interval samples all counts are
+// halved, so the report follows the current workload rather than history.
+//
+// Big keys are tracked in a second top-K by stored size. Writes only lock
+// when they are larger than the smallest tracked size, so a key that later
+// shrinks or disappears stays listed until correct_size() is told.
+class HotKeys {
+public:
+    struct Options {
+        size_t top_k = 32;              // Candidates kept per list
+        size_t width = 4096;            // Counters per sketch row, rounded up to a power of two
+        size_t depth = 4;               // Sketch rows
+        uint32_t sample_rate = 16;      // Count one access in this many, rounded up to a power of two
+        uint64_t decay_interval = 1 << 18;  // Samples between halvings
+    };
+
+    struct KeyCount {
+        std::string key;
+        uint64_t count;     // Estimated accesses, or bytes for big keys
+    };
+
+    HotKeys();
+    explicit HotKeys(Options options);
+
+    // Non-copyable, non-movable
+    HotKeys(const HotKeys&) = delete;
+    HotKeys& operator=(const HotKeys&) = delete;
+    HotKeys(HotKeys&&) = delete;
+    HotKeys& operator=(HotKeys&&) = delete;
+
+    // Returns true if this access was sampled
+    bool record_access(const std::string& key);
+    void record_size(const std::string& key, size_t size);
+    // Replaces a tracked key's size; 0 drops it from the big keys
+    void correct_size(const std::string& key, size_t size);
+
+    // Highest estimated access count first
+    std::vector<KeyCount> hot_keys(size_t count) const;
+    // Largest first
+    std::vector<KeyCount> big_keys(size_t count) const;
+    // Estimated recent accesses of any key, scaled by the sample rate
+    uint64_t estimate(const std::string& key) const;
+    void reset();
+
+    // Statistics
+    uint64_t samples() const;
+
+private:
+    Options options_;
+    size_t width_mask_;
+    std::unique_ptr<std::atomic<uint32_t>[]> counters_;   // depth rows of width counters
+
+    mutable std::mutex hot_mutex_;
+    std::vector<KeyCount> hot_;                 // Guarded by hot_mutex_, sampled counts
+    std::atomic<uint64_t> hot_min_{0};          // Smallest count in a full hot_, else 0
+
+    mutable std::mutex big_mutex_;
+    std::vector<KeyCount> big_;                 // Guarded by big_mutex_
+    std::atomic<uint64_t> big_min_{0};          // Smallest size in a full big_, else 0
+
+    // Statistics
+    std::atomic<uint64_t> samples_{0};
+
+    size_t slot(uint64_t hash, size_t row) const;
+    uint32_t sketch_min(uint64_t hash) const;
+    void decay();
+    static void refresh_min(const std::vector<KeyCount>& list, size_t capacity, std::atomic<uint64_t>& min);
+    static std::vector<KeyCount> top(std::vector<KeyCount> list, size_t count);
+};
+
+} // namespace cache
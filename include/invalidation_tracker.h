@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <cstdint>
+
+#include "lock_stats.h"
+
+namespace cache {
+
+// Server side of client-side caching. A client that turns tracking on is
+// subscribed to every key it reads; the next write to the key pushes
+// "INVALIDATE key" to it. Subscriptions are one-shot: the client drops its
+// copy, and has to read the key again (subscribing again) to cache it.
+// CLEAR pushes "INVALIDATE *" to every tracking client.
+//
+// A key is tracked before the read that returns it, so a write racing the
+// read always finds the subscription. At most max_keys keys are tracked;
+// beyond that the tracker forgets keys early, invalidating them as if they
+// had been written. Writes with nothing tracked cost one atomic load.
+class InvalidationTracker {
+public:
+    // Delivers a push line, without its newline. Called from the writing
+    // thread, so it must not wait on the client.
+    using Push = std::function<void(const std::string& message)>;
+    
+    explicit InvalidationTracker(size_t max_keys = 1024 * 1024, size_t num_shards = 16);
+    
+    // Non-copyable, non-movable
+    InvalidationTracker(const InvalidationTracker&) = delete;
+    InvalidationTracker& operator=(const InvalidationTracker&) = delete;
+    InvalidationTracker(InvalidationTracker&&) = delete;
+    InvalidationTracker& operator=(InvalidationTracker&&) = delete;
+    
+    // Returns the client's id, never 0
+    uint64_t add_client(Push push);
+    // No push to the client is running or starts once this returns. Its
+    // subscriptions are dropped lazily, when their keys are written.
+    void remove_client(uint64_t client);
+    
+    void track(uint64_t client, const std::string& key);
+    void invalidate(const std::string& key);
+    void invalidate_all();
+    
+    // Statistics
+    size_t clients() const;
+    size_t tracked_keys() const;
+    uint64_t invalidations_sent() const;
+
+private:
+    struct Shard {
+        Mutex mutex{CACHE_LOCK_NAME("tracker_shard")};
+        std::unordered_map<std::string, std::vector<uint64_t>> subscribers;    // Guarded by mutex
+    };
+    
+    size_t max_keys_per_shard_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    
+    mutable SharedMutex clients_mutex_{CACHE_LOCK_NAME("tracker_clients")};
+    std::unordered_map<uint64_t, Push> clients_;    // Guarded by clients_mutex_
+    uint64_t next_client_ = 1;                      // Guarded by clients_mutex_
+    
+    // Statistics
+    std::atomic<size_t> tracked_keys_{0};
+    std::atomic<uint64_t> invalidations_sent_{0};
+    
+    Shard& shard_for(const std::string& key);
+    void push(const std::string& key, const std::vector<uint64_t>& subscribers);
+};
+
+} // namespace cache
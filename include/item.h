@@ -0,0 +1,125 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "slab_allocator.h"
+
+namespace cache {
+
+// One cache entry in a single slab chunk: this header, then the key bytes,
+// then the value bytes. Integers written by INCR/DECR are stored as their
+// 8 native bytes. The links make the item its own hash chain and LRU node,
+// so nothing else is allocated per entry.
+struct Item {
+    static constexpr uint8_t kInteger = 1;
+    static constexpr uint8_t kCompressed = 2;   // Value holds the Compression form
+    static constexpr size_t kMaxKeyLength = UINT16_MAX;
+    static constexpr size_t kMaxValueLength = UINT32_MAX;
+    
+    Item* prev;                 // Towards the most recently used
+    Item* next;                 // Towards the least recently used
+    Item* hash_next;
+    uint64_t version;
+    uint32_t hash;
+    uint32_t last_access;       // now_ticks() when last touched
+    uint32_t value_len;
+    uint16_t key_len;
+    uint8_t flags;
+    
+    std::string_view key() const {
+        return std::string_view(reinterpret_cast<const char*>(this + 1), key_len);
+    }
+    std::string_view value() const {
+        return std::string_view(reinterpret_cast<const char*>(this + 1) + key_len, value_len);
+    }
+    bool is_integer() const { return (flags & kInteger) != 0; }
+    bool is_compressed() const { return (flags & kCompressed) != 0; }
+    int64_t int_value() const;
+    // Stored form; compressed values still need Cache::expand
+    std::string value_string() const;
+    
+    size_t total_size() const { return sizeof(Item) + key_len + value_len; }
+    // Bytes the item takes from its allocator
+    size_t footprint() const { return SlabAllocator::allocation_size(total_size()); }
+    
+    // Callers check the key and value limits first
+    static Item* create(SlabAllocator& allocator, std::string_view key, std::string_view value,
+                        uint8_t flags, uint64_t version, uint32_t hash);
+    static Item* create(SlabAllocator& allocator, std::string_view key, int64_t value,
+                        uint64_t version, uint32_t hash);
+    static void destroy(SlabAllocator& allocator, Item* item);
+    
+    // Coarse monotonic clock, milliseconds, wrapping every ~49 days. Ages
+    // are taken by unsigned subtraction, so they stay right across a wrap.
+    static uint32_t now_ticks();
+    static uint32_t age(uint32_t ticks, uint32_t now) { return now - ticks; }
+};
+
+static_assert(sizeof(Item) == 48, "Item header should stay packed");
+
+// Hash index and LRU list over Items, one per shard and namespace. The
+// bucket array doubles once there is an item per bucket. Not thread-safe:
+// the shard lock guards it. Items are owned by the caller, who allocates
+// them before insert and frees them after remove.
+class ItemTable {
+public:
+    ItemTable();
+    
+    // Non-copyable, non-movable
+    ItemTable(const ItemTable&) = delete;
+    ItemTable& operator=(const ItemTable&) = delete;
+    ItemTable(ItemTable&&) = delete;
+    ItemTable& operator=(ItemTable&&) = delete;
+    
+    Item* find(std::string_view key, uint32_t hash) const;
+    // Adds item as most recently used; the key must not be present
+    void insert(Item* item);
+    void remove(Item* item);
+    // Puts replacement where item was, in the index and the LRU list
+    void replace(Item* item, Item* replacement);
+    // Marks item most recently used
+    void touch(Item* item, uint32_t now);
+    
+    Item* lru() const { return tail_; }
+    size_t size() const { return size_; }
+    size_t index_bytes() const { return buckets_.size() * sizeof(Item*); }
+    
+    // Least recently used first
+    template<typename Fn>
+    void for_each(Fn&& fn) const {
+        for (Item* item = tail_; item; item = item->prev) {
+            fn(*item);
+        }
+    }
+    
+    // Unlinks every item, passing each to fn (which may free it)
+    template<typename Fn>
+    void clear(Fn&& fn) {
+        Item* item = head_;
+        while (item) {
+            Item* next = item->next;
+            fn(item);
+            item = next;
+        }
+        reset();
+    }
+
+private:
+    std::vector<Item*> buckets_;
+    Item* head_ = nullptr;
+    Item* tail_ = nullptr;
+    size_t size_ = 0;
+    
+    Item** bucket_for(uint32_t hash) { return &buckets_[hash & (buckets_.size() - 1)]; }
+    Item** slot_of(Item* item);
+    void link_front(Item* item);
+    void unlink(Item* item);
+    void grow();
+    void reset();
+};
+
+} // namespace cache
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+namespace cache {
+
+// Durations in nanoseconds, recorded without locks. Exact below 4ns, then
+// 4 buckets per power of two (within 25%).
+class DurationHistogram {
+public:
+    static constexpr size_t kBucketCount = 256;
+
+    void record(uint64_t ns);
+
+    struct Snapshot {
+        uint64_t count = 0;
+        uint64_t total_ns = 0;
+        std::vector<uint64_t> buckets = std::vector<uint64_t>(kBucketCount, 0);
+
+        double mean_ns() const;
+        // Upper bound of the bucket holding the given percentile
+        uint64_t percentile_ns(double percentile) const;
+        void merge(const Snapshot& other);
+    };
+
+    Snapshot snapshot() const;
+
+    static size_t bucket_index(uint64_t ns);
+    static uint64_t bucket_upper_bound(size_t index);
+
+private:
+    std::atomic<uint64_t> buckets_[kBucketCount] = {};
+    std::atomic<uint64_t> total_ns_{0};
+};
+
+// Counters of one lock instance. Locks sharing a name (e.g. every cache
+// shard) are summed by LockRegistry.
+struct alignas(64) LockCounters {
+    explicit LockCounters(const char* lock_name) : name(lock_name) {}
+
+    const char* name;
+    std::atomic<uint64_t> acquisitions{0};
+    std::atomic<uint64_t> contended{0};     // Acquisitions that had to wait
+    DurationHistogram wait;                 // Contended acquisitions only
+    DurationHistogram hold;                 // Exclusive holds only
+};
+
+class LockRegistry {
+public:
+    struct LockStats {
+        std::string name;
+        size_t instances = 0;   // Live locks with this name
+        uint64_t acquisitions = 0;
+        uint64_t contended = 0;
+        DurationHistogram::Snapshot wait;
+        DurationHistogram::Snapshot hold;
+    };
+
+    // Never destroyed, so locks in static objects can unregister at exit
+    static LockRegistry& instance();
+
+    void add(LockCounters* counters);
+    // Folds the counters into the name's totals
+    void remove(LockCounters* counters);
+    // One entry per name, sorted by name
+    std::vector<LockStats> snapshot() const;
+
+    // Whether this build instruments the cache's locks (CACHE_LOCK_STATS)
+    static constexpr bool enabled() {
+#if defined(CACHE_LOCK_STATS)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+private:
+    LockRegistry() = default;
+
+    mutable std::mutex mutex_;
+    std::vector<LockCounters*> live_;
+    std::map<std::string, LockStats> retired_;
+};
+
+// std::mutex that counts acquisitions and times waits and holds. An
+// uncontended lock costs a try_lock and two clock reads.
+class InstrumentedMutex {
+public:
+    explicit InstrumentedMutex(const char* name);
+    ~InstrumentedMutex();
+
+    // Non-copyable, non-movable
+    InstrumentedMutex(const InstrumentedMutex&) = delete;
+    InstrumentedMutex& operator=(const InstrumentedMutex&) = delete;
+    InstrumentedMutex(InstrumentedMutex&&) = delete;
+    InstrumentedMutex& operator=(InstrumentedMutex&&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+private:
+    std::mutex mutex_;
+    LockCounters counters_;
+    uint64_t acquired_ns_ = 0;  // Written by the holder only
+};
+
+// std::shared_mutex with the same counters. Shared holds are not timed,
+// since several threads hold the lock at once.
+class InstrumentedSharedMutex {
+public:
+    explicit InstrumentedSharedMutex(const char* name);
+    ~InstrumentedSharedMutex();
+
+    // Non-copyable, non-movable
+    InstrumentedSharedMutex(const InstrumentedSharedMutex&) = delete;
+    InstrumentedSharedMutex& operator=(const InstrumentedSharedMutex&) = delete;
+    InstrumentedSharedMutex(InstrumentedSharedMutex&&) = delete;
+    InstrumentedSharedMutex& operator=(InstrumentedSharedMutex&&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+    void lock_shared();
+    bool try_lock_shared();
+    void unlock_shared();
+
+private:
+    std::shared_mutex mutex_;
+    LockCounters counters_;
+    uint64_t acquired_ns_ = 0;
+};
+
+// The cache's own locks. Declare them as
+//     Mutex mutex_{CACHE_LOCK_NAME("lru_cache")};
+// so that with CACHE_LOCK_STATS off they are plain std types at no cost.
+#if defined(CACHE_LOCK_STATS)
+using Mutex = InstrumentedMutex;
+using SharedMutex = InstrumentedSharedMutex;
+using ConditionVariable = std::condition_variable_any;
+#define CACHE_LOCK_NAME(name) name
+#else
+using Mutex = std::mutex;
+using SharedMutex = std::shared_mutex;
+using ConditionVariable = std::condition_variable;
+#define CACHE_LOCK_NAME(name)
+#endif
+
+} // namespace cache
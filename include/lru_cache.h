@@ -2,9 +2,10 @@
 
 #include <unordered_map>
 #include <list>
-#include <mutex>
 #include <optional>
 
+#include "lock_stats.h"
+
 namespace cache {
 
 template<typename Key, typename Value>
@@ -19,7 +20,7 @@ public:
     LRUCache& operator=(LRUCache&&) = delete;
 
     std::optional<Value> get(const Key& key) {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<Mutex> lock(mutex_);
         
         auto it = cache_map_.find(key);
         if (it == cache_map_.end()) {
@@ -33,8 +34,24 @@ public:
         return std::make_optional(it->second->second);
     }
 
+    // Applies fn to the cached value in place and marks it most recently used.
+    // Returns false (without calling fn) if the key is not present.
+    template<typename Fn>
+    bool update(const Key& key, Fn&& fn) {
+        std::lock_guard<Mutex> lock(mutex_);
+        
+        auto it = cache_map_.find(key);
+        if (it == cache_map_.end()) {
+            return false;
+        }
+        
+        access_order_.splice(access_order_.begin(), access_order_, it->second);
+        fn(it->second->second);
+        return true;
+    }
+
     void put(const Key& key, Value value) {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<Mutex> lock(mutex_);
         
         auto it = cache_map_.find(key);
         if (it != cache_map_.end()) {
@@ -56,8 +73,78 @@ public:
         cache_map_[key] = access_order_.begin();
     }
 
+    // Removes and returns the least recently used entry, if any.
+    std::optional<std::pair<Key, Value>> evict_lru() {
+        std::lock_guard<Mutex> lock(mutex_);
+        
+        if (access_order_.empty()) {
+            return std::nullopt;
+        }
+        
+        auto lru_it = std::prev(access_order_.end());
+        cache_map_.erase(lru_it->first);
+        std::optional<std::pair<Key, Value>> victim(std::move(*lru_it));
+        access_order_.erase(lru_it);
+        return victim;
+    }
+
+    // Removes key and returns its value, if present.
+    std::optional<Value> extract(const Key& key) {
+        std::lock_guard<Mutex> lock(mutex_);
+        
+        auto it = cache_map_.find(key);
+        if (it == cache_map_.end()) {
+            return std::nullopt;
+        }
+        
+        std::optional<Value> value(std::move(it->second->second));
+        access_order_.erase(it->second);
+        cache_map_.erase(it);
+        return value;
+    }
+
+    // Calls fn(value) on the entry for key without touching recency.
+    // Returns false if the key is not present.
+    template<typename Fn>
+    bool peek(const Key& key, Fn&& fn) const {
+        std::lock_guard<Mutex> lock(mutex_);
+        
+        auto it = cache_map_.find(key);
+        if (it == cache_map_.end()) {
+            return false;
+        }
+        
+        fn(it->second->second);
+        return true;
+    }
+    
+    // Calls fn(key, value) on the least recently used entry without touching
+    // recency. Returns false if the cache is empty.
+    template<typename Fn>
+    bool peek_lru(Fn&& fn) const {
+        std::lock_guard<Mutex> lock(mutex_);
+        
+        if (access_order_.empty()) {
+            return false;
+        }
+        
+        const auto& lru = access_order_.back();
+        fn(lru.first, lru.second);
+        return true;
+    }
+
+    // Calls fn(key, value) on every entry from least to most recently used.
+    template<typename Fn>
+    void for_each(Fn&& fn) const {
+        std::lock_guard<Mutex> lock(mutex_);
+        
+        for (auto it = access_order_.rbegin(); it != access_order_.rend(); ++it) {
+            fn(it->first, it->second);
+        }
+    }
+
     bool remove(const Key& key) {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<Mutex> lock(mutex_);
         
         auto it = cache_map_.find(key);
         if (it == cache_map_.end()) {
@@ -70,13 +157,13 @@ public:
     }
 
     void clear() {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<Mutex> lock(mutex_);
         cache_map_.clear();
         access_order_.clear();
     }
 
     size_t size() const {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<Mutex> lock(mutex_);
         return cache_map_.size();
     }
 
@@ -85,7 +172,7 @@ public:
     }
 
     void set_capacity(size_t capacity) {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<Mutex> lock(mutex_);
         capacity_ = capacity;
         
         // Evict excess entries
@@ -97,7 +184,7 @@ public:
     }
 
 private:
-    mutable std::mutex mutex_;
+    mutable Mutex mutex_{CACHE_LOCK_NAME("lru_cache")};
     std::list<std::pair<Key, Value>> access_order_;
     std::unordered_map<Key, typename std::list<std::pair<Key, Value>>::iterator> cache_map_;
     size_t capacity_;
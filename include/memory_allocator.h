@@ -2,14 +2,17 @@
 
 #include <memory>
 #include <vector>
-#include <mutex>
 #include <atomic>
 
+#include "arena.h"
+#include "lock_stats.h"
+
 namespace cache {
 
 class MemoryAllocator {
 public:
-    explicit MemoryAllocator(size_t pool_size = 1024 * 1024); // 1MB default
+    // Pools are mmap'd arenas of pool_size, optionally huge-page backed
+    explicit MemoryAllocator(size_t pool_size = 1024 * 1024, bool huge_pages = false); // 1MB default
     ~MemoryAllocator();
 
     // Non-copyable, non-movable
@@ -37,13 +40,14 @@ private:
         Block(void* p, size_t s) : ptr(p), size(s), in_use(false) {}
     };
 
-    mutable std::mutex mutex_;
-    std::vector<std::unique_ptr<char[]>> pools_;
+    mutable Mutex mutex_{CACHE_LOCK_NAME("memory_allocator")};
+    std::vector<std::unique_ptr<Arena>> pools_;
     std::vector<Block> blocks_;
     
     std::atomic<size_t> allocated_bytes_{0};
     std::atomic<size_t> allocation_count_{0};
     size_t pool_size_;
+    bool huge_pages_;
     size_t current_pool_offset_{0};
 
     void allocate_new_pool();
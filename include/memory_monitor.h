@@ -0,0 +1,94 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <cstdint>
+
+#include "cache.h"
+
+namespace cache {
+
+// Keeps a cache's budget inside its container's memory. Every interval it
+// reads the cgroup v2 memory pressure (PSI "some avg10", the share of time
+// tasks stalled waiting for memory) and the process RSS. Under pressure it
+// shrinks the capacity a step through Cache::set_max_capacity and compacts
+// a few sparse pages per shard so their memory goes back to the OS, leaving
+// the rest to the background Compactor; once pressure clears it grows the
+// capacity back towards its ceiling a step at a time, so the process gives
+// way before the OOM killer picks it.
+class MemoryMonitor {
+public:
+    struct Options {
+        std::string cgroup_path;            // cgroup v2 directory; empty finds the process's own
+        std::chrono::milliseconds interval{1000};
+        double pressure_threshold = 10.0;   // some avg10 percent that counts as pressure
+        double rss_threshold = 0.90;        // Share of memory.max RSS may reach before it does
+        double shrink_step = 0.10;          // Share of the capacity given up per interval
+        double grow_step = 0.05;            // Share of the ceiling taken back per calm interval
+        size_t min_capacity = 16 * 1024 * 1024;
+        // Compaction after each shrink, bounded like a Compactor pass so it
+        // stays cheap while the host is short of memory
+        double compact_occupancy = 0.5;     // Emptier pages are evacuated
+        size_t compact_pages = 8;           // Per shard and shrink
+    };
+    
+    // ceiling is the capacity to grow back to, normally the one at startup
+    MemoryMonitor(Cache& cache, Options options, size_t ceiling);
+    ~MemoryMonitor();
+    
+    // Non-copyable, non-movable
+    MemoryMonitor(const MemoryMonitor&) = delete;
+    MemoryMonitor& operator=(const MemoryMonitor&) = delete;
+    MemoryMonitor(MemoryMonitor&&) = delete;
+    MemoryMonitor& operator=(MemoryMonitor&&) = delete;
+    
+    void start();
+    void stop();
+    // One reading and adjustment; the worker calls it every interval
+    void check();
+    
+    // The process's cgroup v2 directory from /proc/self/cgroup, or empty
+    static std::string find_cgroup();
+    // memory.max in bytes; nullopt when unlimited or unreadable
+    static std::optional<size_t> memory_limit(const std::string& cgroup_path);
+    // some avg10 from memory.pressure, in percent; nullopt without PSI
+    static std::optional<double> memory_pressure(const std::string& cgroup_path);
+    static size_t resident_bytes();
+    // Capacity for a memory limit: what headroom leaves for items, where
+    // headroom is a share of the limit, at least min_headroom bytes
+    static size_t capacity_for(size_t limit, double headroom, size_t min_headroom);
+    
+    // Statistics
+    size_t ceiling() const;
+    std::optional<size_t> limit() const;
+    std::optional<double> pressure() const;     // Last reading
+    size_t rss() const;                         // Last reading
+    size_t shrinks() const;
+    size_t grows() const;
+
+private:
+    Cache& cache_;
+    Options options_;
+    size_t ceiling_;
+    
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stop_requested_{false};
+    
+    // Statistics; a negative value means no reading
+    std::atomic<int64_t> limit_{-1};
+    std::atomic<double> pressure_{-1.0};
+    std::atomic<size_t> rss_{0};
+    std::atomic<size_t> shrinks_{0};
+    std::atomic<size_t> grows_{0};
+    
+    void run();
+};
+
+} // namespace cache
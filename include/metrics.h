@@ -0,0 +1,113 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+
+#include "protocol.h"
+
+namespace cache {
+
+// Per-command request latency, recorded without locks.
+//
+// Each recording thread owns a slot of relaxed atomic counters, so the hot
+// path neither locks nor shares cache lines with other workers. Readers
+// merge every slot on demand; the result may miss requests that are being
+// recorded concurrently but is never torn.
+//
+// Latencies are bucketed log-linearly in microseconds: exact below 16us,
+// then 8 buckets per power of two (within 12.5%).
+class RequestMetrics {
+public:
+    static constexpr size_t kCommandCount = static_cast<size_t>(Protocol::Command::UNKNOWN) + 1;
+    static constexpr size_t kBucketCount = 16 + 36 * 8;
+
+    RequestMetrics();
+    ~RequestMetrics();
+
+    // Non-copyable, non-movable
+    RequestMetrics(const RequestMetrics&) = delete;
+    RequestMetrics& operator=(const RequestMetrics&) = delete;
+    RequestMetrics(RequestMetrics&&) = delete;
+    RequestMetrics& operator=(RequestMetrics&&) = delete;
+
+    // Invalid requests are recorded under UNKNOWN
+    void record(Protocol::Command command, uint64_t latency_us);
+
+    struct CommandStats {
+        uint64_t count = 0;
+        uint64_t total_us = 0;
+        std::vector<uint64_t> buckets = std::vector<uint64_t>(kBucketCount, 0);
+
+        double mean_us() const;
+        // Upper bound of the bucket holding the given percentile
+        uint64_t percentile_us(double percentile) const;
+        uint64_t max_us() const;
+        // Requests whose bucket lies entirely at or below limit_us
+        uint64_t count_at_or_below(uint64_t limit_us) const;
+    };
+
+    // Merged over all threads, indexed by Protocol::Command
+    std::vector<CommandStats> snapshot() const;
+    uint64_t total_requests() const;
+    uint64_t total_latency_us() const;
+    // Recordings that missed the per-thread slot cache and took the lock
+    uint64_t slot_lookups() const;
+
+    static size_t bucket_index(uint64_t value_us);
+    static uint64_t bucket_upper_bound(size_t index);
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> buckets[kCommandCount][kBucketCount] = {};
+        std::atomic<uint64_t> total_us[kCommandCount] = {};
+    };
+
+    const uint64_t id_;     // Distinguishes instances in the per-thread slot cache
+    mutable std::mutex slots_mutex_;
+    std::unordered_map<std::thread::id, std::unique_ptr<Slot>> slots_;
+    std::atomic<uint64_t> slot_lookups_{0};
+
+    Slot& local_slot();
+};
+
+// Serves GET /metrics over plain HTTP on a loopback port, for Prometheus.
+// One connection at a time on its own thread; scrapes are rare and cheap.
+class MetricsHttpServer {
+public:
+    MetricsHttpServer(int port, std::function<std::string()> render);
+    ~MetricsHttpServer();
+
+    // Non-copyable, non-movable
+    MetricsHttpServer(const MetricsHttpServer&) = delete;
+    MetricsHttpServer& operator=(const MetricsHttpServer&) = delete;
+    MetricsHttpServer(MetricsHttpServer&&) = delete;
+    MetricsHttpServer& operator=(MetricsHttpServer&&) = delete;
+
+    bool start();
+    void stop();
+
+    // Statistics
+    size_t scrapes() const;
+
+private:
+    int port_;
+    int server_socket_ = -1;
+    std::function<std::string()> render_;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+
+    // Statistics
+    std::atomic<size_t> scrapes_{0};
+
+    void serve();
+    void handle(int client_socket);
+};
+
+} // namespace cache
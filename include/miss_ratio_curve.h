@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+#include "hdr_histogram.h"
+
+namespace cache {
+
+// Online miss ratio curve estimation with SHARDS (Waldspurger et al., FAST '15).
+//
+// Only keys whose hash falls below a threshold are tracked. For each access
+// to a tracked key, the bytes of other tracked keys touched since its last
+// access are summed and divided by the sampling rate. That is its LRU stack
+// distance in bytes. An LRU cache of C bytes would have hit every access
+// whose distance is at most C, which gives the predicted hit ratio at any
+// capacity from one histogram.
+//
+// Fixed-size variant: once more than max_keys keys are tracked, the
+// threshold drops to evict the keys with the largest hashes. Memory and
+// per-sample cost stay bounded and the rate adapts to the key space.
+// Untracked keys cost one hash and a compare.
+class MissRatioCurve {
+public:
+    struct Options {
+        double initial_rate = 0.01;     // Fraction of the key space tracked at first
+        size_t max_keys = 8192;         // Tracked keys at most
+    };
+
+    struct Point {
+        uint64_t capacity_bytes;
+        double hit_ratio;
+    };
+
+    MissRatioCurve();
+    explicit MissRatioCurve(Options options);
+
+    // Non-copyable, non-movable
+    MissRatioCurve(const MissRatioCurve&) = delete;
+    MissRatioCurve& operator=(const MissRatioCurve&) = delete;
+    MissRatioCurve(MissRatioCurve&&) = delete;
+    MissRatioCurve& operator=(MissRatioCurve&&) = delete;
+
+    // size is the bytes the key occupies; 0 if unknown (e.g. a miss), in
+    // which case its last known size or the tracked average is used
+    void record(const std::string& key, size_t size);
+    // Predicted LRU hit ratio at the given capacity
+    double hit_ratio(uint64_t capacity_bytes) const;
+    std::vector<Point> curve(const std::vector<uint64_t>& capacities) const;
+    void reset();
+
+    // Statistics
+    double sample_rate() const;
+    uint64_t sampled_accesses() const;
+    size_t tracked_keys() const;
+
+private:
+    static constexpr int kThresholdBits = 24;   // Threshold compared against the hash's top bits
+
+    struct Tracked {
+        uint64_t time;      // Position in tree_
+        uint64_t size;
+    };
+
+    const uint64_t id_;                 // Distinguishes instances in the per-thread reference batch
+    Options options_;
+    std::atomic<uint64_t> threshold_;   // Hashes whose top bits are below this are tracked
+
+    mutable std::mutex mutex_;
+    std::map<uint64_t, Tracked> keys_;  // By hash, so the largest are evicted first
+    std::vector<int64_t> tree_;         // Fenwick tree: bytes of keys last accessed at each time
+    uint64_t clock_ = 0;
+    uint64_t tracked_bytes_ = 0;
+    HdrHistogram distances_;            // Scaled reuse distances in bytes
+    uint64_t accesses_ = 0;             // Weighted, including first accesses, which miss at any size
+
+    // Statistics
+    uint64_t samples_ = 0;              // Guarded by mutex_
+    std::atomic<uint64_t> references_{0};  // Every record() call, sampled or not
+
+    void add(uint64_t time, int64_t bytes);
+    int64_t prefix_sum(uint64_t time) const;
+    void compact();
+    void lower_threshold();
+    double rate() const;
+    static uint64_t threshold_for(double rate);
+};
+
+} // namespace cache
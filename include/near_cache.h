@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <optional>
+#include <chrono>
+#include <cstdint>
+
+#include "lru_cache.h"
+
+namespace cache {
+
+// In-process L1 in front of the server for CacheClient: a bounded, sharded
+// LRU of recent GET replies, kept coherent by the server's invalidation
+// pushes (TRACKING ON). Entries also expire after ttl, which bounds how long
+// a value can be served stale if a push is lost, e.g. with the connection.
+//
+// A fill races invalidations of its key: the reply may have been read on
+// the server before a write whose push arrives first. So a fill carries
+// the key's epoch from before its request was sent, and is discarded if an
+// invalidation has bumped the epoch since. Epochs live in a fixed table of
+// buckets, so an invalidation may also discard fills of unrelated keys.
+class NearCache {
+public:
+    struct Options {
+        size_t capacity = 0;                    // Entries; 0 disables the near cache
+        std::chrono::milliseconds ttl{1000};    // Longest an entry is served without the server
+        size_t shards = 16;
+    };
+    
+    NearCache();
+    explicit NearCache(Options options);
+    
+    // Non-copyable, non-movable
+    NearCache(const NearCache&) = delete;
+    NearCache& operator=(const NearCache&) = delete;
+    NearCache(NearCache&&) = delete;
+    NearCache& operator=(NearCache&&) = delete;
+    
+    std::optional<std::string> get(const std::string& key);
+    // Call before sending the GET; pass the result to fill()
+    uint64_t begin_fill(const std::string& key) const;
+    // Caches the reply unless the key was invalidated since begin_fill
+    void fill(const std::string& key, const std::string& value, uint64_t token);
+    void invalidate(const std::string& key);
+    void invalidate_all();
+    
+    size_t size() const;
+    const Options& options() const;
+    
+    // Statistics
+    uint64_t hits() const;
+    uint64_t misses() const;
+    uint64_t invalidations() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr size_t kEpochBuckets = 1024;
+    
+    struct Entry {
+        std::string value;
+        Clock::time_point expires_at;
+    };
+    
+    Options options_;
+    std::vector<std::unique_ptr<LRUCache<std::string, Entry>>> shards_;
+    std::unique_ptr<std::atomic<uint64_t>[]> epochs_;
+    
+    // Statistics
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> invalidations_{0};
+    
+    LRUCache<std::string, Entry>& shard_for(size_t hash) const;
+    std::atomic<uint64_t>& epoch_for(size_t hash) const;
+};
+
+} // namespace cache
@@ -0,0 +1,20 @@
+#pragma once
+
+// USDT probes in the request path, provider "hpcache". They compile to a
+// single nop unless a tracer is attached, e.g.
+//   bpftrace -e 'usdt:./cache_server:hpcache:lookup { @us[str(arg1)] = hist(arg2); }'
+//
+//   parse(command, key, request_bytes)     after a request line is parsed
+//   lookup(command, key, execute_us)       after the cache operation returns
+//   send(command, response_bytes, send_us) after the response is written
+//
+// command is the Protocol::Command value and key a NUL-terminated string.
+// Built only when CMake finds <sys/sdt.h> (systemtap-sdt-dev) and
+// CACHE_USDT is on; otherwise the macros expand to nothing.
+
+#if defined(CACHE_HAVE_USDT)
+#include <sys/sdt.h>
+#define CACHE_PROBE3(name, a, b, c) DTRACE_PROBE3(hpcache, name, a, b, c)
+#else
+#define CACHE_PROBE3(name, a, b, c) do {} while (0)
+#endif
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -13,6 +14,17 @@ public:
         DELETE,
         CLEAR,
         STATS,
+        INCR,
+        DECR,
+        GETS,
+        CAS,
+        BGSAVE,
+        SLOWLOG,
+        HOTKEYS,
+        BIGKEYS,
+        TRACKING,
+        SYNC,
+        SELECT,
         UNKNOWN
     };
 
@@ -20,6 +32,8 @@ public:
         Command command;
         std::string key;
         std::string value;
+        int64_t delta = 1;      // INCR/DECR amount, SLOWLOG GET/HOTKEYS/BIGKEYS count
+        uint64_t version = 0;   // CAS expected version, SYNC offset
         bool valid;
     };
 
@@ -33,9 +47,12 @@ public:
     static std::string format_response(const Response& response);
     static std::string format_error(const std::string& error);
     static std::string format_success(const std::string& data = "");
+    // Lower-case name, as used in STATS keys and metric labels
+    static const char* command_name(Command command);
 
 private:
     static std::vector<std::string> split(const std::string& str, char delimiter);
+    static std::string join(const std::vector<std::string>& parts, size_t first);
     static Command parse_command(const std::string& cmd);
 };
 
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace cache {
+
+class Cache;
+
+// Evicts in the background so writes find free memory waiting (see
+// Cache::reclaim). The cache wakes it once free memory drops below the low
+// watermark; it also runs every interval to catch shards that filled up
+// unevenly. Attach it with Cache::attach_reclaimer.
+class Reclaimer {
+public:
+    struct Options {
+        double low_watermark = 0.05;    // Free share of capacity that triggers eviction
+        double high_watermark = 0.10;   // Free share eviction stops at
+        size_t batch_size = 64;         // Items per shard lock hold
+        std::chrono::milliseconds interval{100};
+    };
+    
+    Reclaimer(Cache& cache, Options options);
+    ~Reclaimer();
+    
+    // Non-copyable, non-movable
+    Reclaimer(const Reclaimer&) = delete;
+    Reclaimer& operator=(const Reclaimer&) = delete;
+    Reclaimer(Reclaimer&&) = delete;
+    Reclaimer& operator=(Reclaimer&&) = delete;
+    
+    void start();
+    void stop();
+    // Cheap when a pass is already pending, so writers may call it freely
+    void wake();
+    const Options& options() const;
+    
+    // Statistics
+    size_t passes() const;
+    size_t items_evicted() const;
+    uint64_t time_us() const;           // Spent in passes, total
+    double last_duration_ms() const;
+
+private:
+    Cache& cache_;
+    Options options_;
+    
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stop_requested_{false};
+    std::atomic<bool> wake_requested_{false};
+    
+    std::atomic<size_t> passes_{0};
+    std::atomic<size_t> items_evicted_{0};
+    std::atomic<uint64_t> time_ns_{0};
+    std::atomic<double> last_duration_ms_{0.0};
+    
+    void run();
+};
+
+} // namespace cache
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <optional>
+
+namespace cache {
+
+// One benchmark metric measured over several repetitions.
+struct Metric {
+    std::string name;               // "<scenario>.<metric>", e.g. "cache_get.p99_ns"
+    bool higher_is_better = true;   // Throughput; latency and bytes per entry are lower-is-better
+    std::vector<double> samples;    // One per repetition
+
+    double mean() const;
+    double stddev() const;
+};
+
+// Baseline results and the comparison against them.
+//
+// Baseline file (JSON):
+//   { "version": 1,
+//     "metrics": [ { "name": "...", "higher_is_better": true, "samples": [ ... ] }, ... ] }
+//
+// A metric regresses when its mean moved in the bad direction by more than
+// the tolerance AND Welch's t-test says the move is significant at alpha.
+// Noise alone therefore cannot fail the gate, and neither can a significant
+// but negligible shift.
+class Regression {
+public:
+    struct Options {
+        double tolerance = 0.10;    // Relative change allowed before flagging
+        double alpha = 0.05;        // Two-sided significance level
+    };
+
+    struct Comparison {
+        std::string name;
+        double baseline_mean = 0.0;
+        double current_mean = 0.0;
+        double change = 0.0;        // Relative; positive means worse
+        double p_value = 1.0;
+        bool regressed = false;
+        bool improved = false;
+        bool missing = false;       // In the baseline but not measured now
+    };
+
+    // Returns nullopt if the file is missing or malformed
+    static std::optional<std::vector<Metric>> load(const std::string& path);
+    static bool save(const std::string& path, const std::vector<Metric>& metrics);
+
+    // One comparison per baseline metric, in baseline order
+    static std::vector<Comparison> compare(const std::vector<Metric>& baseline,
+                                           const std::vector<Metric>& current,
+                                           const Options& options);
+
+    // Two-sided p-value of Welch's unequal-variance t-test
+    static double welch_p_value(const std::vector<double>& a, const std::vector<double>& b);
+};
+
+} // namespace cache
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <cstdint>
+
+#include "cache.h"
+
+namespace cache {
+
+// Primary side of primary/replica replication.
+//
+// Mutations are appended to an in-memory ring (the backlog) in the write
+// log's record layout without the checksum, TCP already covers that:
+//   uint32 payload_len, payload: uint8 op, uint8 flags, uint64 version,
+//                                uint32 key_len, uint32 value_len, key, value
+// The replication offset is the number of backlog bytes ever appended, so a
+// replica's offset names the next byte it needs.
+//
+// A replica sends "SYNC id offset". If id is this primary's and the offset
+// is still in the backlog, the reply is "OK CONTINUE offset" and the stream
+// resumes there. Otherwise the reply is "OK FULLSYNC id offset", followed
+// by every entry as a SET record (copied one shard at a time), a
+// SNAPSHOT_END record, and the stream from offset on. Records appended
+// while the shards are copied are sent again after SNAPSHOT_END; replaying
+// them is harmless since each carries the entry's resulting state. While
+// idle the primary sends a PING record carrying its offset, and the replica
+// acknowledges with "ACK offset" lines.
+//
+// The backlog only starts recording once a replica has synced, so a server
+// without replicas pays one relaxed load per write.
+class ReplicationPrimary {
+public:
+    enum class Op : uint8_t {
+        SET = 1,
+        REMOVE = 2,
+        CLEAR = 3,
+        SNAPSHOT_END = 4,   // version holds the offset the stream continues from
+        PING = 5            // version holds the primary's offset; not in the backlog
+    };
+    
+    struct Options {
+        size_t backlog_bytes = 16 * 1024 * 1024;        // How far behind a replica can resume from
+        std::chrono::milliseconds ping_interval{1000};
+    };
+    
+    struct ReplicaState {
+        std::string address;
+        uint64_t acked_offset = 0;
+        bool loading = true;            // Still receiving the full sync
+    };
+    
+    ReplicationPrimary(const Cache& cache, Options options);
+    ~ReplicationPrimary();
+    
+    // Non-copyable, non-movable
+    ReplicationPrimary(const ReplicationPrimary&) = delete;
+    ReplicationPrimary& operator=(const ReplicationPrimary&) = delete;
+    ReplicationPrimary(ReplicationPrimary&&) = delete;
+    ReplicationPrimary& operator=(ReplicationPrimary&&) = delete;
+    
+    // Called by Cache under the shard lock of the key being mutated, which
+    // keeps per-key backlog order identical to apply order
+    void append_set(const Cache::CacheEntry& entry);
+    void append_remove(const std::string& key);
+    void append_clear();
+    // False until a replica has synced; lets callers skip building records
+    bool recording() const;
+    
+    // Answers "SYNC [id offset]" on socket and streams to the replica until
+    // it disconnects, falls out of the backlog, or stop() is called
+    void serve(int socket, const std::string& id, std::optional<uint64_t> offset);
+    void stop();
+    
+    // Statistics
+    const std::string& id() const;
+    uint64_t offset() const;
+    uint64_t backlog_start() const;     // Oldest offset a replica can resume from
+    std::vector<ReplicaState> replicas() const;
+    size_t full_syncs() const;
+    size_t partial_syncs() const;
+    
+    // Encodes one record in the stream format
+    static void encode(std::string& out, Op op, uint8_t flags, uint64_t version,
+                       const std::string& key, const char* value, size_t value_len);
+    static void encode_entry(std::string& out, const Cache::CacheEntry& entry);
+
+private:
+    const Cache& cache_;
+    Options options_;
+    std::string id_;
+    std::atomic<bool> active_{false};
+    
+    mutable std::mutex mutex_;
+    std::condition_variable appended_;
+    std::string backlog_;               // Ring of backlog_bytes; guarded by mutex_
+    uint64_t offset_ = 0;               // Guarded by mutex_
+    bool stop_ = false;                 // Guarded by mutex_
+    std::list<ReplicaState> replicas_;  // Guarded by mutex_
+    
+    // Statistics
+    std::atomic<size_t> full_syncs_{0};
+    std::atomic<size_t> partial_syncs_{0};
+    
+    void append(const std::string& record);
+    // Copies backlog bytes from position on, up to max_bytes; false if position was overwritten
+    bool read(uint64_t position, std::string& out, size_t max_bytes) const;
+    bool send_snapshot(int socket);
+};
+
+// Replica side: keeps a local Cache in step with a primary. Runs on its own
+// thread, reconnecting after retry_delay whenever the link drops and
+// resuming from its offset when the primary still has it.
+class ReplicaLink {
+public:
+    struct Options {
+        std::string host;
+        int port = 8080;
+        std::chrono::milliseconds retry_delay{1000};
+        std::chrono::milliseconds ack_interval{1000};
+    };
+    
+    ReplicaLink(Cache& cache, Options options);
+    ~ReplicaLink();
+    
+    // Non-copyable, non-movable
+    ReplicaLink(const ReplicaLink&) = delete;
+    ReplicaLink& operator=(const ReplicaLink&) = delete;
+    ReplicaLink(ReplicaLink&&) = delete;
+    ReplicaLink& operator=(ReplicaLink&&) = delete;
+    
+    void start();
+    void stop();
+    
+    // Statistics
+    std::string primary() const;        // "host:port"
+    bool link_up() const;               // Synced and streaming
+    uint64_t offset() const;            // Applied up to here
+    uint64_t primary_offset() const;    // As of the primary's last record or ping
+    int64_t last_io_ms() const;         // Since data last arrived; -1 if never
+    size_t full_syncs() const;
+    size_t partial_syncs() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    
+    Cache& cache_;
+    Options options_;
+    std::thread worker_;
+    
+    std::mutex mutex_;
+    std::condition_variable stop_condition_;
+    bool stop_ = false;                 // Guarded by mutex_
+    int socket_ = -1;                   // Guarded by mutex_, for stop() to interrupt
+    std::string id_;                    // Only touched by the worker
+    
+    // Statistics
+    std::atomic<bool> link_up_{false};
+    std::atomic<bool> synced_{false};   // offset_ is meaningful
+    std::atomic<uint64_t> offset_{0};
+    std::atomic<uint64_t> primary_offset_{0};
+    std::atomic<int64_t> last_io_ns_{0};
+    std::atomic<size_t> full_syncs_{0};
+    std::atomic<size_t> partial_syncs_{0};
+    
+    void run();
+    // One connection: handshake, then apply records until the link drops
+    void session(int socket);
+    // Applies complete records at the front of buffer; false on a malformed one
+    bool apply(std::string& buffer, bool& loading);
+    int connect_to_primary() const;
+};
+
+} // namespace cache
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <future>
+#include <optional>
+#include <chrono>
+#include <cstdint>
+
+#include "cache_client.h"
+#include "hash_ring.h"
+
+namespace cache {
+
+// Spreads keys over several cache_server nodes with a consistent hash ring,
+// with one CacheClient (and connection pool) per node.
+//
+// A request that fails with a transport error (not connected, connection
+// lost, timeout) marks its node down for down_time and is retried on the
+// next node in ring order, so requests skip a dead node without waiting for
+// it. Keys owned by the dead node are served by their failover node until it
+// comes back, then move home; entries written meanwhile are not copied back.
+// Multi-key batches are split per node and the per-node batches are in
+// flight at the same time.
+class ShardedClient {
+public:
+    struct Options {
+        std::vector<std::string> nodes;                 // "host:port"
+        size_t virtual_nodes = 160;                     // Ring points per node
+        std::chrono::milliseconds down_time{1000};      // How long a failed node is skipped
+        CacheClient::Options client;                    // Per node; host and port are replaced
+    };
+    
+    ShardedClient();
+    explicit ShardedClient(Options options);
+    ~ShardedClient();
+    
+    // Non-copyable, non-movable
+    ShardedClient(const ShardedClient&) = delete;
+    ShardedClient& operator=(const ShardedClient&) = delete;
+    ShardedClient(ShardedClient&&) = delete;
+    ShardedClient& operator=(ShardedClient&&) = delete;
+    
+    // Starts a client per node; false if a node is malformed or none is reachable
+    bool connect();
+    void close();
+    
+    // Sends a command about key to its node, without failover
+    void send(const std::string& key, const std::string& command, CacheClient::Callback callback);
+    std::future<bool> set(const std::string& key, const std::string& value);
+    std::future<std::optional<std::string>> get(const std::string& key);
+    std::future<bool> remove(const std::string& key);
+    // One batch per node, all in flight at once; values in key order
+    std::future<std::vector<std::optional<std::string>>> mget(const std::vector<std::string>& keys);
+    
+    // Node currently serving the key: its owner, or the failover while the owner is down
+    size_t node_for(const std::string& key) const;
+    size_t node_count() const;
+    const std::string& node_name(size_t index) const;
+    // For per-node commands such as STATS and CLEAR
+    CacheClient& node(size_t index);
+    bool is_down(size_t index) const;
+    
+    // Statistics
+    uint64_t failovers() const;
+
+private:
+    struct Node {
+        std::string name;
+        std::unique_ptr<CacheClient> client;
+        std::atomic<int64_t> down_until_ns{0};  // steady_clock time
+    };
+    
+    Options options_;
+    HashRing ring_;
+    std::vector<std::unique_ptr<Node>> nodes_;
+    std::atomic<bool> running_{false};
+    
+    // Statistics
+    std::atomic<uint64_t> failovers_{0};
+    
+    void send_with_failover(const std::string& key, const std::string& command,
+                            CacheClient::Callback done, size_t retries);
+    // Wraps done so a transport error marks node down and retries elsewhere
+    CacheClient::Callback with_failover(size_t node, const std::string& key, const std::string& command,
+                                        CacheClient::Callback done, size_t retries);
+    void mark_down(size_t index);
+};
+
+} // namespace cache
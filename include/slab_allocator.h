@@ -0,0 +1,120 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+#include "arena.h"
+
+namespace cache {
+
+// Size-class allocator for cache items, one per cache shard.
+//
+// Requests are rounded up to a size class (64 bytes, then 1.25x steps to a
+// quarter page). Each class carves its chunks out of its own kPageSize
+// pages, and each page keeps a header with its own free list and a bitmap
+// of live chunks, so an item costs one chunk and no per-allocation header.
+// Larger requests go to the global heap at their exact size.
+//
+// Pages are cut from mmap'd Arenas of Options::arena_size, aligned to
+// kPageSize so a chunk finds its page by masking its address. A class keeps
+// its pages until compact() moves the live chunks off one, or
+// release_pages() hands everything back when the allocator is empty.
+//
+// Not thread-safe: the owning shard's lock guards it.
+class SlabAllocator {
+public:
+    static constexpr size_t kPageSize = 64 * 1024;
+    static constexpr size_t kPageHeaderSize = 256;
+    static constexpr size_t kMinChunkSize = 64;
+    static constexpr size_t kMaxChunkSize = (kPageSize - kPageHeaderSize) / 4;
+    static constexpr uint8_t kLargeClass = 0xFF;
+
+    struct ClassStats {
+        size_t chunk_size;
+        size_t pages;
+        size_t used_chunks;
+        size_t free_chunks;     // On a page's free list or not carved yet
+        size_t evictions;       // Reported through record_eviction
+        size_t pages_compacted; // Emptied by compact()
+    };
+
+    // Called with a chunk's old and new address after its bytes were copied
+    using RelocateFn = std::function<void(void* from, void* to)>;
+
+    explicit SlabAllocator(Arena::Options options = {});
+    ~SlabAllocator();
+
+    // Non-copyable, non-movable
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+    SlabAllocator(SlabAllocator&&) = delete;
+    SlabAllocator& operator=(SlabAllocator&&) = delete;
+
+    // size must be passed back unchanged to deallocate
+    void* allocate(size_t size);
+    void deallocate(void* ptr, size_t size);
+
+    // Applies to arenas mapped from now on
+    void configure(Arena::Options options);
+    // Maps arenas for at least bytes of pages now, faulted in if prefault is set
+    void reserve(size_t bytes);
+    // Returns every page to the free pool and their memory to the OS. Only
+    // while no chunk is allocated; large allocations are unaffected.
+    void release_pages();
+
+    // Moves the live chunks of the class's emptiest page into free chunks on
+    // its other pages, calling relocate for each, and returns the page to
+    // the free pool (and its memory to the OS, unless on huge pages). Does
+    // nothing and returns false if that page is fuller than max_occupancy or
+    // the other pages lack the room.
+    bool compact(uint8_t slab_class, double max_occupancy, const RelocateFn& relocate);
+    // Eviction pressure, for choosing which classes to take pages from
+    void record_eviction(size_t size);
+
+    // Class of a request; kLargeClass past kMaxChunkSize
+    static uint8_t class_for(size_t size);
+    static size_t num_classes();
+    static size_t chunk_size(uint8_t slab_class);
+    static size_t chunks_per_page(uint8_t slab_class);
+    // Bytes a request of size really takes
+    static size_t allocation_size(size_t size);
+
+    // Statistics
+    size_t reserved_bytes() const;      // Pages held by classes plus large allocations
+    size_t mapped_bytes() const;        // Arenas, carved or not
+    size_t used_bytes() const;          // Chunks handed out plus large allocations
+    size_t large_bytes() const;
+    size_t free_pages() const;          // Carved from an arena, held by no class
+    std::vector<ClassStats> class_stats() const;
+
+private:
+    struct Page;
+
+    struct SlabClass {
+        std::vector<Page*> pages;
+        Page* partial = nullptr;        // Pages with a free or uncarved chunk
+        size_t used_chunks = 0;
+        size_t evictions = 0;
+        size_t pages_compacted = 0;
+    };
+
+    std::vector<SlabClass> classes_;
+    size_t large_bytes_ = 0;
+    Arena::Options options_;
+    std::vector<std::unique_ptr<Arena>> arenas_;
+    std::vector<char*> free_pages_;
+    char* arena_next_ = nullptr;        // Uncarved tail of the newest arena
+    char* arena_end_ = nullptr;
+
+    static Page* page_of(void* chunk);
+    char* take_page();
+    void map_arena();
+    void link_partial(SlabClass& slab, Page* page);
+    void unlink_partial(SlabClass& slab, Page* page);
+    void retire_page(SlabClass& slab, Page* page);
+};
+
+} // namespace cache
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+namespace cache {
+
+// Bounded log of the slowest requests, like Redis SLOWLOG.
+//
+// Writers never block: each claims the next slot of a ring with fetch_add
+// and fills it under a per-slot sequence number (odd while being written).
+// If a slot is still being written by a writer that lapped the ring, the
+// new entry is dropped rather than waited for. Readers copy a slot and
+// skip it if its sequence number changed underneath them.
+class SlowLog {
+public:
+    static constexpr size_t kMaxKeyLength = 64;  // Longer keys are truncated
+
+    struct Entry {
+        uint64_t id = 0;            // Increases by one per logged request
+        uint64_t timestamp_us = 0;  // Wall clock, microseconds since the epoch
+        std::string command;
+        std::string key;
+        uint64_t value_size = 0;
+        uint64_t queue_wait_us = 0; // Waiting for a worker, or behind pipelined requests
+        uint64_t lock_wait_us = 0;  // Blocked on cache shard locks
+        uint64_t execute_us = 0;    // Parse and execute, including lock waits
+        uint64_t send_us = 0;
+
+        uint64_t total_us() const {
+            return queue_wait_us + execute_us + send_us;
+        }
+    };
+
+    // A negative threshold disables the log; 0 logs every request
+    explicit SlowLog(size_t capacity = 128, int64_t threshold_us = 10000);
+
+    // Non-copyable, non-movable
+    SlowLog(const SlowLog&) = delete;
+    SlowLog& operator=(const SlowLog&) = delete;
+    SlowLog(SlowLog&&) = delete;
+    SlowLog& operator=(SlowLog&&) = delete;
+
+    bool should_log(uint64_t total_us) const;
+    // Assigns the entry's id and timestamp
+    void record(const Entry& entry);
+    // Newest first, at most count entries
+    std::vector<Entry> get(size_t count) const;
+    // Forgets every entry logged so far
+    void reset();
+
+    void set_threshold_us(int64_t threshold_us);
+    int64_t threshold_us() const;
+    size_t capacity() const;
+    // Entries currently retrievable
+    size_t size() const;
+
+    // Statistics
+    uint64_t logged() const;
+    uint64_t dropped() const;
+
+private:
+    static constexpr size_t kKeyWords = kMaxKeyLength / sizeof(uint64_t);
+
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};  // 2 * (id + 1) when complete, odd while writing
+        std::atomic<uint64_t> timestamp_us{0};
+        std::atomic<uint64_t> value_size{0};
+        std::atomic<uint64_t> queue_wait_us{0};
+        std::atomic<uint64_t> lock_wait_us{0};
+        std::atomic<uint64_t> execute_us{0};
+        std::atomic<uint64_t> send_us{0};
+        std::atomic<uint64_t> key[kKeyWords] = {};
+        std::atomic<uint32_t> key_length{0};
+        std::atomic<uint32_t> command_length{0};
+        std::atomic<uint64_t> command{0};   // Up to 8 bytes of command name
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t capacity_;
+    std::atomic<int64_t> threshold_us_;
+    std::atomic<uint64_t> next_id_{0};
+    std::atomic<uint64_t> reset_id_{0};     // Entries with smaller ids were reset away
+
+    // Statistics
+    std::atomic<uint64_t> dropped_{0};
+};
+
+} // namespace cache
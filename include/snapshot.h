@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <optional>
+
+#include "cache.h"
+
+namespace cache {
+
+// Compact binary snapshot of a Cache.
+//
+// Layout (native little-endian integers, no padding):
+//   header   : char magic[8] = "HPCSNAP1", uint32 format_version, uint32 section_count
+//   table    : section_count x { uint64 offset, uint64 length, uint64 entry_count }
+//   sections : one per cache shard, records ordered least to most recently used
+//   record   : uint32 key_len, uint32 value_len, uint64 version, int64 expires_at_ms,
+//              int64 age_ns, uint8 flags, key bytes, value bytes
+//
+// Integer entries (flags & 1) store their value as 8 raw int64 bytes.
+// Compressed entries (flags & 2) store the Compression form unchanged.
+// expires_at_ms is wall-clock milliseconds, 0 meaning the entry never expires.
+// age_ns is how long before the start of the dump the entry was last used.
+class Snapshot {
+public:
+    // Walks the cache one shard at a time, so writers only ever wait on the
+    // shard currently being copied. Output goes to a temporary file that is
+    // fsynced and renamed over path once complete, and the directory is
+    // fsynced, so the snapshot is durable when save returns true. Saves to
+    // the same path are serialized.
+    static bool save(const Cache& cache, const std::string& path);
+
+    // Memory-maps path and restores its sections in parallel. Returns the
+    // number of entries restored, or nullopt if the file is missing or corrupt.
+    static std::optional<size_t> load(Cache& cache, const std::string& path,
+                                      size_t num_threads = std::thread::hardware_concurrency());
+};
+
+// Periodically dumps a cache in the background, or on demand via request().
+class SnapshotWriter {
+public:
+    SnapshotWriter(const Cache& cache, std::string path, std::chrono::seconds interval);
+    ~SnapshotWriter();
+
+    // Non-copyable, non-movable
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+    SnapshotWriter(SnapshotWriter&&) = delete;
+    SnapshotWriter& operator=(SnapshotWriter&&) = delete;
+
+    void start();
+    void stop();
+    void request();
+
+    // Statistics
+    size_t snapshots_written() const;
+    size_t snapshot_failures() const;
+    double last_duration_ms() const;
+    bool in_progress() const;
+
+private:
+    const Cache& cache_;
+    std::string path_;
+    std::chrono::seconds interval_;
+    
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stop_requested_{false};
+    bool save_requested_{false};
+    
+    std::atomic<bool> in_progress_{false};
+    std::atomic<size_t> snapshots_written_{0};
+    std::atomic<size_t> snapshot_failures_{0};
+    std::atomic<double> last_duration_ms_{0.0};
+
+    void run();
+};
+
+} // namespace cache
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <chrono>
 #include <memory>
 #include <atomic>
 #include <thread>
@@ -11,6 +12,18 @@
 
 #include "thread_pool.h"
 #include "cache.h"
+#include "snapshot.h"
+#include "compactor.h"
+#include "reclaimer.h"
+#include "memory_monitor.h"
+#include "write_log.h"
+#include "flash_tier.h"
+#include "metrics.h"
+#include "protocol.h"
+#include "slow_log.h"
+#include "invalidation_tracker.h"
+#include "replication.h"
+#include "lock_stats.h"
 
 namespace cache {
 
@@ -29,27 +42,100 @@ public:
     void stop();
     bool is_running() const;
 
+    Cache& cache();
+    // Requests slower than its threshold, end to end on the server
+    SlowLog& slow_log();
+    // Starts a background writer that dumps the cache to path every interval
+    // and whenever a client sends BGSAVE.
+    void enable_snapshots(const std::string& path, std::chrono::seconds interval);
+    // Starts a background compactor that defragments the cache's slab memory
+    void enable_compactor(const Compactor::Options& options);
+    // Evicts in the background to keep free headroom (see Reclaimer)
+    void enable_reclaimer(const Reclaimer::Options& options);
+    // Shrinks the cache under memory pressure and grows it back to its
+    // current capacity (see MemoryMonitor)
+    void enable_memory_monitor(const MemoryMonitor::Options& options);
+    // Opens the write log and attaches it to the cache. Replay it first.
+    bool enable_write_log(const WriteLog::Options& options);
+    // Opens the flash file and demotes evicted entries to it
+    bool enable_flash_tier(const FlashTier::Options& options);
+    // Serves Prometheus text at http://127.0.0.1:port/metrics
+    bool enable_metrics_endpoint(int port);
+    // Keys read by clients that sent TRACKING ON
+    InvalidationTracker& invalidation_tracker();
+    // Serves SYNC, so replicas can follow this server
+    void enable_replication(const ReplicationPrimary::Options& options);
+    // Follows a primary and rejects writes from clients. Call before start().
+    void enable_replica(const ReplicaLink::Options& options);
+    // Adds a cache namespace (see Cache::add_namespace) with its own
+    // latency metrics. Call before start().
+    bool add_namespace(const std::string& name, size_t quota);
+
     // Statistics
     size_t connections_handled() const;
+    size_t active_connections() const;
     size_t requests_processed() const;
     double average_response_time() const;
+    const RequestMetrics& request_metrics() const;
+    // Prometheus text exposition format
+    std::string prometheus_metrics() const;
 
 private:
+    // Per-connection state
+    struct Connection {
+        int socket;
+        Mutex send_mutex{CACHE_LOCK_NAME("connection_send")};  // Held while writing to the socket
+        Mutex push_mutex{CACHE_LOCK_NAME("connection_push")};
+        std::string pending_pushes;     // Invalidation lines not yet written, guarded by push_mutex
+        bool pushes_overflowed = false; // pending_pushes was capped to INVALIDATE *, guarded by push_mutex
+        uint64_t tracking_id = 0;       // InvalidationTracker client while tracking is on
+        bool replica = false;           // Sent SYNC; the rest of the connection is a replication stream
+        std::string key_prefix;         // "name:" after SELECT name; empty in the default namespace
+        
+        explicit Connection(int fd) : socket(fd) {}
+    };
+    
     int port_;
     int server_socket_;
     std::atomic<bool> running_{false};
     std::unique_ptr<ThreadPool> thread_pool_;
     std::unique_ptr<Cache> cache_;
+    std::unique_ptr<SnapshotWriter> snapshot_writer_;
+    std::unique_ptr<Compactor> compactor_;
+    std::unique_ptr<Reclaimer> reclaimer_;
+    std::unique_ptr<MemoryMonitor> memory_monitor_;
+    std::unique_ptr<WriteLog> write_log_;
+    std::unique_ptr<FlashTier> flash_tier_;
+    std::unique_ptr<MetricsHttpServer> metrics_server_;
+    InvalidationTracker invalidation_tracker_;
+    std::unique_ptr<ReplicationPrimary> replication_;
+    std::unique_ptr<ReplicaLink> replica_;
     
     // Statistics
     std::atomic<size_t> connections_handled_{0};
-    std::atomic<size_t> requests_processed_{0};
-    std::atomic<double> total_response_time_{0.0};
+    std::atomic<size_t> active_connections_{0};
+    RequestMetrics request_metrics_;
+    std::vector<std::unique_ptr<RequestMetrics>> namespace_metrics_;   // Indexed like Cache::namespace_stats()
+    SlowLog slow_log_;
     
-    void handle_client(int client_socket);
-    std::string process_request(const std::string& request);
-    std::string parse_and_execute(const std::string& command);
-    void send_response(int client_socket, const std::string& response);
+    void handle_client(int client_socket, std::chrono::steady_clock::time_point accepted_at);
+    std::string process_request(const std::string& request, Protocol::Request& req, Connection& connection);
+    std::string execute(const Protocol::Request& req, Connection& connection);
+    // Writes are no longer durable; mutations reply WAL_FAILED
+    bool write_log_failed() const { return write_log_ && write_log_->failed(); }
+    std::string tracking(const Protocol::Request& req, Connection& connection);
+    std::string select(const Protocol::Request& req, Connection& connection);
+    std::string replication_stats() const;
+    std::string namespace_stats() const;
+    std::string slab_stats() const;
+    std::string memory_stats() const;
+    std::string stats(const std::string& section) const;
+    std::string slowlog(const Protocol::Request& req);
+    void send_response(Connection& connection, const std::string& response);
+    // Non-blocking: the line is queued and written by whichever thread holds
+    // the socket, without waiting. A client too slow to take it is disconnected.
+    static void push(Connection& connection, const std::string& message);
+    static void flush_pushes(Connection& connection);
 };
 
 } // namespace cache
@@ -8,6 +8,9 @@
 #include <functional>
 #include <future>
 #include <atomic>
+#include <chrono>
+
+#include "lock_stats.h"
 
 namespace cache {
 
@@ -30,12 +33,24 @@ public:
     size_t size() const;
     size_t queue_size() const;
 
+    // Statistics
+    // Time tasks spent queued before a worker picked them up
+    DurationHistogram::Snapshot queue_wait() const;
+
 private:
+    struct QueuedTask {
+        std::function<void()> run;
+        std::chrono::steady_clock::time_point enqueued_at;
+    };
+
     std::vector<std::thread> workers_;
-    std::queue<std::function<void()>> tasks_;
-    mutable std::mutex queue_mutex_;
-    std::condition_variable condition_;
+    std::queue<QueuedTask> tasks_;
+    mutable Mutex queue_mutex_{CACHE_LOCK_NAME("thread_pool_queue")};
+    ConditionVariable condition_;
     std::atomic<bool> stop_{false};
+
+    // Statistics
+    DurationHistogram queue_wait_;
 };
 
 template<typename F, typename... Args>
@@ -51,13 +66,13 @@ auto ThreadPool::enqueue(F&& f, Args&&... args)
     std::future<return_type> res = task->get_future();
     
     {
-        std::unique_lock<std::mutex> lock(queue_mutex_);
+        std::unique_lock<Mutex> lock(queue_mutex_);
         
         if (stop_) {
             throw std::runtime_error("enqueue on stopped ThreadPool");
         }
         
-        tasks_.emplace([task]() { (*task)(); });
+        tasks_.push({[task]() { (*task)(); }, std::chrono::steady_clock::now()});
     }
     
     condition_.notify_one();
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <cstdint>
+
+#include "cache.h"
+
+namespace cache {
+
+// Anonymized request trace.
+//
+// Layout (native little-endian integers, no padding):
+//   header : char magic[8] = "HPCTRACE", uint32 format_version
+//   record : uint64 timestamp_us, uint64 key_hash, uint32 value_size,
+//            uint32 ttl_s, uint8 op
+//
+// Keys are only known by hash; replay names them with key_name(). Values
+// are synthesized at the recorded size. ttl_s is kept for when the cache
+// grows expiry and is ignored until then.
+struct TraceRecord {
+    enum class Op : uint8_t {
+        GET = 0,
+        SET = 1,
+        DELETE = 2
+    };
+
+    uint64_t timestamp_us;
+    uint64_t key_hash;
+    uint32_t value_size;
+    uint32_t ttl_s;
+    Op op;
+};
+
+class Trace {
+public:
+    // Returns nullopt if the file is missing, has a bad header or ends mid-record
+    static std::optional<std::vector<TraceRecord>> load(const std::string& path);
+    static bool save(const std::string& path, const std::vector<TraceRecord>& records);
+
+    static std::string key_name(uint64_t key_hash);
+
+    struct SimulationResult {
+        size_t gets = 0;
+        size_t hits = 0;
+        size_t sets = 0;
+        size_t deletes = 0;
+
+        double hit_ratio() const {
+            return gets == 0 ? 0.0 : static_cast<double>(hits) / gets;
+        }
+    };
+
+    // Applies the trace to an embedded cache as fast as possible
+    static SimulationResult simulate(const std::vector<TraceRecord>& records, Cache& cache);
+};
+
+} // namespace cache
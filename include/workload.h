@@ -0,0 +1,113 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <random>
+#include <optional>
+#include <cstdint>
+
+namespace cache {
+
+// Zipfian ranks in [0, n) using the rejection-free method of Gray et al.
+// (as in YCSB). Rank 0 is the most popular. n may grow between calls; the
+// zeta constant is extended incrementally rather than recomputed.
+class ZipfianGenerator {
+public:
+    // theta must be in (0, 1); YCSB uses 0.99
+    ZipfianGenerator(uint64_t n, double theta = 0.99);
+
+    uint64_t next(std::mt19937_64& rng);
+    uint64_t next(std::mt19937_64& rng, uint64_t n);
+
+private:
+    double theta_;
+    double alpha_;
+    double zeta2_;
+    uint64_t n_;
+    double zeta_n_;
+    double eta_;
+
+    void grow(uint64_t n);
+};
+
+// Value sizes: fixed, uniform over [min, max], or an empirical histogram.
+class ValueSizeDistribution {
+public:
+    static ValueSizeDistribution fixed(size_t size);
+    static ValueSizeDistribution uniform(size_t min_size, size_t max_size);
+    // Parses "N" or "MIN-MAX"
+    static std::optional<ValueSizeDistribution> parse(const std::string& spec);
+    // Reads lines of "size weight"; blank lines and lines starting with # are skipped
+    static std::optional<ValueSizeDistribution> from_file(const std::string& path);
+
+    size_t next(std::mt19937_64& rng);
+    size_t max_size() const;
+
+private:
+    std::vector<size_t> sizes_;
+    std::discrete_distribution<size_t> weights_;
+    size_t min_size_ = 0;
+    size_t max_size_ = 0;
+};
+
+struct WorkloadSpec {
+    enum class KeyDistribution {
+        UNIFORM,
+        ZIPFIAN,    // Scrambled so popular keys are spread across shards
+        HOTSPOT,    // hot_op_fraction of requests go to hot_set_fraction of keys
+        LATEST      // Skewed towards the most recently inserted keys
+    };
+
+    KeyDistribution key_distribution = KeyDistribution::UNIFORM;
+    uint64_t key_count = 1000000;
+    double zipf_theta = 0.99;
+    double hot_set_fraction = 0.2;
+    double hot_op_fraction = 0.8;
+
+    // Operation mix; proportions are normalized
+    double read_proportion = 0.8;
+    double update_proportion = 0.2;
+    double insert_proportion = 0.0;
+    double scan_proportion = 0.0;
+    double read_modify_write_proportion = 0.0;
+    size_t max_scan_length = 100;
+
+    // YCSB core workloads A-F; nullopt for any other letter
+    static std::optional<WorkloadSpec> ycsb(char preset);
+    static std::optional<KeyDistribution> parse_distribution(const std::string& name);
+};
+
+// Turns a WorkloadSpec into protocol requests. Each instance owns its random
+// stream; give every client thread its own stream_id so inserted keys do not
+// collide.
+class Workload {
+public:
+    Workload(const WorkloadSpec& spec, ValueSizeDistribution value_sizes,
+             uint64_t seed, size_t stream_id = 0, size_t stream_count = 1);
+
+    // Appends the request lines for one operation. Scans expand to GETs of
+    // consecutive keys and read-modify-writes to a GET followed by a SET.
+    void next(std::vector<std::string>& requests);
+    std::vector<std::string> generate(size_t num_requests);
+    // A value drawn from the value size distribution
+    std::string next_value();
+
+    static std::string key_name(uint64_t id);
+
+private:
+    WorkloadSpec spec_;
+    ValueSizeDistribution value_sizes_;
+    std::mt19937_64 rng_;
+    std::discrete_distribution<int> operations_;
+    ZipfianGenerator zipfian_;
+    std::uniform_real_distribution<double> unit_{0.0, 1.0};
+    std::string value_pool_;
+    uint64_t stream_id_;
+    uint64_t stream_count_;
+    uint64_t inserted_ = 0;
+
+    uint64_t key_count() const;
+    uint64_t next_key();
+};
+
+} // namespace cache
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <optional>
+
+#include "cache.h"
+
+namespace cache {
+
+// Append-only log of cache mutations with group commit.
+//
+// Each file starts with the 8-byte magic "HPCWAL01" followed by records:
+//   uint32 payload_len, uint32 checksum (FNV-1a of payload), payload
+//   payload: uint8 op, uint8 flags, uint64 version, uint32 key_len,
+//            uint32 value_len, key bytes, value bytes
+//
+// Writers append to an in-memory buffer under the key's shard lock, which
+// keeps per-key log order identical to apply order. A flusher thread writes
+// the buffer out and, depending on the policy, fsyncs it; under ALWAYS every
+// writer waiting in commit() is released by the same fsync.
+//
+// A failed write or fsync (ENOSPC, EIO) marks the log failed: nothing after
+// it is durable or even replayable, so every later commit() fails and the
+// flusher stops writing. Restart the server once the disk is fixed.
+//
+// Once the log grows past compact_bytes it is rotated to path + ".old" and a
+// background thread writes a snapshot, after which the old log is deleted.
+// Recovery is: load the snapshot, replay path + ".old", then replay path.
+class WriteLog {
+public:
+    enum class FsyncPolicy {
+        ALWAYS,     // commit() blocks until the record is on disk
+        INTERVAL,   // fsync every fsync_interval
+        NEVER       // write every fsync_interval, leave syncing to the OS
+    };
+
+    enum class Op : uint8_t {
+        SET = 1,
+        REMOVE = 2,
+        CLEAR = 3
+    };
+
+    struct Options {
+        std::string path;
+        std::string snapshot_path;
+        FsyncPolicy policy = FsyncPolicy::INTERVAL;
+        std::chrono::milliseconds fsync_interval{1000};
+        size_t compact_bytes = 64 * 1024 * 1024; // 64MB default
+    };
+
+    WriteLog(const Cache& cache, Options options);
+    ~WriteLog();
+
+    // Non-copyable, non-movable
+    WriteLog(const WriteLog&) = delete;
+    WriteLog& operator=(const WriteLog&) = delete;
+    WriteLog(WriteLog&&) = delete;
+    WriteLog& operator=(WriteLog&&) = delete;
+
+    bool open();
+    void close();
+
+    // Appends a record and returns its log sequence number. Called by Cache
+    // under the shard lock of the key being mutated.
+    uint64_t append_set(const Cache::CacheEntry& entry);
+    uint64_t append_remove(const std::string& key);
+    uint64_t append_clear();
+
+    // Waits until lsn is durable under ALWAYS; returns immediately otherwise.
+    // Returns false once the log has failed. Called by Cache after the shard
+    // lock is released.
+    bool commit(uint64_t lsn);
+    bool failed() const;
+
+    // Applies the records in path + ".old" and path to cache, truncating a
+    // torn tail left by a crash. Returns the number of records applied.
+    static std::optional<size_t> replay(Cache& cache, const std::string& path);
+    static std::optional<FsyncPolicy> parse_policy(const std::string& policy,
+                                                   std::chrono::milliseconds& interval);
+
+    // Statistics
+    size_t records_appended() const;
+    size_t bytes_written() const;
+    size_t fsyncs() const;
+    size_t compactions() const;
+    size_t write_errors() const;
+
+private:
+    const Cache& cache_;
+    Options options_;
+    int fd_{-1};
+    size_t file_bytes_{0};
+    
+    std::mutex mutex_;
+    std::condition_variable flush_condition_;
+    std::condition_variable durable_condition_;
+    std::string buffer_;
+    uint64_t next_lsn_{1};
+    uint64_t durable_lsn_{0};
+    size_t commit_waiters_{0};
+    bool stop_{false};
+    std::atomic<bool> failed_{false};
+    std::thread flusher_;
+    
+    std::mutex compact_mutex_;
+    std::condition_variable compact_condition_;
+    bool compact_requested_{false};
+    bool compact_stop_{false};
+    std::atomic<bool> compacting_{false};
+    std::thread compactor_;
+    
+    std::atomic<size_t> records_appended_{0};
+    std::atomic<size_t> bytes_written_{0};
+    std::atomic<size_t> fsyncs_{0};
+    std::atomic<size_t> compactions_{0};
+    std::atomic<size_t> write_errors_{0};
+
+    uint64_t append(Op op, uint8_t flags, uint64_t version,
+                    const std::string& key, const char* value, size_t value_len);
+    void run_flusher();
+    void run_compactor();
+    bool write_all(const std::string& data);
+    bool sync();
+    void fail(const char* what);
+    bool rotate();
+    static std::optional<size_t> replay_file(Cache& cache, const std::string& path, bool truncate_tail);
+};
+
+} // namespace cache
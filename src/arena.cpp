@@ -0,0 +1,84 @@
+#include "arena.h"
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace cache {
+
+namespace {
+
+size_t round_up(size_t size, size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+void* map_anonymous(size_t size, int extra_flags) {
+    return mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+}
+
+} // namespace
+
+Arena::Arena(size_t size, bool huge_pages, bool prefault, size_t alignment) : huge_pages_(huge_pages) {
+    size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_ = round_up(std::max<size_t>(size, 1), huge_pages ? kHugePageSize : page_size);
+    alignment = std::max(alignment, huge_pages ? kHugePageSize : page_size);
+    int populate = prefault ? MAP_POPULATE : 0;
+    
+    if (!huge_pages && alignment == page_size) {
+        void* mapping = map_anonymous(size_, populate);
+        if (mapping == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        mapping_ = data_ = static_cast<char*>(mapping);
+        mapping_size_ = size_;
+        return;
+    }
+    
+    // Reserved huge pages first; most systems have none configured
+    if (huge_pages && alignment == kHugePageSize) {
+        void* mapping = map_anonymous(size_, MAP_HUGETLB | populate);
+        if (mapping != MAP_FAILED) {
+            mapping_ = data_ = static_cast<char*>(mapping);
+            mapping_size_ = size_;
+            hugetlb_ = true;
+            return;
+        }
+    }
+    
+    // Map the slack to align within; transparent huge pages only back
+    // 2MB-aligned ranges. Populating must wait for the madvise, or the range
+    // would be faulted in with small pages.
+    mapping_size_ = size_ + alignment;
+    void* mapping = map_anonymous(mapping_size_, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    mapping_ = static_cast<char*>(mapping);
+    data_ = mapping_ + (round_up(reinterpret_cast<uintptr_t>(mapping_), alignment) -
+                        reinterpret_cast<uintptr_t>(mapping_));
+    if (huge_pages) {
+        madvise(data_, size_, MADV_HUGEPAGE);
+    }
+    if (prefault) {
+        for (size_t offset = 0; offset < size_; offset += page_size) {
+            data_[offset] = 0;
+        }
+    }
+}
+
+Arena::~Arena() {
+    if (mapping_) {
+        munmap(mapping_, mapping_size_);
+    }
+}
+
+void Arena::release() {
+    release(data_, size_);
+}
+
+void Arena::release(char* begin, size_t length) {
+    madvise(begin, length, MADV_DONTNEED);
+}
+
+} // namespace cache
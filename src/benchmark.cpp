@@ -1,145 +1,175 @@
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <vector>
 #include <thread>
 #include <chrono>
-#include <random>
 #include <atomic>
 #include <string>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <unistd.h>
-#include <cstring>
+#include <limits>
+#include <optional>
+#include <mutex>
+#include <condition_variable>
+
+#include "cache_client.h"
+#include "hdr_histogram.h"
+#include "workload.h"
+#include "trace.h"
+#include "cache.h"
+
+namespace {
+
+// Latencies are tracked in microseconds up to one minute
+constexpr uint64_t kHighestLatencyUs = 60ULL * 1000 * 1000;
+const double kReportedPercentiles[] = {50.0, 90.0, 99.0, 99.9, 99.99};
+
+} // namespace
 
 class BenchmarkClient {
 public:
-    BenchmarkClient(const std::string& host, int port) : host_(host), port_(port) {}
+    BenchmarkClient(const std::string& host, int port) : client_(options(host, port)) {}
     
     struct Result {
         size_t operations = 0;
         size_t errors = 0;
+        size_t misses = 0;
         double total_time_ms = 0.0;
-        double min_latency_ms = std::numeric_limits<double>::max();
-        double max_latency_ms = 0.0;
-        double total_latency_ms = 0.0;
+        cache::HdrHistogram latency_us{kHighestLatencyUs};
+        
+        void merge(const Result& other) {
+            operations += other.operations;
+            errors += other.errors;
+            misses += other.misses;
+            total_time_ms = std::max(total_time_ms, other.total_time_ms);
+            latency_us.merge(other.latency_us);
+        }
     };
     
-    Result run_benchmark(size_t num_operations, double read_ratio = 0.8) {
+    // Closed loop: a request is sent only when fewer than depth are awaiting
+    // replies. Depth 1 waits out every round trip; more pipelines them.
+    Result run_benchmark(const std::vector<std::string>& requests, size_t depth = 1) {
         Result result;
         
-        if (!connect()) {
-            result.errors = num_operations;
+        if (!client_.connect()) {
+            result.errors = requests.size();
             return result;
         }
         
-        auto start_time = std::chrono::high_resolution_clock::now();
+        std::mutex mutex;
+        std::condition_variable replied;
+        size_t in_flight = 0;
+        depth = std::max<size_t>(depth, 1);
         
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_real_distribution<> dis(0.0, 1.0);
-        std::uniform_int_distribution<> key_dis(1, 1000000);
-        std::uniform_int_distribution<> value_dis(10, 1000);
+        auto start_time = std::chrono::steady_clock::now();
         
-        for (size_t i = 0; i < num_operations; ++i) {
-            auto op_start = std::chrono::high_resolution_clock::now();
-            
-            std::string key = "key_" + std::to_string(key_dis(gen));
-            
-            if (dis(gen) < read_ratio) {
-                // Read operation
-                std::string response = send_command("GET " + key);
-                if (response.find("ERROR") != 0) {
-                    result.operations++;
-                } else {
-                    result.errors++;
-                }
-            } else {
-                // Write operation
-                std::string value = "value_" + std::to_string(value_dis(gen));
-                std::string response = send_command("SET " + key + " " + value);
-                if (response.find("OK") == 0) {
-                    result.operations++;
-                } else {
-                    result.errors++;
-                }
+        for (const auto& request : requests) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                replied.wait(lock, [&]() { return in_flight < depth; });
+                in_flight++;
             }
-            
-            auto op_end = std::chrono::high_resolution_clock::now();
-            double latency_ms = std::chrono::duration<double, std::milli>(op_end - op_start).count();
-            
-            result.min_latency_ms = std::min(result.min_latency_ms, latency_ms);
-            result.max_latency_ms = std::max(result.max_latency_ms, latency_ms);
-            result.total_latency_ms += latency_ms;
+            auto op_start = std::chrono::steady_clock::now();
+            client_.send(request, [&, op_start](const std::string& response) {
+                auto op_end = std::chrono::steady_clock::now();
+                std::lock_guard<std::mutex> lock(mutex);
+                classify(response, result);
+                result.latency_us.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                    op_end - op_start).count());
+                in_flight--;
+                replied.notify_one();
+            });
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            replied.wait(lock, [&]() { return in_flight == 0; });
         }
         
-        auto end_time = std::chrono::high_resolution_clock::now();
+        auto end_time = std::chrono::steady_clock::now();
         result.total_time_ms = std::chrono::duration<double, std::milli>(end_time - start_time).count();
         
-        disconnect();
+        client_.close();
         return result;
     }
-
-private:
-    std::string host_;
-    int port_;
-    int socket_ = -1;
-    
-    bool connect() {
-        socket_ = socket(AF_INET, SOCK_STREAM, 0);
-        if (socket_ < 0) {
-            return false;
-        }
-        
-        struct sockaddr_in server_addr;
-        server_addr.sin_family = AF_INET;
-        server_addr.sin_port = htons(port_);
-        
-        if (inet_pton(AF_INET, host_.c_str(), &server_addr.sin_addr) <= 0) {
-            close(socket_);
-            socket_ = -1;
-            return false;
-        }
-        
-        if (::connect(socket_, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-            close(socket_);
-            socket_ = -1;
-            return false;
-        }
-        
-        return true;
-    }
     
-    void disconnect() {
-        if (socket_ >= 0) {
-            close(socket_);
-            socket_ = -1;
+    // Open loop: request i is due at start + i / rate whether or not earlier
+    // replies have arrived. Latency is measured from that scheduled time, so
+    // a stalled server is charged for every request it delayed (no
+    // coordinated omission).
+    Result run_open_loop(const std::vector<std::string>& requests, double rate) {
+        auto interval = std::chrono::nanoseconds(static_cast<int64_t>(1e9 / rate));
+        std::vector<std::chrono::nanoseconds> schedule(requests.size());
+        for (size_t i = 0; i < schedule.size(); ++i) {
+            schedule[i] = interval * i;
         }
+        return run_schedule(requests, schedule);
     }
     
-    std::string send_command(const std::string& command) {
-        if (socket_ < 0) {
-            return "ERROR Not connected";
-        }
+    // Sends requests[i] at start + schedule[i]; schedule must be non-decreasing
+    Result run_schedule(const std::vector<std::string>& requests,
+                        const std::vector<std::chrono::nanoseconds>& schedule) {
+        Result result;
         
-        std::string full_command = command + "\n";
-        if (send(socket_, full_command.c_str(), full_command.length(), 0) < 0) {
-            return "ERROR Send failed";
+        if (!client_.connect()) {
+            result.errors = requests.size();
+            return result;
         }
         
-        char buffer[4096];
-        ssize_t bytes_received = recv(socket_, buffer, sizeof(buffer) - 1, 0);
-        if (bytes_received <= 0) {
-            return "ERROR Receive failed";
-        }
+        std::mutex mutex;
+        std::condition_variable replied;
+        size_t outstanding = requests.size();
         
-        buffer[bytes_received] = '\0';
-        std::string response(buffer);
+        auto start_time = std::chrono::steady_clock::now();
         
-        if (!response.empty() && response.back() == '\n') {
-            response.pop_back();
+        // Replies that stop arriving time out in the client and count as errors
+        for (size_t i = 0; i < requests.size(); ++i) {
+            auto scheduled = start_time + schedule[i];
+            if (std::chrono::steady_clock::now() < scheduled) {
+                std::this_thread::sleep_until(scheduled);
+            }
+            client_.send(requests[i], [&, scheduled](const std::string& response) {
+                auto now = std::chrono::steady_clock::now();
+                std::lock_guard<std::mutex> lock(mutex);
+                classify(response, result);
+                result.latency_us.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                    now - scheduled).count());
+                if (--outstanding == 0) {
+                    replied.notify_one();
+                }
+            });
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            replied.wait(lock, [&]() { return outstanding == 0; });
         }
         
-        return response;
+        auto end_time = std::chrono::steady_clock::now();
+        result.total_time_ms = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+        
+        client_.close();
+        return result;
+    }
+
+private:
+    // One connection per benchmark thread, as the server serves each connection on one worker
+    cache::CacheClient client_;
+    
+    static cache::CacheClient::Options options(const std::string& host, int port) {
+        cache::CacheClient::Options options;
+        options.host = host;
+        options.port = port;
+        options.connections = 1;
+        return options;
+    }
+    
+    static void classify(const std::string& response, Result& result) {
+        if (response.compare(0, 15, "ERROR NOT_FOUND") == 0) {
+            result.operations++;
+            result.misses++;
+        } else if (response.compare(0, 5, "ERROR") == 0) {
+            result.errors++;
+        } else {
+            result.operations++;
+        }
     }
 };
 
@@ -148,8 +178,28 @@ struct BenchmarkConfig {
     int port = 8080;
     size_t num_operations = 100000;
     size_t num_threads = 4;
-    double read_ratio = 0.8;
+    std::string workload_name = "custom";
+    cache::WorkloadSpec workload;
+    cache::ValueSizeDistribution value_sizes = cache::ValueSizeDistribution::fixed(100);
+    uint64_t seed = 1;
+    bool preload = false;
     bool warmup = true;
+    std::vector<double> rates;      // Total requests/sec; empty means closed loop
+    size_t pipeline_depth = 1;      // Closed loop: requests in flight per connection
+    double duration_s = 0.0;        // Open loop: overrides num_operations when set
+    std::string csv_path;
+    std::string json_path;
+    std::string replay_path;
+    double replay_speed = 1.0;      // 2 replays twice as fast; 0 sends as fast as possible
+    bool offline = false;
+    std::vector<size_t> capacities{64 * 1024 * 1024};
+};
+
+// One point on the latency-vs-throughput curve
+struct RunSummary {
+    double target_rate;             // 0 for closed loop
+    double throughput;
+    BenchmarkClient::Result result;
 };
 
 void print_usage(const char* program_name) {
@@ -159,14 +209,77 @@ void print_usage(const char* program_name) {
               << "  --port PORT        Server port (default: 8080)\n"
               << "  --operations N     Number of operations per thread (default: 100000)\n"
               << "  --threads N        Number of client threads (default: 4)\n"
-              << "  --read-ratio R     Ratio of read operations (default: 0.8)\n"
+              << "  --read-ratio R     Ratio of reads to updates (default: 0.8)\n"
+              << "  --workload X       YCSB core workload A-F (mix and key distribution)\n"
+              << "  --distribution D   Key distribution: uniform, zipfian, hotspot, latest (default: uniform)\n"
+              << "  --zipf-theta T     Zipfian skew, 0 < T < 1 (default: 0.99)\n"
+              << "  --hot-set F        Hotspot: fraction of keys that are hot (default: 0.2)\n"
+              << "  --hot-ops F        Hotspot: fraction of requests to hot keys (default: 0.8)\n"
+              << "  --keys N           Number of distinct keys (default: 1000000)\n"
+              << "  --value-size S     Value size in bytes, N or MIN-MAX (default: 100)\n"
+              << "  --value-size-file F  Value sizes from a histogram of \"size weight\" lines\n"
+              << "  --seed N           Random seed (default: 1)\n"
+              << "  --preload          SET every key once before the benchmark\n"
+              << "  --replay FILE      Replay a recorded trace, one connection per thread\n"
+              << "  --speed X          Replay X times faster than recorded; 0 for no delays (default: 1)\n"
+              << "  --offline          Replay into an embedded cache instead of the server\n"
+              << "  --capacity C1,...  Offline: cache sizes to simulate, e.g. 64M,1G (default: 64M)\n"
+              << "  --rate R           Open loop: send R requests/sec in total on a fixed schedule\n"
+              << "  --rates R1,R2,...  Open loop at each rate in turn (latency-vs-throughput curve)\n"
+              << "  --duration S       Open loop: run each rate for S seconds instead of --operations\n"
+              << "  --csv FILE         Write one row per run to FILE\n"
+              << "  --json FILE        Write the runs to FILE as JSON\n"
+              << "  --pipeline N       Closed loop: keep N requests in flight per connection (default: 1)\n"
               << "  --no-warmup        Skip warmup phase\n"
               << "  --help             Show this help message\n";
 }
 
+// Parses a size such as 4096, 64K, 256M or 2G
+size_t parse_size(const std::string& text) {
+    size_t pos = 0;
+    double value = std::stod(text, &pos);
+    std::string suffix = text.substr(pos);
+    if (suffix == "K" || suffix == "k") {
+        value *= 1024;
+    } else if (suffix == "M" || suffix == "m") {
+        value *= 1024 * 1024;
+    } else if (suffix == "G" || suffix == "g") {
+        value *= 1024.0 * 1024 * 1024;
+    } else if (!suffix.empty()) {
+        throw std::invalid_argument("bad size suffix");
+    }
+    return static_cast<size_t>(value);
+}
+
+std::vector<double> parse_rates(const std::string& list) {
+    std::vector<double> rates;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            rates.push_back(std::stod(item));
+        }
+    }
+    return rates;
+}
+
 BenchmarkConfig parse_arguments(int argc, char* argv[]) {
     BenchmarkConfig config;
     
+    // A preset sets the whole mix, so apply it before any individual overrides
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == "--workload") {
+            std::string name = argv[i + 1];
+            auto preset = name.size() == 1 ? cache::WorkloadSpec::ycsb(name[0]) : std::nullopt;
+            if (!preset) {
+                std::cerr << "Unknown workload: " << name << " (expected A-F)" << std::endl;
+                exit(1);
+            }
+            config.workload = *preset;
+            config.workload_name = "ycsb-" + name;
+        }
+    }
+    
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
         if (arg == "--host" && i + 1 < argc) {
@@ -178,7 +291,65 @@ BenchmarkConfig parse_arguments(int argc, char* argv[]) {
         } else if (arg == "--threads" && i + 1 < argc) {
             config.num_threads = std::stoul(argv[++i]);
         } else if (arg == "--read-ratio" && i + 1 < argc) {
-            config.read_ratio = std::stod(argv[++i]);
+            config.workload.read_proportion = std::stod(argv[++i]);
+            config.workload.update_proportion = 1.0 - config.workload.read_proportion;
+        } else if (arg == "--workload" && i + 1 < argc) {
+            ++i; // Applied above
+        } else if (arg == "--distribution" && i + 1 < argc) {
+            auto distribution = cache::WorkloadSpec::parse_distribution(argv[++i]);
+            if (!distribution) {
+                std::cerr << "Unknown distribution: " << argv[i] << std::endl;
+                exit(1);
+            }
+            config.workload.key_distribution = *distribution;
+        } else if (arg == "--zipf-theta" && i + 1 < argc) {
+            config.workload.zipf_theta = std::stod(argv[++i]);
+        } else if (arg == "--hot-set" && i + 1 < argc) {
+            config.workload.hot_set_fraction = std::stod(argv[++i]);
+        } else if (arg == "--hot-ops" && i + 1 < argc) {
+            config.workload.hot_op_fraction = std::stod(argv[++i]);
+        } else if (arg == "--keys" && i + 1 < argc) {
+            config.workload.key_count = std::max<uint64_t>(std::stoull(argv[++i]), 1);
+        } else if (arg == "--value-size" && i + 1 < argc) {
+            auto sizes = cache::ValueSizeDistribution::parse(argv[++i]);
+            if (!sizes) {
+                std::cerr << "Invalid value size: " << argv[i] << std::endl;
+                exit(1);
+            }
+            config.value_sizes = *sizes;
+        } else if (arg == "--value-size-file" && i + 1 < argc) {
+            auto sizes = cache::ValueSizeDistribution::from_file(argv[++i]);
+            if (!sizes) {
+                exit(1);
+            }
+            config.value_sizes = *sizes;
+        } else if (arg == "--seed" && i + 1 < argc) {
+            config.seed = std::stoull(argv[++i]);
+        } else if (arg == "--preload") {
+            config.preload = true;
+        } else if (arg == "--replay" && i + 1 < argc) {
+            config.replay_path = argv[++i];
+        } else if (arg == "--speed" && i + 1 < argc) {
+            config.replay_speed = std::stod(argv[++i]);
+        } else if (arg == "--offline") {
+            config.offline = true;
+        } else if (arg == "--capacity" && i + 1 < argc) {
+            config.capacities.clear();
+            std::stringstream stream(argv[++i]);
+            std::string item;
+            while (std::getline(stream, item, ',')) {
+                config.capacities.push_back(parse_size(item));
+            }
+        } else if ((arg == "--rate" || arg == "--rates") && i + 1 < argc) {
+            config.rates = parse_rates(argv[++i]);
+        } else if (arg == "--duration" && i + 1 < argc) {
+            config.duration_s = std::stod(argv[++i]);
+        } else if (arg == "--csv" && i + 1 < argc) {
+            config.csv_path = argv[++i];
+        } else if (arg == "--json" && i + 1 < argc) {
+            config.json_path = argv[++i];
+        } else if (arg == "--pipeline" && i + 1 < argc) {
+            config.pipeline_depth = std::max<size_t>(std::stoul(argv[++i]), 1);
         } else if (arg == "--no-warmup") {
             config.warmup = false;
         } else if (arg == "--help") {
@@ -187,50 +358,87 @@ BenchmarkConfig parse_arguments(int argc, char* argv[]) {
         }
     }
     
+    if (config.host == "localhost") {
+        config.host = "127.0.0.1";
+    }
+    config.num_threads = std::max<size_t>(config.num_threads, 1);
+    
     return config;
 }
 
+const char* distribution_name(cache::WorkloadSpec::KeyDistribution distribution) {
+    switch (distribution) {
+        case cache::WorkloadSpec::KeyDistribution::UNIFORM: return "uniform";
+        case cache::WorkloadSpec::KeyDistribution::ZIPFIAN: return "zipfian";
+        case cache::WorkloadSpec::KeyDistribution::HOTSPOT: return "hotspot";
+        case cache::WorkloadSpec::KeyDistribution::LATEST: return "latest";
+    }
+    return "unknown";
+}
+
+// Writes every key once, like the YCSB load phase, so reads can hit
+void preload_cache(const BenchmarkConfig& config) {
+    std::cout << "Preloading " << config.workload.key_count << " keys..." << std::endl;
+    
+    std::vector<std::thread> threads;
+    std::vector<BenchmarkClient::Result> results(config.num_threads);
+    for (size_t t = 0; t < config.num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            cache::Workload workload(config.workload, config.value_sizes, config.seed, t, config.num_threads);
+            std::vector<std::string> requests;
+            for (uint64_t id = t; id < config.workload.key_count; id += config.num_threads) {
+                requests.push_back("SET " + cache::Workload::key_name(id) + " " + workload.next_value());
+            }
+            BenchmarkClient client(config.host, config.port);
+            results[t] = client.run_open_loop(requests, 1e9); // As fast as the server accepts them
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    size_t stored = 0;
+    for (const auto& result : results) {
+        stored += result.operations;
+    }
+    std::cout << "Preload completed: " << stored << " keys stored" << std::endl;
+}
+
 void warmup_cache(const BenchmarkConfig& config) {
     std::cout << "Warming up cache..." << std::endl;
     
+    // A separate stream so warmup does not replay the benchmark's requests
+    cache::Workload workload(config.workload, config.value_sizes, config.seed, config.num_threads,
+                             config.num_threads + 1);
     BenchmarkClient client(config.host, config.port);
-    auto result = client.run_benchmark(10000, 0.5); // 50% read/write ratio for warmup
+    auto result = client.run_benchmark(workload.generate(10000));
     
-    std::cout << "Warmup completed: " << result.operations << " operations in " 
+    std::cout << "Warmup completed: " << result.operations << " operations in "
               << result.total_time_ms << " ms" << std::endl;
 }
 
-int main(int argc, char* argv[]) {
-    auto config = parse_arguments(argc, argv);
-    
-    std::cout << "High-Performance Cache Benchmark" << std::endl;
-    std::cout << "=================================" << std::endl;
-    std::cout << "Host: " << config.host << std::endl;
-    std::cout << "Port: " << config.port << std::endl;
-    std::cout << "Operations per thread: " << config.num_operations << std::endl;
-    std::cout << "Number of threads: " << config.num_threads << std::endl;
-    std::cout << "Read ratio: " << config.read_ratio << std::endl;
-    std::cout << std::endl;
-    
-    // Warmup phase
-    if (config.warmup) {
-        warmup_cache(config);
+RunSummary run(const BenchmarkConfig& config, double rate) {
+    size_t operations = config.num_operations;
+    double rate_per_thread = rate / config.num_threads;
+    if (rate > 0 && config.duration_s > 0) {
+        operations = std::max<size_t>(1, static_cast<size_t>(rate_per_thread * config.duration_s));
     }
     
-    // Benchmark phase
-    std::cout << "Starting benchmark..." << std::endl;
-    
     std::vector<std::thread> threads;
     std::vector<BenchmarkClient::Result> results(config.num_threads);
-    std::atomic<size_t> completed_threads{0};
     
-    auto start_time = std::chrono::high_resolution_clock::now();
+    auto start_time = std::chrono::steady_clock::now();
     
     for (size_t i = 0; i < config.num_threads; ++i) {
         threads.emplace_back([&, i]() {
+            cache::Workload workload(config.workload, config.value_sizes, config.seed, i, config.num_threads);
+            auto requests = workload.generate(operations);
             BenchmarkClient client(config.host, config.port);
-            results[i] = client.run_benchmark(config.num_operations, config.read_ratio);
-            completed_threads++;
+            if (rate > 0) {
+                results[i] = client.run_open_loop(requests, rate_per_thread);
+            } else {
+                results[i] = client.run_benchmark(requests, config.pipeline_depth);
+            }
         });
     }
     
@@ -239,30 +447,302 @@ int main(int argc, char* argv[]) {
         thread.join();
     }
     
-    auto end_time = std::chrono::high_resolution_clock::now();
-    double total_time_ms = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+    auto end_time = std::chrono::steady_clock::now();
     
-    // Aggregate results
-    BenchmarkClient::Result total_result;
+    RunSummary summary{rate, 0.0, BenchmarkClient::Result()};
     for (const auto& result : results) {
-        total_result.operations += result.operations;
-        total_result.errors += result.errors;
-        total_result.min_latency_ms = std::min(total_result.min_latency_ms, result.min_latency_ms);
-        total_result.max_latency_ms = std::max(total_result.max_latency_ms, result.max_latency_ms);
-        total_result.total_latency_ms += result.total_latency_ms;
+        summary.result.merge(result);
     }
+    summary.result.total_time_ms = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+    summary.throughput = summary.result.operations / (summary.result.total_time_ms / 1000.0);
+    return summary;
+}
+
+void print_summary(const RunSummary& summary) {
+    const auto& result = summary.result;
+    const auto& latency = result.latency_us;
+    size_t attempted = result.operations + result.errors;
     
-    // Print results
-    std::cout << "\nBenchmark Results" << std::endl;
+    std::cout << "\nBenchmark Results";
+    if (summary.target_rate > 0) {
+        std::cout << " (open loop, target " << summary.target_rate << " ops/sec)";
+    }
+    std::cout << std::endl;
     std::cout << "=================" << std::endl;
-    std::cout << "Total operations: " << total_result.operations << std::endl;
-    std::cout << "Total errors: " << total_result.errors << std::endl;
-    std::cout << "Total time: " << total_time_ms << " ms" << std::endl;
-    std::cout << "Throughput: " << (total_result.operations / (total_time_ms / 1000.0)) << " ops/sec" << std::endl;
-    std::cout << "Average latency: " << (total_result.total_latency_ms / total_result.operations) << " ms" << std::endl;
-    std::cout << "Min latency: " << total_result.min_latency_ms << " ms" << std::endl;
-    std::cout << "Max latency: " << total_result.max_latency_ms << " ms" << std::endl;
-    std::cout << "Error rate: " << (100.0 * total_result.errors / (total_result.operations + total_result.errors)) << "%" << std::endl;
+    std::cout << "Total operations: " << result.operations << std::endl;
+    std::cout << "Total errors: " << result.errors << std::endl;
+    std::cout << "Total time: " << result.total_time_ms << " ms" << std::endl;
+    std::cout << "Throughput: " << summary.throughput << " ops/sec" << std::endl;
+    std::cout << "Hit ratio: " << (result.operations > 0 ?
+        1.0 - static_cast<double>(result.misses) / result.operations : 0.0) << std::endl;
+    std::cout << "Average latency: " << latency.mean() << " us" << std::endl;
+    std::cout << "Min latency: " << latency.min() << " us" << std::endl;
+    for (double p : kReportedPercentiles) {
+        std::cout << "p" << p << " latency: " << latency.percentile(p) << " us" << std::endl;
+    }
+    std::cout << "Max latency: " << latency.max() << " us" << std::endl;
+    std::cout << "Error rate: " << (attempted > 0 ? 100.0 * result.errors / attempted : 0.0) << "%" << std::endl;
+}
+
+bool write_csv(const std::string& path, const std::vector<RunSummary>& runs) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    
+    out << "target_rate,throughput,operations,errors,misses,mean_us,min_us";
+    for (double p : kReportedPercentiles) {
+        out << ",p" << p << "_us";
+    }
+    out << ",max_us\n";
+    
+    for (const auto& run : runs) {
+        const auto& latency = run.result.latency_us;
+        out << run.target_rate << ',' << run.throughput << ',' << run.result.operations << ','
+            << run.result.errors << ',' << run.result.misses << ',' << latency.mean() << ','
+            << latency.min();
+        for (double p : kReportedPercentiles) {
+            out << ',' << latency.percentile(p);
+        }
+        out << ',' << latency.max() << '\n';
+    }
+    return true;
+}
+
+bool write_json(const std::string& path, const BenchmarkConfig& config, const std::vector<RunSummary>& runs) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    
+    out << "{\n  \"threads\": " << config.num_threads
+        << ",\n  \"workload\": \"" << config.workload_name << "\""
+        << ",\n  \"key_distribution\": \"" << distribution_name(config.workload.key_distribution) << "\""
+        << ",\n  \"keys\": " << config.workload.key_count
+        << ",\n  \"pipeline_depth\": " << config.pipeline_depth
+        << ",\n  \"runs\": [";
+    for (size_t i = 0; i < runs.size(); ++i) {
+        const auto& run = runs[i];
+        const auto& latency = run.result.latency_us;
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"target_rate\": " << run.target_rate
+            << ", \"throughput\": " << run.throughput
+            << ", \"operations\": " << run.result.operations
+            << ", \"errors\": " << run.result.errors
+            << ", \"misses\": " << run.result.misses
+            << ", \"latency_us\": {\"mean\": " << latency.mean()
+            << ", \"min\": " << latency.min();
+        for (double p : kReportedPercentiles) {
+            out << ", \"p" << p << "\": " << latency.percentile(p);
+        }
+        out << ", \"max\": " << latency.max() << "}}";
+    }
+    out << "\n  ]\n}\n";
+    return true;
+}
+
+// Feeds the trace into one embedded cache per capacity, in parallel
+int replay_offline(const BenchmarkConfig& config, const std::vector<cache::TraceRecord>& records) {
+    struct Point {
+        size_t capacity;
+        cache::Trace::SimulationResult result;
+        size_t memory_usage;
+        double seconds;
+    };
+    std::vector<Point> points(config.capacities.size());
+    std::vector<std::thread> threads;
+    
+    for (size_t i = 0; i < config.capacities.size(); ++i) {
+        threads.emplace_back([&, i]() {
+            cache::Cache cache(config.capacities[i]);
+            auto start_time = std::chrono::steady_clock::now();
+            auto result = cache::Trace::simulate(records, cache);
+            auto end_time = std::chrono::steady_clock::now();
+            points[i] = Point{config.capacities[i], result, cache.memory_usage(),
+                              std::chrono::duration<double>(end_time - start_time).count()};
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    // The embedded Cache evicts in LRU order; it is the only policy it implements
+    const char* policy = "lru";
+    std::cout << "\nOffline Replay Results" << std::endl;
+    std::cout << "======================" << std::endl;
+    for (const auto& point : points) {
+        std::cout << "capacity=" << point.capacity << " policy=" << policy
+                  << " gets=" << point.result.gets << " hits=" << point.result.hits
+                  << " hit_ratio=" << point.result.hit_ratio()
+                  << " memory_usage=" << point.memory_usage
+                  << " time=" << point.seconds << "s" << std::endl;
+    }
+    
+    if (!config.csv_path.empty()) {
+        std::ofstream out(config.csv_path);
+        if (!out) {
+            std::cerr << "Failed to open " << config.csv_path << std::endl;
+            return 1;
+        }
+        out << "capacity,policy,gets,hits,hit_ratio,sets,deletes,memory_usage\n";
+        for (const auto& point : points) {
+            out << point.capacity << ',' << policy << ',' << point.result.gets << ','
+                << point.result.hits << ',' << point.result.hit_ratio() << ','
+                << point.result.sets << ',' << point.result.deletes << ','
+                << point.memory_usage << '\n';
+        }
+    }
+    return 0;
+}
+
+// Replays the trace against the server on its recorded schedule. Requests
+// are split across connections by key hash so each key's order is kept.
+int replay_online(const BenchmarkConfig& config, const std::vector<cache::TraceRecord>& records) {
+    size_t connections = config.num_threads;
+    std::vector<std::vector<std::string>> requests(connections);
+    std::vector<std::vector<std::chrono::nanoseconds>> schedules(connections);
+    
+    uint64_t first_us = records.front().timestamp_us;
+    std::string value;
+    for (const auto& record : records) {
+        size_t connection = record.key_hash % connections;
+        std::string key = cache::Trace::key_name(record.key_hash);
+        switch (record.op) {
+            case cache::TraceRecord::Op::GET:
+                requests[connection].push_back("GET " + key);
+                break;
+            case cache::TraceRecord::Op::SET:
+                value.assign(std::max<uint32_t>(record.value_size, 1), 'x');
+                requests[connection].push_back("SET " + key + " " + value);
+                break;
+            case cache::TraceRecord::Op::DELETE:
+                requests[connection].push_back("DELETE " + key);
+                break;
+        }
+        
+        double offset_us = config.replay_speed > 0 ?
+            (std::max(record.timestamp_us, first_us) - first_us) / config.replay_speed : 0.0;
+        auto offset = std::chrono::nanoseconds(static_cast<int64_t>(offset_us * 1000));
+        // Keep each connection's schedule monotonic even if the trace is not sorted
+        if (!schedules[connection].empty()) {
+            offset = std::max(offset, schedules[connection].back());
+        }
+        schedules[connection].push_back(offset);
+    }
+    
+    std::vector<std::thread> threads;
+    std::vector<BenchmarkClient::Result> results(connections);
+    auto start_time = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < connections; ++i) {
+        threads.emplace_back([&, i]() {
+            BenchmarkClient client(config.host, config.port);
+            results[i] = client.run_schedule(requests[i], schedules[i]);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto end_time = std::chrono::steady_clock::now();
+    
+    double span_s = (records.back().timestamp_us - first_us) / 1e6;
+    double target_rate = config.replay_speed > 0 && span_s > 0 ?
+        records.size() / (span_s / config.replay_speed) : 0.0;
+    std::vector<RunSummary> runs{RunSummary{target_rate, 0.0, BenchmarkClient::Result()}};
+    for (const auto& result : results) {
+        runs[0].result.merge(result);
+    }
+    runs[0].result.total_time_ms = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+    runs[0].throughput = runs[0].result.operations / (runs[0].result.total_time_ms / 1000.0);
+    print_summary(runs[0]);
+    
+    if (!config.csv_path.empty() && !write_csv(config.csv_path, runs)) {
+        return 1;
+    }
+    if (!config.json_path.empty() && !write_json(config.json_path, config, runs)) {
+        return 1;
+    }
+    return 0;
+}
+
+int replay(const BenchmarkConfig& config) {
+    auto records = cache::Trace::load(config.replay_path);
+    if (!records) {
+        return 1;
+    }
+    if (records->empty()) {
+        std::cerr << "Trace " << config.replay_path << " is empty" << std::endl;
+        return 1;
+    }
+    
+    double span_s = (records->back().timestamp_us - records->front().timestamp_us) / 1e6;
+    std::cout << "Replaying " << records->size() << " requests spanning " << span_s << " s from "
+              << config.replay_path;
+    if (config.offline) {
+        std::cout << " into an embedded cache" << std::endl;
+        return replay_offline(config, *records);
+    }
+    std::cout << " at " << config.replay_speed << "x over " << config.num_threads
+              << " connections" << std::endl;
+    return replay_online(config, *records);
+}
+
+int main(int argc, char* argv[]) {
+    auto config = parse_arguments(argc, argv);
+    
+    if (!config.replay_path.empty()) {
+        return replay(config);
+    }
+    
+    std::cout << "High-Performance Cache Benchmark" << std::endl;
+    std::cout << "=================================" << std::endl;
+    std::cout << "Host: " << config.host << std::endl;
+    std::cout << "Port: " << config.port << std::endl;
+    if (config.rates.empty() || config.duration_s <= 0) {
+        std::cout << "Operations per thread: " << config.num_operations << std::endl;
+    } else {
+        std::cout << "Duration per rate: " << config.duration_s << " s" << std::endl;
+    }
+    std::cout << "Number of threads: " << config.num_threads << std::endl;
+    std::cout << "Workload: " << config.workload_name << " ("
+              << distribution_name(config.workload.key_distribution) << " over "
+              << config.workload.key_count << " keys)" << std::endl;
+    std::cout << "Mode: " << (config.rates.empty() ? "closed loop" : "open loop");
+    if (config.rates.empty() && config.pipeline_depth > 1) {
+        std::cout << ", pipeline depth " << config.pipeline_depth;
+    }
+    std::cout << std::endl;
+    std::cout << std::endl;
+    
+    if (config.preload) {
+        preload_cache(config);
+    }
+    
+    // Warmup phase
+    if (config.warmup) {
+        warmup_cache(config);
+    }
+    
+    // Benchmark phase
+    std::cout << "Starting benchmark..." << std::endl;
+    
+    std::vector<RunSummary> runs;
+    if (config.rates.empty()) {
+        runs.push_back(run(config, 0.0));
+        print_summary(runs.back());
+    }
+    for (double rate : config.rates) {
+        runs.push_back(run(config, rate));
+        print_summary(runs.back());
+    }
+    
+    if (!config.csv_path.empty() && !write_csv(config.csv_path, runs)) {
+        return 1;
+    }
+    if (!config.json_path.empty() && !write_json(config.json_path, config, runs)) {
+        return 1;
+    }
     
     return 0;
 }
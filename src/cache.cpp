@@ -1,92 +1,404 @@
 #include "cache.h"
+#include "write_log.h"
+#include "flash_tier.h"
+#include "invalidation_tracker.h"
+#include "replication.h"
+#include "reclaimer.h"
+#include "compression.h"
 #include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <limits>
 
 namespace cache {
 
-Cache::Cache(size_t max_capacity) 
-    : lru_cache_(10000), // Start with 10k entries capacity
-      allocator_(std::make_unique<MemoryAllocator>()),
-      entry_pool_(std::make_unique<ObjectPool<CacheEntry>>()),
-      max_capacity_(max_capacity) {
+namespace {
+
+// Time the calling thread has spent blocked on shard locks. Only a failed
+// try_lock is timed, so uncontended acquisitions cost no clock reads.
+thread_local uint64_t t_lock_wait_ns = 0;
+
+template<typename Lock>
+Lock acquire(SharedMutex& mutex) {
+    Lock lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        auto start = std::chrono::steady_clock::now();
+        lock.lock();
+        t_lock_wait_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+    return lock;
+}
+
+std::unique_lock<SharedMutex> lock_exclusive(SharedMutex& mutex) {
+    return acquire<std::unique_lock<SharedMutex>>(mutex);
+}
+
+std::shared_lock<SharedMutex> lock_shared(SharedMutex& mutex) {
+    return acquire<std::shared_lock<SharedMutex>>(mutex);
+}
+
+// The whole of text as a 64-bit integer, as INCR accepts it
+std::optional<int64_t> parse_integer(std::string_view text) {
+    int64_t value = 0;
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    auto [ptr, ec] = std::from_chars(begin, end, value);
+    if (ec != std::errc() || ptr != end || begin == end) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+} // namespace
+
+Cache::Cache(size_t max_capacity, size_t num_shards) 
+    : max_capacity_(max_capacity) {
+    shards_.reserve(std::max<size_t>(num_shards, 1));
+    for (size_t i = 0; i < std::max<size_t>(num_shards, 1); ++i) {
+        shards_.push_back(std::make_unique<Shard>());
+    }
+    namespaces_.push_back(std::make_unique<Namespace>(kDefaultNamespace));
+}
+
+Cache::~Cache() {
+    for (auto& shard : shards_) {
+        for (auto& table : shard->tables) {
+            table->clear([&](Item* item) { Item::destroy(shard->allocator, item); });
+        }
+    }
 }
 
 bool Cache::set(const std::string& key, const std::string& value) {
-    std::unique_lock<std::shared_mutex> lock(mutex_);
+    hot_keys_.record_access(key);
     
-    // Check if we need to evict entries
-    size_t entry_size = key.size() + value.size() + sizeof(CacheEntry);
+    // Compress before taking the shard lock; capacity is charged for the stored form
+    auto compressed = compress(value);
+    std::string_view stored = compressed ? std::string_view(*compressed) : std::string_view(value);
+    size_t new_size = item_size(key.size(), stored.size());
+    size_t ns = namespace_of(key);
     
     // If the single entry is larger than capacity, reject it
-    if (entry_size > max_capacity_) {
+    if (!fits(ns, new_size)) {
         return false;
     }
+    hot_keys_.record_size(key, new_size);
+    miss_ratio_curve_.record(key, new_size);
     
-    if (current_memory_usage_ + entry_size > max_capacity_) {
-        if (!evict_if_needed()) {
-            return false; // Couldn't free enough space
+    uint64_t hash = hash_key(key);
+    uint64_t lsn = 0;
+    {
+        Shard& shard = shard_at(hash);
+        auto lock = lock_exclusive(shard.mutex);
+        
+        Item* old = shard.tables[ns]->find(key, item_hash(hash));
+        Item* item = Item::create(shard.allocator, key, stored, compressed ? Item::kCompressed : 0,
+                                  next_version_++, item_hash(hash));
+        lsn = log_set(*item);
+        // A key lives in at most one tier; drop any demoted copy
+        if (!old && flash_tier_) {
+            flash_tier_->erase(key);
         }
+        store(shard, ns, item, old);
     }
+    bool durable = commit(lsn);
+    invalidate(key);
     
-    // Create new entry
-    CacheEntry entry(key, value);
+    // Evict after releasing the shard lock so eviction never nests shard locks
+    make_room(ns);
     
-    // Store in LRU cache
-    lru_cache_.put(key, std::move(entry));
-    current_memory_usage_ += entry_size;
-    
-    return true;
+    return durable;
 }
 
 std::string Cache::get(const std::string& key) {
-    std::unique_lock<std::shared_mutex> lock(mutex_);
+    hot_keys_.record_access(key);
     
-    auto entry_opt = lru_cache_.get(key);
-    if (!entry_opt.has_value()) {
-        update_statistics(false);
-        return "";
+    std::string value;
+    bool found = false;
+    bool compressed = false;
+    size_t stored_size = 0;
+    size_t ns = namespace_of(key);
+    uint64_t hash = hash_key(key);
+    {
+        Shard& shard = shard_at(hash);
+        auto lock = lock_exclusive(shard.mutex);
+        
+        // Copy the value out and bump recency in a single lookup
+        ItemTable& table = *shard.tables[ns];
+        Item* item = table.find(key, item_hash(hash));
+        if (item) {
+            table.touch(item, Item::now_ticks());
+            value = item->value_string();
+            compressed = item->is_compressed();
+            stored_size = item->footprint();
+            found = true;
+        }
     }
     
-    auto entry = std::move(entry_opt.value());
-    std::string value = entry.value; // Copy the value first
-    entry.access_count++;
-    entry.timestamp = std::chrono::steady_clock::now();
+    if (!found && flash_tier_) {
+        auto promoted = promote(key);
+        if (promoted) {
+            value = promoted->value_string();
+            compressed = promoted->is_compressed;
+            stored_size = item_size(*promoted);
+            found = true;
+            flash_hits_++;
+        }
+    }
+    miss_ratio_curve_.record(key, stored_size);
     
-    // Put the updated entry back
-    lru_cache_.put(key, std::move(entry));
+    // Decompress after the shard lock is released
+    if (compressed) {
+        value = expand(value);
+    }
     
-    update_statistics(true);
+    update_statistics(ns, found);
     return value;
 }
 
-bool Cache::remove(const std::string& key) {
-    std::unique_lock<std::shared_mutex> lock(mutex_);
+std::optional<int64_t> Cache::incr(const std::string& key, int64_t delta) {
+    hot_keys_.record_access(key);
     
-    auto entry_opt = lru_cache_.get(key);
-    if (!entry_opt.has_value()) {
-        return false;
+    if (flash_tier_ && flash_tier_->contains(key)) {
+        promote(key);
     }
     
-    auto entry = std::move(entry_opt.value());
-    size_t entry_size = key.size() + entry.value.size() + sizeof(CacheEntry);
+    std::optional<int64_t> result;
+    uint64_t lsn = 0;
+    size_t new_size = item_size(key.size(), sizeof(int64_t));
+    size_t ns = namespace_of(key);
+    uint64_t hash = hash_key(key);
     
-    if (lru_cache_.remove(key)) {
-        current_memory_usage_ -= entry_size;
-        return true;
+    {
+        Shard& shard = shard_at(hash);
+        auto lock = lock_exclusive(shard.mutex);
+        
+        ItemTable& table = *shard.tables[ns];
+        Item* item = table.find(key, item_hash(hash));
+        if (item) {
+            int64_t current = 0;
+            if (item->is_integer()) {
+                current = item->int_value();
+            } else {
+                // Convert a string written by SET once; later updates stay
+                // native. Numbers are never compressed (see compress), so a
+                // compressed value is not one and is never expanded here,
+                // under the shard lock.
+                auto parsed = item->is_compressed() ? std::nullopt : parse_integer(item->value());
+                if (!parsed) {
+                    return std::nullopt;
+                }
+                current = *parsed;
+            }
+            
+            int64_t next;
+            if (__builtin_add_overflow(current, delta, &next)) {
+                return std::nullopt;
+            }
+            
+            if (item->is_integer()) {
+                // Same size: rewrite the counter in place
+                std::memcpy(const_cast<char*>(item->value().data()), &next, sizeof(next));
+                item->version = next_version_++;
+                table.touch(item, Item::now_ticks());
+            } else {
+                Item* counter = Item::create(shard.allocator, key, next, next_version_++, item_hash(hash));
+                store(shard, ns, counter, item);
+                item = counter;
+            }
+            lsn = log_set(*item);
+            result = next;
+        } else {
+            // Missing counters start from zero
+            if (!fits(ns, new_size)) {
+                return std::nullopt;
+            }
+            item = Item::create(shard.allocator, key, delta, next_version_++, item_hash(hash));
+            lsn = log_set(*item);
+            if (flash_tier_) {
+                flash_tier_->erase(key);
+            }
+            store(shard, ns, item, nullptr);
+            result = delta;
+        }
     }
+    bool durable = commit(lsn);
+    invalidate(key);
+    miss_ratio_curve_.record(key, new_size);
     
-    return false;
+    make_room(ns);
+    return durable ? result : std::nullopt;
+}
+
+std::optional<int64_t> Cache::decr(const std::string& key, int64_t delta) {
+    if (delta == std::numeric_limits<int64_t>::min()) {
+        return std::nullopt;
+    }
+    return incr(key, -delta);
+}
+
+std::optional<Cache::VersionedValue> Cache::get_versioned(const std::string& key) {
+    hot_keys_.record_access(key);
+    
+    std::optional<VersionedValue> result;
+    bool compressed = false;
+    size_t stored_size = 0;
+    size_t ns = namespace_of(key);
+    uint64_t hash = hash_key(key);
+    {
+        Shard& shard = shard_at(hash);
+        auto lock = lock_exclusive(shard.mutex);
+        
+        ItemTable& table = *shard.tables[ns];
+        Item* item = table.find(key, item_hash(hash));
+        if (item) {
+            table.touch(item, Item::now_ticks());
+            result = VersionedValue{item->value_string(), item->version};
+            compressed = item->is_compressed();
+            stored_size = item->footprint();
+        }
+    }
+    
+    if (!result && flash_tier_) {
+        auto promoted = promote(key);
+        if (promoted) {
+            result = VersionedValue{promoted->value_string(), promoted->version};
+            compressed = promoted->is_compressed;
+            stored_size = item_size(*promoted);
+            flash_hits_++;
+        }
+    }
+    miss_ratio_curve_.record(key, stored_size);
+    
+    if (result && compressed) {
+        result->value = expand(result->value);
+    }
+    
+    update_statistics(ns, result.has_value());
+    return result;
+}
+
+Cache::CasResult Cache::cas(const std::string& key, const std::string& value, uint64_t expected_version) {
+    hot_keys_.record_access(key);
+    
+    auto compressed = compress(value);
+    std::string_view stored = compressed ? std::string_view(*compressed) : std::string_view(value);
+    size_t new_size = item_size(key.size(), stored.size());
+    size_t ns = namespace_of(key);
+    if (!fits(ns, new_size)) {
+        return CasResult::REJECTED;
+    }
+    
+    if (flash_tier_ && flash_tier_->contains(key)) {
+        promote(key);
+    }
+    
+    CasResult result = CasResult::NOT_FOUND;
+    uint64_t lsn = 0;
+    uint64_t hash = hash_key(key);
+    {
+        Shard& shard = shard_at(hash);
+        auto lock = lock_exclusive(shard.mutex);
+        
+        Item* old = shard.tables[ns]->find(key, item_hash(hash));
+        if (old && old->version != expected_version) {
+            result = CasResult::EXISTS;
+        } else if (old) {
+            Item* item = Item::create(shard.allocator, key, stored, compressed ? Item::kCompressed : 0,
+                                      next_version_++, item_hash(hash));
+            lsn = log_set(*item);
+            store(shard, ns, item, old);
+            hot_keys_.record_size(key, new_size);
+            result = CasResult::STORED;
+        }
+    }
+    bool durable = commit(lsn);
+    if (result == CasResult::STORED) {
+        invalidate(key);
+    }
+    miss_ratio_curve_.record(key, result == CasResult::STORED ? new_size : 0);
+    
+    make_room(ns);
+    return durable ? result : CasResult::REJECTED;
+}
+
+bool Cache::remove(const std::string& key) {
+    uint64_t lsn = 0;
+    bool removed = false;
+    size_t ns = namespace_of(key);
+    uint64_t hash = hash_key(key);
+    {
+        Shard& shard = shard_at(hash);
+        auto lock = lock_exclusive(shard.mutex);
+        
+        Item* item = shard.tables[ns]->find(key, item_hash(hash));
+        bool on_flash = flash_tier_ && flash_tier_->erase(key);
+        removed = item || on_flash;
+        
+        if (item) {
+            release(shard, ns, item);
+        }
+        if (removed && replication_) {
+            replication_->append_remove(key);
+        }
+        if (removed && write_log_) {
+            lsn = write_log_->append_remove(key);
+        }
+    }
+    commit(lsn);
+    // Even when missing: a client may still hold a copy of an evicted entry
+    invalidate(key);
+    return removed;
 }
 
 void Cache::clear() {
-    std::unique_lock<std::shared_mutex> lock(mutex_);
-    lru_cache_.clear();
-    current_memory_usage_ = 0;
+    // Hold every shard lock (always taken in index order) so the clear is
+    // atomic with respect to writers and to the order of the write log
+    std::vector<std::unique_lock<SharedMutex>> locks;
+    locks.reserve(shards_.size());
+    for (auto& shard : shards_) {
+        locks.push_back(lock_exclusive(shard->mutex));
+    }
+    
+    if (replication_) {
+        replication_->append_clear();
+    }
+    uint64_t lsn = write_log_ ? write_log_->append_clear() : 0;
+    for (auto& shard : shards_) {
+        for (auto& table : shard->tables) {
+            table->clear([&](Item* item) { Item::destroy(shard->allocator, item); });
+        }
+        // Every chunk is free again, so the pages go back to the OS
+        shard->allocator.release_pages();
+        current_memory_usage_ -= shard->memory_usage;
+        shard->memory_usage = 0;
+    }
+    for (auto& space : namespaces_) {
+        space->memory_usage = 0;
+    }
+    if (flash_tier_) {
+        flash_tier_->clear();
+    }
+    
+    locks.clear();
+    commit(lsn);
+    if (invalidation_tracker_) {
+        invalidation_tracker_->invalidate_all();
+    }
 }
 
 size_t Cache::size() const {
-    std::shared_lock<std::shared_mutex> lock(mutex_);
-    return lru_cache_.size();
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        std::shared_lock<SharedMutex> lock(shard->mutex);
+        for (const auto& table : shard->tables) {
+            total += table->size();
+        }
+    }
+    return total;
 }
 
 size_t Cache::capacity() const {
@@ -107,49 +419,739 @@ size_t Cache::misses() const {
     return misses_.load();
 }
 
+size_t Cache::ram_hits() const {
+    return hits_.load() - flash_hits_.load();
+}
+
+size_t Cache::flash_hits() const {
+    return flash_hits_.load();
+}
+
+size_t Cache::evictions() const {
+    return evictions_.load();
+}
+
+size_t Cache::background_evictions() const {
+    return background_evictions_.load();
+}
+
+size_t Cache::inline_evictions() const {
+    return evictions_.load() - background_evictions_.load();
+}
+
+uint64_t Cache::inline_eviction_time_us() const {
+    return inline_eviction_ns_.load() / 1000;
+}
+
+uint64_t Cache::lock_wait_ns() {
+    return t_lock_wait_ns;
+}
+
+size_t Cache::compressed_values() const {
+    return compressed_values_.load();
+}
+
+double Cache::compression_ratio() const {
+    uint64_t output = compress_output_bytes_.load();
+    if (output == 0) return 1.0;
+    return static_cast<double>(compress_input_bytes_.load()) / output;
+}
+
+uint64_t Cache::compress_time_us() const {
+    return compress_time_ns_.load() / 1000;
+}
+
+uint64_t Cache::decompress_time_us() const {
+    return decompress_time_ns_.load() / 1000;
+}
+
+std::vector<HotKeys::KeyCount> Cache::hot_keys(size_t count) const {
+    return hot_keys_.hot_keys(count);
+}
+
+std::vector<HotKeys::KeyCount> Cache::big_keys(size_t count) const {
+    // Candidates may be stale: re-read each size and correct the tracker
+    auto candidates = hot_keys_.big_keys(std::numeric_limits<size_t>::max());
+    std::vector<HotKeys::KeyCount> result;
+    for (const auto& candidate : candidates) {
+        size_t size = 0;
+        {
+            uint64_t hash = hash_key(candidate.key);
+            Shard& shard = shard_at(hash);
+            std::shared_lock<SharedMutex> lock(shard.mutex);
+            const Item* item = shard.tables[namespace_of(candidate.key)]->find(candidate.key, item_hash(hash));
+            size = item ? item->footprint() : 0;
+        }
+        if (size != candidate.count) {
+            hot_keys_.correct_size(candidate.key, size);
+        }
+        if (size > 0) {
+            result.push_back({candidate.key, size});
+        }
+    }
+    
+    std::sort(result.begin(), result.end(), [](const HotKeys::KeyCount& a, const HotKeys::KeyCount& b) {
+        return a.count > b.count;
+    });
+    if (result.size() > count) {
+        result.resize(count);
+    }
+    return result;
+}
+
+uint64_t Cache::key_samples() const {
+    return hot_keys_.samples();
+}
+
+const MissRatioCurve& Cache::miss_ratio_curve() const {
+    return miss_ratio_curve_;
+}
+
 size_t Cache::memory_usage() const {
     return current_memory_usage_.load();
 }
 
+size_t Cache::reserved_memory() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        std::shared_lock<SharedMutex> lock(shard->mutex);
+        total += shard->allocator.reserved_bytes();
+        for (const auto& table : shard->tables) {
+            total += table->index_bytes();
+        }
+    }
+    return total;
+}
+
+size_t Cache::mapped_memory() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        std::shared_lock<SharedMutex> lock(shard->mutex);
+        total += shard->allocator.mapped_bytes();
+    }
+    return total;
+}
+
+void Cache::set_memory_options(const Arena::Options& options) {
+    for (auto& shard : shards_) {
+        std::unique_lock<SharedMutex> lock(shard->mutex);
+        shard->allocator.configure(options);
+        if (options.prefault) {
+            shard->allocator.reserve(max_capacity_ / shards_.size());
+        }
+    }
+}
+
+size_t Cache::compact(double max_occupancy, size_t max_pages_per_shard) {
+    size_t freed = 0;
+    for (auto& shard : shards_) {
+        freed += compact_shard(*shard, max_occupancy, max_pages_per_shard);
+    }
+    return freed;
+}
+
+std::vector<SlabAllocator::ClassStats> Cache::slab_stats() const {
+    std::vector<SlabAllocator::ClassStats> total;
+    for (const auto& shard : shards_) {
+        std::shared_lock<SharedMutex> lock(shard->mutex);
+        auto stats = shard->allocator.class_stats();
+        if (total.empty()) {
+            total = std::move(stats);
+            continue;
+        }
+        for (size_t i = 0; i < stats.size(); ++i) {
+            total[i].pages += stats[i].pages;
+            total[i].used_chunks += stats[i].used_chunks;
+            total[i].free_chunks += stats[i].free_chunks;
+            total[i].evictions += stats[i].evictions;
+            total[i].pages_compacted += stats[i].pages_compacted;
+        }
+    }
+    return total;
+}
+
+double Cache::fragmentation_ratio() const {
+    size_t page_bytes = 0;
+    size_t used_bytes = 0;
+    for (const auto& stats : slab_stats()) {
+        page_bytes += stats.pages * SlabAllocator::kPageSize;
+        used_bytes += stats.used_chunks * stats.chunk_size;
+    }
+    return page_bytes == 0 ? 0.0 : 1.0 - static_cast<double>(used_bytes) / page_bytes;
+}
+
+size_t Cache::pages_compacted() const {
+    size_t total = 0;
+    for (const auto& stats : slab_stats()) {
+        total += stats.pages_compacted;
+    }
+    return total;
+}
+
+size_t Cache::pages_rebalanced() const {
+    return pages_rebalanced_.load();
+}
+
+size_t Cache::items_relocated() const {
+    return items_relocated_.load();
+}
+
 void Cache::set_max_capacity(size_t capacity) {
+    // Resizes take turns, so each evicts against the capacity it set
+    std::lock_guard<Mutex> lock(resize_mutex_);
     max_capacity_ = capacity;
     
+    // Shrinking shrinks the namespace quotas too
+    for (size_t ns = 1; ns < namespaces_.size(); ++ns) {
+        if (namespaces_[ns]->memory_usage > namespace_quota(ns)) {
+            evict(ns, ns + 1, namespaces_[ns]->memory_usage, namespace_quota(ns));
+        }
+    }
     // If current usage exceeds new capacity, evict entries
     if (current_memory_usage_ > capacity) {
-        evict_if_needed();
+        if (reclaimer_) {
+            evict(0, namespaces_.size(), current_memory_usage_, capacity);
+        } else {
+            evict_if_needed();
+        }
     }
 }
 
-bool Cache::evict_if_needed() {
-    // Simple eviction: remove oldest entries until we have enough space
-    size_t target_usage = max_capacity_ * 0.8; // Keep at 80% capacity
-    
-    while (current_memory_usage_ > target_usage && lru_cache_.size() > 0) {
-        // Reduce LRU cache capacity to force eviction
-        size_t current_size = lru_cache_.size();
-        if (current_size > 1) {
-            lru_cache_.set_capacity(current_size - 1);
-            // Estimate memory reduction (this is simplified)
-            size_t estimated_reduction = 50; // Rough estimate for small entries
-            if (current_memory_usage_ > estimated_reduction) {
-                current_memory_usage_ -= estimated_reduction;
-            } else {
-                current_memory_usage_ = 0;
+bool Cache::add_namespace(const std::string& name, size_t quota) {
+    if (name.empty() || name == kDefaultNamespace || name.find(kNamespaceSeparator) != std::string::npos ||
+        namespace_ids_.count(name) > 0 || quota == 0 || namespace_quotas_ + quota > max_capacity_) {
+        return false;
+    }
+    
+    // Every shard gets a table for it before any key can map there
+    for (auto& shard : shards_) {
+        std::unique_lock<SharedMutex> lock(shard->mutex);
+        shard->tables.push_back(std::make_unique<ItemTable>());
+    }
+    namespaces_.push_back(std::make_unique<Namespace>(name, quota));
+    namespace_ids_.emplace(namespaces_.back()->name, namespaces_.size() - 1);
+    max_namespace_length_ = std::max(max_namespace_length_, name.size());
+    namespace_quotas_ += quota;
+    quota_capacity_ = max_capacity_;
+    return true;
+}
+
+size_t Cache::namespace_of(std::string_view key) const {
+    if (namespace_ids_.empty()) {
+        return 0;
+    }
+    // Only a prefix as long as the longest name can hold the separator
+    size_t limit = std::min(key.size(), max_namespace_length_ + 1);
+    const void* separator = std::memchr(key.data(), kNamespaceSeparator, limit);
+    if (!separator) {
+        return 0;
+    }
+    size_t length = static_cast<const char*>(separator) - key.data();
+    auto it = namespace_ids_.find(key.substr(0, length));
+    return it == namespace_ids_.end() ? 0 : it->second;
+}
+
+size_t Cache::num_namespaces() const {
+    return namespaces_.size();
+}
+
+std::vector<Cache::NamespaceStats> Cache::namespace_stats() const {
+    std::vector<NamespaceStats> stats;
+    for (size_t ns = 0; ns < namespaces_.size(); ++ns) {
+        const Namespace& space = *namespaces_[ns];
+        stats.push_back({space.name, namespace_quota(ns), space.memory_usage.load(), 0,
+                         space.hits.load(), space.misses.load(), space.evictions.load()});
+    }
+    for (const auto& shard : shards_) {
+        std::shared_lock<SharedMutex> lock(shard->mutex);
+        for (size_t ns = 0; ns < stats.size(); ++ns) {
+            stats[ns].items += shard->tables[ns]->size();
+        }
+    }
+    return stats;
+}
+
+void Cache::attach_write_log(WriteLog* log) {
+    write_log_ = log;
+}
+
+void Cache::attach_flash_tier(FlashTier* tier) {
+    flash_tier_ = tier;
+}
+
+void Cache::attach_reclaimer(Reclaimer* reclaimer) {
+    reclaimer_ = reclaimer;
+    reclaim_low_watermark_ = reclaimer->options().low_watermark;
+}
+
+size_t Cache::reclaim(double low_watermark, double high_watermark, size_t batch_size) {
+    size_t share = max_capacity_ / shards_.size();
+    size_t start_usage = static_cast<size_t>(share * (1.0 - low_watermark));
+    size_t target_usage = static_cast<size_t>(share * (1.0 - high_watermark));
+    size_t evicted = 0;
+    
+    for (auto& shard : shards_) {
+        // Between the watermarks a shard is left alone, so it is not
+        // trimmed by a few items on every write
+        size_t threshold = start_usage;
+        while (true) {
+            auto lock = lock_exclusive(shard->mutex);
+            if (shard->memory_usage <= threshold) {
+                break;
+            }
+            threshold = target_usage;
+            
+            uint32_t now = Item::now_ticks();
+            auto now_time = std::chrono::steady_clock::now();
+            size_t batch = 0;
+            for (; batch < batch_size && shard->memory_usage > target_usage; ++batch) {
+                // Oldest tail over the namespaces above their share of the
+                // target, so one namespace's growth does not evict another
+                // within its quota; the oldest overall when none is above
+                size_t victim_ns = 0;
+                Item* victim = nullptr;
+                bool victim_over = false;
+                for (size_t ns = 0; ns < shard->tables.size(); ++ns) {
+                    Item* tail = shard->tables[ns]->lru();
+                    if (!tail) {
+                        continue;
+                    }
+                    bool over = namespaces_[ns]->memory_usage > namespace_quota(ns) * (1.0 - high_watermark);
+                    if (!victim || over > victim_over ||
+                        (over == victim_over && Item::age(tail->last_access, now) > Item::age(victim->last_access, now))) {
+                        victim = tail;
+                        victim_ns = ns;
+                        victim_over = over;
+                    }
+                }
+                if (!victim) {
+                    break;
+                }
+                evict_item(*shard, victim_ns, victim, now, now_time);
+            }
+            evicted += batch;
+            background_evictions_ += batch;
+            if (batch < batch_size) {
+                break;
             }
+        }
+    }
+    return evicted;
+}
+
+void Cache::attach_invalidation_tracker(InvalidationTracker* tracker) {
+    invalidation_tracker_ = tracker;
+}
+
+void Cache::attach_replication(ReplicationPrimary* primary) {
+    replication_ = primary;
+}
+
+void Cache::set_compression_threshold(size_t min_size) {
+    compression_threshold_ = min_size;
+}
+
+size_t Cache::compression_threshold() const {
+    return compression_threshold_.load();
+}
+
+size_t Cache::num_shards() const {
+    return shards_.size();
+}
+
+size_t Cache::shard_index(const std::string& key) const {
+    return hash_key(key) % shards_.size();
+}
+
+std::vector<Cache::CacheEntry> Cache::export_shard(size_t shard) const {
+    std::vector<CacheEntry> entries;
+    if (shard >= shards_.size()) {
+        return entries;
+    }
+    
+    // Namespace by namespace, so a restore rebuilds each namespace's LRU order
+    std::shared_lock<SharedMutex> lock(shards_[shard]->mutex);
+    uint32_t now = Item::now_ticks();
+    auto now_time = std::chrono::steady_clock::now();
+    for (const auto& table : shards_[shard]->tables) {
+        entries.reserve(entries.size() + table->size());
+        table->for_each([&](const Item& item) {
+            entries.push_back(to_entry(item, now, now_time));
+        });
+    }
+    return entries;
+}
+
+bool Cache::restore(CacheEntry entry) {
+    const std::string& key = entry.key;
+    size_t new_size = item_size(entry);
+    size_t ns = namespace_of(key);
+    if (!fits(ns, new_size)) {
+        return false;
+    }
+    
+    // Keep future versions ahead of everything restored
+    uint64_t next = next_version_.load();
+    while (entry.version >= next &&
+           !next_version_.compare_exchange_weak(next, entry.version + 1)) {
+    }
+    
+    uint64_t hash = hash_key(key);
+    {
+        Shard& shard = shard_at(hash);
+        auto lock = lock_exclusive(shard.mutex);
+        
+        ItemTable& table = *shard.tables[ns];
+        Item* previous = table.find(key, item_hash(hash));
+        if (previous) {
+            // Restored entries become most recently used, whatever their age
+            release(shard, ns, previous);
+        } else if (flash_tier_) {
+            flash_tier_->erase(key);
+        }
+        store(shard, ns, make_item(shard, entry, item_hash(hash)), nullptr);
+    }
+    // Replicas apply the primary's writes through restore
+    invalidate(key);
+    
+    make_room(ns);
+    return true;
+}
+
+size_t Cache::item_size(size_t key_len, size_t value_len) {
+    if (key_len > Item::kMaxKeyLength || value_len > Item::kMaxValueLength) {
+        return std::numeric_limits<size_t>::max();
+    }
+    return SlabAllocator::allocation_size(sizeof(Item) + key_len + value_len);
+}
+
+size_t Cache::item_size(const CacheEntry& entry) {
+    return item_size(entry.key.size(), entry.is_integer ? sizeof(int64_t) : entry.value.size());
+}
+
+uint64_t Cache::hash_key(const std::string& key) {
+    return std::hash<std::string>{}(key);
+}
+
+uint32_t Cache::item_hash(uint64_t hash) {
+    // Folds in the high half, which the shard choice (hash % shards) barely uses
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+Cache::CacheEntry Cache::to_entry(const Item& item, uint32_t now,
+                                  std::chrono::steady_clock::time_point now_time) {
+    CacheEntry entry;
+    entry.key = std::string(item.key());
+    if (item.is_integer()) {
+        entry.int_value = item.int_value();
+    } else {
+        entry.value = std::string(item.value());
+        entry.int_value = 0;
+    }
+    entry.timestamp = now_time - std::chrono::milliseconds(Item::age(item.last_access, now));
+    entry.access_count = 0;
+    entry.version = item.version;
+    entry.is_integer = item.is_integer();
+    entry.is_compressed = item.is_compressed();
+    return entry;
+}
+
+Item* Cache::make_item(Shard& shard, const CacheEntry& entry, uint32_t hash) {
+    Item* item = entry.is_integer
+        ? Item::create(shard.allocator, entry.key, entry.int_value, entry.version, hash)
+        : Item::create(shard.allocator, entry.key, entry.value,
+                       entry.is_compressed ? Item::kCompressed : 0, entry.version, hash);
+    
+    // Carry the entry's age over into the coarse clock; future timestamps count as now
+    auto age = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - entry.timestamp).count();
+    age = std::clamp<int64_t>(age, 0, std::numeric_limits<int32_t>::max());
+    item->last_access -= static_cast<uint32_t>(age);
+    return item;
+}
+
+std::optional<std::string> Cache::compress(const std::string& value) {
+    size_t threshold = compression_threshold_.load();
+    if (threshold == 0 || value.size() < threshold) {
+        return std::nullopt;
+    }
+    // Numbers stay plain so INCR can parse them without decompressing
+    if (parse_integer(value)) {
+        return std::nullopt;
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    auto compressed = Compression::compress(value);
+    compress_time_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    if (!compressed) {
+        // Incompressible values are stored as-is
+        return std::nullopt;
+    }
+    
+    compressed_values_++;
+    compress_input_bytes_ += value.size();
+    compress_output_bytes_ += compressed->size();
+    return compressed;
+}
+
+std::string Cache::expand(std::string_view stored) const {
+    auto start = std::chrono::steady_clock::now();
+    auto value = Compression::decompress(stored);
+    decompress_time_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    return value ? std::move(*value) : std::string();
+}
+
+Cache::Shard& Cache::shard_at(uint64_t hash) const {
+    return *shards_[hash % shards_.size()];
+}
+
+void Cache::store(Shard& shard, size_t ns, Item* item, Item* old) {
+    ItemTable& table = *shard.tables[ns];
+    if (old) {
+        table.replace(old, item);
+        table.touch(item, item->last_access);
+        charge(shard, ns, item->footprint(), old->footprint());
+        Item::destroy(shard.allocator, old);
+    } else {
+        table.insert(item);
+        charge(shard, ns, item->footprint(), 0);
+    }
+}
+
+void Cache::release(Shard& shard, size_t ns, Item* item) {
+    shard.tables[ns]->remove(item);
+    charge(shard, ns, 0, item->footprint());
+    Item::destroy(shard.allocator, item);
+}
+
+size_t Cache::namespace_quota(size_t ns) const {
+    // Below the capacity the quotas were admitted against, every namespace
+    // gives up the same share
+    size_t capacity = max_capacity_;
+    double scale = capacity < quota_capacity_ ? static_cast<double>(capacity) / quota_capacity_ : 1.0;
+    if (ns != 0) {
+        return static_cast<size_t>(namespaces_[ns]->quota * scale);
+    }
+    size_t named = static_cast<size_t>(namespace_quotas_ * scale);
+    return capacity > named ? capacity - named : 0;
+}
+
+bool Cache::fits(size_t ns, size_t size) const {
+    return size <= max_capacity_ && size <= namespace_quota(ns);
+}
+
+void Cache::charge(Shard& shard, size_t ns, size_t added, size_t released) {
+    shard.memory_usage += added;
+    shard.memory_usage -= released;
+    current_memory_usage_ += added;
+    current_memory_usage_ -= released;
+    namespaces_[ns]->memory_usage += added;
+    namespaces_[ns]->memory_usage -= released;
+}
+
+uint64_t Cache::log_set(const Item& item) {
+    bool replicating = replication_ && replication_->recording();
+    if (!write_log_ && !replicating) {
+        return 0;
+    }
+    
+    // Items have no serialized form of their own; the logs take a CacheEntry
+    CacheEntry entry = to_entry(item, item.last_access, std::chrono::steady_clock::now());
+    if (replicating) {
+        replication_->append_set(entry);
+    }
+    return write_log_ ? write_log_->append_set(entry) : 0;
+}
+
+bool Cache::commit(uint64_t lsn) {
+    return !write_log_ || lsn == 0 || write_log_->commit(lsn);
+}
+
+void Cache::invalidate(const std::string& key) {
+    if (invalidation_tracker_) {
+        invalidation_tracker_->invalidate(key);
+    }
+}
+
+std::optional<Cache::CacheEntry> Cache::promote(const std::string& key) {
+    // The device read happens before any shard lock is taken
+    auto found = flash_tier_->find(key);
+    if (!found) {
+        return std::nullopt;
+    }
+    
+    std::optional<CacheEntry> result;
+    size_t ns = namespace_of(key);
+    uint64_t hash = hash_key(key);
+    {
+        Shard& shard = shard_at(hash);
+        auto lock = lock_exclusive(shard.mutex);
+        
+        ItemTable& table = *shard.tables[ns];
+        if (flash_tier_->erase_if(key, found->location)) {
+            CacheEntry& entry = found->entry;
+            entry.timestamp = std::chrono::steady_clock::now();
+            store(shard, ns, make_item(shard, entry, item_hash(hash)), nullptr);
+            result = std::move(entry);
+        } else if (Item* item = table.find(key, item_hash(hash))) {
+            // Raced with a writer or another promotion; whatever is in RAM now wins
+            uint32_t now = Item::now_ticks();
+            table.touch(item, now);
+            result = to_entry(*item, now, std::chrono::steady_clock::now());
+        }
+    }
+    
+    make_room(ns);
+    return result;
+}
+
+void Cache::make_room(size_t ns) {
+    if (reclaimer_ && current_memory_usage_ > max_capacity_ * (1.0 - reclaim_low_watermark_)) {
+        reclaimer_->wake();
+    }
+    bool over_quota = namespaces_.size() > 1 && namespaces_[ns]->memory_usage > namespace_quota(ns);
+    if (!over_quota && current_memory_usage_ <= max_capacity_) {
+        return;
+    }
+    
+    // This write pays for the eviction
+    auto start_time = std::chrono::steady_clock::now();
+    // With namespaces, an over-quota namespace evicts only its own entries
+    if (over_quota) {
+        evict(ns, ns + 1, namespaces_[ns]->memory_usage, namespace_quota(ns) * 0.8);
+    }
+    if (current_memory_usage_ > max_capacity_) {
+        // With a reclaimer, headroom is its job; take only what this write needs
+        if (reclaimer_) {
+            evict(0, namespaces_.size(), current_memory_usage_, max_capacity_);
         } else {
+            evict_if_needed();
+        }
+    }
+    inline_eviction_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_time).count();
+}
+
+bool Cache::evict_if_needed() {
+    // Remove least recently used entries until we are back under 80% capacity
+    return evict(0, namespaces_.size(), current_memory_usage_, max_capacity_ * 0.8);
+}
+
+bool Cache::evict(size_t first_ns, size_t last_ns, const std::atomic<size_t>& usage, size_t target_usage) {
+    // Each round evicts from the table whose LRU tail is oldest, so the order
+    // approximates one LRU list over the shards.
+    const size_t batch_size = 8;
+    
+    while (usage > target_usage) {
+        Shard* victim_shard = nullptr;
+        size_t victim_ns = first_ns;
+        uint32_t oldest = 0;
+        for (auto& shard : shards_) {
+            auto lock = lock_shared(shard->mutex);
+            // Read under the lock so no tail in this shard is newer than now
+            uint32_t now = Item::now_ticks();
+            for (size_t ns = first_ns; ns < last_ns; ++ns) {
+                const Item* tail = shard->tables[ns]->lru();
+                if (tail && (!victim_shard || Item::age(tail->last_access, now) > oldest)) {
+                    oldest = Item::age(tail->last_access, now);
+                    victim_shard = shard.get();
+                    victim_ns = ns;
+                }
+            }
+        }
+        if (!victim_shard) {
             break;
         }
+        
+        auto lock = lock_exclusive(victim_shard->mutex);
+        ItemTable& table = *victim_shard->tables[victim_ns];
+        uint32_t now = Item::now_ticks();
+        auto now_time = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < batch_size && usage > target_usage; ++i) {
+            Item* victim = table.lru();
+            if (!victim) {
+                break;
+            }
+            evict_item(*victim_shard, victim_ns, victim, now, now_time);
+        }
     }
     
-    return current_memory_usage_ <= target_usage;
+    return usage <= target_usage;
 }
 
-void Cache::update_statistics(bool hit) {
+void Cache::evict_item(Shard& shard, size_t ns, Item* victim, uint32_t now,
+                       std::chrono::steady_clock::time_point now_time) {
+    // Demote under the shard lock so a concurrent remove cannot be undone
+    if (flash_tier_) {
+        flash_tier_->insert(to_entry(*victim, now, now_time));
+    }
+    shard.allocator.record_eviction(victim->total_size());
+    shard.evictions++;
+    release(shard, ns, victim);
+    evictions_++;
+    namespaces_[ns]->evictions++;
+}
+
+void Cache::update_statistics(size_t ns, bool hit) {
     if (hit) {
         hits_++;
+        namespaces_[ns]->hits.fetch_add(1, std::memory_order_relaxed);
     } else {
         misses_++;
+        namespaces_[ns]->misses.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+size_t Cache::compact_shard(Shard& shard, double max_occupancy, size_t max_pages) {
+    // A moved item takes the old one's place in its table; the bytes,
+    // links included, were already copied
+    auto relocate = [&](void* from, void* to) {
+        Item* moved = static_cast<Item*>(to);
+        shard.tables[namespace_of(moved->key())]->replace(static_cast<Item*>(from), moved);
+        items_relocated_.fetch_add(1, std::memory_order_relaxed);
+    };
+    
+    size_t freed = 0;
+    for (size_t slab_class = 0; slab_class < SlabAllocator::num_classes() && freed < max_pages; ++slab_class) {
+        while (freed < max_pages) {
+            auto lock = lock_exclusive(shard.mutex);
+            if (!shard.allocator.compact(static_cast<uint8_t>(slab_class), max_occupancy, relocate)) {
+                break;
+            }
+            freed++;
+        }
+    }
+    
+    // Evictions with no free page left mean the classes being written to
+    // are growing by mapping more memory; hand them a page the class with
+    // the most spare chunks can give up instead
+    while (freed < max_pages) {
+        auto lock = lock_exclusive(shard.mutex);
+        if (shard.evictions == shard.evictions_seen || shard.allocator.free_pages() > 0) {
+            shard.evictions_seen = shard.evictions;
+            break;
+        }
+        std::optional<uint8_t> donor;
+        size_t most_free = 0;
+        auto stats = shard.allocator.class_stats();
+        for (size_t i = 0; i < stats.size(); ++i) {
+            size_t free_bytes = stats[i].free_chunks * stats[i].chunk_size;
+            if (stats[i].free_chunks >= SlabAllocator::chunks_per_page(static_cast<uint8_t>(i)) &&
+                free_bytes > most_free) {
+                donor = static_cast<uint8_t>(i);
+                most_free = free_bytes;
+            }
+        }
+        shard.evictions_seen = shard.evictions;
+        if (!donor || !shard.allocator.compact(*donor, 1.0, relocate)) {
+            break;
+        }
+        pages_rebalanced_++;
+        freed++;
     }
+    return freed;
 }
 
 } // namespace cache
@@ -0,0 +1,657 @@
+#include "cache_client.h"
+#include <algorithm>
+#include <string_view>
+#include <cstring>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace cache {
+
+namespace {
+
+// epoll token of the wake eventfd; connections use their index
+constexpr uint64_t kWakeToken = UINT64_MAX;
+constexpr int kMaxEvents = 64;
+constexpr size_t kReceiveBufferSize = 64 * 1024;
+// Server push for a near cache entry; never the start of a reply
+constexpr std::string_view kInvalidatePrefix = "INVALIDATE ";
+
+// Returns a non-blocking socket with a connect in progress, or -1
+int open_socket(const sockaddr_storage& address, socklen_t length) {
+    int fd = socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    // Pipelined requests must leave as soon as they are written
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), length) < 0 && errno != EINPROGRESS) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool socket_error(int fd) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    return getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0;
+}
+
+bool is_ok(const std::string& reply) {
+    return reply.compare(0, 2, "OK") == 0;
+}
+
+// "OK value" -> value; nullopt for "ERROR ..."
+std::optional<std::string> value_of(const std::string& reply) {
+    if (!is_ok(reply)) {
+        return std::nullopt;
+    }
+    return reply.size() > 3 ? reply.substr(3) : std::string();
+}
+
+} // namespace
+
+CacheClient::CacheClient() : CacheClient(Options()) {
+}
+
+CacheClient::CacheClient(Options options) : options_(std::move(options)) {
+    options_.connections = std::max<size_t>(options_.connections, 1);
+    if (options_.near_cache.capacity > 0) {
+        near_cache_ = std::make_unique<NearCache>(options_.near_cache);
+    }
+}
+
+CacheClient::~CacheClient() {
+    close();
+}
+
+bool CacheClient::connect() {
+    if (is_connected()) {
+        return true;
+    }
+    close();
+    
+    // Open the whole pool up front so an unreachable server is reported
+    // here. "localhost" may resolve to ::1 before 127.0.0.1, so try each.
+    std::vector<Connection> connections;
+    bool opened = false;
+    auto addresses = resolve();
+    for (const auto& [address, length] : addresses) {
+        address_ = address;
+        address_length_ = length;
+        connections = std::vector<Connection>(options_.connections);
+        opened = open_pool(connections);
+        if (opened) {
+            break;
+        }
+    }
+    if (!opened && !options_.require_server && !addresses.empty()) {
+        // Start closed; the I/O thread connects when the first requests arrive
+        address_ = addresses.front().first;
+        address_length_ = addresses.front().second;
+        connections = std::vector<Connection>(options_.connections);
+        opened = true;
+    }
+    
+    epoll_fd_ = opened ? epoll_create1(EPOLL_CLOEXEC) : -1;
+    wake_fd_ = opened ? eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC) : -1;
+    if (!opened || epoll_fd_ < 0 || wake_fd_ < 0) {
+        for (auto& connection : connections) {
+            if (connection.fd >= 0) {
+                ::close(connection.fd);
+            }
+        }
+        if (epoll_fd_ >= 0) {
+            ::close(epoll_fd_);
+            epoll_fd_ = -1;
+        }
+        if (wake_fd_ >= 0) {
+            ::close(wake_fd_);
+            wake_fd_ = -1;
+        }
+        return false;
+    }
+    
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = kWakeToken;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+    for (size_t i = 0; i < connections.size(); ++i) {
+        Connection& connection = connections[i];
+        if (connection.fd >= 0) {
+            if (near_cache_) {
+                start_tracking(connection);
+            }
+            connection.want_write = !connection.output.empty();
+            event.events = connection.want_write ? EPOLLIN | EPOLLOUT : EPOLLIN;
+            event.data.u64 = i;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, connection.fd, &event);
+        }
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connections_ = std::move(connections);
+        running_ = true;
+    }
+    io_thread_ = std::thread(&CacheClient::io_loop, this);
+    return true;
+}
+
+void CacheClient::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    if (io_thread_.joinable()) {
+        wake();
+        io_thread_.join();
+    }
+    
+    std::vector<Completion> completions;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < connections_.size(); ++i) {
+            fail(i, "ERROR Not connected", completions);
+        }
+        connections_.clear();
+    }
+    if (epoll_fd_ >= 0) {
+        ::close(epoll_fd_);
+        epoll_fd_ = -1;
+    }
+    if (wake_fd_ >= 0) {
+        ::close(wake_fd_);
+        wake_fd_ = -1;
+    }
+    run(completions);
+}
+
+bool CacheClient::is_connected() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) {
+        return false;
+    }
+    return std::any_of(connections_.begin(), connections_.end(), [](const Connection& connection) {
+        return connection.fd >= 0 && !connection.connecting;
+    });
+}
+
+void CacheClient::send(const std::string& command, Callback callback) {
+    std::vector<Callback> callbacks;
+    callbacks.push_back(std::move(callback));
+    std::vector<Completion> completions;
+    enqueue({command}, callbacks, completions);
+    run(completions);
+}
+
+std::future<std::string> CacheClient::send(const std::string& command) {
+    auto promise = std::make_shared<std::promise<std::string>>();
+    auto future = promise->get_future();
+    send(command, [promise](const std::string& reply) {
+        promise->set_value(reply);
+    });
+    return future;
+}
+
+std::string CacheClient::send_command(const std::string& command) {
+    return send(command).get();
+}
+
+void CacheClient::send_batch(const std::vector<std::string>& commands, std::vector<Callback> callbacks) {
+    std::vector<Completion> completions;
+    enqueue(commands, callbacks, completions);
+    run(completions);
+}
+
+std::future<bool> CacheClient::set(const std::string& key, const std::string& value) {
+    auto promise = std::make_shared<std::promise<bool>>();
+    auto future = promise->get_future();
+    if (near_cache_) {
+        near_cache_->invalidate(key);
+    }
+    // Dropping the key again on the reply discards fills from GETs the
+    // server answered before the write, whose pushes may still be on the way
+    send("SET " + key + " " + value, [this, promise, key](const std::string& reply) {
+        if (near_cache_) {
+            near_cache_->invalidate(key);
+        }
+        promise->set_value(is_ok(reply));
+    });
+    return future;
+}
+
+std::future<std::optional<std::string>> CacheClient::get(const std::string& key) {
+    auto promise = std::make_shared<std::promise<std::optional<std::string>>>();
+    auto future = promise->get_future();
+    if (!near_cache_) {
+        send("GET " + key, [promise](const std::string& reply) {
+            promise->set_value(value_of(reply));
+        });
+        return future;
+    }
+    
+    if (auto value = near_cache_->get(key)) {
+        promise->set_value(std::move(value));
+        return future;
+    }
+    uint64_t token = near_cache_->begin_fill(key);
+    send("GET " + key, [this, promise, key, token](const std::string& reply) {
+        auto value = value_of(reply);
+        if (value) {
+            near_cache_->fill(key, *value, token);
+        }
+        promise->set_value(std::move(value));
+    });
+    return future;
+}
+
+std::future<bool> CacheClient::remove(const std::string& key) {
+    auto promise = std::make_shared<std::promise<bool>>();
+    auto future = promise->get_future();
+    if (near_cache_) {
+        near_cache_->invalidate(key);
+    }
+    send("DELETE " + key, [this, promise, key](const std::string& reply) {
+        if (near_cache_) {
+            near_cache_->invalidate(key);
+        }
+        promise->set_value(is_ok(reply));
+    });
+    return future;
+}
+
+std::future<std::vector<std::optional<std::string>>> CacheClient::mget(const std::vector<std::string>& keys) {
+    struct Batch {
+        std::vector<std::optional<std::string>> values;
+        std::atomic<size_t> remaining;
+        std::promise<std::vector<std::optional<std::string>>> promise;
+    };
+    auto batch = std::make_shared<Batch>();
+    batch->values.resize(keys.size());
+    batch->remaining = keys.size();
+    auto future = batch->promise.get_future();
+    if (keys.empty()) {
+        batch->promise.set_value({});
+        return future;
+    }
+    
+    std::vector<std::string> commands;
+    std::vector<Callback> callbacks;
+    commands.reserve(keys.size());
+    callbacks.reserve(keys.size());
+    size_t near_hits = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        // Only the misses go to the server
+        if (near_cache_) {
+            if (auto value = near_cache_->get(keys[i])) {
+                batch->values[i] = std::move(value);
+                near_hits++;
+                continue;
+            }
+        }
+        uint64_t token = near_cache_ ? near_cache_->begin_fill(keys[i]) : 0;
+        commands.push_back("GET " + keys[i]);
+        callbacks.push_back([this, batch, i, key = keys[i], token](const std::string& reply) {
+            batch->values[i] = value_of(reply);
+            if (near_cache_ && batch->values[i]) {
+                near_cache_->fill(key, *batch->values[i], token);
+            }
+            if (batch->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                batch->promise.set_value(std::move(batch->values));
+            }
+        });
+    }
+    if (near_hits > 0 && batch->remaining.fetch_sub(near_hits, std::memory_order_acq_rel) == near_hits) {
+        batch->promise.set_value(std::move(batch->values));
+        return future;
+    }
+    send_batch(commands, std::move(callbacks));
+    return future;
+}
+
+NearCache* CacheClient::near_cache() {
+    return near_cache_.get();
+}
+
+uint64_t CacheClient::requests_sent() const {
+    return requests_sent_.load(std::memory_order_relaxed);
+}
+
+uint64_t CacheClient::writes() const {
+    return writes_.load(std::memory_order_relaxed);
+}
+
+uint64_t CacheClient::reconnects() const {
+    return reconnects_.load(std::memory_order_relaxed);
+}
+
+void CacheClient::enqueue(const std::vector<std::string>& commands, std::vector<Callback>& callbacks,
+                          std::vector<Completion>& completions) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) {
+        for (auto& callback : callbacks) {
+            completions.push_back({std::move(callback), "ERROR Not connected"});
+        }
+        return;
+    }
+    
+    size_t index = next_connection_.fetch_add(1, std::memory_order_relaxed) % connections_.size();
+    Connection& connection = connections_[index];
+    bool idle = connection.output.empty();
+    auto now = Clock::now();
+    size_t queued = 0;
+    for (size_t i = 0; i < commands.size(); ++i) {
+        // An embedded newline would shift every later reply onto the wrong request
+        if (commands[i].find_first_of("\r\n") != std::string::npos) {
+            completions.push_back({std::move(callbacks[i]), "ERROR Invalid command"});
+            continue;
+        }
+        connection.output += commands[i];
+        connection.output += '\n';
+        connection.pending.push_back({std::move(callbacks[i]), now});
+        queued++;
+    }
+    requests_sent_.fetch_add(queued, std::memory_order_relaxed);
+    
+    if (!idle || queued == 0) {
+        return;     // The pending write takes these with it
+    }
+    // Write from the caller when possible, saving a hop to the I/O thread;
+    // anything the socket does not take is left to EPOLLOUT
+    if (connection.fd >= 0 && !connection.connecting) {
+        flush(index, completions);
+    } else {
+        wake();
+    }
+}
+
+void CacheClient::wake() {
+    uint64_t one = 1;
+    ssize_t written = write(wake_fd_, &one, sizeof(one));
+    (void)written;  // EAGAIN means a wake-up is already pending
+}
+
+void CacheClient::io_loop() {
+    epoll_event events[kMaxEvents];
+    int timeout_ms = 0;
+    // Callers that write for themselves do not wake this thread, so it looks
+    // for new requests to expire at least this often. A reply is given up on
+    // between timeout and 1.25 * timeout after its request.
+    auto idle_check = std::max<Clock::duration>(options_.timeout / 4, std::chrono::milliseconds(1));
+    
+    while (true) {
+        int count = epoll_wait(epoll_fd_, events, kMaxEvents, timeout_ms);
+        std::vector<Completion> completions;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) {
+                break;
+            }
+            
+            for (int i = 0; i < count; ++i) {
+                if (events[i].data.u64 == kWakeToken) {
+                    uint64_t value;
+                    ssize_t drained = read(wake_fd_, &value, sizeof(value));
+                    (void)drained;
+                    continue;
+                }
+                size_t index = events[i].data.u64;
+                Connection& connection = connections_[index];
+                if (connection.fd < 0) {
+                    continue;   // Failed earlier in this batch
+                }
+                if (connection.connecting) {
+                    finish_connect(index, completions);
+                    continue;
+                }
+                if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                    receive(index, completions);
+                }
+                if (connection.fd >= 0 && (events[i].events & EPOLLOUT)) {
+                    flush(index, completions);
+                }
+            }
+            
+            // Write new requests, reconnect, and expire; sleep until the next deadline
+            auto now = Clock::now();
+            auto next_deadline = now + idle_check;
+            for (size_t index = 0; index < connections_.size(); ++index) {
+                Connection& connection = connections_[index];
+                if (!connection.pending.empty() && now - connection.pending.front().queued_at > options_.timeout) {
+                    fail(index, connection.fd >= 0 && !connection.connecting ? "ERROR Timeout" : "ERROR Not connected",
+                         completions);
+                }
+                if (connection.fd < 0 && !connection.pending.empty()) {
+                    if (now >= connection.retry_at) {
+                        start_connect(index, now);
+                        if (connection.fd < 0) {
+                            fail(index, "ERROR Not connected", completions);
+                        }
+                    } else {
+                        next_deadline = std::min(next_deadline, connection.retry_at);
+                    }
+                } else if (connection.connecting) {
+                    next_deadline = std::min(next_deadline, connection.connect_started + options_.timeout);
+                } else if (connection.fd >= 0 && !connection.output.empty()) {
+                    flush(index, completions);
+                }
+                if (!connection.pending.empty()) {
+                    next_deadline = std::min(next_deadline, connection.pending.front().queued_at + options_.timeout);
+                }
+            }
+            
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next_deadline - now).count();
+            timeout_ms = static_cast<int>(std::max<int64_t>(wait + 1, 0));
+        }
+        run(completions);
+    }
+}
+
+void CacheClient::start_connect(size_t index, Clock::time_point now) {
+    Connection& connection = connections_[index];
+    connection.fd = open_socket(address_, address_length_);
+    if (connection.fd < 0) {
+        return;
+    }
+    connection.connecting = true;
+    connection.connect_started = now;
+    connection.want_write = true;
+    if (near_cache_) {
+        start_tracking(connection);
+    }
+    
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLOUT;
+    event.data.u64 = index;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, connection.fd, &event);
+}
+
+void CacheClient::finish_connect(size_t index, std::vector<Completion>& completions) {
+    Connection& connection = connections_[index];
+    if (socket_error(connection.fd)) {
+        fail(index, "ERROR Not connected", completions);
+        return;
+    }
+    connection.connecting = false;
+    if (connection.opened_before) {
+        reconnects_.fetch_add(1, std::memory_order_relaxed);
+    }
+    connection.opened_before = true;
+    flush(index, completions);
+}
+
+void CacheClient::flush(size_t index, std::vector<Completion>& completions) {
+    Connection& connection = connections_[index];
+    size_t written = 0;
+    while (written < connection.output.size()) {
+        ssize_t n = ::send(connection.fd, connection.output.data() + written,
+                           connection.output.size() - written, MSG_NOSIGNAL);
+        if (n > 0) {
+            written += n;
+            writes_.fetch_add(1, std::memory_order_relaxed);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            fail(index, "ERROR Connection lost", completions);
+            return;
+        }
+    }
+    connection.output.erase(0, written);
+    update_events(connection, index);
+}
+
+void CacheClient::receive(size_t index, std::vector<Completion>& completions) {
+    Connection& connection = connections_[index];
+    char buffer[kReceiveBufferSize];
+    bool closed = false;
+    while (true) {
+        ssize_t n = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            connection.input.append(buffer, n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        closed = n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+        break;
+    }
+    
+    // Replies arrive in request order; invalidation pushes may come between them
+    size_t start = 0;
+    size_t end;
+    while ((end = connection.input.find('\n', start)) != std::string::npos) {
+        if (connection.input.compare(start, kInvalidatePrefix.size(), kInvalidatePrefix) == 0) {
+            if (near_cache_) {
+                std::string key = connection.input.substr(start + kInvalidatePrefix.size(),
+                                                          end - start - kInvalidatePrefix.size());
+                if (key == "*") {
+                    near_cache_->invalidate_all();
+                } else {
+                    near_cache_->invalidate(key);
+                }
+            }
+        } else if (!connection.pending.empty()) {
+            completions.push_back({std::move(connection.pending.front().callback),
+                                   connection.input.substr(start, end - start)});
+            connection.pending.pop_front();
+        }
+        start = end + 1;
+    }
+    connection.input.erase(0, start);
+    
+    if (closed) {
+        fail(index, "ERROR Connection lost", completions);
+    }
+}
+
+void CacheClient::fail(size_t index, const std::string& reply, std::vector<Completion>& completions) {
+    Connection& connection = connections_[index];
+    if (connection.fd >= 0) {
+        ::close(connection.fd);     // Also leaves the epoll set
+        connection.fd = -1;
+    }
+    connection.connecting = false;
+    connection.want_write = false;
+    connection.output.clear();
+    connection.input.clear();
+    for (auto& pending : connection.pending) {
+        completions.push_back({std::move(pending.callback), reply});
+    }
+    connection.pending.clear();
+    connection.retry_at = Clock::now() + options_.reconnect_delay;
+    // Pushes sent while the connection is down are lost
+    if (near_cache_) {
+        near_cache_->invalidate_all();
+    }
+}
+
+void CacheClient::update_events(Connection& connection, size_t index) {
+    bool want_write = connection.connecting || !connection.output.empty();
+    if (want_write == connection.want_write) {
+        return;
+    }
+    epoll_event event{};
+    event.events = want_write ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    event.data.u64 = index;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event);
+    connection.want_write = want_write;
+}
+
+void CacheClient::start_tracking(Connection& connection) {
+    // Keeps the oldest request's timeout clock
+    auto queued_at = connection.pending.empty() ? Clock::now() : connection.pending.front().queued_at;
+    connection.output.insert(0, "TRACKING ON\n");
+    connection.pending.push_front({nullptr, queued_at});
+}
+
+bool CacheClient::open_pool(std::vector<Connection>& connections) {
+    auto deadline = Clock::now() + options_.timeout;
+    for (auto& connection : connections) {
+        connection.fd = open_socket(address_, address_length_);
+        if (connection.fd < 0) {
+            break;
+        }
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+        pollfd poll_fd{connection.fd, POLLOUT, 0};
+        if (poll(&poll_fd, 1, std::max<int>(static_cast<int>(remaining.count()), 0)) <= 0 ||
+            socket_error(connection.fd)) {
+            break;
+        }
+        connection.opened_before = true;
+    }
+    
+    bool opened = std::all_of(connections.begin(), connections.end(), [](const Connection& connection) {
+        return connection.opened_before;
+    });
+    if (!opened) {
+        for (auto& connection : connections) {
+            if (connection.fd >= 0) {
+                ::close(connection.fd);
+                connection.fd = -1;
+            }
+        }
+    }
+    return opened;
+}
+
+std::vector<std::pair<sockaddr_storage, socklen_t>> CacheClient::resolve() const {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    std::string port = std::to_string(options_.port);
+    if (getaddrinfo(options_.host.c_str(), port.c_str(), &hints, &result) != 0) {
+        return {};
+    }
+    std::vector<std::pair<sockaddr_storage, socklen_t>> addresses;
+    for (addrinfo* info = result; info != nullptr; info = info->ai_next) {
+        sockaddr_storage address{};
+        std::memcpy(&address, info->ai_addr, info->ai_addrlen);
+        addresses.emplace_back(address, info->ai_addrlen);
+    }
+    freeaddrinfo(result);
+    return addresses;
+}
+
+void CacheClient::run(std::vector<Completion>& completions) {
+    for (auto& completion : completions) {
+        if (completion.callback) {
+            completion.callback(completion.reply);
+        }
+    }
+}
+
+} // namespace cache
@@ -1,142 +1,75 @@
 #include <iostream>
+#include <sstream>
 #include <string>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <unistd.h>
-#include <cstring>
+#include <vector>
+#include <future>
 
-class CacheClient {
-public:
-    CacheClient(const std::string& host, int port) : host_(host), port_(port), socket_(-1) {}
-    
-    ~CacheClient() {
-        disconnect();
-    }
-    
-    bool connect() {
-        socket_ = socket(AF_INET, SOCK_STREAM, 0);
-        if (socket_ < 0) {
-            std::cerr << "Failed to create socket" << std::endl;
-            return false;
-        }
-        
-        struct sockaddr_in server_addr;
-        server_addr.sin_family = AF_INET;
-        server_addr.sin_port = htons(port_);
-        
-        if (inet_pton(AF_INET, host_.c_str(), &server_addr.sin_addr) <= 0) {
-            std::cerr << "Invalid address: " << host_ << std::endl;
-            close(socket_);
-            socket_ = -1;
-            return false;
-        }
-        
-        if (::connect(socket_, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-            std::cerr << "Failed to connect to " << host_ << ":" << port_ << std::endl;
-            close(socket_);
-            socket_ = -1;
-            return false;
-        }
-        
-        return true;
-    }
-    
-    void disconnect() {
-        if (socket_ >= 0) {
-            close(socket_);
-            socket_ = -1;
-        }
-    }
-    
-    std::string send_command(const std::string& command) {
-        if (socket_ < 0) {
-            return "ERROR Not connected";
-        }
-        
-        std::string full_command = command + "\n";
-        if (send(socket_, full_command.c_str(), full_command.length(), 0) < 0) {
-            return "ERROR Send failed";
-        }
-        
-        char buffer[4096];
-        ssize_t bytes_received = recv(socket_, buffer, sizeof(buffer) - 1, 0);
-        if (bytes_received <= 0) {
-            return "ERROR Receive failed";
-        }
-        
-        buffer[bytes_received] = '\0';
-        std::string response(buffer);
-        
-        // Remove trailing newline
-        if (!response.empty() && response.back() == '\n') {
-            response.pop_back();
-        }
-        
-        return response;
-    }
-    
-    bool set(const std::string& key, const std::string& value) {
-        std::string command = "SET " + key + " " + value;
-        std::string response = send_command(command);
-        return response.find("OK") == 0;
+#include "sharded_client.h"
+
+namespace {
+
+// Commands without a key go to every node
+bool is_broadcast(const std::string& command) {
+    return command == "STATS" || command == "CLEAR" || command == "BGSAVE" || command == "SLOWLOG" ||
+           command == "HOTKEYS" || command == "BIGKEYS";
+}
+
+// Sends a raw protocol line: to the key's node, or to every node for
+// commands without a key, prefixing each reply with its node
+void send_line(cache::ShardedClient& client, const std::string& line) {
+    std::istringstream words(line);
+    std::string command;
+    std::string key;
+    words >> command >> key;
+    for (auto& c : command) {
+        c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
     }
     
-    std::string get(const std::string& key) {
-        std::string command = "GET " + key;
-        std::string response = send_command(command);
-        
-        if (response.find("OK") == 0) {
-            // Extract value from "OK value"
-            size_t space_pos = response.find(' ');
-            if (space_pos != std::string::npos) {
-                return response.substr(space_pos + 1);
+    if (is_broadcast(command) || key.empty()) {
+        for (size_t i = 0; i < client.node_count(); ++i) {
+            std::string reply = client.node(i).send_command(line);
+            if (client.node_count() > 1) {
+                std::cout << client.node_name(i) << ": ";
             }
+            std::cout << reply << std::endl;
         }
-        
-        return "";
-    }
-    
-    bool remove(const std::string& key) {
-        std::string command = "DELETE " + key;
-        std::string response = send_command(command);
-        return response.find("OK") == 0;
-    }
-    
-    void clear() {
-        send_command("CLEAR");
+        return;
     }
     
-    std::string stats() {
-        return send_command("STATS");
-    }
+    std::promise<std::string> reply;
+    client.send(key, line, [&reply](const std::string& response) {
+        reply.set_value(response);
+    });
+    std::cout << reply.get_future().get() << std::endl;
+}
 
-private:
-    std::string host_;
-    int port_;
-    int socket_;
-};
+} // namespace
 
 void print_usage(const char* program_name) {
     std::cout << "Usage: " << program_name << " [options] [command]\n"
               << "Options:\n"
               << "  --host HOST    Server host (default: localhost)\n"
               << "  --port PORT    Server port (default: 8080)\n"
+              << "  --nodes LIST   Shard keys over host:port,host:port,... instead\n"
               << "  --help         Show this help message\n"
               << "\n"
               << "Commands:\n"
               << "  set KEY VALUE  Set a key-value pair\n"
               << "  get KEY        Get a value by key\n"
               << "  delete KEY     Delete a key\n"
+              << "  mget KEY...    Get several keys in one round trip\n"
               << "  clear          Clear all data\n"
-              << "  stats          Show server statistics\n"
+              << "  stats [SECTION] Show server statistics; SECTION is latency, commands,\n"
+              << "                 cache, server, mrc or locks\n"
               << "  interactive    Start interactive mode\n";
 }
 
 int main(int argc, char* argv[]) {
     std::string host = "localhost";
     int port = 8080;
+    std::string nodes;
     std::string command;
+    std::vector<std::string> command_args;
     
     // Parse arguments
     for (int i = 1; i < argc; i++) {
@@ -145,22 +78,41 @@ int main(int argc, char* argv[]) {
             host = argv[++i];
         } else if (arg == "--port" && i + 1 < argc) {
             port = std::stoi(argv[++i]);
+        } else if (arg == "--nodes" && i + 1 < argc) {
+            nodes = argv[++i];
         } else if (arg == "--help") {
             print_usage(argv[0]);
             return 0;
         } else if (command.empty()) {
             command = arg;
+        } else {
+            command_args.push_back(arg);
         }
     }
     
-    CacheClient client(host, port);
+    // A single server is a ring of one
+    cache::ShardedClient::Options options;
+    if (nodes.empty()) {
+        options.nodes.push_back(host + ":" + std::to_string(port));
+    } else {
+        std::stringstream list(nodes);
+        std::string node;
+        while (std::getline(list, node, ',')) {
+            options.nodes.push_back(node);
+        }
+    }
+    cache::ShardedClient client(options);
     
     if (!client.connect()) {
         std::cerr << "Failed to connect to cache server" << std::endl;
         return 1;
     }
     
-    std::cout << "Connected to cache server at " << host << ":" << port << std::endl;
+    for (size_t i = 0; i < client.node_count(); ++i) {
+        if (!client.is_down(i)) {
+            std::cout << "Connected to cache server at " << client.node_name(i) << std::endl;
+        }
+    }
     
     if (command == "interactive" || command.empty()) {
         // Interactive mode
@@ -176,15 +128,32 @@ int main(int argc, char* argv[]) {
                 continue;
             }
             
-            std::string response = client.send_command(line);
-            std::cout << response << std::endl;
+            send_line(client, line);
         }
     } else {
         // Single command mode
-        if (command == "stats") {
-            std::cout << client.stats() << std::endl;
+        if (command == "set" && command_args.size() >= 2) {
+            std::string value = command_args[1];
+            for (size_t i = 2; i < command_args.size(); ++i) {
+                value += " " + command_args[i];
+            }
+            std::cout << (client.set(command_args[0], value).get() ? "OK" : "Failed") << std::endl;
+        } else if (command == "get" && command_args.size() == 1) {
+            auto value = client.get(command_args[0]).get();
+            std::cout << (value ? *value : "(not found)") << std::endl;
+        } else if (command == "delete" && command_args.size() == 1) {
+            std::cout << (client.remove(command_args[0]).get() ? "OK" : "Not found") << std::endl;
+        } else if (command == "mget" && !command_args.empty()) {
+            auto values = client.mget(command_args).get();
+            for (size_t i = 0; i < values.size(); ++i) {
+                std::cout << command_args[i] << ": " << (values[i] ? *values[i] : "(not found)") << std::endl;
+            }
+        } else if (command == "stats") {
+            send_line(client, command_args.empty() ? "STATS" : "STATS " + command_args[0]);
         } else if (command == "clear") {
-            client.clear();
+            for (size_t i = 0; i < client.node_count(); ++i) {
+                client.node(i).send_command("CLEAR");
+            }
             std::cout << "Cache cleared" << std::endl;
         } else {
             std::cout << "Unknown command: " << command << std::endl;
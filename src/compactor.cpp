@@ -0,0 +1,67 @@
+#include "compactor.h"
+
+namespace cache {
+
+Compactor::Compactor(Cache& cache, Options options) : cache_(cache), options_(options) {
+}
+
+Compactor::~Compactor() {
+    stop();
+}
+
+void Compactor::start() {
+    if (worker_.joinable()) {
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_requested_ = false;
+    }
+    worker_ = std::thread([this] { run(); });
+}
+
+void Compactor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_requested_ = true;
+    }
+    condition_.notify_all();
+    
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+size_t Compactor::passes() const {
+    return passes_.load();
+}
+
+size_t Compactor::pages_freed() const {
+    return pages_freed_.load();
+}
+
+double Compactor::last_duration_ms() const {
+    return last_duration_ms_.load();
+}
+
+void Compactor::run() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait_for(lock, options_.interval, [this] { return stop_requested_; });
+            if (stop_requested_) {
+                return;
+            }
+        }
+        
+        auto start_time = std::chrono::steady_clock::now();
+        pages_freed_ += cache_.compact(options_.max_occupancy, options_.max_pages);
+        auto end_time = std::chrono::steady_clock::now();
+        
+        last_duration_ms_ = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+        passes_++;
+    }
+}
+
+} // namespace cache
@@ -0,0 +1,58 @@
+#include "compression.h"
+#include <lz4.h>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace cache {
+
+namespace {
+
+constexpr size_t kPrefixSize = sizeof(uint32_t);
+
+} // namespace
+
+std::optional<std::string> Compression::compress(std::string_view value) {
+    if (value.size() > static_cast<size_t>(LZ4_MAX_INPUT_SIZE)) {
+        return std::nullopt;
+    }
+    
+    int bound = LZ4_compressBound(static_cast<int>(value.size()));
+    std::string data(kPrefixSize + bound, '\0');
+    uint32_t raw_len = value.size();
+    std::memcpy(&data[0], &raw_len, sizeof(raw_len));
+    
+    int written = LZ4_compress_default(value.data(), &data[kPrefixSize],
+                                       static_cast<int>(value.size()), bound);
+    if (written <= 0 || kPrefixSize + written >= value.size()) {
+        return std::nullopt;
+    }
+    
+    data.resize(kPrefixSize + written);
+    data.shrink_to_fit();
+    return data;
+}
+
+std::optional<std::string> Compression::decompress(std::string_view data) {
+    if (data.size() < kPrefixSize ||
+        data.size() - kPrefixSize > static_cast<size_t>(std::numeric_limits<int>::max())) {
+        return std::nullopt;
+    }
+    
+    uint32_t raw_len;
+    std::memcpy(&raw_len, data.data(), sizeof(raw_len));
+    if (raw_len > static_cast<uint32_t>(LZ4_MAX_INPUT_SIZE)) {
+        return std::nullopt;
+    }
+    
+    std::string value(raw_len, '\0');
+    int read = LZ4_decompress_safe(data.data() + kPrefixSize, value.data(),
+                                   static_cast<int>(data.size() - kPrefixSize),
+                                   static_cast<int>(raw_len));
+    if (read < 0 || static_cast<uint32_t>(read) != raw_len) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+} // namespace cache
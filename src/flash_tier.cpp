@@ -0,0 +1,321 @@
+#include "flash_tier.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <iostream>
+
+namespace cache {
+
+namespace {
+
+constexpr uint8_t kFlagInteger = 1;
+constexpr uint8_t kFlagCompressed = 2;
+constexpr size_t kRecordHeaderSize = 3 * sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint64_t);
+
+template<typename T>
+void append_raw(std::string& buffer, T value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template<typename T>
+T read_at(const char* data) {
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+uint32_t fnv1a(const char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint64_t key_hash(const std::string& key) {
+    return std::hash<std::string>{}(key);
+}
+
+} // namespace
+
+FlashTier::FlashTier(Options options)
+    : options_(std::move(options)) {
+}
+
+FlashTier::~FlashTier() {
+    close();
+}
+
+bool FlashTier::open() {
+    // The index lives in memory only, so old contents are meaningless
+    fd_ = ::open(options_.path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Failed to open flash file " << options_.path << std::endl;
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    segment_keys_.assign(options_.num_segments, {});
+    active_segment_ = 0;
+    active_buffer_ = std::make_shared<std::string>();
+    active_buffer_->reserve(options_.segment_size);
+    in_memory_[active_segment_] = active_buffer_;
+    stop_ = false;
+    flusher_ = std::thread([this] { run_flusher(); });
+    return true;
+}
+
+void FlashTier::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    flush_condition_.notify_all();
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+    
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool FlashTier::insert(const Cache::CacheEntry& entry) {
+    // Encode before taking the index lock
+    const char* value = entry.is_integer ? reinterpret_cast<const char*>(&entry.int_value)
+                                         : entry.value.data();
+    uint32_t value_len = entry.is_integer ? sizeof(entry.int_value) : entry.value.size();
+    
+    std::string record;
+    record.reserve(kRecordHeaderSize + entry.key.size() + value_len);
+    append_raw<uint32_t>(record, 0);
+    append_raw<uint32_t>(record, entry.key.size());
+    append_raw<uint32_t>(record, value_len);
+    append_raw<uint8_t>(record, (entry.is_integer ? kFlagInteger : 0) |
+                                (entry.is_compressed ? kFlagCompressed : 0));
+    append_raw<uint64_t>(record, entry.version);
+    record.append(entry.key);
+    record.append(value, value_len);
+    uint32_t checksum = fnv1a(record.data() + sizeof(uint32_t), record.size() - sizeof(uint32_t));
+    std::memcpy(&record[0], &checksum, sizeof(checksum));
+    
+    if (record.size() > options_.segment_size) {
+        dropped_++;
+        return false;
+    }
+    
+    uint64_t hash = key_hash(entry.key);
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    if (fd_ < 0 || stop_) {
+        dropped_++;
+        return false;
+    }
+    
+    if (active_buffer_->size() + record.size() > options_.segment_size && !roll_segment()) {
+        dropped_++;
+        return false;
+    }
+    
+    Location location{active_segment_, static_cast<uint32_t>(active_buffer_->size()),
+                      static_cast<uint32_t>(record.size())};
+    active_buffer_->append(record);
+    index_[hash] = location;
+    segment_keys_[active_segment_ % options_.num_segments].push_back(hash);
+    return true;
+}
+
+std::optional<FlashTier::Location> FlashTier::read_record(const std::string& key, std::string& record) {
+    uint64_t hash = key_hash(key);
+    Location location;
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(hash);
+        if (it == index_.end()) {
+            return std::nullopt;
+        }
+        if (!is_live(it->second.segment)) {
+            index_.erase(it);
+            return std::nullopt;
+        }
+        
+        location = it->second;
+        auto buffered = in_memory_.find(location.segment);
+        if (buffered != in_memory_.end()) {
+            record.assign(buffered->second->data() + location.offset, location.length);
+        }
+    }
+    
+    // Device reads happen with no lock held, so they overlap freely
+    if (record.empty()) {
+        record.resize(location.length);
+        off_t position = static_cast<off_t>(location.segment % options_.num_segments) * options_.segment_size
+                         + location.offset;
+        size_t done = 0;
+        while (done < record.size()) {
+            ssize_t n = pread(fd_, &record[done], record.size() - done, position + done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return std::nullopt;
+            }
+            done += n;
+        }
+    }
+    reads_++;
+    
+    // Verify the record; a mismatch means a hash collision or an overwritten slot
+    uint32_t key_len = read_at<uint32_t>(record.data() + 4);
+    uint32_t value_len = read_at<uint32_t>(record.data() + 8);
+    if (kRecordHeaderSize + static_cast<size_t>(key_len) + value_len != record.size() ||
+        fnv1a(record.data() + 4, record.size() - 4) != read_at<uint32_t>(record.data()) ||
+        record.compare(kRecordHeaderSize, key_len, key) != 0) {
+        return std::nullopt;
+    }
+    return location;
+}
+    
+std::optional<FlashTier::Lookup> FlashTier::find(const std::string& key) {
+    std::string record;
+    auto location = read_record(key, record);
+    if (!location) {
+        return std::nullopt;
+    }
+    
+    uint32_t key_len = read_at<uint32_t>(record.data() + 4);
+    uint32_t value_len = read_at<uint32_t>(record.data() + 8);
+    uint8_t flags = read_at<uint8_t>(record.data() + 12);
+    uint64_t version = read_at<uint64_t>(record.data() + 13);
+    const char* value = record.data() + kRecordHeaderSize + key_len;
+    
+    if (flags & kFlagInteger) {
+        return Lookup{Cache::CacheEntry(key, read_at<int64_t>(value), version), *location};
+    }
+    Cache::CacheEntry entry(key, std::string(value, value_len), version);
+    entry.is_compressed = (flags & kFlagCompressed) != 0;
+    return Lookup{std::move(entry), *location};
+}
+
+bool FlashTier::erase_if(const std::string& key, const Location& location) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key_hash(key));
+    if (it == index_.end() || !(it->second == location) || !is_live(location.segment)) {
+        return false;
+    }
+    index_.erase(it);
+    return true;
+}
+
+bool FlashTier::erase(const std::string& key) {
+    // The index only knows the hash; a colliding key must not remove this one
+    std::string record;
+    auto location = read_record(key, record);
+    return location && erase_if(key, *location);
+}
+
+bool FlashTier::contains(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key_hash(key));
+    return it != index_.end() && is_live(it->second.segment);
+}
+
+void FlashTier::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    index_.clear();
+    for (auto& keys : segment_keys_) {
+        keys.clear();
+    }
+}
+
+size_t FlashTier::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index_.size();
+}
+
+size_t FlashTier::bytes_written() const {
+    return bytes_written_.load();
+}
+
+size_t FlashTier::reads() const {
+    return reads_.load();
+}
+
+size_t FlashTier::dropped() const {
+    return dropped_.load();
+}
+
+bool FlashTier::roll_segment() {
+    // Device is behind; shed demotions rather than buffer without bound
+    if (flush_queue_.size() >= options_.max_pending_segments) {
+        return false;
+    }
+    
+    flush_queue_.push_back(active_segment_);
+    flush_condition_.notify_one();
+    active_segment_++;
+    
+    // FIFO reclaim: the ring slot we are about to reuse held the oldest segment
+    size_t slot = active_segment_ % options_.num_segments;
+    if (active_segment_ >= options_.num_segments) {
+        uint64_t reclaimed = active_segment_ - options_.num_segments;
+        for (uint64_t hash : segment_keys_[slot]) {
+            auto it = index_.find(hash);
+            if (it != index_.end() && it->second.segment == reclaimed) {
+                index_.erase(it);
+            }
+        }
+    }
+    segment_keys_[slot].clear();
+    
+    active_buffer_ = std::make_shared<std::string>();
+    active_buffer_->reserve(options_.segment_size);
+    in_memory_[active_segment_] = active_buffer_;
+    return true;
+}
+
+bool FlashTier::is_live(uint64_t segment) const {
+    return segment + options_.num_segments > active_segment_;
+}
+
+void FlashTier::run_flusher() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    
+    while (true) {
+        flush_condition_.wait(lock, [this] { return stop_ || !flush_queue_.empty(); });
+        if (flush_queue_.empty()) {
+            return;
+        }
+        
+        uint64_t segment = flush_queue_.front();
+        std::shared_ptr<std::string> buffer = in_memory_[segment];
+        lock.unlock();
+        
+        // One large sequential write per segment
+        off_t position = static_cast<off_t>(segment % options_.num_segments) * options_.segment_size;
+        size_t done = 0;
+        while (done < buffer->size()) {
+            ssize_t n = pwrite(fd_, buffer->data() + done, buffer->size() - done, position + done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                std::cerr << "Failed to write flash segment " << segment << std::endl;
+                break;
+            }
+            done += n;
+        }
+        bytes_written_ += done;
+        
+        lock.lock();
+        flush_queue_.pop_front();
+        in_memory_.erase(segment);
+    }
+}
+
+} // namespace cache
@@ -0,0 +1,80 @@
+#include "hash_ring.h"
+
+namespace cache {
+
+namespace {
+
+uint64_t fnv1a64(const std::string& data) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// MurmurHash3 finalizer: FNV-1a alone leaves similar keys ("node-1",
+// "node-2") close together on the ring
+uint64_t mix(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+} // namespace
+
+HashRing::HashRing(size_t virtual_nodes) : virtual_nodes_(std::max<size_t>(virtual_nodes, 1)) {
+}
+
+size_t HashRing::add(const std::string& node) {
+    uint32_t index = static_cast<uint32_t>(nodes_.size());
+    nodes_.push_back(node);
+    for (size_t i = 0; i < virtual_nodes_; ++i) {
+        points_.emplace_back(hash(node + "-" + std::to_string(i)), index);
+    }
+    std::sort(points_.begin(), points_.end());
+    return index;
+}
+
+size_t HashRing::size() const {
+    return nodes_.size();
+}
+
+bool HashRing::empty() const {
+    return nodes_.empty();
+}
+
+const std::string& HashRing::node_name(size_t index) const {
+    return nodes_[index];
+}
+
+size_t HashRing::node_for(const std::string& key) const {
+    return points_[first_point(key)].second;
+}
+
+std::vector<size_t> HashRing::preference_list(const std::string& key, size_t count) const {
+    std::vector<size_t> nodes;
+    count = std::min(count, nodes_.size());
+    size_t start = first_point(key);
+    for (size_t i = 0; i < points_.size() && nodes.size() < count; ++i) {
+        size_t node = points_[(start + i) % points_.size()].second;
+        if (std::find(nodes.begin(), nodes.end(), node) == nodes.end()) {
+            nodes.push_back(node);
+        }
+    }
+    return nodes;
+}
+
+uint64_t HashRing::hash(const std::string& data) {
+    return mix(fnv1a64(data));
+}
+
+size_t HashRing::first_point(const std::string& key) const {
+    auto it = std::lower_bound(points_.begin(), points_.end(), std::make_pair(hash(key), uint32_t{0}));
+    return it == points_.end() ? 0 : static_cast<size_t>(it - points_.begin());
+}
+
+} // namespace cache
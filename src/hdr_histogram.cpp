@@ -0,0 +1,137 @@
+#include "hdr_histogram.h"
+#include <algorithm>
+#include <cmath>
+
+namespace cache {
+
+HdrHistogram::HdrHistogram(uint64_t highest_trackable, int significant_digits)
+    : highest_trackable_(std::max<uint64_t>(highest_trackable, 2)) {
+    significant_digits = std::clamp(significant_digits, 1, 5);
+    
+    // Enough linear sub-buckets to resolve 10^digits distinct values per power of two
+    uint64_t largest_single_unit = 2 * static_cast<uint64_t>(std::pow(10, significant_digits));
+    int sub_bucket_count_magnitude = static_cast<int>(std::ceil(std::log2(largest_single_unit)));
+    sub_bucket_half_count_magnitude_ = sub_bucket_count_magnitude - 1;
+    sub_bucket_half_count_ = 1ULL << sub_bucket_half_count_magnitude_;
+    sub_bucket_mask_ = (1ULL << sub_bucket_count_magnitude) - 1;
+    
+    size_t bucket_count = 1;
+    uint64_t smallest_untrackable = 1ULL << sub_bucket_count_magnitude;
+    while (smallest_untrackable <= highest_trackable_) {
+        if (smallest_untrackable > UINT64_MAX / 2) {
+            bucket_count++;
+            break;
+        }
+        smallest_untrackable <<= 1;
+        bucket_count++;
+    }
+    counts_.assign((bucket_count + 1) * sub_bucket_half_count_, 0);
+}
+
+void HdrHistogram::record(uint64_t value, uint64_t count) {
+    value = std::min(value, highest_trackable_);
+    counts_[index_for(value)] += count;
+    total_count_ += count;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+    sum_ += static_cast<double>(value) * count;
+}
+
+void HdrHistogram::record_corrected(uint64_t value, uint64_t expected_interval) {
+    record(value);
+    if (expected_interval == 0) {
+        return;
+    }
+    for (uint64_t missing = value; missing > expected_interval; ) {
+        missing -= expected_interval;
+        record(missing);
+    }
+}
+
+void HdrHistogram::merge(const HdrHistogram& other) {
+    size_t n = std::min(counts_.size(), other.counts_.size());
+    for (size_t i = 0; i < n; ++i) {
+        counts_[i] += other.counts_[i];
+    }
+    total_count_ += other.total_count_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    sum_ += other.sum_;
+}
+
+void HdrHistogram::reset() {
+    std::fill(counts_.begin(), counts_.end(), 0);
+    total_count_ = 0;
+    min_ = UINT64_MAX;
+    max_ = 0;
+    sum_ = 0.0;
+}
+
+uint64_t HdrHistogram::count() const {
+    return total_count_;
+}
+
+uint64_t HdrHistogram::min() const {
+    return total_count_ == 0 ? 0 : min_;
+}
+
+uint64_t HdrHistogram::max() const {
+    return max_;
+}
+
+double HdrHistogram::mean() const {
+    return total_count_ == 0 ? 0.0 : sum_ / total_count_;
+}
+
+uint64_t HdrHistogram::percentile(double percentile) const {
+    if (total_count_ == 0) {
+        return 0;
+    }
+    
+    percentile = std::clamp(percentile, 0.0, 100.0);
+    uint64_t target = static_cast<uint64_t>(std::ceil(percentile / 100.0 * total_count_));
+    target = std::max<uint64_t>(target, 1);
+    
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        seen += counts_[i];
+        if (seen >= target) {
+            return std::min(highest_equivalent_value(i), max_);
+        }
+    }
+    return max_;
+}
+
+uint64_t HdrHistogram::count_at_or_below(uint64_t value) const {
+    if (value >= max_) {
+        return total_count_;
+    }
+    size_t last = index_for(std::min(value, highest_trackable_));
+    uint64_t seen = 0;
+    for (size_t i = 0; i <= last; ++i) {
+        seen += counts_[i];
+    }
+    return seen;
+}
+
+size_t HdrHistogram::index_for(uint64_t value) const {
+    // Bucket is how far the value's top bit sits above the first bucket's range
+    int bits = 64 - __builtin_clzll(value | sub_bucket_mask_);
+    int bucket = bits - (sub_bucket_half_count_magnitude_ + 1);
+    uint64_t sub_bucket = value >> bucket;
+    return ((static_cast<size_t>(bucket) + 1) << sub_bucket_half_count_magnitude_) +
+           (sub_bucket - sub_bucket_half_count_);
+}
+
+uint64_t HdrHistogram::highest_equivalent_value(size_t index) const {
+    int bucket = static_cast<int>(index >> sub_bucket_half_count_magnitude_) - 1;
+    uint64_t sub_bucket = (index & (sub_bucket_half_count_ - 1)) + sub_bucket_half_count_;
+    if (bucket < 0) {
+        sub_bucket -= sub_bucket_half_count_;
+        bucket = 0;
+    }
+    uint64_t lowest = sub_bucket << bucket;
+    return lowest + (1ULL << bucket) - 1;
+}
+
+} // namespace cache
@@ -0,0 +1,225 @@
+#include "hot_keys.h"
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+namespace cache {
+
+namespace {
+
+// Per-thread xorshift generator for sampling. Random rather than every Nth
+// access, so a client cycling through N keys cannot hide all but one.
+uint64_t next_random() {
+    thread_local uint64_t state =
+        std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+uint64_t mix(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+size_t round_up_pow2(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+} // namespace
+
+HotKeys::HotKeys() : HotKeys(Options()) {
+}
+
+HotKeys::HotKeys(Options options)
+    : options_(options),
+      width_mask_(round_up_pow2(std::max<size_t>(options.width, 1)) - 1) {
+    options_.depth = std::max<size_t>(options_.depth, 1);
+    options_.top_k = std::max<size_t>(options_.top_k, 1);
+    options_.sample_rate = static_cast<uint32_t>(round_up_pow2(std::max<uint32_t>(options_.sample_rate, 1)));
+    options_.decay_interval = std::max<uint64_t>(options_.decay_interval, 1);
+    counters_ = std::make_unique<std::atomic<uint32_t>[]>(options_.depth * (width_mask_ + 1));
+    hot_.reserve(options_.top_k);
+    big_.reserve(options_.top_k);
+}
+
+bool HotKeys::record_access(const std::string& key) {
+    if ((next_random() & (options_.sample_rate - 1)) != 0) {
+        return false;
+    }
+    
+    uint64_t hash = mix(std::hash<std::string>{}(key));
+    uint64_t estimate = UINT64_MAX;
+    for (size_t row = 0; row < options_.depth; ++row) {
+        uint32_t count = counters_[slot(hash, row)].fetch_add(1, std::memory_order_relaxed) + 1;
+        estimate = std::min<uint64_t>(estimate, count);
+    }
+    
+    // Skip the update rather than wait if another thread holds the list;
+    // a hot key will be sampled again soon
+    std::unique_lock<std::mutex> lock(hot_mutex_, std::defer_lock);
+    if (estimate > hot_min_.load(std::memory_order_relaxed) && lock.try_lock()) {
+        auto it = std::find_if(hot_.begin(), hot_.end(), [&key](const KeyCount& entry) {
+            return entry.key == key;
+        });
+        if (it != hot_.end()) {
+            it->count = estimate;
+        } else if (hot_.size() < options_.top_k) {
+            hot_.push_back({key, estimate});
+        } else {
+            auto coldest = std::min_element(hot_.begin(), hot_.end(), [](const KeyCount& a, const KeyCount& b) {
+                return a.count < b.count;
+            });
+            if (estimate > coldest->count) {
+                *coldest = {key, estimate};
+            }
+        }
+        refresh_min(hot_, options_.top_k, hot_min_);
+        lock.unlock();
+    }
+    
+    if ((samples_.fetch_add(1, std::memory_order_relaxed) + 1) % options_.decay_interval == 0) {
+        decay();
+    }
+    return true;
+}
+
+void HotKeys::record_size(const std::string& key, size_t size) {
+    if (size <= big_min_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(big_mutex_);
+    auto it = std::find_if(big_.begin(), big_.end(), [&key](const KeyCount& entry) {
+        return entry.key == key;
+    });
+    if (it != big_.end()) {
+        it->count = size;
+    } else if (big_.size() < options_.top_k) {
+        big_.push_back({key, size});
+    } else {
+        auto smallest = std::min_element(big_.begin(), big_.end(), [](const KeyCount& a, const KeyCount& b) {
+            return a.count < b.count;
+        });
+        if (size > smallest->count) {
+            *smallest = {key, size};
+        }
+    }
+    refresh_min(big_, options_.top_k, big_min_);
+}
+
+void HotKeys::correct_size(const std::string& key, size_t size) {
+    std::lock_guard<std::mutex> lock(big_mutex_);
+    auto it = std::find_if(big_.begin(), big_.end(), [&key](const KeyCount& entry) {
+        return entry.key == key;
+    });
+    if (it == big_.end()) {
+        return;
+    }
+    if (size == 0) {
+        big_.erase(it);
+    } else {
+        it->count = size;
+    }
+    refresh_min(big_, options_.top_k, big_min_);
+}
+
+std::vector<HotKeys::KeyCount> HotKeys::hot_keys(size_t count) const {
+    std::vector<KeyCount> list;
+    {
+        std::lock_guard<std::mutex> lock(hot_mutex_);
+        list = hot_;
+    }
+    for (auto& entry : list) {
+        entry.count *= options_.sample_rate;
+    }
+    return top(std::move(list), count);
+}
+
+std::vector<HotKeys::KeyCount> HotKeys::big_keys(size_t count) const {
+    std::lock_guard<std::mutex> lock(big_mutex_);
+    return top(big_, count);
+}
+
+uint64_t HotKeys::estimate(const std::string& key) const {
+    return static_cast<uint64_t>(sketch_min(mix(std::hash<std::string>{}(key)))) * options_.sample_rate;
+}
+
+void HotKeys::reset() {
+    for (size_t i = 0; i < options_.depth * (width_mask_ + 1); ++i) {
+        counters_[i].store(0, std::memory_order_relaxed);
+    }
+    {
+        std::lock_guard<std::mutex> lock(hot_mutex_);
+        hot_.clear();
+        hot_min_.store(0, std::memory_order_relaxed);
+    }
+    std::lock_guard<std::mutex> lock(big_mutex_);
+    big_.clear();
+    big_min_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t HotKeys::samples() const {
+    return samples_.load(std::memory_order_relaxed);
+}
+
+size_t HotKeys::slot(uint64_t hash, size_t row) const {
+    // Double hashing: row i probes h1 + i * h2, with h2 odd
+    uint64_t h1 = hash & 0xffffffffULL;
+    uint64_t h2 = (hash >> 32) | 1;
+    return row * (width_mask_ + 1) + ((h1 + row * h2) & width_mask_);
+}
+
+uint32_t HotKeys::sketch_min(uint64_t hash) const {
+    uint32_t estimate = UINT32_MAX;
+    for (size_t row = 0; row < options_.depth; ++row) {
+        estimate = std::min(estimate, counters_[slot(hash, row)].load(std::memory_order_relaxed));
+    }
+    return estimate;
+}
+
+void HotKeys::decay() {
+    // Increments racing with the halving may be lost; the sketch is approximate anyway
+    for (size_t i = 0; i < options_.depth * (width_mask_ + 1); ++i) {
+        counters_[i].store(counters_[i].load(std::memory_order_relaxed) >> 1, std::memory_order_relaxed);
+    }
+    
+    std::lock_guard<std::mutex> lock(hot_mutex_);
+    for (auto& entry : hot_) {
+        entry.count >>= 1;
+    }
+    hot_.erase(std::remove_if(hot_.begin(), hot_.end(), [](const KeyCount& entry) {
+        return entry.count == 0;
+    }), hot_.end());
+    refresh_min(hot_, options_.top_k, hot_min_);
+}
+
+void HotKeys::refresh_min(const std::vector<KeyCount>& list, size_t capacity, std::atomic<uint64_t>& min) {
+    uint64_t smallest = 0;
+    if (list.size() >= capacity) {
+        smallest = UINT64_MAX;
+        for (const auto& entry : list) {
+            smallest = std::min(smallest, entry.count);
+        }
+    }
+    min.store(smallest, std::memory_order_relaxed);
+}
+
+std::vector<HotKeys::KeyCount> HotKeys::top(std::vector<KeyCount> list, size_t count) {
+    std::sort(list.begin(), list.end(), [](const KeyCount& a, const KeyCount& b) {
+        return a.count > b.count || (a.count == b.count && a.key < b.key);
+    });
+    if (list.size() > count) {
+        list.resize(count);
+    }
+    return list;
+}
+
+} // namespace cache
@@ -0,0 +1,128 @@
+#include "invalidation_tracker.h"
+#include <algorithm>
+
+namespace cache {
+
+InvalidationTracker::InvalidationTracker(size_t max_keys, size_t num_shards) {
+    num_shards = std::max<size_t>(num_shards, 1);
+    max_keys_per_shard_ = std::max<size_t>(max_keys / num_shards, 1);
+    shards_.reserve(num_shards);
+    for (size_t i = 0; i < num_shards; ++i) {
+        shards_.push_back(std::make_unique<Shard>());
+    }
+}
+
+uint64_t InvalidationTracker::add_client(Push push) {
+    std::unique_lock<SharedMutex> lock(clients_mutex_);
+    uint64_t client = next_client_++;
+    clients_.emplace(client, std::move(push));
+    return client;
+}
+
+void InvalidationTracker::remove_client(uint64_t client) {
+    // Exclusive, so it waits out pushes running under the shared lock
+    std::unique_lock<SharedMutex> lock(clients_mutex_);
+    clients_.erase(client);
+}
+
+void InvalidationTracker::track(uint64_t client, const std::string& key) {
+    std::string forgotten;
+    std::vector<uint64_t> forgotten_subscribers;
+    {
+        Shard& shard = shard_for(key);
+        std::lock_guard<Mutex> lock(shard.mutex);
+        
+        auto it = shard.subscribers.find(key);
+        if (it == shard.subscribers.end()) {
+            if (shard.subscribers.size() >= max_keys_per_shard_) {
+                // Full: forget an arbitrary key, telling its subscribers
+                auto victim = shard.subscribers.begin();
+                forgotten = victim->first;
+                forgotten_subscribers = std::move(victim->second);
+                shard.subscribers.erase(victim);
+                tracked_keys_.fetch_sub(1, std::memory_order_relaxed);
+            }
+            it = shard.subscribers.emplace(key, std::vector<uint64_t>()).first;
+            // Seen by a writer that locks the cache shard after this thread's
+            // read did, so invalidate() cannot skip a key tracked for a read
+            // it raced with
+            tracked_keys_.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (std::find(it->second.begin(), it->second.end(), client) == it->second.end()) {
+            it->second.push_back(client);
+        }
+    }
+    
+    if (!forgotten_subscribers.empty()) {
+        push(forgotten, forgotten_subscribers);
+    }
+}
+
+void InvalidationTracker::invalidate(const std::string& key) {
+    if (tracked_keys_.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    
+    std::vector<uint64_t> subscribers;
+    {
+        Shard& shard = shard_for(key);
+        std::lock_guard<Mutex> lock(shard.mutex);
+        
+        auto it = shard.subscribers.find(key);
+        if (it == shard.subscribers.end()) {
+            return;
+        }
+        subscribers = std::move(it->second);
+        shard.subscribers.erase(it);
+        tracked_keys_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    
+    // Pushed outside the shard lock so a slow socket never holds up tracking
+    push(key, subscribers);
+}
+
+void InvalidationTracker::invalidate_all() {
+    for (auto& shard : shards_) {
+        std::lock_guard<Mutex> lock(shard->mutex);
+        tracked_keys_.fetch_sub(shard->subscribers.size(), std::memory_order_relaxed);
+        shard->subscribers.clear();
+    }
+    
+    std::shared_lock<SharedMutex> lock(clients_mutex_);
+    for (const auto& [client, push] : clients_) {
+        push("INVALIDATE *");
+        invalidations_sent_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+size_t InvalidationTracker::clients() const {
+    std::shared_lock<SharedMutex> lock(clients_mutex_);
+    return clients_.size();
+}
+
+size_t InvalidationTracker::tracked_keys() const {
+    return tracked_keys_.load(std::memory_order_relaxed);
+}
+
+uint64_t InvalidationTracker::invalidations_sent() const {
+    return invalidations_sent_.load(std::memory_order_relaxed);
+}
+
+InvalidationTracker::Shard& InvalidationTracker::shard_for(const std::string& key) {
+    return *shards_[std::hash<std::string>{}(key) % shards_.size()];
+}
+
+void InvalidationTracker::push(const std::string& key, const std::vector<uint64_t>& subscribers) {
+    std::string message = "INVALIDATE " + key;
+    std::shared_lock<SharedMutex> lock(clients_mutex_);
+    for (uint64_t client : subscribers) {
+        auto it = clients_.find(client);
+        if (it == clients_.end()) {
+            continue;   // Disconnected or tracking turned off
+        }
+        it->second(message);
+        invalidations_sent_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+} // namespace cache
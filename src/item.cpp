@@ -0,0 +1,154 @@
+#include "item.h"
+#include <cstring>
+#include <ctime>
+
+namespace cache {
+
+namespace {
+
+constexpr size_t kInitialBuckets = 16;
+
+} // namespace
+
+int64_t Item::int_value() const {
+    int64_t value;
+    std::memcpy(&value, this->value().data(), sizeof(value));
+    return value;
+}
+
+std::string Item::value_string() const {
+    return is_integer() ? std::to_string(int_value()) : std::string(value());
+}
+
+Item* Item::create(SlabAllocator& allocator, std::string_view key, std::string_view value,
+                   uint8_t flags, uint64_t version, uint32_t hash) {
+    size_t size = sizeof(Item) + key.size() + value.size();
+    Item* item = static_cast<Item*>(allocator.allocate(size));
+    item->prev = nullptr;
+    item->next = nullptr;
+    item->hash_next = nullptr;
+    item->version = version;
+    item->hash = hash;
+    item->last_access = now_ticks();
+    item->value_len = static_cast<uint32_t>(value.size());
+    item->key_len = static_cast<uint16_t>(key.size());
+    item->flags = flags;
+    char* data = reinterpret_cast<char*>(item + 1);
+    std::memcpy(data, key.data(), key.size());
+    std::memcpy(data + key.size(), value.data(), value.size());
+    return item;
+}
+
+Item* Item::create(SlabAllocator& allocator, std::string_view key, int64_t value,
+                   uint64_t version, uint32_t hash) {
+    std::string_view bytes(reinterpret_cast<const char*>(&value), sizeof(value));
+    return create(allocator, key, bytes, kInteger, version, hash);
+}
+
+void Item::destroy(SlabAllocator& allocator, Item* item) {
+    allocator.deallocate(item, item->total_size());
+}
+
+uint32_t Item::now_ticks() {
+    // The coarse clock is read from the vDSO without a syscall or TSC read
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    return static_cast<uint32_t>(static_cast<uint64_t>(now.tv_sec) * 1000 + now.tv_nsec / 1000000);
+}
+
+ItemTable::ItemTable() : buckets_(kInitialBuckets, nullptr) {
+}
+
+Item* ItemTable::find(std::string_view key, uint32_t hash) const {
+    Item* item = buckets_[hash & (buckets_.size() - 1)];
+    while (item) {
+        // The stored hash rejects almost every other key without touching its bytes
+        if (item->hash == hash && item->key() == key) {
+            return item;
+        }
+        item = item->hash_next;
+    }
+    return nullptr;
+}
+
+void ItemTable::insert(Item* item) {
+    if (size_ >= buckets_.size()) {
+        grow();
+    }
+    Item** bucket = bucket_for(item->hash);
+    item->hash_next = *bucket;
+    *bucket = item;
+    link_front(item);
+    size_++;
+}
+
+void ItemTable::remove(Item* item) {
+    *slot_of(item) = item->hash_next;
+    unlink(item);
+    size_--;
+}
+
+void ItemTable::replace(Item* item, Item* replacement) {
+    *slot_of(item) = replacement;
+    replacement->hash_next = item->hash_next;
+    replacement->prev = item->prev;
+    replacement->next = item->next;
+    (item->prev ? item->prev->next : head_) = replacement;
+    (item->next ? item->next->prev : tail_) = replacement;
+}
+
+void ItemTable::touch(Item* item, uint32_t now) {
+    item->last_access = now;
+    if (item != head_) {
+        unlink(item);
+        link_front(item);
+    }
+}
+
+Item** ItemTable::slot_of(Item* item) {
+    Item** slot = bucket_for(item->hash);
+    while (*slot != item) {
+        slot = &(*slot)->hash_next;
+    }
+    return slot;
+}
+
+void ItemTable::link_front(Item* item) {
+    item->prev = nullptr;
+    item->next = head_;
+    if (head_) {
+        head_->prev = item;
+    } else {
+        tail_ = item;
+    }
+    head_ = item;
+}
+
+void ItemTable::unlink(Item* item) {
+    (item->prev ? item->prev->next : head_) = item->next;
+    (item->next ? item->next->prev : tail_) = item->prev;
+}
+
+void ItemTable::grow() {
+    std::vector<Item*> buckets(buckets_.size() * 2, nullptr);
+    size_t mask = buckets.size() - 1;
+    for (Item* chain : buckets_) {
+        while (chain) {
+            Item* next = chain->hash_next;
+            chain->hash_next = buckets[chain->hash & mask];
+            buckets[chain->hash & mask] = chain;
+            chain = next;
+        }
+    }
+    buckets_.swap(buckets);
+}
+
+void ItemTable::reset() {
+    buckets_.assign(kInitialBuckets, nullptr);
+    buckets_.shrink_to_fit();
+    head_ = nullptr;
+    tail_ = nullptr;
+    size_ = 0;
+}
+
+} // namespace cache
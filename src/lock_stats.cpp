@@ -0,0 +1,219 @@
+#include "lock_stats.h"
+#include <algorithm>
+#include <chrono>
+
+namespace cache {
+
+namespace {
+
+uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void merge_counters(LockRegistry::LockStats& stats, const LockCounters& counters) {
+    stats.acquisitions += counters.acquisitions.load(std::memory_order_relaxed);
+    stats.contended += counters.contended.load(std::memory_order_relaxed);
+    stats.wait.merge(counters.wait.snapshot());
+    stats.hold.merge(counters.hold.snapshot());
+}
+
+} // namespace
+
+void DurationHistogram::record(uint64_t ns) {
+    buckets_[bucket_index(ns)].fetch_add(1, std::memory_order_relaxed);
+    total_ns_.fetch_add(ns, std::memory_order_relaxed);
+}
+
+DurationHistogram::Snapshot DurationHistogram::snapshot() const {
+    Snapshot snapshot;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[i];
+    }
+    snapshot.total_ns = total_ns_.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+size_t DurationHistogram::bucket_index(uint64_t ns) {
+    if (ns < 4) {
+        return ns;
+    }
+    int msb = 63 - __builtin_clzll(ns);
+    size_t sub_bucket = (ns >> (msb - 2)) & 3;
+    return static_cast<size_t>(msb - 1) * 4 + sub_bucket;
+}
+
+uint64_t DurationHistogram::bucket_upper_bound(size_t index) {
+    if (index < 4) {
+        return index;
+    }
+    int msb = static_cast<int>(index / 4) + 1;
+    uint64_t lowest = (4 + index % 4) << (msb - 2);
+    return lowest + (1ULL << (msb - 2)) - 1;
+}
+
+double DurationHistogram::Snapshot::mean_ns() const {
+    return count == 0 ? 0.0 : static_cast<double>(total_ns) / count;
+}
+
+uint64_t DurationHistogram::Snapshot::percentile_ns(double percentile) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(percentile / 100.0 * count + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= target) {
+            return bucket_upper_bound(i);
+        }
+    }
+    return bucket_upper_bound(buckets.size() - 1);
+}
+
+void DurationHistogram::Snapshot::merge(const Snapshot& other) {
+    count += other.count;
+    total_ns += other.total_ns;
+    for (size_t i = 0; i < buckets.size() && i < other.buckets.size(); ++i) {
+        buckets[i] += other.buckets[i];
+    }
+}
+
+LockRegistry& LockRegistry::instance() {
+    static LockRegistry* registry = new LockRegistry();
+    return *registry;
+}
+
+void LockRegistry::add(LockCounters* counters) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    live_.push_back(counters);
+}
+
+void LockRegistry::remove(LockCounters* counters) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find(live_.begin(), live_.end(), counters);
+    if (it == live_.end()) {
+        return;
+    }
+    live_.erase(it);
+    
+    LockStats& retired = retired_[counters->name];
+    retired.name = counters->name;
+    merge_counters(retired, *counters);
+}
+
+std::vector<LockRegistry::LockStats> LockRegistry::snapshot() const {
+    std::map<std::string, LockStats> by_name;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        by_name = retired_;
+        for (const LockCounters* counters : live_) {
+            LockStats& stats = by_name[counters->name];
+            stats.name = counters->name;
+            stats.instances++;
+            merge_counters(stats, *counters);
+        }
+    }
+    
+    std::vector<LockStats> result;
+    result.reserve(by_name.size());
+    for (auto& [name, stats] : by_name) {
+        result.push_back(std::move(stats));
+    }
+    return result;
+}
+
+InstrumentedMutex::InstrumentedMutex(const char* name) : counters_(name) {
+    LockRegistry::instance().add(&counters_);
+}
+
+InstrumentedMutex::~InstrumentedMutex() {
+    LockRegistry::instance().remove(&counters_);
+}
+
+void InstrumentedMutex::lock() {
+    if (!mutex_.try_lock()) {
+        uint64_t start = now_ns();
+        mutex_.lock();
+        acquired_ns_ = now_ns();
+        counters_.contended.fetch_add(1, std::memory_order_relaxed);
+        counters_.wait.record(acquired_ns_ - start);
+    } else {
+        acquired_ns_ = now_ns();
+    }
+    counters_.acquisitions.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool InstrumentedMutex::try_lock() {
+    if (!mutex_.try_lock()) {
+        return false;
+    }
+    acquired_ns_ = now_ns();
+    counters_.acquisitions.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void InstrumentedMutex::unlock() {
+    counters_.hold.record(now_ns() - acquired_ns_);
+    mutex_.unlock();
+}
+
+InstrumentedSharedMutex::InstrumentedSharedMutex(const char* name) : counters_(name) {
+    LockRegistry::instance().add(&counters_);
+}
+
+InstrumentedSharedMutex::~InstrumentedSharedMutex() {
+    LockRegistry::instance().remove(&counters_);
+}
+
+void InstrumentedSharedMutex::lock() {
+    if (!mutex_.try_lock()) {
+        uint64_t start = now_ns();
+        mutex_.lock();
+        acquired_ns_ = now_ns();
+        counters_.contended.fetch_add(1, std::memory_order_relaxed);
+        counters_.wait.record(acquired_ns_ - start);
+    } else {
+        acquired_ns_ = now_ns();
+    }
+    counters_.acquisitions.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool InstrumentedSharedMutex::try_lock() {
+    if (!mutex_.try_lock()) {
+        return false;
+    }
+    acquired_ns_ = now_ns();
+    counters_.acquisitions.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void InstrumentedSharedMutex::unlock() {
+    counters_.hold.record(now_ns() - acquired_ns_);
+    mutex_.unlock();
+}
+
+void InstrumentedSharedMutex::lock_shared() {
+    if (!mutex_.try_lock_shared()) {
+        uint64_t start = now_ns();
+        mutex_.lock_shared();
+        counters_.contended.fetch_add(1, std::memory_order_relaxed);
+        counters_.wait.record(now_ns() - start);
+    }
+    counters_.acquisitions.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool InstrumentedSharedMutex::try_lock_shared() {
+    if (!mutex_.try_lock_shared()) {
+        return false;
+    }
+    counters_.acquisitions.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void InstrumentedSharedMutex::unlock_shared() {
+    mutex_.unlock_shared();
+}
+
+} // namespace cache
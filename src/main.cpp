@@ -1,5 +1,14 @@
 #include "tcp_server.h"
+#include "snapshot.h"
+#include "compactor.h"
+#include "reclaimer.h"
+#include "memory_monitor.h"
+#include "write_log.h"
+#include "flash_tier.h"
+#include "replication.h"
+#include <algorithm>
 #include <iostream>
+#include <new>
 #include <signal.h>
 #include <unistd.h>
 
@@ -12,12 +21,55 @@ namespace {
             g_server->stop();
         }
     }
+    
+    // Splits "host:port" (or "[v6]:port")
+    bool parse_address(const std::string& address, std::string& host, int& port) {
+        size_t colon = address.rfind(':');
+        if (colon == std::string::npos || colon == 0 || colon + 1 == address.size()) {
+            return false;
+        }
+        host = address.substr(0, colon);
+        if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+            host = host.substr(1, host.size() - 2);
+        }
+        try {
+            size_t used = 0;
+            port = std::stoi(address.substr(colon + 1), &used);
+            return used == address.size() - colon - 1 && port > 0 && port < 65536;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
 }
 
 int main(int argc, char* argv[]) {
     // Parse command line arguments
     int port = 8080;
     size_t thread_pool_size = std::thread::hardware_concurrency();
+    std::string load_path;
+    std::string snapshot_path;
+    long snapshot_interval = 300;
+    std::string wal_path;
+    std::string wal_fsync = "1000";
+    size_t wal_compact_bytes = 64 * 1024 * 1024;
+    cache::FlashTier::Options flash_options;
+    size_t flash_size = flash_options.segment_size * flash_options.num_segments;
+    size_t compress_min = 0;
+    int metrics_port = 0;
+    int64_t slowlog_threshold_us = 10000;
+    std::string replicaof;
+    std::vector<std::string> namespaces;
+    cache::ReplicationPrimary::Options replication_options;
+    cache::Arena::Options memory_options;
+    cache::Compactor::Options compactor_options;
+    long compact_interval_ms = compactor_options.interval.count();
+    cache::Reclaimer::Options reclaimer_options;
+    double evict_low = reclaimer_options.low_watermark * 100;
+    double evict_high = reclaimer_options.high_watermark * 100;
+    size_t capacity = 0;
+    double memory_headroom = 25;
+    cache::MemoryMonitor::Options monitor_options;
+    long memory_check_ms = monitor_options.interval.count();
     
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
@@ -25,16 +77,115 @@ int main(int argc, char* argv[]) {
             port = std::stoi(argv[++i]);
         } else if (arg == "--threads" && i + 1 < argc) {
             thread_pool_size = std::stoul(argv[++i]);
+        } else if (arg == "--load" && i + 1 < argc) {
+            load_path = argv[++i];
+        } else if (arg == "--snapshot" && i + 1 < argc) {
+            snapshot_path = argv[++i];
+        } else if (arg == "--snapshot-interval" && i + 1 < argc) {
+            snapshot_interval = std::stol(argv[++i]);
+        } else if (arg == "--wal" && i + 1 < argc) {
+            wal_path = argv[++i];
+        } else if (arg == "--wal-fsync" && i + 1 < argc) {
+            wal_fsync = argv[++i];
+        } else if (arg == "--wal-compact-bytes" && i + 1 < argc) {
+            wal_compact_bytes = std::stoul(argv[++i]);
+        } else if (arg == "--flash" && i + 1 < argc) {
+            flash_options.path = argv[++i];
+        } else if (arg == "--flash-size" && i + 1 < argc) {
+            flash_size = std::stoul(argv[++i]);
+        } else if (arg == "--flash-segment" && i + 1 < argc) {
+            flash_options.segment_size = std::stoul(argv[++i]);
+        } else if (arg == "--compress-min" && i + 1 < argc) {
+            compress_min = std::stoul(argv[++i]);
+        } else if (arg == "--metrics-port" && i + 1 < argc) {
+            metrics_port = std::stoi(argv[++i]);
+        } else if (arg == "--slowlog-threshold-us" && i + 1 < argc) {
+            slowlog_threshold_us = std::stoll(argv[++i]);
+        } else if (arg == "--replicaof" && i + 1 < argc) {
+            replicaof = argv[++i];
+        } else if (arg == "--namespace" && i + 1 < argc) {
+            namespaces.push_back(argv[++i]);
+        } else if (arg == "--repl-backlog" && i + 1 < argc) {
+            replication_options.backlog_bytes = std::stoul(argv[++i]);
+        } else if (arg == "--arena-size" && i + 1 < argc) {
+            memory_options.arena_size = std::stoul(argv[++i]);
+        } else if (arg == "--huge-pages") {
+            memory_options.huge_pages = true;
+        } else if (arg == "--prefault") {
+            memory_options.prefault = true;
+        } else if (arg == "--compact-interval" && i + 1 < argc) {
+            compact_interval_ms = std::stol(argv[++i]);
+        } else if (arg == "--evict-low" && i + 1 < argc) {
+            evict_low = std::stod(argv[++i]);
+        } else if (arg == "--evict-high" && i + 1 < argc) {
+            evict_high = std::stod(argv[++i]);
+        } else if (arg == "--capacity" && i + 1 < argc) {
+            capacity = std::stoul(argv[++i]);
+        } else if (arg == "--memory-headroom" && i + 1 < argc) {
+            memory_headroom = std::stod(argv[++i]);
+        } else if (arg == "--memory-check-interval" && i + 1 < argc) {
+            memory_check_ms = std::stol(argv[++i]);
+        } else if (arg == "--pressure-threshold" && i + 1 < argc) {
+            monitor_options.pressure_threshold = std::stod(argv[++i]);
         } else if (arg == "--help") {
             std::cout << "Usage: " << argv[0] << " [options]\n"
                       << "Options:\n"
-                      << "  --port PORT      Server port (default: 8080)\n"
-                      << "  --threads N      Number of worker threads (default: CPU cores)\n"
-                      << "  --help           Show this help message\n";
+                      << "  --port PORT              Server port (default: 8080)\n"
+                      << "  --threads N              Number of worker threads (default: CPU cores)\n"
+                      << "  --load FILE              Restore the cache from a snapshot before serving\n"
+                      << "  --snapshot FILE          Write snapshots to FILE in the background\n"
+                      << "  --snapshot-interval S    Seconds between snapshots (default: 300)\n"
+                      << "  --wal FILE               Log mutations to FILE and replay it on startup\n"
+                      << "  --wal-fsync POLICY       always, never, or an interval in ms (default: 1000)\n"
+                      << "  --wal-compact-bytes N    Compact the log into a snapshot past N bytes (default: 64MB)\n"
+                      << "  --flash FILE             Demote evicted entries to a flash file\n"
+                      << "  --flash-size N           Flash file size in bytes (default: 1GB)\n"
+                      << "  --flash-segment N        Flash segment size in bytes (default: 16MB)\n"
+                      << "  --compress-min N         LZ4-compress values of N bytes or more (default: off)\n"
+                      << "  --metrics-port PORT      Serve Prometheus metrics on 127.0.0.1:PORT/metrics\n"
+                      << "  --slowlog-threshold-us N Log requests slower than N us; 0 logs all, -1 disables (default: 10000)\n"
+                      << "  --namespace NAME:BYTES   Keys prefixed NAME: get their own LRU and a quota (repeatable)\n"
+                      << "  --replicaof HOST:PORT    Run as a read-only replica of the server at HOST:PORT\n"
+                      << "  --repl-backlog N         Replication backlog in bytes; 0 refuses replicas (default: 16MB)\n"
+                      << "  --arena-size N           Bytes mapped at a time for each shard's slab pages (default: 8MB)\n"
+                      << "  --huge-pages             Back slab memory with huge pages (hugetlbfs, else transparent)\n"
+                      << "  --prefault               Map and fault in the whole capacity at startup\n"
+                      << "  --compact-interval MS    Defragment slab memory every MS ms; 0 disables (default: 1000)\n"
+                      << "  --evict-low PCT          Evict in the background below PCT% free memory (default: 5)\n"
+                      << "  --evict-high PCT         ... until PCT% is free; 0 evicts only inline (default: 10)\n"
+                      << "  --capacity N             Cache capacity in bytes (default: cgroup memory.max less headroom, else 1GB)\n"
+                      << "  --memory-headroom PCT    Share of memory.max left out of the capacity, at least 64MB (default: 25)\n"
+                      << "  --memory-check-interval MS  Check memory pressure every MS ms; 0 disables (default: 1000)\n"
+                      << "  --pressure-threshold PCT Memory PSI (some avg10) that shrinks the capacity (default: 10)\n"
+                      << "  --help                   Show this help message\n";
             return 0;
         }
     }
     
+    cache::WriteLog::Options wal_options;
+    if (!wal_path.empty()) {
+        auto policy = cache::WriteLog::parse_policy(wal_fsync, wal_options.fsync_interval);
+        if (!policy) {
+            std::cerr << "Invalid --wal-fsync policy: " << wal_fsync << std::endl;
+            return 1;
+        }
+        wal_options.path = wal_path;
+        wal_options.policy = *policy;
+        wal_options.compact_bytes = wal_compact_bytes;
+        wal_options.snapshot_path = snapshot_path.empty() ? wal_path + ".snapshot" : snapshot_path;
+        
+        // Recovery starts from the snapshot the log was last compacted into
+        if (load_path.empty() && access(wal_options.snapshot_path.c_str(), F_OK) == 0) {
+            load_path = wal_options.snapshot_path;
+        }
+    }
+    
+    cache::ReplicaLink::Options replica_options;
+    if (!replicaof.empty() && !parse_address(replicaof, replica_options.host, replica_options.port)) {
+        std::cerr << "Invalid --replicaof address: " << replicaof << std::endl;
+        return 1;
+    }
+    
     // Set up signal handlers
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
@@ -45,6 +196,140 @@ int main(int argc, char* argv[]) {
     
     // Create and start server
     g_server = std::make_unique<cache::TCPServer>(port, thread_pool_size);
+    g_server->slow_log().set_threshold_us(slowlog_threshold_us);
+    
+    // Before the namespaces, whose quotas must fit in it
+    std::string cgroup = cache::MemoryMonitor::find_cgroup();
+    auto memory_limit = cache::MemoryMonitor::memory_limit(cgroup);
+    if (capacity == 0 && memory_limit) {
+        capacity = cache::MemoryMonitor::capacity_for(*memory_limit, memory_headroom / 100, 64 * 1024 * 1024);
+        if (capacity == 0) {
+            std::cerr << "cgroup memory.max of " << *memory_limit << " bytes leaves no room for the cache" << std::endl;
+            return 1;
+        }
+    }
+    if (capacity > 0) {
+        g_server->cache().set_max_capacity(capacity);
+    }
+    std::cout << "Capacity: " << g_server->cache().capacity() << " bytes";
+    if (memory_limit) {
+        std::cout << " (cgroup memory.max " << *memory_limit << ")";
+    }
+    std::cout << std::endl;
+    
+    for (const auto& spec : namespaces) {
+        size_t colon = spec.rfind(':');
+        size_t quota = 0;
+        if (colon != std::string::npos) {
+            try {
+                quota = std::stoul(spec.substr(colon + 1));
+            } catch (const std::exception&) {
+                quota = 0;
+            }
+        }
+        if (colon == std::string::npos || !g_server->add_namespace(spec.substr(0, colon), quota)) {
+            std::cerr << "Invalid --namespace " << spec << " (quotas must fit in "
+                      << g_server->cache().capacity() << " bytes)" << std::endl;
+            return 1;
+        }
+        std::cout << "Namespace: " << spec.substr(0, colon) << " (" << quota << " bytes)" << std::endl;
+    }
+    
+    // Before the snapshot or log fills the cache
+    try {
+        g_server->cache().set_memory_options(memory_options);
+    } catch (const std::bad_alloc&) {
+        std::cerr << "Failed to prefault " << g_server->cache().capacity() << " bytes" << std::endl;
+        return 1;
+    }
+    if (memory_options.huge_pages || memory_options.prefault) {
+        std::cout << "Memory: " << memory_options.arena_size << " byte arenas"
+                  << (memory_options.huge_pages ? ", huge pages" : "")
+                  << (memory_options.prefault ? ", prefaulted" : "") << std::endl;
+    }
+    
+    if (compress_min > 0) {
+        g_server->cache().set_compression_threshold(compress_min);
+        std::cout << "Compression: values of " << compress_min << " bytes or more" << std::endl;
+    }
+    
+    if (!flash_options.path.empty()) {
+        flash_options.num_segments = std::max<size_t>(2, flash_size / flash_options.segment_size);
+        if (!g_server->enable_flash_tier(flash_options)) {
+            return 1;
+        }
+        std::cout << "Flash tier: " << flash_options.path << " (" << flash_options.num_segments
+                  << " x " << flash_options.segment_size << " bytes)" << std::endl;
+    }
+    
+    if (!load_path.empty()) {
+        auto start_time = std::chrono::steady_clock::now();
+        auto restored = cache::Snapshot::load(g_server->cache(), load_path, thread_pool_size);
+        auto end_time = std::chrono::steady_clock::now();
+        if (!restored) {
+            std::cerr << "Failed to load snapshot " << load_path << std::endl;
+            return 1;
+        }
+        std::cout << "Loaded " << *restored << " entries from " << load_path << " in "
+                  << std::chrono::duration<double, std::milli>(end_time - start_time).count()
+                  << " ms" << std::endl;
+    }
+    
+    if (!wal_path.empty()) {
+        auto replayed = cache::WriteLog::replay(g_server->cache(), wal_path);
+        if (!replayed) {
+            std::cerr << "Failed to replay write log " << wal_path << std::endl;
+            return 1;
+        }
+        std::cout << "Replayed " << *replayed << " records from " << wal_path << std::endl;
+        
+        if (!g_server->enable_write_log(wal_options)) {
+            return 1;
+        }
+        std::cout << "Write log: " << wal_path << " (fsync " << wal_fsync << ")" << std::endl;
+    }
+    
+    if (!snapshot_path.empty()) {
+        g_server->enable_snapshots(snapshot_path, std::chrono::seconds(snapshot_interval));
+        std::cout << "Snapshots: " << snapshot_path << " every " << snapshot_interval << "s" << std::endl;
+    }
+    
+    if (compact_interval_ms > 0) {
+        compactor_options.interval = std::chrono::milliseconds(compact_interval_ms);
+        g_server->enable_compactor(compactor_options);
+    }
+    
+    if (evict_high > 0) {
+        if (evict_low < 0 || evict_low > evict_high || evict_high >= 100) {
+            std::cerr << "Invalid eviction watermarks: need 0 <= --evict-low <= --evict-high < 100" << std::endl;
+            return 1;
+        }
+        reclaimer_options.low_watermark = evict_low / 100;
+        reclaimer_options.high_watermark = evict_high / 100;
+        g_server->enable_reclaimer(reclaimer_options);
+    }
+    
+    if (memory_check_ms > 0) {
+        monitor_options.cgroup_path = cgroup;
+        monitor_options.interval = std::chrono::milliseconds(memory_check_ms);
+        g_server->enable_memory_monitor(monitor_options);
+    }
+    
+    if (metrics_port > 0) {
+        if (!g_server->enable_metrics_endpoint(metrics_port)) {
+            return 1;
+        }
+        std::cout << "Metrics: http://127.0.0.1:" << metrics_port << "/metrics" << std::endl;
+    }
+    
+    if (replication_options.backlog_bytes > 0) {
+        g_server->enable_replication(replication_options);
+    }
+    if (!replicaof.empty()) {
+        // The primary's full sync replaces whatever was loaded above
+        g_server->enable_replica(replica_options);
+        std::cout << "Replica of " << replicaof << std::endl;
+    }
     
     if (!g_server->start()) {
         std::cerr << "Failed to start server" << std::endl;
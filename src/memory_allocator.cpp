@@ -5,8 +5,8 @@
 
 namespace cache {
 
-MemoryAllocator::MemoryAllocator(size_t pool_size) 
-    : pool_size_(pool_size) {
+MemoryAllocator::MemoryAllocator(size_t pool_size, bool huge_pages) 
+    : pool_size_(pool_size), huge_pages_(huge_pages) {
     allocate_new_pool();
 }
 
@@ -15,7 +15,7 @@ MemoryAllocator::~MemoryAllocator() {
 }
 
 void* MemoryAllocator::allocate(size_t size) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<Mutex> lock(mutex_);
     
     // Store original size for accurate tracking
     size_t original_size = size;
@@ -38,7 +38,7 @@ void* MemoryAllocator::allocate(size_t size) {
     }
     
     // Allocate from current pool
-    void* ptr = pools_.back().get() + current_pool_offset_;
+    void* ptr = pools_.back()->data() + current_pool_offset_;
     current_pool_offset_ += size;
     
     // Add to blocks list
@@ -54,7 +54,7 @@ void* MemoryAllocator::allocate(size_t size) {
 void MemoryAllocator::deallocate(void* ptr, size_t size) {
     if (!ptr) return;
     
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<Mutex> lock(mutex_);
     
     // Find the block
     auto it = std::find_if(blocks_.begin(), blocks_.end(),
@@ -74,7 +74,7 @@ size_t MemoryAllocator::allocated_bytes() const {
 }
 
 size_t MemoryAllocator::total_bytes() const {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<Mutex> lock(mutex_);
     return pools_.size() * pool_size_;
 }
 
@@ -83,7 +83,7 @@ size_t MemoryAllocator::allocation_count() const {
 }
 
 double MemoryAllocator::fragmentation_ratio() const {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<Mutex> lock(mutex_);
     
     size_t free_bytes = 0;
     for (const auto& block : blocks_) {
@@ -99,8 +99,8 @@ double MemoryAllocator::fragmentation_ratio() const {
 }
 
 void MemoryAllocator::allocate_new_pool() {
-    auto pool = std::make_unique<char[]>(pool_size_);
-    pools_.push_back(std::move(pool));
+    // Mapped rather than heap-allocated: untouched pages cost nothing and nothing is zeroed up front
+    pools_.push_back(std::make_unique<Arena>(pool_size_, huge_pages_));
     current_pool_offset_ = 0;
 }
 
@@ -0,0 +1,195 @@
+#include "memory_monitor.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+namespace cache {
+
+namespace {
+
+const char* kCgroupRoot = "/sys/fs/cgroup";
+
+std::optional<std::string> read_file(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        return std::nullopt;
+    }
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+} // namespace
+
+MemoryMonitor::MemoryMonitor(Cache& cache, Options options, size_t ceiling)
+    : cache_(cache), options_(std::move(options)), ceiling_(ceiling) {
+    if (options_.cgroup_path.empty()) {
+        options_.cgroup_path = find_cgroup();
+    }
+}
+
+MemoryMonitor::~MemoryMonitor() {
+    stop();
+}
+
+void MemoryMonitor::start() {
+    if (worker_.joinable()) {
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_requested_ = false;
+    }
+    worker_ = std::thread([this] { run(); });
+}
+
+void MemoryMonitor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_requested_ = true;
+    }
+    condition_.notify_all();
+    
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+void MemoryMonitor::check() {
+    auto limit = memory_limit(options_.cgroup_path);
+    auto pressure = memory_pressure(options_.cgroup_path);
+    size_t rss = resident_bytes();
+    limit_ = limit ? static_cast<int64_t>(*limit) : -1;
+    pressure_ = pressure ? *pressure : -1.0;
+    rss_ = rss;
+    
+    // Growing waits for the pressure to halve and for room to grow a step
+    // without reaching the RSS threshold, so the capacity does not flap
+    size_t step = static_cast<size_t>(ceiling_ * options_.grow_step);
+    bool stalled = pressure && *pressure >= options_.pressure_threshold;
+    bool full = limit && rss >= *limit * options_.rss_threshold;
+    bool calm = (!pressure || *pressure < options_.pressure_threshold / 2) &&
+                (!limit || rss + step < *limit * options_.rss_threshold);
+    
+    size_t capacity = cache_.capacity();
+    if (stalled || full) {
+        size_t shrunk = std::max(options_.min_capacity, static_cast<size_t>(capacity * (1.0 - options_.shrink_step)));
+        if (shrunk < capacity) {
+            cache_.set_max_capacity(shrunk);
+            // Emptied pages are what gives memory back to the OS
+            cache_.compact(options_.compact_occupancy, options_.compact_pages);
+            shrinks_++;
+        }
+    } else if (calm && capacity < ceiling_) {
+        size_t grown = std::min(ceiling_, capacity + step);
+        cache_.set_max_capacity(grown);
+        grows_++;
+    }
+}
+
+std::string MemoryMonitor::find_cgroup() {
+    // cgroup v2 has the single line "0::/path"
+    auto contents = read_file("/proc/self/cgroup");
+    if (!contents) {
+        return "";
+    }
+    std::istringstream lines(*contents);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.rfind("0::", 0) == 0) {
+            std::string path = std::string(kCgroupRoot) + line.substr(3);
+            return read_file(path + "/memory.max") ? path : "";
+        }
+    }
+    return "";
+}
+
+std::optional<size_t> MemoryMonitor::memory_limit(const std::string& cgroup_path) {
+    if (cgroup_path.empty()) {
+        return std::nullopt;
+    }
+    auto contents = read_file(cgroup_path + "/memory.max");
+    if (!contents || contents->rfind("max", 0) == 0) {
+        return std::nullopt;
+    }
+    unsigned long long limit = 0;
+    if (std::sscanf(contents->c_str(), "%llu", &limit) != 1) {
+        return std::nullopt;
+    }
+    return static_cast<size_t>(limit);
+}
+
+std::optional<double> MemoryMonitor::memory_pressure(const std::string& cgroup_path) {
+    if (cgroup_path.empty()) {
+        return std::nullopt;
+    }
+    // "some avg10=1.23 avg60=... avg300=... total=..." then a "full" line
+    auto contents = read_file(cgroup_path + "/memory.pressure");
+    double avg10 = 0.0;
+    if (!contents || std::sscanf(contents->c_str(), "some avg10=%lf", &avg10) != 1) {
+        return std::nullopt;
+    }
+    return avg10;
+}
+
+size_t MemoryMonitor::resident_bytes() {
+    // statm's second field is resident pages, heap and mmap'd arenas alike
+    long pages = 0;
+    long resident = 0;
+    if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        std::fclose(statm);
+    }
+    return static_cast<size_t>(resident) * sysconf(_SC_PAGESIZE);
+}
+
+size_t MemoryMonitor::capacity_for(size_t limit, double headroom, size_t min_headroom) {
+    size_t reserved = std::max(static_cast<size_t>(limit * headroom), min_headroom);
+    return limit > reserved ? limit - reserved : 0;
+}
+
+size_t MemoryMonitor::ceiling() const {
+    return ceiling_;
+}
+
+std::optional<size_t> MemoryMonitor::limit() const {
+    int64_t limit = limit_.load();
+    return limit < 0 ? std::nullopt : std::optional<size_t>(static_cast<size_t>(limit));
+}
+
+std::optional<double> MemoryMonitor::pressure() const {
+    double pressure = pressure_.load();
+    return pressure < 0 ? std::nullopt : std::optional<double>(pressure);
+}
+
+size_t MemoryMonitor::rss() const {
+    return rss_.load();
+}
+
+size_t MemoryMonitor::shrinks() const {
+    return shrinks_.load();
+}
+
+size_t MemoryMonitor::grows() const {
+    return grows_.load();
+}
+
+void MemoryMonitor::run() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait_for(lock, options_.interval, [this] { return stop_requested_; });
+            if (stop_requested_) {
+                return;
+            }
+        }
+        check();
+    }
+}
+
+} // namespace cache
@@ -0,0 +1,277 @@
+#include "metrics.h"
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace cache {
+
+namespace {
+
+constexpr uint64_t kHighestTrackableUs = (1ULL << 40) - 1;
+
+std::atomic<uint64_t> g_next_metrics_id{1};
+
+// Slots this thread recorded into, one entry per instance. A worker records
+// into the server-wide instance and its namespace's on every request, so one
+// entry would have them evict each other. Ids are never reused, so a stale
+// entry for a destroyed instance can never match a live one.
+constexpr size_t kSlotCacheSize = 16;
+
+struct SlotCacheEntry {
+    uint64_t owner = 0;
+    void* slot = nullptr;
+};
+
+struct SlotCache {
+    SlotCacheEntry entries[kSlotCacheSize];
+    size_t next_victim = 0;     // Replaced round robin once every entry is taken
+};
+thread_local SlotCache t_slot_cache;
+
+} // namespace
+
+RequestMetrics::RequestMetrics() : id_(g_next_metrics_id++) {
+}
+
+RequestMetrics::~RequestMetrics() = default;
+
+size_t RequestMetrics::bucket_index(uint64_t value_us) {
+    value_us = std::min(value_us, kHighestTrackableUs);
+    if (value_us < 16) {
+        return value_us;
+    }
+    int exponent = 63 - __builtin_clzll(value_us);
+    size_t sub_bucket = (value_us >> (exponent - 3)) & 7;
+    return 16 + (exponent - 4) * 8 + sub_bucket;
+}
+
+uint64_t RequestMetrics::bucket_upper_bound(size_t index) {
+    if (index < 16) {
+        return index;
+    }
+    size_t exponent = (index - 16) / 8 + 4;
+    size_t sub_bucket = (index - 16) % 8;
+    return ((8 + sub_bucket + 1) << (exponent - 3)) - 1;
+}
+
+void RequestMetrics::record(Protocol::Command command, uint64_t latency_us) {
+    size_t index = static_cast<size_t>(command);
+    if (index >= kCommandCount) {
+        index = static_cast<size_t>(Protocol::Command::UNKNOWN);
+    }
+    Slot& slot = local_slot();
+    // Only this thread writes the slot, so a relaxed load and store is enough
+    auto& bucket = slot.buckets[index][bucket_index(latency_us)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    auto& total = slot.total_us[index];
+    total.store(total.load(std::memory_order_relaxed) + latency_us, std::memory_order_relaxed);
+}
+
+RequestMetrics::Slot& RequestMetrics::local_slot() {
+    SlotCache& cache = t_slot_cache;
+    for (const auto& entry : cache.entries) {
+        if (entry.owner == id_) {
+            return *static_cast<Slot*>(entry.slot);
+        }
+    }
+    
+    slot_lookups_.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    auto& slot = slots_[std::this_thread::get_id()];
+    if (!slot) {
+        slot = std::make_unique<Slot>();
+    }
+    cache.entries[cache.next_victim] = {id_, slot.get()};
+    cache.next_victim = (cache.next_victim + 1) % kSlotCacheSize;
+    return *slot;
+}
+
+uint64_t RequestMetrics::slot_lookups() const {
+    return slot_lookups_.load(std::memory_order_relaxed);
+}
+
+std::vector<RequestMetrics::CommandStats> RequestMetrics::snapshot() const {
+    std::vector<CommandStats> stats(kCommandCount);
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    for (const auto& [thread_id, slot] : slots_) {
+        for (size_t command = 0; command < kCommandCount; ++command) {
+            auto& merged = stats[command];
+            for (size_t i = 0; i < kBucketCount; ++i) {
+                uint64_t count = slot->buckets[command][i].load(std::memory_order_relaxed);
+                merged.buckets[i] += count;
+                merged.count += count;
+            }
+            merged.total_us += slot->total_us[command].load(std::memory_order_relaxed);
+        }
+    }
+    return stats;
+}
+
+uint64_t RequestMetrics::total_requests() const {
+    uint64_t total = 0;
+    for (const auto& stats : snapshot()) {
+        total += stats.count;
+    }
+    return total;
+}
+
+uint64_t RequestMetrics::total_latency_us() const {
+    uint64_t total = 0;
+    for (const auto& stats : snapshot()) {
+        total += stats.total_us;
+    }
+    return total;
+}
+
+double RequestMetrics::CommandStats::mean_us() const {
+    return count == 0 ? 0.0 : static_cast<double>(total_us) / count;
+}
+
+uint64_t RequestMetrics::CommandStats::percentile_us(double percentile) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(percentile / 100.0 * count + 0.5);
+    target = std::max<uint64_t>(target, 1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= target) {
+            return bucket_upper_bound(i);
+        }
+    }
+    return max_us();
+}
+
+uint64_t RequestMetrics::CommandStats::max_us() const {
+    for (size_t i = buckets.size(); i > 0; --i) {
+        if (buckets[i - 1] > 0) {
+            return bucket_upper_bound(i - 1);
+        }
+    }
+    return 0;
+}
+
+uint64_t RequestMetrics::CommandStats::count_at_or_below(uint64_t limit_us) const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < buckets.size() && bucket_upper_bound(i) <= limit_us; ++i) {
+        total += buckets[i];
+    }
+    return total;
+}
+
+MetricsHttpServer::MetricsHttpServer(int port, std::function<std::string()> render)
+    : port_(port), render_(std::move(render)) {
+}
+
+MetricsHttpServer::~MetricsHttpServer() {
+    stop();
+}
+
+bool MetricsHttpServer::start() {
+    server_socket_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (server_socket_ < 0) {
+        std::cerr << "Failed to create metrics socket" << std::endl;
+        return false;
+    }
+    
+    int opt = 1;
+    setsockopt(server_socket_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    
+    // Loopback only: the endpoint has no authentication
+    struct sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port_);
+    
+    if (bind(server_socket_, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        listen(server_socket_, 4) < 0) {
+        std::cerr << "Failed to listen for metrics on port " << port_ << std::endl;
+        close(server_socket_);
+        server_socket_ = -1;
+        return false;
+    }
+    
+    running_ = true;
+    thread_ = std::thread([this] { serve(); });
+    return true;
+}
+
+void MetricsHttpServer::stop() {
+    running_ = false;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (server_socket_ >= 0) {
+        close(server_socket_);
+        server_socket_ = -1;
+    }
+}
+
+size_t MetricsHttpServer::scrapes() const {
+    return scrapes_.load();
+}
+
+void MetricsHttpServer::serve() {
+    while (running_) {
+        // Wake up regularly to notice stop()
+        struct pollfd fd{server_socket_, POLLIN, 0};
+        if (poll(&fd, 1, 200) <= 0) {
+            continue;
+        }
+        int client_socket = accept(server_socket_, nullptr, nullptr);
+        if (client_socket < 0) {
+            continue;
+        }
+        handle(client_socket);
+        close(client_socket);
+    }
+}
+
+void MetricsHttpServer::handle(int client_socket) {
+    // Only the request line matters; give a slow client one second to send it
+    struct timeval timeout{1, 0};
+    setsockopt(client_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n") == std::string::npos && request.size() < 8192) {
+        ssize_t bytes = recv(client_socket, buffer, sizeof(buffer), 0);
+        if (bytes <= 0) {
+            return;
+        }
+        request.append(buffer, bytes);
+    }
+    
+    std::string status = "200 OK";
+    std::string body;
+    if (request.rfind("GET /metrics ", 0) == 0 || request.rfind("GET /metrics?", 0) == 0) {
+        body = render_();
+        scrapes_++;
+    } else {
+        status = "404 Not Found";
+        body = "Not found; try /metrics\n";
+    }
+    
+    std::string response = "HTTP/1.1 " + status + "\r\n"
+                           "Content-Type: text/plain; version=0.0.4\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                           "Connection: close\r\n\r\n" + body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t bytes = send(client_socket, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (bytes <= 0) {
+            return;
+        }
+        sent += bytes;
+    }
+}
+
+} // namespace cache
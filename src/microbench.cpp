@@ -0,0 +1,316 @@
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <unistd.h>
+
+#include "cache.h"
+#include "lru_cache.h"
+#include "memory_allocator.h"
+#include "object_pool.h"
+#include "protocol.h"
+
+// In-process microbenchmarks; no sockets involved. Compare runs with
+//   ./cache_microbench --benchmark_out=run.json --benchmark_out_format=json
+
+namespace {
+
+constexpr size_t kValueSize = 100;
+
+std::vector<std::string> make_keys(size_t count) {
+    std::vector<std::string> keys;
+    keys.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        keys.push_back("key_" + std::to_string(i));
+    }
+    return keys;
+}
+
+// Each thread walks the key space from its own random start with a stride
+// co-prime to any power of two, so threads touch different keys
+size_t next_index(size_t index, size_t count) {
+    return (index + 7919) % count;
+}
+
+size_t start_index(const benchmark::State& state, size_t count) {
+    std::mt19937_64 rng(state.thread_index());
+    return rng() % count;
+}
+
+// Shared between the threads of one benchmark run. Thread 0 builds it before
+// the timing loop and tears it down after; the loop start and end are barriers.
+std::unique_ptr<cache::Cache> g_cache;
+std::unique_ptr<cache::LRUCache<std::string, std::string>> g_lru;
+std::unique_ptr<cache::ObjectPool<cache::Cache::CacheEntry>> g_pool;
+std::vector<std::string> g_keys;
+
+void setup_cache(const benchmark::State& state, bool populate) {
+    if (state.thread_index() != 0) {
+        return;
+    }
+    size_t count = state.range(0);
+    g_keys = make_keys(count);
+    g_cache = std::make_unique<cache::Cache>(1024ULL * 1024 * 1024);
+    if (populate) {
+        std::string value(kValueSize, 'v');
+        for (const auto& key : g_keys) {
+            g_cache->set(key, value);
+        }
+    }
+}
+
+void setup_lru(const benchmark::State& state) {
+    if (state.thread_index() != 0) {
+        return;
+    }
+    size_t count = state.range(0);
+    g_keys = make_keys(count);
+    g_lru = std::make_unique<cache::LRUCache<std::string, std::string>>(count);
+    std::string value(kValueSize, 'v');
+    for (const auto& key : g_keys) {
+        g_lru->put(key, value);
+    }
+}
+
+size_t resident_bytes() {
+    // Heap and mmap'd arenas alike; statm's second field is resident pages
+    long pages = 0;
+    long resident = 0;
+    if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        std::fclose(statm);
+    }
+    return static_cast<size_t>(resident) * sysconf(_SC_PAGESIZE);
+}
+
+std::vector<std::string> make_sized_keys(size_t count) {
+    std::vector<std::string> keys;
+    keys.reserve(count);
+    char key[32];
+    for (size_t i = 0; i < count; ++i) {
+        std::snprintf(key, sizeof(key), "user:%015zu", i);
+        keys.emplace_back(key);
+    }
+    return keys;
+}
+
+void teardown(const benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        g_cache.reset();
+        g_lru.reset();
+        g_pool.reset();
+        g_keys.clear();
+    }
+}
+
+} // namespace
+
+static void BM_CacheGet(benchmark::State& state) {
+    setup_cache(state, true);
+    size_t index = start_index(state, state.range(0));
+    
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(g_cache->get(g_keys[index]));
+        index = next_index(index, g_keys.size());
+    }
+    
+    state.SetItemsProcessed(state.iterations());
+    teardown(state);
+}
+BENCHMARK(BM_CacheGet)->Arg(1 << 10)->Arg(1 << 17)->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_CacheSet(benchmark::State& state) {
+    setup_cache(state, false);
+    size_t index = start_index(state, state.range(0));
+    std::string value(kValueSize, 'v');
+    
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(g_cache->set(g_keys[index], value));
+        index = next_index(index, g_keys.size());
+    }
+    
+    state.SetItemsProcessed(state.iterations());
+    teardown(state);
+}
+BENCHMARK(BM_CacheSet)->Arg(1 << 10)->Arg(1 << 17)->ThreadRange(1, 8)->UseRealTime();
+
+// 90% GET, 10% SET
+static void BM_CacheMixed(benchmark::State& state) {
+    setup_cache(state, true);
+    size_t index = start_index(state, state.range(0));
+    std::string value(kValueSize, 'w');
+    size_t op = 0;
+    
+    for (auto _ : state) {
+        if (++op % 10 == 0) {
+            benchmark::DoNotOptimize(g_cache->set(g_keys[index], value));
+        } else {
+            benchmark::DoNotOptimize(g_cache->get(g_keys[index]));
+        }
+        index = next_index(index, g_keys.size());
+    }
+    
+    state.SetItemsProcessed(state.iterations());
+    teardown(state);
+}
+BENCHMARK(BM_CacheMixed)->Arg(1 << 10)->Arg(1 << 17)->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_LRUCacheGet(benchmark::State& state) {
+    setup_lru(state);
+    size_t index = start_index(state, state.range(0));
+    
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(g_lru->get(g_keys[index]));
+        index = next_index(index, g_keys.size());
+    }
+    
+    state.SetItemsProcessed(state.iterations());
+    teardown(state);
+}
+BENCHMARK(BM_LRUCacheGet)->Arg(1 << 10)->Arg(1 << 17)->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_LRUCachePut(benchmark::State& state) {
+    setup_lru(state);
+    size_t index = start_index(state, state.range(0));
+    std::string value(kValueSize, 'w');
+    
+    for (auto _ : state) {
+        g_lru->put(g_keys[index], value);
+        index = next_index(index, g_keys.size());
+    }
+    
+    state.SetItemsProcessed(state.iterations());
+    teardown(state);
+}
+BENCHMARK(BM_LRUCachePut)->Arg(1 << 10)->Arg(1 << 17)->ThreadRange(1, 8)->UseRealTime();
+
+// 90% get, 10% put
+static void BM_LRUCacheMixed(benchmark::State& state) {
+    setup_lru(state);
+    size_t index = start_index(state, state.range(0));
+    std::string value(kValueSize, 'w');
+    size_t op = 0;
+    
+    for (auto _ : state) {
+        if (++op % 10 == 0) {
+            g_lru->put(g_keys[index], value);
+        } else {
+            benchmark::DoNotOptimize(g_lru->get(g_keys[index]));
+        }
+        index = next_index(index, g_keys.size());
+    }
+    
+    state.SetItemsProcessed(state.iterations());
+    teardown(state);
+}
+BENCHMARK(BM_LRUCacheMixed)->Arg(1 << 10)->Arg(1 << 17)->ThreadRange(1, 8)->UseRealTime();
+
+// Keeps range(0) allocations of 16-1024 bytes live, replacing a random one per iteration
+static void BM_MemoryAllocatorChurn(benchmark::State& state) {
+    cache::MemoryAllocator allocator;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> size_dis(16, 1024);
+    
+    std::vector<std::pair<void*, size_t>> live(state.range(0));
+    for (auto& slot : live) {
+        slot.second = size_dis(rng);
+        slot.first = allocator.allocate(slot.second);
+    }
+    
+    for (auto _ : state) {
+        auto& slot = live[rng() % live.size()];
+        allocator.deallocate(slot.first, slot.second);
+        slot.second = size_dis(rng);
+        slot.first = allocator.allocate(slot.second);
+        benchmark::DoNotOptimize(slot.first);
+    }
+    
+    for (auto& slot : live) {
+        allocator.deallocate(slot.first, slot.second);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["fragmentation"] = allocator.fragmentation_ratio();
+}
+BENCHMARK(BM_MemoryAllocatorChurn)->Arg(64)->Arg(1024);
+
+// Resident bytes per stored item for 20-byte keys and 50-byte values: the
+// packed slab items of Cache against the node-based layout it replaced
+// (CacheEntry in an LRUCache, i.e. a list node plus a map node per key)
+static void BM_CacheBytesPerItem(benchmark::State& state) {
+    auto keys = make_sized_keys(state.range(0));
+    std::string value(50, 'v');
+    double bytes = 0;
+    for (auto _ : state) {
+        size_t before = resident_bytes();
+        auto store = std::make_unique<cache::Cache>(1024ULL * 1024 * 1024);
+        for (const auto& key : keys) {
+            store->set(key, value);
+        }
+        bytes = static_cast<double>(resident_bytes() - before);
+    }
+    state.counters["bytes_per_item"] = bytes / keys.size();
+}
+BENCHMARK(BM_CacheBytesPerItem)->Arg(1 << 17)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+static void BM_NodeBytesPerItem(benchmark::State& state) {
+    auto keys = make_sized_keys(state.range(0));
+    std::string value(50, 'v');
+    double bytes = 0;
+    for (auto _ : state) {
+        size_t before = resident_bytes();
+        auto store = std::make_unique<cache::LRUCache<std::string, cache::Cache::CacheEntry>>(keys.size());
+        for (const auto& key : keys) {
+            store->put(key, cache::Cache::CacheEntry(key, value));
+        }
+        bytes = static_cast<double>(resident_bytes() - before);
+    }
+    state.counters["bytes_per_item"] = bytes / keys.size();
+}
+BENCHMARK(BM_NodeBytesPerItem)->Arg(1 << 17)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+static void BM_ObjectPoolAcquireRelease(benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        g_pool = std::make_unique<cache::ObjectPool<cache::Cache::CacheEntry>>();
+    }
+    
+    for (auto _ : state) {
+        auto entry = g_pool->acquire();
+        benchmark::DoNotOptimize(entry.get());
+        g_pool->release(std::move(entry));
+    }
+    
+    state.SetItemsProcessed(state.iterations());
+    teardown(state);
+}
+BENCHMARK(BM_ObjectPoolAcquireRelease)->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_ProtocolParseGet(benchmark::State& state) {
+    std::string request = "GET key_123456";
+    
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cache::Protocol::parse_request(request));
+    }
+    
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * request.size());
+}
+BENCHMARK(BM_ProtocolParseGet);
+
+// range(0) is the value size
+static void BM_ProtocolParseSet(benchmark::State& state) {
+    std::string request = "SET key_123456 " + std::string(state.range(0), 'v');
+    
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cache::Protocol::parse_request(request));
+    }
+    
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * request.size());
+}
+BENCHMARK(BM_ProtocolParseSet)->Arg(16)->Arg(1024)->Arg(16 * 1024);
+
+BENCHMARK_MAIN();
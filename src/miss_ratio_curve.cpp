@@ -0,0 +1,204 @@
+#include "miss_ratio_curve.h"
+#include <algorithm>
+#include <functional>
+
+namespace cache {
+
+namespace {
+
+constexpr uint64_t kLargestDistance = 1ULL << 50;
+
+// Every reference is counted, so threads add to the shared total in batches
+// rather than bouncing its cache line on each access. The total may lag by
+// up to a batch per thread. A batch belongs to one instance; a thread that
+// moves on to another curve drops what it had counted for the last one.
+constexpr uint64_t kReferenceBatch = 64;
+
+struct PendingReferences {
+    uint64_t owner = 0;
+    uint64_t count = 0;
+};
+
+std::atomic<uint64_t> g_next_curve_id{1};
+thread_local PendingReferences t_pending_references;
+
+} // namespace
+
+MissRatioCurve::MissRatioCurve() : MissRatioCurve(Options()) {
+}
+
+MissRatioCurve::MissRatioCurve(Options options)
+    : id_(g_next_curve_id++),
+      options_(options),
+      threshold_(threshold_for(options.initial_rate)),
+      distances_(kLargestDistance, 2) {
+    options_.max_keys = std::max<size_t>(options_.max_keys, 1);
+    // Room for a few accesses per key between compactions
+    tree_.assign(4 * options_.max_keys + 1, 0);
+}
+
+void MissRatioCurve::record(const std::string& key, size_t size) {
+    PendingReferences& pending = t_pending_references;
+    if (pending.owner != id_) {
+        pending = {id_, 0};
+    }
+    if (++pending.count == kReferenceBatch) {
+        references_.fetch_add(kReferenceBatch, std::memory_order_relaxed);
+        pending.count = 0;
+    }
+    
+    uint64_t hash = std::hash<std::string>{}(key);
+    uint64_t bucket = hash >> (64 - kThresholdBits);
+    if (bucket >= threshold_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (bucket >= threshold_.load(std::memory_order_relaxed)) {
+        return;     // Evicted by a threshold change while waiting
+    }
+    
+    // Each sample stands for 1 / rate accesses; weighting by it keeps samples
+    // taken before and after a threshold change comparable
+    uint64_t weight = (1ULL << kThresholdBits) / threshold_.load(std::memory_order_relaxed);
+    accesses_ += weight;
+    samples_++;
+    if (clock_ + 1 >= tree_.size()) {
+        compact();
+    }
+    uint64_t now = ++clock_;
+    
+    auto it = keys_.find(hash);
+    if (it == keys_.end()) {
+        // First access misses at every size
+        if (size == 0 && !keys_.empty()) {
+            size = tracked_bytes_ / keys_.size();
+        }
+        keys_.emplace(hash, Tracked{now, size});
+        add(now, static_cast<int64_t>(size));
+        tracked_bytes_ += size;
+        if (keys_.size() > options_.max_keys) {
+            lower_threshold();
+        }
+        return;
+    }
+    
+    Tracked& tracked = it->second;
+    if (size == 0) {
+        size = tracked.size;
+    }
+    int64_t between = prefix_sum(now - 1) - prefix_sum(tracked.time);
+    uint64_t distance = static_cast<uint64_t>(std::max<int64_t>(between, 0) / rate()) + size;
+    distances_.record(std::min(distance, kLargestDistance), weight);
+    
+    add(tracked.time, -static_cast<int64_t>(tracked.size));
+    add(now, static_cast<int64_t>(size));
+    tracked_bytes_ = tracked_bytes_ - tracked.size + size;
+    tracked.time = now;
+    tracked.size = size;
+}
+
+double MissRatioCurve::hit_ratio(uint64_t capacity_bytes) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (accesses_ == 0) {
+        return 0.0;
+    }
+    // SHARDS_adj: credit the gap between expected and actual sampled
+    // references as hits at every size (or debit it). With skewed traffic,
+    // whether the few hottest keys happen to be sampled swings the estimate.
+    uint64_t total = std::max(references_.load(std::memory_order_relaxed), accesses_);
+    double adjust = static_cast<double>(total) - static_cast<double>(accesses_);
+    double hits = static_cast<double>(distances_.count_at_or_below(capacity_bytes)) + adjust;
+    return std::clamp(hits / total, 0.0, 1.0);
+}
+
+std::vector<MissRatioCurve::Point> MissRatioCurve::curve(const std::vector<uint64_t>& capacities) const {
+    std::vector<Point> points;
+    points.reserve(capacities.size());
+    for (uint64_t capacity : capacities) {
+        points.push_back({capacity, hit_ratio(capacity)});
+    }
+    return points;
+}
+
+void MissRatioCurve::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    keys_.clear();
+    std::fill(tree_.begin(), tree_.end(), 0);
+    clock_ = 0;
+    tracked_bytes_ = 0;
+    distances_.reset();
+    accesses_ = 0;
+    samples_ = 0;
+    references_.store(0, std::memory_order_relaxed);
+    threshold_.store(threshold_for(options_.initial_rate), std::memory_order_relaxed);
+}
+
+double MissRatioCurve::sample_rate() const {
+    return rate();
+}
+
+uint64_t MissRatioCurve::sampled_accesses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return samples_;
+}
+
+size_t MissRatioCurve::tracked_keys() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return keys_.size();
+}
+
+void MissRatioCurve::add(uint64_t time, int64_t bytes) {
+    for (; time < tree_.size(); time += time & (~time + 1)) {
+        tree_[time] += bytes;
+    }
+}
+
+int64_t MissRatioCurve::prefix_sum(uint64_t time) const {
+    int64_t sum = 0;
+    for (; time > 0; time -= time & (~time + 1)) {
+        sum += tree_[time];
+    }
+    return sum;
+}
+
+void MissRatioCurve::compact() {
+    // Renumber the tracked keys 1..n in access order so the clock can keep running
+    std::vector<std::pair<uint64_t, Tracked*>> order;
+    order.reserve(keys_.size());
+    for (auto& [hash, tracked] : keys_) {
+        order.emplace_back(tracked.time, &tracked);
+    }
+    std::sort(order.begin(), order.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+    
+    std::fill(tree_.begin(), tree_.end(), 0);
+    clock_ = 0;
+    for (auto& [time, tracked] : order) {
+        tracked->time = ++clock_;
+        add(tracked->time, static_cast<int64_t>(tracked->size));
+    }
+}
+
+void MissRatioCurve::lower_threshold() {
+    // Drop every key sharing the largest hash's top bits, then sample below them
+    uint64_t threshold = std::prev(keys_.end())->first >> (64 - kThresholdBits);
+    while (!keys_.empty() && (std::prev(keys_.end())->first >> (64 - kThresholdBits)) >= threshold) {
+        auto largest = std::prev(keys_.end());
+        add(largest->second.time, -static_cast<int64_t>(largest->second.size));
+        tracked_bytes_ -= largest->second.size;
+        keys_.erase(largest);
+    }
+    threshold_.store(std::max<uint64_t>(threshold, 1), std::memory_order_relaxed);
+}
+
+uint64_t MissRatioCurve::threshold_for(double rate) {
+    return std::max<uint64_t>(1, static_cast<uint64_t>(std::clamp(rate, 0.0, 1.0) * (1ULL << kThresholdBits)));
+}
+
+double MissRatioCurve::rate() const {
+    return static_cast<double>(threshold_.load(std::memory_order_relaxed)) / (1ULL << kThresholdBits);
+}
+
+} // namespace cache
@@ -0,0 +1,128 @@
+#include "near_cache.h"
+#include <algorithm>
+#include <functional>
+
+namespace cache {
+
+NearCache::NearCache() : NearCache(Options()) {
+}
+
+NearCache::NearCache(Options options)
+    : options_(options), epochs_(std::make_unique<std::atomic<uint64_t>[]>(kEpochBuckets)) {
+    if (options_.capacity == 0) {
+        return;
+    }
+    size_t shards = std::clamp<size_t>(options_.shards, 1, options_.capacity);
+    size_t per_shard = (options_.capacity + shards - 1) / shards;
+    shards_.reserve(shards);
+    for (size_t i = 0; i < shards; ++i) {
+        shards_.push_back(std::make_unique<LRUCache<std::string, Entry>>(per_shard));
+    }
+}
+
+std::optional<std::string> NearCache::get(const std::string& key) {
+    if (shards_.empty()) {
+        return std::nullopt;
+    }
+    
+    auto& shard = shard_for(std::hash<std::string>{}(key));
+    std::optional<std::string> value;
+    bool expired = false;
+    auto now = Clock::now();
+    shard.update(key, [&](Entry& entry) {
+        if (now < entry.expires_at) {
+            value = entry.value;
+        } else {
+            expired = true;
+        }
+    });
+    if (expired) {
+        shard.remove(key);
+    }
+    
+    (value ? hits_ : misses_).fetch_add(1, std::memory_order_relaxed);
+    return value;
+}
+
+uint64_t NearCache::begin_fill(const std::string& key) const {
+    if (shards_.empty()) {
+        return 0;
+    }
+    return epoch_for(std::hash<std::string>{}(key)).load(std::memory_order_acquire);
+}
+
+void NearCache::fill(const std::string& key, const std::string& value, uint64_t token) {
+    if (shards_.empty()) {
+        return;
+    }
+    
+    // Insert, then check: invalidate() bumps, then removes, and the shard
+    // lock orders the two removes against the insert, so either this sees
+    // the bump or the invalidation removes the entry
+    size_t hash = std::hash<std::string>{}(key);
+    auto& shard = shard_for(hash);
+    shard.put(key, Entry{value, Clock::now() + options_.ttl});
+    if (epoch_for(hash).load(std::memory_order_acquire) != token) {
+        shard.remove(key);
+    }
+}
+
+void NearCache::invalidate(const std::string& key) {
+    if (shards_.empty()) {
+        return;
+    }
+    
+    size_t hash = std::hash<std::string>{}(key);
+    epoch_for(hash).fetch_add(1, std::memory_order_acq_rel);
+    shard_for(hash).remove(key);
+    invalidations_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void NearCache::invalidate_all() {
+    if (shards_.empty()) {
+        return;
+    }
+    
+    for (size_t i = 0; i < kEpochBuckets; ++i) {
+        epochs_[i].fetch_add(1, std::memory_order_acq_rel);
+    }
+    for (auto& shard : shards_) {
+        shard->clear();
+    }
+    invalidations_.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t NearCache::size() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        total += shard->size();
+    }
+    return total;
+}
+
+const NearCache::Options& NearCache::options() const {
+    return options_;
+}
+
+uint64_t NearCache::hits() const {
+    return hits_.load(std::memory_order_relaxed);
+}
+
+uint64_t NearCache::misses() const {
+    return misses_.load(std::memory_order_relaxed);
+}
+
+uint64_t NearCache::invalidations() const {
+    return invalidations_.load(std::memory_order_relaxed);
+}
+
+LRUCache<std::string, NearCache::Entry>& NearCache::shard_for(size_t hash) const {
+    return *shards_[hash % shards_.size()];
+}
+
+std::atomic<uint64_t>& NearCache::epoch_for(size_t hash) const {
+    // Higher bits than the shard index, so one shard's keys spread over buckets
+    return epochs_[(hash >> 16) % kEpochBuckets];
+}
+
+} // namespace cache
@@ -0,0 +1,270 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <sched.h>
+
+#include "cache.h"
+#include "hdr_histogram.h"
+#include "lru_cache.h"
+#include "regression.h"
+#include "workload.h"
+
+// Performance regression gate: runs fixed in-process scenarios several
+// times, pinned to one CPU, and compares the results with a stored baseline.
+// Exits 1 if any metric regressed significantly.
+
+namespace {
+
+constexpr size_t kKeyCount = 100000;
+constexpr size_t kValueSize = 100;
+
+struct GateConfig {
+    std::string baseline_path;
+    std::string json_path;
+    bool update = false;
+    size_t repetitions = 5;
+    size_t operations = 200000;
+    int cpu = 0;
+    cache::Regression::Options options;
+};
+
+void print_usage(const char* program_name) {
+    std::cout << "Usage: " << program_name << " --baseline FILE [options]\n"
+              << "Options:\n"
+              << "  --baseline FILE    Baseline results to compare against (required)\n"
+              << "  --update           Measure and overwrite the baseline instead of comparing\n"
+              << "  --repetitions N    Runs per scenario (default: 5)\n"
+              << "  --operations N     Operations per run (default: 200000)\n"
+              << "  --cpu N            Pin to CPU N; -1 to leave unpinned (default: 0)\n"
+              << "  --tolerance F      Relative change allowed before flagging (default: 0.10)\n"
+              << "  --alpha A          Significance level of the t-test (default: 0.05)\n"
+              << "  --json FILE        Also write the current results to FILE\n"
+              << "  --help             Show this help message\n";
+}
+
+GateConfig parse_arguments(int argc, char* argv[]) {
+    GateConfig config;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--baseline" && i + 1 < argc) {
+            config.baseline_path = argv[++i];
+        } else if (arg == "--update") {
+            config.update = true;
+        } else if (arg == "--repetitions" && i + 1 < argc) {
+            config.repetitions = std::max<size_t>(std::stoul(argv[++i]), 2);
+        } else if (arg == "--operations" && i + 1 < argc) {
+            config.operations = std::max<size_t>(std::stoul(argv[++i]), 1);
+        } else if (arg == "--cpu" && i + 1 < argc) {
+            config.cpu = std::stoi(argv[++i]);
+        } else if (arg == "--tolerance" && i + 1 < argc) {
+            config.options.tolerance = std::stod(argv[++i]);
+        } else if (arg == "--alpha" && i + 1 < argc) {
+            config.options.alpha = std::stod(argv[++i]);
+        } else if (arg == "--json" && i + 1 < argc) {
+            config.json_path = argv[++i];
+        } else if (arg == "--help") {
+            print_usage(argv[0]);
+            exit(0);
+        }
+    }
+    
+    if (config.baseline_path.empty()) {
+        print_usage(argv[0]);
+        exit(1);
+    }
+    return config;
+}
+
+void pin_to_cpu(int cpu) {
+    if (cpu < 0) {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        std::cerr << "Warning: could not pin to CPU " << cpu << "; running unpinned" << std::endl;
+    }
+}
+
+std::vector<std::string> make_keys() {
+    std::vector<std::string> keys;
+    keys.reserve(kKeyCount);
+    for (size_t i = 0; i < kKeyCount; ++i) {
+        keys.push_back(cache::Workload::key_name(i));
+    }
+    return keys;
+}
+
+// Times each call of op(i) and appends ops_per_sec and p99_ns samples
+void measure(const std::string& scenario, const GateConfig& config,
+             const std::function<void(size_t)>& op, std::vector<cache::Metric>& metrics) {
+    cache::Metric throughput{scenario + ".ops_per_sec", true, {}};
+    cache::Metric p99{scenario + ".p99_ns", false, {}};
+    cache::HdrHistogram histogram(1000ULL * 1000 * 1000);
+    
+    // Warm up caches and branch predictors once before the measured runs
+    for (size_t i = 0; i < config.operations / 10; ++i) {
+        op(i);
+    }
+    
+    for (size_t rep = 0; rep < config.repetitions; ++rep) {
+        histogram.reset();
+        auto run_start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < config.operations; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            op(i);
+            auto end = std::chrono::steady_clock::now();
+            histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - run_start).count();
+        throughput.samples.push_back(config.operations / seconds);
+        p99.samples.push_back(static_cast<double>(histogram.percentile(99.0)));
+    }
+    
+    metrics.push_back(std::move(throughput));
+    metrics.push_back(std::move(p99));
+}
+
+std::vector<cache::Metric> run_scenarios(const GateConfig& config) {
+    std::vector<cache::Metric> metrics;
+    std::vector<std::string> keys = make_keys();
+    std::string value(kValueSize, 'v');
+    
+    // Key indices are drawn up front so the generator is not timed
+    std::mt19937_64 rng(1);
+    cache::ZipfianGenerator zipfian(kKeyCount);
+    std::vector<size_t> skewed(config.operations);
+    std::vector<size_t> uniform(config.operations);
+    for (size_t i = 0; i < config.operations; ++i) {
+        skewed[i] = zipfian.next(rng) * 7919 % kKeyCount;
+        uniform[i] = rng() % kKeyCount;
+    }
+    
+    {
+        cache::Cache cache;
+        for (const auto& key : keys) {
+            cache.set(key, value);
+        }
+        
+        // Accounting is deterministic, so one sample per repetition is identical
+        cache::Metric bytes{"cache.bytes_per_entry", false, {}};
+        for (size_t rep = 0; rep < config.repetitions; ++rep) {
+            bytes.samples.push_back(static_cast<double>(cache.memory_usage()) / cache.size());
+        }
+        metrics.push_back(std::move(bytes));
+        
+        measure("cache_get", config, [&](size_t i) {
+            cache.get(keys[skewed[i]]);
+        }, metrics);
+        measure("cache_set", config, [&](size_t i) {
+            cache.set(keys[uniform[i]], value);
+        }, metrics);
+        measure("cache_mixed", config, [&](size_t i) {
+            if (i % 10 == 0) {
+                cache.set(keys[skewed[i]], value);
+            } else {
+                cache.get(keys[skewed[i]]);
+            }
+        }, metrics);
+    }
+    
+    {
+        cache::LRUCache<std::string, std::string> lru(kKeyCount);
+        for (const auto& key : keys) {
+            lru.put(key, value);
+        }
+        measure("lru_mixed", config, [&](size_t i) {
+            if (i % 10 == 0) {
+                lru.put(keys[skewed[i]], value);
+            } else {
+                lru.get(keys[skewed[i]]);
+            }
+        }, metrics);
+    }
+    
+    return metrics;
+}
+
+void print_metrics(const std::vector<cache::Metric>& metrics) {
+    std::cout << std::left << std::setw(28) << "Metric" << std::right
+              << std::setw(16) << "Mean" << std::setw(14) << "Stddev" << "\n";
+    for (const auto& metric : metrics) {
+        std::cout << std::left << std::setw(28) << metric.name << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(16) << metric.mean()
+                  << std::setw(14) << metric.stddev() << "\n";
+    }
+}
+
+// Returns the number of regressions
+size_t print_comparisons(const std::vector<cache::Regression::Comparison>& comparisons) {
+    size_t regressions = 0;
+    std::cout << std::left << std::setw(28) << "Metric" << std::right
+              << std::setw(16) << "Baseline" << std::setw(16) << "Current"
+              << std::setw(10) << "Worse" << std::setw(10) << "p" << "  Status\n";
+    for (const auto& comparison : comparisons) {
+        std::cout << std::left << std::setw(28) << comparison.name << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(16) << comparison.baseline_mean;
+        if (comparison.missing) {
+            std::cout << std::setw(16) << "-" << std::setw(10) << "-" << std::setw(10) << "-"
+                      << "  MISSING\n";
+            continue;
+        }
+        std::cout << std::setw(16) << comparison.current_mean
+                  << std::setw(9) << comparison.change * 100.0 << "%"
+                  << std::setprecision(4) << std::setw(10) << comparison.p_value << "  ";
+        if (comparison.regressed) {
+            regressions++;
+            std::cout << "REGRESSION\n";
+        } else if (comparison.improved) {
+            std::cout << "improved\n";
+        } else {
+            std::cout << "ok\n";
+        }
+    }
+    return regressions;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    GateConfig config = parse_arguments(argc, argv);
+    pin_to_cpu(config.cpu);
+    
+    std::cout << "Running " << config.repetitions << " repetitions of " << config.operations
+              << " operations per scenario" << std::endl;
+    std::vector<cache::Metric> current = run_scenarios(config);
+    
+    if (!config.json_path.empty() && !cache::Regression::save(config.json_path, current)) {
+        return 1;
+    }
+    
+    if (config.update) {
+        print_metrics(current);
+        if (!cache::Regression::save(config.baseline_path, current)) {
+            return 1;
+        }
+        std::cout << "Baseline written to " << config.baseline_path << std::endl;
+        return 0;
+    }
+    
+    auto baseline = cache::Regression::load(config.baseline_path);
+    if (!baseline) {
+        std::cerr << "Run with --update to create a baseline" << std::endl;
+        return 1;
+    }
+    
+    size_t regressions = print_comparisons(cache::Regression::compare(*baseline, current, config.options));
+    if (regressions > 0) {
+        std::cerr << regressions << " metric(s) regressed by more than "
+                  << config.options.tolerance * 100.0 << "% (p < " << config.options.alpha << ")" << std::endl;
+        return 1;
+    }
+    std::cout << "No significant regressions" << std::endl;
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include "protocol.h"
 #include <sstream>
 #include <algorithm>
+#include <charconv>
 
 namespace cache {
 
@@ -20,17 +21,40 @@ Protocol::Request Protocol::parse_request(const std::string& request) {
             if (parts.size() >= 3) {
                 req.key = parts[1];
                 // Join remaining parts as value (in case value contains spaces)
-                std::ostringstream value_stream;
-                for (size_t i = 2; i < parts.size(); ++i) {
-                    if (i > 2) value_stream << " ";
-                    value_stream << parts[i];
-                }
-                req.value = value_stream.str();
+                req.value = join(parts, 2);
                 req.valid = true;
             }
             break;
             
+        case Command::INCR:
+        case Command::DECR:
+            // INCR key [delta]
+            if (parts.size() == 2) {
+                req.key = parts[1];
+                req.valid = true;
+            } else if (parts.size() == 3) {
+                req.key = parts[1];
+                const char* begin = parts[2].data();
+                const char* end = begin + parts[2].size();
+                auto [ptr, ec] = std::from_chars(begin, end, req.delta);
+                req.valid = ec == std::errc() && ptr == end;
+            }
+            break;
+            
+        case Command::CAS:
+            // CAS key version value
+            if (parts.size() >= 4) {
+                req.key = parts[1];
+                const char* begin = parts[2].data();
+                const char* end = begin + parts[2].size();
+                auto [ptr, ec] = std::from_chars(begin, end, req.version);
+                req.value = join(parts, 3);
+                req.valid = ec == std::errc() && ptr == end;
+            }
+            break;
+            
         case Command::GET:
+        case Command::GETS:
         case Command::DELETE:
             if (parts.size() >= 2) {
                 req.key = parts[1];
@@ -38,8 +62,75 @@ Protocol::Request Protocol::parse_request(const std::string& request) {
             }
             break;
             
-        case Command::CLEAR:
         case Command::STATS:
+            // STATS [section]
+            if (parts.size() >= 2) {
+                req.key = parts[1];
+            }
+            req.valid = true;
+            break;
+            
+        case Command::SLOWLOG:
+            // SLOWLOG GET [count] | SLOWLOG LEN | SLOWLOG RESET
+            if (parts.size() == 2) {
+                req.key = parts[1];
+                req.delta = 10;
+                req.valid = true;
+            } else if (parts.size() == 3) {
+                req.key = parts[1];
+                const char* begin = parts[2].data();
+                const char* end = begin + parts[2].size();
+                auto [ptr, ec] = std::from_chars(begin, end, req.delta);
+                req.valid = ec == std::errc() && ptr == end && req.delta >= 0;
+            }
+            break;
+            
+        case Command::HOTKEYS:
+        case Command::BIGKEYS:
+            // HOTKEYS [count] | BIGKEYS [count]
+            req.delta = 10;
+            if (parts.size() == 1) {
+                req.valid = true;
+            } else if (parts.size() == 2) {
+                const char* begin = parts[1].data();
+                const char* end = begin + parts[1].size();
+                auto [ptr, ec] = std::from_chars(begin, end, req.delta);
+                req.valid = ec == std::errc() && ptr == end && req.delta >= 0;
+            }
+            break;
+            
+        case Command::TRACKING:
+            // TRACKING ON | TRACKING OFF
+            if (parts.size() == 2) {
+                req.key = parts[1];
+                std::transform(req.key.begin(), req.key.end(), req.key.begin(), ::toupper);
+                req.valid = req.key == "ON" || req.key == "OFF";
+            }
+            break;
+            
+        case Command::SYNC:
+            // SYNC (full) | SYNC replication_id offset (resume)
+            if (parts.size() == 1) {
+                req.valid = true;
+            } else if (parts.size() == 3) {
+                req.key = parts[1];
+                const char* begin = parts[2].data();
+                const char* end = begin + parts[2].size();
+                auto [ptr, ec] = std::from_chars(begin, end, req.version);
+                req.valid = ec == std::errc() && ptr == end;
+            }
+            break;
+            
+        case Command::SELECT:
+            // SELECT namespace
+            if (parts.size() == 2) {
+                req.key = parts[1];
+                req.valid = true;
+            }
+            break;
+            
+        case Command::CLEAR:
+        case Command::BGSAVE:
             req.valid = true;
             break;
             
@@ -80,6 +171,28 @@ std::string Protocol::format_success(const std::string& data) {
     return "OK " + data;
 }
 
+const char* Protocol::command_name(Command command) {
+    switch (command) {
+        case Command::SET: return "set";
+        case Command::GET: return "get";
+        case Command::DELETE: return "delete";
+        case Command::CLEAR: return "clear";
+        case Command::STATS: return "stats";
+        case Command::INCR: return "incr";
+        case Command::DECR: return "decr";
+        case Command::GETS: return "gets";
+        case Command::CAS: return "cas";
+        case Command::BGSAVE: return "bgsave";
+        case Command::SLOWLOG: return "slowlog";
+        case Command::HOTKEYS: return "hotkeys";
+        case Command::BIGKEYS: return "bigkeys";
+        case Command::TRACKING: return "tracking";
+        case Command::SYNC: return "sync";
+        case Command::SELECT: return "select";
+        default: return "unknown";
+    }
+}
+
 std::vector<std::string> Protocol::split(const std::string& str, char delimiter) {
     std::vector<std::string> tokens;
     std::stringstream ss(str);
@@ -94,6 +207,15 @@ std::vector<std::string> Protocol::split(const std::string& str, char delimiter)
     return tokens;
 }
 
+std::string Protocol::join(const std::vector<std::string>& parts, size_t first) {
+    std::ostringstream oss;
+    for (size_t i = first; i < parts.size(); ++i) {
+        if (i > first) oss << " ";
+        oss << parts[i];
+    }
+    return oss.str();
+}
+
 Protocol::Command Protocol::parse_command(const std::string& cmd) {
     std::string upper_cmd = cmd;
     std::transform(upper_cmd.begin(), upper_cmd.end(), upper_cmd.begin(), ::toupper);
@@ -103,6 +225,17 @@ Protocol::Command Protocol::parse_command(const std::string& cmd) {
     if (upper_cmd == "DELETE") return Command::DELETE;
     if (upper_cmd == "CLEAR") return Command::CLEAR;
     if (upper_cmd == "STATS") return Command::STATS;
+    if (upper_cmd == "INCR") return Command::INCR;
+    if (upper_cmd == "DECR") return Command::DECR;
+    if (upper_cmd == "GETS") return Command::GETS;
+    if (upper_cmd == "CAS") return Command::CAS;
+    if (upper_cmd == "BGSAVE") return Command::BGSAVE;
+    if (upper_cmd == "SLOWLOG") return Command::SLOWLOG;
+    if (upper_cmd == "HOTKEYS") return Command::HOTKEYS;
+    if (upper_cmd == "BIGKEYS") return Command::BIGKEYS;
+    if (upper_cmd == "TRACKING") return Command::TRACKING;
+    if (upper_cmd == "SYNC") return Command::SYNC;
+    if (upper_cmd == "SELECT") return Command::SELECT;
     
     return Command::UNKNOWN;
 }
@@ -0,0 +1,91 @@
+#include "reclaimer.h"
+#include "cache.h"
+
+namespace cache {
+
+Reclaimer::Reclaimer(Cache& cache, Options options) : cache_(cache), options_(options) {
+}
+
+Reclaimer::~Reclaimer() {
+    stop();
+}
+
+void Reclaimer::start() {
+    if (worker_.joinable()) {
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_requested_ = false;
+    }
+    worker_ = std::thread([this] { run(); });
+}
+
+void Reclaimer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_requested_ = true;
+    }
+    condition_.notify_all();
+    
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+void Reclaimer::wake() {
+    if (wake_requested_.exchange(true)) {
+        return;
+    }
+    // Taking the mutex orders the flag before the worker's next check, so
+    // the notification cannot fall between its check and its wait
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    condition_.notify_one();
+}
+
+const Reclaimer::Options& Reclaimer::options() const {
+    return options_;
+}
+
+size_t Reclaimer::passes() const {
+    return passes_.load();
+}
+
+size_t Reclaimer::items_evicted() const {
+    return items_evicted_.load();
+}
+
+uint64_t Reclaimer::time_us() const {
+    return time_ns_.load() / 1000;
+}
+
+double Reclaimer::last_duration_ms() const {
+    return last_duration_ms_.load();
+}
+
+void Reclaimer::run() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait_for(lock, options_.interval, [this] { return stop_requested_ || wake_requested_; });
+            if (stop_requested_) {
+                return;
+            }
+        }
+        // Cleared before the pass, so writes during it can wake the next one
+        wake_requested_ = false;
+        
+        auto start_time = std::chrono::steady_clock::now();
+        items_evicted_ += cache_.reclaim(options_.low_watermark, options_.high_watermark, options_.batch_size);
+        auto elapsed = std::chrono::steady_clock::now() - start_time;
+        
+        time_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        last_duration_ms_ = std::chrono::duration<double, std::milli>(elapsed).count();
+        passes_++;
+    }
+}
+
+} // namespace cache
@@ -0,0 +1,385 @@
+#include "regression.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+
+namespace cache {
+
+namespace {
+
+constexpr int kFormatVersion = 1;
+
+// Just enough JSON for the baseline layout: objects, arrays, strings without
+// escapes other than \" and \\, numbers and booleans
+class JsonReader {
+public:
+    explicit JsonReader(const std::string& text) : text_(text) {}
+    
+    bool expect(char c) {
+        skip_whitespace();
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            pos_++;
+            return true;
+        }
+        return false;
+    }
+    
+    bool peek(char c) {
+        skip_whitespace();
+        return pos_ < text_.size() && text_[pos_] == c;
+    }
+    
+    std::optional<std::string> string() {
+        if (!expect('"')) {
+            return std::nullopt;
+        }
+        std::string value;
+        while (pos_ < text_.size() && text_[pos_] != '"') {
+            if (text_[pos_] == '\\' && pos_ + 1 < text_.size()) {
+                pos_++;
+            }
+            value.push_back(text_[pos_++]);
+        }
+        if (pos_ == text_.size()) {
+            return std::nullopt;
+        }
+        pos_++;
+        return value;
+    }
+    
+    std::optional<double> number() {
+        skip_whitespace();
+        const char* start = text_.c_str() + pos_;
+        char* end = nullptr;
+        double value = std::strtod(start, &end);
+        if (end == start) {
+            return std::nullopt;
+        }
+        pos_ += end - start;
+        return value;
+    }
+    
+    std::optional<bool> boolean() {
+        skip_whitespace();
+        if (text_.compare(pos_, 4, "true") == 0) {
+            pos_ += 4;
+            return true;
+        }
+        if (text_.compare(pos_, 5, "false") == 0) {
+            pos_ += 5;
+            return false;
+        }
+        return std::nullopt;
+    }
+    
+    // Skips any value, so unknown keys are tolerated
+    bool skip() {
+        if (peek('"')) {
+            return string().has_value();
+        }
+        if (peek('{') || peek('[')) {
+            char close = text_[pos_] == '{' ? '}' : ']';
+            pos_++;
+            if (expect(close)) {
+                return true;
+            }
+            do {
+                if (close == '}' && (!string() || !expect(':'))) {
+                    return false;
+                }
+                if (!skip()) {
+                    return false;
+                }
+            } while (expect(','));
+            return expect(close);
+        }
+        if (boolean()) {
+            return true;
+        }
+        return number().has_value();
+    }
+    
+    bool at_end() {
+        skip_whitespace();
+        return pos_ == text_.size();
+    }
+
+private:
+    const std::string& text_;
+    size_t pos_ = 0;
+    
+    void skip_whitespace() {
+        while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) {
+            pos_++;
+        }
+    }
+};
+
+std::optional<Metric> read_metric(JsonReader& reader) {
+    Metric metric;
+    if (!reader.expect('{')) {
+        return std::nullopt;
+    }
+    if (reader.expect('}')) {
+        return std::nullopt;
+    }
+    do {
+        auto key = reader.string();
+        if (!key || !reader.expect(':')) {
+            return std::nullopt;
+        }
+        if (*key == "name") {
+            auto name = reader.string();
+            if (!name) {
+                return std::nullopt;
+            }
+            metric.name = *name;
+        } else if (*key == "higher_is_better") {
+            auto higher = reader.boolean();
+            if (!higher) {
+                return std::nullopt;
+            }
+            metric.higher_is_better = *higher;
+        } else if (*key == "samples") {
+            if (!reader.expect('[')) {
+                return std::nullopt;
+            }
+            if (!reader.expect(']')) {
+                do {
+                    auto sample = reader.number();
+                    if (!sample) {
+                        return std::nullopt;
+                    }
+                    metric.samples.push_back(*sample);
+                } while (reader.expect(','));
+                if (!reader.expect(']')) {
+                    return std::nullopt;
+                }
+            }
+        } else if (!reader.skip()) {
+            return std::nullopt;
+        }
+    } while (reader.expect(','));
+    
+    if (!reader.expect('}') || metric.name.empty() || metric.samples.empty()) {
+        return std::nullopt;
+    }
+    return metric;
+}
+
+// Continued fraction for the regularized incomplete beta function (modified Lentz)
+double beta_continued_fraction(double a, double b, double x) {
+    const double tiny = 1e-300;
+    double c = 1.0;
+    double d = 1.0 - (a + b) * x / (a + 1.0);
+    d = 1.0 / (std::fabs(d) < tiny ? tiny : d);
+    double result = d;
+    for (int m = 1; m <= 300; ++m) {
+        double m2 = 2.0 * m;
+        double numerator = m * (b - m) * x / ((a + m2 - 1.0) * (a + m2));
+        d = 1.0 + numerator * d;
+        c = 1.0 + numerator / c;
+        d = 1.0 / (std::fabs(d) < tiny ? tiny : d);
+        c = std::fabs(c) < tiny ? tiny : c;
+        result *= d * c;
+        
+        numerator = -(a + m) * (a + b + m) * x / ((a + m2) * (a + m2 + 1.0));
+        d = 1.0 + numerator * d;
+        c = 1.0 + numerator / c;
+        d = 1.0 / (std::fabs(d) < tiny ? tiny : d);
+        c = std::fabs(c) < tiny ? tiny : c;
+        double delta = d * c;
+        result *= delta;
+        if (std::fabs(delta - 1.0) < 1e-12) {
+            break;
+        }
+    }
+    return result;
+}
+
+double incomplete_beta(double a, double b, double x) {
+    if (x <= 0.0) {
+        return 0.0;
+    }
+    if (x >= 1.0) {
+        return 1.0;
+    }
+    double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) +
+                            a * std::log(x) + b * std::log(1.0 - x));
+    if (x < (a + 1.0) / (a + b + 2.0)) {
+        return front * beta_continued_fraction(a, b, x) / a;
+    }
+    return 1.0 - front * beta_continued_fraction(b, a, 1.0 - x) / b;
+}
+
+} // namespace
+
+double Metric::mean() const {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+    return sum / samples.size();
+}
+
+double Metric::stddev() const {
+    if (samples.size() < 2) {
+        return 0.0;
+    }
+    double m = mean();
+    double sum = 0.0;
+    for (double sample : samples) {
+        sum += (sample - m) * (sample - m);
+    }
+    return std::sqrt(sum / (samples.size() - 1));
+}
+
+std::optional<std::vector<Metric>> Regression::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Failed to open baseline " << path << std::endl;
+        return std::nullopt;
+    }
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    
+    JsonReader reader(text);
+    std::vector<Metric> metrics;
+    bool version_ok = false;
+    bool ok = reader.expect('{') && !reader.peek('}');
+    while (ok) {
+        auto key = reader.string();
+        if (!key || !reader.expect(':')) {
+            ok = false;
+            break;
+        }
+        if (*key == "version") {
+            auto version = reader.number();
+            version_ok = version && *version == kFormatVersion;
+            ok = version.has_value();
+        } else if (*key == "metrics") {
+            ok = reader.expect('[');
+            if (ok && !reader.expect(']')) {
+                do {
+                    auto metric = read_metric(reader);
+                    if (!metric) {
+                        ok = false;
+                        break;
+                    }
+                    metrics.push_back(std::move(*metric));
+                } while (reader.expect(','));
+                ok = ok && reader.expect(']');
+            }
+        } else {
+            ok = reader.skip();
+        }
+        if (!ok || !reader.expect(',')) {
+            break;
+        }
+    }
+    if (!ok || !reader.expect('}') || !reader.at_end() || !version_ok) {
+        std::cerr << "Baseline " << path << " is malformed" << std::endl;
+        return std::nullopt;
+    }
+    return metrics;
+}
+
+bool Regression::save(const std::string& path, const std::vector<Metric>& metrics) {
+    std::ostringstream out;
+    out << std::setprecision(10);
+    out << "{\n  \"version\": " << kFormatVersion << ",\n  \"metrics\": [";
+    for (size_t i = 0; i < metrics.size(); ++i) {
+        const auto& metric = metrics[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": \"" << metric.name << "\", \"higher_is_better\": "
+            << (metric.higher_is_better ? "true" : "false") << ", \"samples\": [";
+        for (size_t j = 0; j < metric.samples.size(); ++j) {
+            out << (j ? ", " : "") << metric.samples[j];
+        }
+        out << "]}";
+    }
+    out << "\n  ]\n}\n";
+    
+    std::ofstream file(path, std::ios::trunc);
+    if (!(file << out.str())) {
+        std::cerr << "Failed to write baseline " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::vector<Regression::Comparison> Regression::compare(const std::vector<Metric>& baseline,
+                                                        const std::vector<Metric>& current,
+                                                        const Options& options) {
+    std::vector<Comparison> comparisons;
+    for (const auto& before : baseline) {
+        Comparison comparison;
+        comparison.name = before.name;
+        comparison.baseline_mean = before.mean();
+        
+        const Metric* after = nullptr;
+        for (const auto& metric : current) {
+            if (metric.name == before.name) {
+                after = &metric;
+                break;
+            }
+        }
+        if (!after || after->samples.empty()) {
+            comparison.missing = true;
+            comparisons.push_back(comparison);
+            continue;
+        }
+        
+        comparison.current_mean = after->mean();
+        if (comparison.baseline_mean != 0.0) {
+            double relative = (comparison.current_mean - comparison.baseline_mean) /
+                              std::fabs(comparison.baseline_mean);
+            comparison.change = before.higher_is_better ? -relative : relative;
+        }
+        comparison.p_value = welch_p_value(before.samples, after->samples);
+        bool significant = comparison.p_value < options.alpha;
+        comparison.regressed = significant && comparison.change > options.tolerance;
+        comparison.improved = significant && comparison.change < -options.tolerance;
+        comparisons.push_back(comparison);
+    }
+    return comparisons;
+}
+
+double Regression::welch_p_value(const std::vector<double>& a, const std::vector<double>& b) {
+    if (a.empty() || b.empty()) {
+        return 1.0;
+    }
+    Metric first{"", true, a};
+    Metric second{"", true, b};
+    double variance_a = first.stddev() * first.stddev() / a.size();
+    double variance_b = second.stddev() * second.stddev() / b.size();
+    double variance = variance_a + variance_b;
+    double difference = first.mean() - second.mean();
+    
+    // Deterministic metrics such as bytes per entry have no spread at all,
+    // up to rounding in the mean
+    double scale = std::max(std::fabs(first.mean()), std::fabs(second.mean()));
+    if (variance <= 1e-18 * scale * scale) {
+        return std::fabs(difference) <= 1e-9 * scale ? 1.0 : 0.0;
+    }
+    
+    double denominator = 0.0;
+    if (a.size() > 1) {
+        denominator += variance_a * variance_a / (a.size() - 1);
+    }
+    if (b.size() > 1) {
+        denominator += variance_b * variance_b / (b.size() - 1);
+    }
+    double df = variance * variance / denominator;
+    double t = difference / std::sqrt(variance);
+    return incomplete_beta(df / 2.0, 0.5, df / (df + t * t));
+}
+
+} // namespace cache
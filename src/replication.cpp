@@ -0,0 +1,594 @@
+#include "replication.h"
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+namespace cache {
+
+namespace {
+
+constexpr uint8_t kFlagInteger = 1;
+constexpr uint8_t kFlagCompressed = 2;
+constexpr size_t kFrameHeaderSize = sizeof(uint32_t);
+constexpr size_t kPayloadHeaderSize = 2 * sizeof(uint8_t) + sizeof(uint64_t) + 2 * sizeof(uint32_t);
+// Largest write to a replica, and the batch size while copying the snapshot
+constexpr size_t kChunkSize = 256 * 1024;
+constexpr int kPollIntervalMs = 100;
+
+template<typename T>
+void append_raw(std::string& buffer, T value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template<typename T>
+T read_at(const char* data) {
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string random_id() {
+    std::random_device device;
+    std::ostringstream id;
+    id << std::hex << std::setfill('0');
+    for (int i = 0; i < 5; ++i) {
+        id << std::setw(8) << device();
+    }
+    return id.str();
+}
+
+std::string peer_address(int socket) {
+    sockaddr_storage address{};
+    socklen_t length = sizeof(address);
+    if (getpeername(socket, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        return "unknown";
+    }
+    char host[NI_MAXHOST];
+    char port[NI_MAXSERV];
+    if (getnameinfo(reinterpret_cast<sockaddr*>(&address), length, host, sizeof(host), port, sizeof(port),
+                    NI_NUMERICHOST | NI_NUMERICSERV) != 0) {
+        return "unknown";
+    }
+    return std::string(host) + ":" + port;
+}
+
+// Blocking send of all of data; keep_going is asked whenever the send times out
+template<typename KeepGoing>
+bool send_all(int socket, const std::string& data, KeepGoing keep_going) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && keep_going()) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+ReplicationPrimary::ReplicationPrimary(const Cache& cache, Options options)
+    : cache_(cache), options_(options), id_(random_id()),
+      backlog_(std::max<size_t>(options.backlog_bytes, 1), '\0') {
+}
+
+ReplicationPrimary::~ReplicationPrimary() {
+    stop();
+}
+
+bool ReplicationPrimary::recording() const {
+    return active_.load(std::memory_order_relaxed);
+}
+
+void ReplicationPrimary::append_set(const Cache::CacheEntry& entry) {
+    if (!active_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::string record;
+    encode_entry(record, entry);
+    append(record);
+}
+
+void ReplicationPrimary::append_remove(const std::string& key) {
+    if (!active_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::string record;
+    encode(record, Op::REMOVE, 0, 0, key, nullptr, 0);
+    append(record);
+}
+
+void ReplicationPrimary::append_clear() {
+    if (!active_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::string record;
+    encode(record, Op::CLEAR, 0, 0, std::string(), nullptr, 0);
+    append(record);
+}
+
+void ReplicationPrimary::serve(int socket, const std::string& id, std::optional<uint64_t> offset) {
+    // Bounded sends, so a stalled replica cannot hold up stop()
+    timeval timeout{1, 0};
+    setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    auto keep_going = [this]() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !stop_;
+    };
+    
+    uint64_t position;
+    bool partial;
+    std::list<ReplicaState>::iterator state;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_) {
+            return;
+        }
+        // From here on every mutation reaches the backlog. A writer that
+        // missed the flag holds its shard lock until its change is visible
+        // to the snapshot copy below.
+        active_.store(true, std::memory_order_relaxed);
+        partial = offset && id == id_ && *offset >= backlog_start() && *offset <= offset_;
+        position = partial ? *offset : offset_;
+        replicas_.push_back({peer_address(socket), position, !partial});
+        state = std::prev(replicas_.end());
+    }
+    
+    std::string reply = partial ? "OK CONTINUE " + std::to_string(position) + "\n"
+                                : "OK FULLSYNC " + id_ + " " + std::to_string(position) + "\n";
+    bool ok = send_all(socket, reply, keep_going);
+    if (ok && !partial) {
+        std::string end;
+        encode(end, Op::SNAPSHOT_END, 0, position, std::string(), nullptr, 0);
+        ok = send_snapshot(socket) && send_all(socket, end, keep_going);
+    }
+    (partial ? partial_syncs_ : full_syncs_).fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        state->loading = false;
+    }
+    
+    std::string chunk;
+    std::string acks;
+    char buffer[256];
+    auto last_ping = std::chrono::steady_clock::now();
+    while (ok) {
+        uint64_t primary_offset;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            appended_.wait_for(lock, options_.ping_interval, [&]() { return stop_ || offset_ > position; });
+            // A replica that fell out of the backlog reconnects for a full sync
+            if (stop_ || !read(position, chunk, kChunkSize)) {
+                break;
+            }
+            primary_offset = offset_;
+        }
+        if (!chunk.empty()) {
+            ok = send_all(socket, chunk, keep_going);
+            position += chunk.size();
+        }
+        
+        // Lets the replica work out its lag while streaming as well as idle
+        auto now = std::chrono::steady_clock::now();
+        if (ok && now - last_ping >= options_.ping_interval) {
+            std::string ping;
+            encode(ping, Op::PING, 0, primary_offset, std::string(), nullptr, 0);
+            ok = send_all(socket, ping, keep_going);
+            last_ping = now;
+        }
+        
+        // "ACK offset" lines from the replica
+        ssize_t n = -1;
+        while (ok && (n = recv(socket, buffer, sizeof(buffer), MSG_DONTWAIT)) != 0) {
+            if (n < 0) {
+                ok = errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+                break;
+            }
+            acks.append(buffer, n);
+        }
+        ok = ok && n != 0;
+        size_t newline;
+        while ((newline = acks.find('\n')) != std::string::npos) {
+            std::string line = acks.substr(0, newline);
+            acks.erase(0, newline + 1);
+            if (line.compare(0, 4, "ACK ") == 0) {
+                uint64_t acked = std::strtoull(line.c_str() + 4, nullptr, 10);
+                std::lock_guard<std::mutex> lock(mutex_);
+                state->acked_offset = acked;
+            }
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    replicas_.erase(state);
+}
+
+void ReplicationPrimary::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    appended_.notify_all();
+}
+
+const std::string& ReplicationPrimary::id() const {
+    return id_;
+}
+
+uint64_t ReplicationPrimary::offset() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return offset_;
+}
+
+uint64_t ReplicationPrimary::backlog_start() const {
+    // Callers hold mutex_ or only need an estimate
+    return offset_ > backlog_.size() ? offset_ - backlog_.size() : 0;
+}
+
+std::vector<ReplicationPrimary::ReplicaState> ReplicationPrimary::replicas() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::vector<ReplicaState>(replicas_.begin(), replicas_.end());
+}
+
+size_t ReplicationPrimary::full_syncs() const {
+    return full_syncs_.load(std::memory_order_relaxed);
+}
+
+size_t ReplicationPrimary::partial_syncs() const {
+    return partial_syncs_.load(std::memory_order_relaxed);
+}
+
+void ReplicationPrimary::encode(std::string& out, Op op, uint8_t flags, uint64_t version,
+                                const std::string& key, const char* value, size_t value_len) {
+    append_raw<uint32_t>(out, kPayloadHeaderSize + key.size() + value_len);
+    append_raw<uint8_t>(out, static_cast<uint8_t>(op));
+    append_raw<uint8_t>(out, flags);
+    append_raw<uint64_t>(out, version);
+    append_raw<uint32_t>(out, key.size());
+    append_raw<uint32_t>(out, value_len);
+    out.append(key);
+    out.append(value, value_len);
+}
+
+void ReplicationPrimary::encode_entry(std::string& out, const Cache::CacheEntry& entry) {
+    if (entry.is_integer) {
+        encode(out, Op::SET, kFlagInteger, entry.version, entry.key,
+               reinterpret_cast<const char*>(&entry.int_value), sizeof(entry.int_value));
+    } else {
+        encode(out, Op::SET, entry.is_compressed ? kFlagCompressed : 0, entry.version, entry.key,
+               entry.value.data(), entry.value.size());
+    }
+}
+
+void ReplicationPrimary::append(const std::string& record) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t capacity = backlog_.size();
+        const char* data = record.data();
+        size_t size = record.size();
+        uint64_t at = offset_;
+        if (size > capacity) {
+            // Only the tail fits; replicas reading the head will resync
+            data += size - capacity;
+            at += size - capacity;
+            size = capacity;
+        }
+        size_t start = at % capacity;
+        size_t first = std::min(size, capacity - start);
+        std::memcpy(&backlog_[start], data, first);
+        std::memcpy(&backlog_[0], data + first, size - first);
+        offset_ += record.size();
+    }
+    appended_.notify_all();
+}
+
+bool ReplicationPrimary::read(uint64_t position, std::string& out, size_t max_bytes) const {
+    // mutex_ held
+    out.clear();
+    if (position < backlog_start() || position > offset_) {
+        return false;
+    }
+    size_t capacity = backlog_.size();
+    size_t size = static_cast<size_t>(std::min<uint64_t>(offset_ - position, max_bytes));
+    size_t start = position % capacity;
+    size_t first = std::min(size, capacity - start);
+    out.assign(backlog_.data() + start, first);
+    out.append(backlog_.data(), size - first);
+    return true;
+}
+
+bool ReplicationPrimary::send_snapshot(int socket) {
+    auto keep_going = [this]() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !stop_;
+    };
+    // One shard at a time, like Snapshot::save, so writers only wait on the shard being copied
+    std::string batch;
+    for (size_t shard = 0; shard < cache_.num_shards(); ++shard) {
+        for (const auto& entry : cache_.export_shard(shard)) {
+            encode_entry(batch, entry);
+            if (batch.size() >= kChunkSize) {
+                if (!send_all(socket, batch, keep_going)) {
+                    return false;
+                }
+                batch.clear();
+            }
+        }
+    }
+    return send_all(socket, batch, keep_going);
+}
+
+ReplicaLink::ReplicaLink(Cache& cache, Options options) : cache_(cache), options_(std::move(options)) {
+}
+
+ReplicaLink::~ReplicaLink() {
+    stop();
+}
+
+void ReplicaLink::start() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = false;
+    }
+    worker_ = std::thread(&ReplicaLink::run, this);
+}
+
+void ReplicaLink::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        if (socket_ >= 0) {
+            shutdown(socket_, SHUT_RDWR);
+        }
+    }
+    stop_condition_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+std::string ReplicaLink::primary() const {
+    return options_.host + ":" + std::to_string(options_.port);
+}
+
+bool ReplicaLink::link_up() const {
+    return link_up_.load(std::memory_order_relaxed);
+}
+
+uint64_t ReplicaLink::offset() const {
+    return offset_.load(std::memory_order_relaxed);
+}
+
+uint64_t ReplicaLink::primary_offset() const {
+    return primary_offset_.load(std::memory_order_relaxed);
+}
+
+int64_t ReplicaLink::last_io_ms() const {
+    int64_t last = last_io_ns_.load(std::memory_order_relaxed);
+    return last == 0 ? -1 : (now_ns() - last) / 1000000;
+}
+
+size_t ReplicaLink::full_syncs() const {
+    return full_syncs_.load(std::memory_order_relaxed);
+}
+
+size_t ReplicaLink::partial_syncs() const {
+    return partial_syncs_.load(std::memory_order_relaxed);
+}
+
+void ReplicaLink::run() {
+    while (true) {
+        int socket = connect_to_primary();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_) {
+                if (socket >= 0) {
+                    close(socket);
+                }
+                return;
+            }
+            socket_ = socket;
+        }
+        
+        if (socket >= 0) {
+            session(socket);
+            link_up_ = false;
+            std::lock_guard<std::mutex> lock(mutex_);
+            socket_ = -1;
+            close(socket);
+        }
+        
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (stop_condition_.wait_for(lock, options_.retry_delay, [this]() { return stop_; })) {
+            return;
+        }
+    }
+}
+
+void ReplicaLink::session(int socket) {
+    std::string request = synced_ ? "SYNC " + id_ + " " + std::to_string(offset_.load()) + "\n" : "SYNC\n";
+    if (!send_all(socket, request, []() { return false; })) {
+        return;
+    }
+    
+    std::string buffer;
+    bool handshake = true;
+    bool loading = false;
+    auto next_ack = Clock::now() + options_.ack_interval;
+    char chunk[64 * 1024];
+    while (true) {
+        pollfd poll_fd{socket, POLLIN, 0};
+        int ready = poll(&poll_fd, 1, kPollIntervalMs);
+        if (ready < 0 && errno != EINTR) {
+            return;
+        }
+        if (ready > 0) {
+            ssize_t n = recv(socket, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                return;     // Primary gone, or stop() shut the socket down
+            }
+            buffer.append(chunk, n);
+            last_io_ns_.store(now_ns(), std::memory_order_relaxed);
+        }
+        
+        if (handshake) {
+            size_t newline = buffer.find('\n');
+            if (newline == std::string::npos) {
+                continue;
+            }
+            std::istringstream reply(buffer.substr(0, newline));
+            buffer.erase(0, newline + 1);
+            std::string status;
+            std::string mode;
+            uint64_t position = 0;
+            reply >> status >> mode;
+            if (status == "OK" && mode == "CONTINUE" && (reply >> position) && position == offset_) {
+                partial_syncs_.fetch_add(1, std::memory_order_relaxed);
+                link_up_ = true;
+            } else if (status == "OK" && mode == "FULLSYNC" && (reply >> id_ >> position)) {
+                // Entries the primary no longer has must not survive the sync
+                synced_ = false;
+                cache_.clear();
+                loading = true;
+            } else {
+                std::cerr << "Replication from " << primary() << " refused: " << reply.str() << std::endl;
+                return;
+            }
+            handshake = false;
+        }
+        
+        if (!apply(buffer, loading)) {
+            std::cerr << "Malformed replication stream from " << primary() << std::endl;
+            return;
+        }
+        
+        auto now = Clock::now();
+        if (synced_ && now >= next_ack) {
+            std::string ack = "ACK " + std::to_string(offset_.load()) + "\n";
+            if (!send_all(socket, ack, []() { return false; })) {
+                return;
+            }
+            next_ack = now + options_.ack_interval;
+        }
+    }
+}
+
+bool ReplicaLink::apply(std::string& buffer, bool& loading) {
+    size_t position = 0;
+    while (buffer.size() - position >= kFrameHeaderSize) {
+        uint32_t payload_len = read_at<uint32_t>(buffer.data() + position);
+        if (payload_len < kPayloadHeaderSize) {
+            return false;
+        }
+        if (buffer.size() - position - kFrameHeaderSize < payload_len) {
+            break;      // Rest of the record still in flight
+        }
+        
+        const char* payload = buffer.data() + position + kFrameHeaderSize;
+        auto op = static_cast<ReplicationPrimary::Op>(read_at<uint8_t>(payload));
+        uint8_t flags = read_at<uint8_t>(payload + 1);
+        uint64_t version = read_at<uint64_t>(payload + 2);
+        uint32_t key_len = read_at<uint32_t>(payload + 10);
+        uint32_t value_len = read_at<uint32_t>(payload + 14);
+        if (kPayloadHeaderSize + static_cast<size_t>(key_len) + value_len != payload_len) {
+            return false;
+        }
+        std::string key(payload + kPayloadHeaderSize, key_len);
+        const char* value = payload + kPayloadHeaderSize + key_len;
+        
+        bool in_backlog = true;
+        switch (op) {
+            case ReplicationPrimary::Op::SET:
+                if ((flags & kFlagInteger) && value_len == sizeof(int64_t)) {
+                    cache_.restore(Cache::CacheEntry(key, read_at<int64_t>(value), version));
+                } else {
+                    Cache::CacheEntry entry(key, std::string(value, value_len), version);
+                    entry.is_compressed = (flags & kFlagCompressed) != 0;
+                    cache_.restore(std::move(entry));
+                }
+                break;
+            case ReplicationPrimary::Op::REMOVE:
+                cache_.remove(key);
+                break;
+            case ReplicationPrimary::Op::CLEAR:
+                cache_.clear();
+                break;
+            case ReplicationPrimary::Op::SNAPSHOT_END:
+                in_backlog = false;
+                loading = false;
+                offset_ = version;
+                synced_ = true;
+                link_up_ = true;
+                full_syncs_.fetch_add(1, std::memory_order_relaxed);
+                break;
+            case ReplicationPrimary::Op::PING:
+                in_backlog = false;
+                primary_offset_ = version;
+                break;
+            default:
+                return false;
+        }
+        
+        // Snapshot entries are not part of the offset
+        if (in_backlog && !loading) {
+            offset_ += kFrameHeaderSize + payload_len;
+        }
+        position += kFrameHeaderSize + payload_len;
+    }
+    primary_offset_ = std::max(primary_offset_.load(), offset_.load());
+    buffer.erase(0, position);
+    return true;
+}
+
+int ReplicaLink::connect_to_primary() const {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    std::string port = std::to_string(options_.port);
+    if (getaddrinfo(options_.host.c_str(), port.c_str(), &hints, &result) != 0) {
+        return -1;
+    }
+    int fd = -1;
+    for (addrinfo* info = result; info != nullptr && fd < 0; info = info->ai_next) {
+        fd = socket(info->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && ::connect(fd, info->ai_addr, info->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(result);
+    if (fd >= 0) {
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+    return fd;
+}
+
+} // namespace cache
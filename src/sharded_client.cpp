@@ -0,0 +1,238 @@
+#include "sharded_client.h"
+#include <map>
+
+namespace cache {
+
+namespace {
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool is_ok(const std::string& reply) {
+    return reply.compare(0, 2, "OK") == 0;
+}
+
+std::optional<std::string> value_of(const std::string& reply) {
+    if (!is_ok(reply)) {
+        return std::nullopt;
+    }
+    return reply.size() > 3 ? reply.substr(3) : std::string();
+}
+
+// Errors from the client rather than the server; the node may be down
+bool is_transport_error(const std::string& reply) {
+    return reply == "ERROR Not connected" || reply == "ERROR Connection lost" || reply == "ERROR Timeout";
+}
+
+// Splits "host:port" or "[v6 address]:port"
+bool parse_node(const std::string& node, std::string& host, int& port) {
+    size_t colon = node.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == node.size()) {
+        return false;
+    }
+    host = node.substr(0, colon);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    try {
+        size_t used = 0;
+        port = std::stoi(node.substr(colon + 1), &used);
+        return used == node.size() - colon - 1 && port > 0 && port < 65536;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+} // namespace
+
+ShardedClient::ShardedClient() : ShardedClient(Options()) {
+}
+
+ShardedClient::ShardedClient(Options options) : options_(std::move(options)), ring_(options_.virtual_nodes) {
+}
+
+ShardedClient::~ShardedClient() {
+    close();
+}
+
+bool ShardedClient::connect() {
+    close();
+    nodes_.clear();
+    ring_ = HashRing(options_.virtual_nodes);
+    
+    for (const auto& name : options_.nodes) {
+        auto node = std::make_unique<Node>();
+        node->name = name;
+        CacheClient::Options client_options = options_.client;
+        if (!parse_node(name, client_options.host, client_options.port)) {
+            nodes_.clear();
+            return false;
+        }
+        // A node that is down now still gets its share of the ring and is
+        // connected to once it is back
+        client_options.require_server = false;
+        node->client = std::make_unique<CacheClient>(client_options);
+        ring_.add(name);
+        nodes_.push_back(std::move(node));
+    }
+    
+    bool reachable = false;
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        nodes_[i]->client->connect();
+        if (nodes_[i]->client->is_connected()) {
+            reachable = true;
+        } else {
+            mark_down(i);
+        }
+    }
+    running_ = reachable;
+    if (!reachable) {
+        close();
+    }
+    return reachable;
+}
+
+void ShardedClient::close() {
+    running_ = false;
+    for (auto& node : nodes_) {
+        node->client->close();
+    }
+}
+
+void ShardedClient::send(const std::string& key, const std::string& command, CacheClient::Callback callback) {
+    if (nodes_.empty()) {
+        callback("ERROR Not connected");
+        return;
+    }
+    nodes_[node_for(key)]->client->send(command, std::move(callback));
+}
+
+std::future<bool> ShardedClient::set(const std::string& key, const std::string& value) {
+    auto promise = std::make_shared<std::promise<bool>>();
+    auto future = promise->get_future();
+    send_with_failover(key, "SET " + key + " " + value, [promise](const std::string& reply) {
+        promise->set_value(is_ok(reply));
+    }, nodes_.size() - 1);
+    return future;
+}
+
+std::future<std::optional<std::string>> ShardedClient::get(const std::string& key) {
+    auto promise = std::make_shared<std::promise<std::optional<std::string>>>();
+    auto future = promise->get_future();
+    send_with_failover(key, "GET " + key, [promise](const std::string& reply) {
+        promise->set_value(value_of(reply));
+    }, nodes_.size() - 1);
+    return future;
+}
+
+std::future<bool> ShardedClient::remove(const std::string& key) {
+    auto promise = std::make_shared<std::promise<bool>>();
+    auto future = promise->get_future();
+    send_with_failover(key, "DELETE " + key, [promise](const std::string& reply) {
+        promise->set_value(is_ok(reply));
+    }, nodes_.size() - 1);
+    return future;
+}
+
+std::future<std::vector<std::optional<std::string>>> ShardedClient::mget(const std::vector<std::string>& keys) {
+    struct Batch {
+        std::vector<std::optional<std::string>> values;
+        std::atomic<size_t> remaining;
+        std::promise<std::vector<std::optional<std::string>>> promise;
+    };
+    auto batch = std::make_shared<Batch>();
+    batch->values.resize(keys.size());
+    batch->remaining = keys.size();
+    auto future = batch->promise.get_future();
+    if (keys.empty()) {
+        batch->promise.set_value({});
+        return future;
+    }
+    if (nodes_.empty()) {
+        batch->promise.set_value(std::move(batch->values));
+        return future;
+    }
+    
+    struct NodeBatch {
+        std::vector<std::string> commands;
+        std::vector<CacheClient::Callback> callbacks;
+    };
+    std::map<size_t, NodeBatch> by_node;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        size_t node = node_for(keys[i]);
+        std::string command = "GET " + keys[i];
+        auto done = [batch, i](const std::string& reply) {
+            batch->values[i] = value_of(reply);
+            if (batch->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                batch->promise.set_value(std::move(batch->values));
+            }
+        };
+        NodeBatch& node_batch = by_node[node];
+        node_batch.callbacks.push_back(with_failover(node, keys[i], command, done, nodes_.size() - 1));
+        node_batch.commands.push_back(std::move(command));
+    }
+    for (auto& [node, node_batch] : by_node) {
+        nodes_[node]->client->send_batch(node_batch.commands, std::move(node_batch.callbacks));
+    }
+    return future;
+}
+
+size_t ShardedClient::node_for(const std::string& key) const {
+    return ring_.node_for(key, [this](size_t index) { return !is_down(index); });
+}
+
+size_t ShardedClient::node_count() const {
+    return nodes_.size();
+}
+
+const std::string& ShardedClient::node_name(size_t index) const {
+    return nodes_[index]->name;
+}
+
+CacheClient& ShardedClient::node(size_t index) {
+    return *nodes_[index]->client;
+}
+
+bool ShardedClient::is_down(size_t index) const {
+    return nodes_[index]->down_until_ns.load(std::memory_order_relaxed) > now_ns();
+}
+
+uint64_t ShardedClient::failovers() const {
+    return failovers_.load(std::memory_order_relaxed);
+}
+
+void ShardedClient::send_with_failover(const std::string& key, const std::string& command,
+                                       CacheClient::Callback done, size_t retries) {
+    if (nodes_.empty()) {
+        done("ERROR Not connected");
+        return;
+    }
+    size_t node = node_for(key);
+    nodes_[node]->client->send(command, with_failover(node, key, command, std::move(done), retries));
+}
+
+CacheClient::Callback ShardedClient::with_failover(size_t node, const std::string& key, const std::string& command,
+                                                   CacheClient::Callback done, size_t retries) {
+    return [this, node, key, command, done = std::move(done), retries](const std::string& reply) {
+        if (!is_transport_error(reply)) {
+            done(reply);
+            return;
+        }
+        mark_down(node);
+        if (retries == 0 || !running_) {
+            done(reply);
+            return;
+        }
+        failovers_.fetch_add(1, std::memory_order_relaxed);
+        send_with_failover(key, command, done, retries - 1);
+    };
+}
+
+void ShardedClient::mark_down(size_t index) {
+    auto down_time = std::chrono::duration_cast<std::chrono::nanoseconds>(options_.down_time).count();
+    nodes_[index]->down_until_ns.store(now_ns() + down_time, std::memory_order_relaxed);
+}
+
+} // namespace cache
@@ -0,0 +1,334 @@
+#include "slab_allocator.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <new>
+
+namespace cache {
+
+namespace {
+
+constexpr size_t kAlignment = 8;
+constexpr size_t kLookupSteps = SlabAllocator::kMaxChunkSize / kAlignment + 1;
+
+struct ClassTable {
+    std::vector<size_t> sizes;
+    // Class for every 8-byte step up to kMaxChunkSize, so class_for is one load
+    std::array<uint8_t, kLookupSteps> lookup{};
+    
+    ClassTable() {
+        size_t size = SlabAllocator::kMinChunkSize;
+        while (size < SlabAllocator::kMaxChunkSize) {
+            sizes.push_back(size);
+            size = (size * 5 / 4 + kAlignment - 1) / kAlignment * kAlignment;
+        }
+        sizes.push_back(SlabAllocator::kMaxChunkSize);
+        
+        size_t slab_class = 0;
+        for (size_t step = 0; step < kLookupSteps; ++step) {
+            while (sizes[slab_class] < step * kAlignment) {
+                slab_class++;
+            }
+            lookup[step] = static_cast<uint8_t>(slab_class);
+        }
+    }
+};
+
+const ClassTable& class_table() {
+    static const ClassTable table;
+    return table;
+}
+
+} // namespace
+
+// Sits at the start of every page, ahead of its chunks
+struct SlabAllocator::Page {
+    static constexpr size_t kMaxChunks = (kPageSize - kPageHeaderSize) / kMinChunkSize;
+    
+    Page* prev = nullptr;       // Neighbours in the class's partial list
+    Page* next = nullptr;
+    void* free_list = nullptr;  // Freed chunks, each holding the next pointer
+    uint32_t used = 0;
+    uint32_t carved = 0;        // Chunks handed out at least once, from the front
+    uint8_t slab_class = 0;
+    bool in_partial = false;
+    bool evacuating = false;    // Being compacted; its freed chunks are not reused
+    uint64_t live[(kMaxChunks + 63) / 64] = {};
+    
+    char* chunk(size_t index) {
+        return reinterpret_cast<char*>(this) + kPageHeaderSize + index * chunk_size(slab_class);
+    }
+    size_t index_of(void* chunk) {
+        return static_cast<size_t>(static_cast<char*>(chunk) - reinterpret_cast<char*>(this) - kPageHeaderSize) /
+               chunk_size(slab_class);
+    }
+};
+
+SlabAllocator::SlabAllocator(Arena::Options options) : classes_(num_classes()) {
+    static_assert(sizeof(Page) <= kPageHeaderSize, "Page header outgrew its space");
+    configure(options);
+}
+
+SlabAllocator::~SlabAllocator() = default;
+
+void* SlabAllocator::allocate(size_t size) {
+    uint8_t slab_class = class_for(size);
+    if (slab_class == kLargeClass) {
+        large_bytes_ += size;
+        return ::operator new(size);
+    }
+    
+    SlabClass& slab = classes_[slab_class];
+    Page* page = slab.partial;
+    if (!page) {
+        page = new (take_page()) Page();
+        page->slab_class = slab_class;
+        slab.pages.push_back(page);
+        link_partial(slab, page);
+    }
+    
+    void* chunk;
+    if (page->free_list) {
+        chunk = page->free_list;
+        page->free_list = *static_cast<void**>(chunk);
+    } else {
+        chunk = page->chunk(page->carved++);
+    }
+    size_t index = page->index_of(chunk);
+    page->live[index / 64] |= uint64_t{1} << (index % 64);
+    page->used++;
+    slab.used_chunks++;
+    if (!page->free_list && page->carved == chunks_per_page(slab_class)) {
+        unlink_partial(slab, page);
+    }
+    return chunk;
+}
+
+void SlabAllocator::deallocate(void* ptr, size_t size) {
+    if (!ptr) {
+        return;
+    }
+    if (class_for(size) == kLargeClass) {
+        large_bytes_ -= size;
+        ::operator delete(ptr);
+        return;
+    }
+    
+    Page* page = page_of(ptr);
+    SlabClass& slab = classes_[page->slab_class];
+    size_t index = page->index_of(ptr);
+    page->live[index / 64] &= ~(uint64_t{1} << (index % 64));
+    *static_cast<void**>(ptr) = page->free_list;
+    page->free_list = ptr;
+    page->used--;
+    slab.used_chunks--;
+    if (!page->in_partial && !page->evacuating) {
+        link_partial(slab, page);
+    }
+}
+
+void SlabAllocator::configure(Arena::Options options) {
+    // Whole pages only
+    options.arena_size = std::max<size_t>(options.arena_size, kPageSize);
+    options.arena_size = (options.arena_size + kPageSize - 1) / kPageSize * kPageSize;
+    options_ = options;
+}
+
+void SlabAllocator::reserve(size_t bytes) {
+    while (mapped_bytes() < bytes) {
+        // Pool what is left of the current arena so mapping the next drops nothing
+        while (arena_next_ && arena_next_ + kPageSize <= arena_end_) {
+            free_pages_.push_back(arena_next_);
+            arena_next_ += kPageSize;
+        }
+        map_arena();
+    }
+}
+
+void SlabAllocator::release_pages() {
+    for (auto& slab : classes_) {
+        for (Page* page : slab.pages) {
+            free_pages_.push_back(reinterpret_cast<char*>(page));
+        }
+        slab.pages.clear();
+        slab.partial = nullptr;
+        slab.used_chunks = 0;
+    }
+    for (auto& arena : arenas_) {
+        arena->release();
+    }
+}
+
+bool SlabAllocator::compact(uint8_t slab_class, double max_occupancy, const RelocateFn& relocate) {
+    SlabClass& slab = classes_[slab_class];
+    if (slab.pages.empty()) {
+        return false;
+    }
+    Page* victim = *std::min_element(slab.pages.begin(), slab.pages.end(),
+                                     [](const Page* a, const Page* b) { return a->used < b->used; });
+    size_t per_page = chunks_per_page(slab_class);
+    size_t free_elsewhere = (slab.pages.size() - 1) * per_page - (slab.used_chunks - victim->used);
+    if (victim->used > max_occupancy * per_page || victim->used > free_elsewhere) {
+        return false;
+    }
+    
+    // Off the partial list first, so the moves land on other pages
+    if (victim->in_partial) {
+        unlink_partial(slab, victim);
+    }
+    victim->evacuating = true;
+    size_t size = chunk_size(slab_class);
+    for (size_t word = 0; word < std::size(victim->live); ++word) {
+        uint64_t bits = victim->live[word];
+        while (bits) {
+            size_t index = word * 64 + static_cast<size_t>(__builtin_ctzll(bits));
+            bits &= bits - 1;
+            void* from = victim->chunk(index);
+            void* to = allocate(size);
+            std::memcpy(to, from, size);
+            relocate(from, to);
+            deallocate(from, size);
+        }
+    }
+    retire_page(slab, victim);
+    slab.pages_compacted++;
+    return true;
+}
+
+void SlabAllocator::record_eviction(size_t size) {
+    uint8_t slab_class = class_for(size);
+    if (slab_class != kLargeClass) {
+        classes_[slab_class].evictions++;
+    }
+}
+
+uint8_t SlabAllocator::class_for(size_t size) {
+    if (size > kMaxChunkSize) {
+        return kLargeClass;
+    }
+    return class_table().lookup[(size + kAlignment - 1) / kAlignment];
+}
+
+size_t SlabAllocator::num_classes() {
+    return class_table().sizes.size();
+}
+
+size_t SlabAllocator::chunk_size(uint8_t slab_class) {
+    return class_table().sizes[slab_class];
+}
+
+size_t SlabAllocator::chunks_per_page(uint8_t slab_class) {
+    return (kPageSize - kPageHeaderSize) / chunk_size(slab_class);
+}
+
+size_t SlabAllocator::allocation_size(size_t size) {
+    uint8_t slab_class = class_for(size);
+    return slab_class == kLargeClass ? size : chunk_size(slab_class);
+}
+
+size_t SlabAllocator::mapped_bytes() const {
+    size_t total = 0;
+    for (const auto& arena : arenas_) {
+        total += arena->size();
+    }
+    return total;
+}
+
+size_t SlabAllocator::reserved_bytes() const {
+    size_t total = large_bytes_;
+    for (const auto& slab : classes_) {
+        total += slab.pages.size() * kPageSize;
+    }
+    return total;
+}
+
+size_t SlabAllocator::used_bytes() const {
+    size_t total = large_bytes_;
+    for (size_t i = 0; i < classes_.size(); ++i) {
+        total += classes_[i].used_chunks * chunk_size(static_cast<uint8_t>(i));
+    }
+    return total;
+}
+
+size_t SlabAllocator::large_bytes() const {
+    return large_bytes_;
+}
+
+size_t SlabAllocator::free_pages() const {
+    size_t uncarved = arena_next_ ? static_cast<size_t>(arena_end_ - arena_next_) / kPageSize : 0;
+    return free_pages_.size() + uncarved;
+}
+
+std::vector<SlabAllocator::ClassStats> SlabAllocator::class_stats() const {
+    std::vector<ClassStats> stats;
+    stats.reserve(classes_.size());
+    for (size_t i = 0; i < classes_.size(); ++i) {
+        uint8_t slab_class = static_cast<uint8_t>(i);
+        const SlabClass& slab = classes_[i];
+        size_t capacity = slab.pages.size() * chunks_per_page(slab_class);
+        stats.push_back({chunk_size(slab_class), slab.pages.size(), slab.used_chunks, capacity - slab.used_chunks,
+                         slab.evictions, slab.pages_compacted});
+    }
+    return stats;
+}
+
+SlabAllocator::Page* SlabAllocator::page_of(void* chunk) {
+    return reinterpret_cast<Page*>(reinterpret_cast<uintptr_t>(chunk) & ~uintptr_t{kPageSize - 1});
+}
+
+char* SlabAllocator::take_page() {
+    if (!free_pages_.empty()) {
+        char* page = free_pages_.back();
+        free_pages_.pop_back();
+        return page;
+    }
+    if (!arena_next_ || arena_next_ + kPageSize > arena_end_) {
+        map_arena();
+    }
+    char* page = arena_next_;
+    arena_next_ += kPageSize;
+    return page;
+}
+
+void SlabAllocator::map_arena() {
+    arenas_.push_back(std::make_unique<Arena>(options_.arena_size, options_.huge_pages, options_.prefault, kPageSize));
+    arena_next_ = arenas_.back()->data();
+    arena_end_ = arena_next_ + arenas_.back()->size() / kPageSize * kPageSize;
+}
+
+void SlabAllocator::link_partial(SlabClass& slab, Page* page) {
+    page->prev = nullptr;
+    page->next = slab.partial;
+    if (slab.partial) {
+        slab.partial->prev = page;
+    }
+    slab.partial = page;
+    page->in_partial = true;
+}
+
+void SlabAllocator::unlink_partial(SlabClass& slab, Page* page) {
+    if (page->prev) {
+        page->prev->next = page->next;
+    } else {
+        slab.partial = page->next;
+    }
+    if (page->next) {
+        page->next->prev = page->prev;
+    }
+    page->prev = page->next = nullptr;
+    page->in_partial = false;
+}
+
+void SlabAllocator::retire_page(SlabClass& slab, Page* page) {
+    slab.pages.erase(std::find(slab.pages.begin(), slab.pages.end(), page));
+    char* base = reinterpret_cast<char*>(page);
+    free_pages_.push_back(base);
+    // Huge pages would be split by a partial release
+    if (!options_.huge_pages) {
+        Arena::release(base, kPageSize);
+    }
+}
+
+} // namespace cache
@@ -0,0 +1,133 @@
+#include "slow_log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace cache {
+
+SlowLog::SlowLog(size_t capacity, int64_t threshold_us)
+    : slots_(std::make_unique<Slot[]>(std::max<size_t>(capacity, 1))),
+      capacity_(std::max<size_t>(capacity, 1)),
+      threshold_us_(threshold_us) {
+}
+
+bool SlowLog::should_log(uint64_t total_us) const {
+    int64_t threshold = threshold_us_.load(std::memory_order_relaxed);
+    return threshold >= 0 && total_us >= static_cast<uint64_t>(threshold);
+}
+
+void SlowLog::record(const Entry& entry) {
+    uint64_t id = next_id_.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots_[id % capacity_];
+    
+    // Claim the slot unless another writer is still in it or already put a newer entry there
+    uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if ((sequence & 1) || sequence >= 2 * (id + 1) ||
+        !slot.sequence.compare_exchange_strong(sequence, 2 * id + 1, std::memory_order_acq_rel)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    slot.timestamp_us.store(std::chrono::duration_cast<std::chrono::microseconds>(now).count(),
+                            std::memory_order_relaxed);
+    slot.value_size.store(entry.value_size, std::memory_order_relaxed);
+    slot.queue_wait_us.store(entry.queue_wait_us, std::memory_order_relaxed);
+    slot.lock_wait_us.store(entry.lock_wait_us, std::memory_order_relaxed);
+    slot.execute_us.store(entry.execute_us, std::memory_order_relaxed);
+    slot.send_us.store(entry.send_us, std::memory_order_relaxed);
+    
+    uint64_t command = 0;
+    size_t command_length = std::min(entry.command.size(), sizeof(command));
+    std::memcpy(&command, entry.command.data(), command_length);
+    slot.command.store(command, std::memory_order_relaxed);
+    slot.command_length.store(command_length, std::memory_order_relaxed);
+    
+    size_t key_length = std::min(entry.key.size(), kMaxKeyLength);
+    for (size_t word = 0; word * sizeof(uint64_t) < key_length; ++word) {
+        uint64_t bytes = 0;
+        size_t offset = word * sizeof(uint64_t);
+        std::memcpy(&bytes, entry.key.data() + offset, std::min(sizeof(bytes), key_length - offset));
+        slot.key[word].store(bytes, std::memory_order_relaxed);
+    }
+    slot.key_length.store(key_length, std::memory_order_relaxed);
+    
+    slot.sequence.store(2 * (id + 1), std::memory_order_release);
+}
+
+std::vector<SlowLog::Entry> SlowLog::get(size_t count) const {
+    std::vector<Entry> entries;
+    uint64_t newest = next_id_.load(std::memory_order_acquire);
+    uint64_t oldest = std::max(reset_id_.load(std::memory_order_acquire),
+                               newest > capacity_ ? newest - capacity_ : 0);
+    
+    for (uint64_t id = newest; id > oldest && entries.size() < count; --id) {
+        const Slot& slot = slots_[(id - 1) % capacity_];
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * id) {
+            continue;   // Still being written, dropped, or overwritten
+        }
+        
+        Entry entry;
+        entry.id = id - 1;
+        entry.timestamp_us = slot.timestamp_us.load(std::memory_order_relaxed);
+        entry.value_size = slot.value_size.load(std::memory_order_relaxed);
+        entry.queue_wait_us = slot.queue_wait_us.load(std::memory_order_relaxed);
+        entry.lock_wait_us = slot.lock_wait_us.load(std::memory_order_relaxed);
+        entry.execute_us = slot.execute_us.load(std::memory_order_relaxed);
+        entry.send_us = slot.send_us.load(std::memory_order_relaxed);
+        
+        uint64_t command = slot.command.load(std::memory_order_relaxed);
+        size_t command_length = std::min<size_t>(slot.command_length.load(std::memory_order_relaxed),
+                                                 sizeof(command));
+        entry.command.assign(reinterpret_cast<const char*>(&command), command_length);
+        
+        size_t key_length = std::min<size_t>(slot.key_length.load(std::memory_order_relaxed), kMaxKeyLength);
+        char key[kMaxKeyLength];
+        for (size_t word = 0; word * sizeof(uint64_t) < key_length; ++word) {
+            uint64_t bytes = slot.key[word].load(std::memory_order_relaxed);
+            std::memcpy(key + word * sizeof(uint64_t), &bytes, sizeof(bytes));
+        }
+        entry.key.assign(key, key_length);
+        
+        // A writer that lapped the ring may have changed the slot while it was copied
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
+        entries.push_back(std::move(entry));
+    }
+    return entries;
+}
+
+void SlowLog::reset() {
+    reset_id_.store(next_id_.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+void SlowLog::set_threshold_us(int64_t threshold_us) {
+    threshold_us_.store(threshold_us, std::memory_order_relaxed);
+}
+
+int64_t SlowLog::threshold_us() const {
+    return threshold_us_.load(std::memory_order_relaxed);
+}
+
+size_t SlowLog::capacity() const {
+    return capacity_;
+}
+
+size_t SlowLog::size() const {
+    uint64_t newest = next_id_.load(std::memory_order_acquire);
+    uint64_t oldest = reset_id_.load(std::memory_order_acquire);
+    return std::min<uint64_t>(newest - oldest, capacity_);
+}
+
+uint64_t SlowLog::logged() const {
+    return next_id_.load(std::memory_order_relaxed) - dropped_.load(std::memory_order_relaxed);
+}
+
+uint64_t SlowLog::dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+}
+
+} // namespace cache
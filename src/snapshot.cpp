@@ -0,0 +1,430 @@
+#include "snapshot.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace cache {
+
+namespace {
+
+constexpr char kMagic[8] = {'H', 'P', 'C', 'S', 'N', 'A', 'P', '1'};
+constexpr uint32_t kFormatVersion = 1;
+constexpr uint8_t kFlagInteger = 1;
+constexpr uint8_t kFlagCompressed = 2;
+
+constexpr size_t kHeaderSize = sizeof(kMagic) + 2 * sizeof(uint32_t);
+constexpr size_t kTableEntrySize = 3 * sizeof(uint64_t);
+constexpr size_t kRecordHeaderSize = 2 * sizeof(uint32_t) + 3 * sizeof(uint64_t) + sizeof(uint8_t);
+
+template<typename T>
+void append(std::string& buffer, T value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template<typename T>
+T read_at(const char* data) {
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+struct Section {
+    uint64_t offset;
+    uint64_t length;
+    uint64_t entry_count;
+};
+
+// Serializes one shard's entries, least recently used first. Ages are taken
+// against one reference time for the whole snapshot so they stay comparable
+// across shards; entries touched after the dump started get a negative age.
+std::string encode_section(const std::vector<Cache::CacheEntry>& entries,
+                           std::chrono::steady_clock::time_point reference) {
+    std::string buffer;
+    
+    for (const auto& entry : entries) {
+        uint32_t value_len = entry.is_integer ? sizeof(int64_t) : entry.value.size();
+        auto age = std::chrono::duration_cast<std::chrono::nanoseconds>(reference - entry.timestamp);
+        
+        append<uint32_t>(buffer, entry.key.size());
+        append<uint32_t>(buffer, value_len);
+        append<uint64_t>(buffer, entry.version);
+        append<int64_t>(buffer, 0); // Cache entries do not carry an expiry yet
+        append<int64_t>(buffer, age.count());
+        append<uint8_t>(buffer, (entry.is_integer ? kFlagInteger : 0) |
+                                (entry.is_compressed ? kFlagCompressed : 0));
+        buffer.append(entry.key);
+        if (entry.is_integer) {
+            append<int64_t>(buffer, entry.int_value);
+        } else {
+            buffer.append(entry.value);
+        }
+    }
+    
+    return buffer;
+}
+
+using ShardBuckets = std::vector<std::vector<Cache::CacheEntry>>;
+
+// Decodes one section into per-destination-shard buckets. Returns false if a
+// record runs past the section end.
+bool decode_section(const Cache& cache, const char* data, const Section& section,
+                    std::chrono::steady_clock::time_point now, ShardBuckets& buckets) {
+    const char* cursor = data + section.offset;
+    const char* end = cursor + section.length;
+    auto wall_now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    
+    for (uint64_t i = 0; i < section.entry_count; ++i) {
+        if (static_cast<size_t>(end - cursor) < kRecordHeaderSize) {
+            return false;
+        }
+        
+        uint32_t key_len = read_at<uint32_t>(cursor);
+        uint32_t value_len = read_at<uint32_t>(cursor + 4);
+        uint64_t version = read_at<uint64_t>(cursor + 8);
+        int64_t expires_at_ms = read_at<int64_t>(cursor + 16);
+        int64_t age_ns = read_at<int64_t>(cursor + 24);
+        uint8_t flags = read_at<uint8_t>(cursor + 32);
+        cursor += kRecordHeaderSize;
+        
+        if (static_cast<size_t>(end - cursor) < static_cast<size_t>(key_len) + value_len) {
+            return false;
+        }
+        
+        std::string key(cursor, key_len);
+        cursor += key_len;
+        const char* value = cursor;
+        cursor += value_len;
+        
+        // Skip entries that expired while the server was down
+        if (expires_at_ms != 0 && expires_at_ms <= wall_now) {
+            continue;
+        }
+        
+        Cache::CacheEntry entry;
+        if (flags & kFlagInteger) {
+            if (value_len != sizeof(int64_t)) {
+                return false;
+            }
+            entry = Cache::CacheEntry(key, read_at<int64_t>(value), version);
+        } else {
+            entry = Cache::CacheEntry(key, std::string(value, value_len), version);
+            entry.is_compressed = (flags & kFlagCompressed) != 0;
+        }
+        entry.timestamp = now - std::chrono::nanoseconds(age_ns);
+        
+        buckets[cache.shard_index(entry.key)].push_back(std::move(entry));
+    }
+    
+    return true;
+}
+
+// The write log's compactor and a SnapshotWriter may share a path. Saves to
+// it run one at a time, so they never share the temporary file and the last
+// rename is always of the snapshot started last.
+std::mutex& save_mutex(const std::string& path) {
+    static std::mutex registry_mutex;
+    static std::unordered_map<std::string, std::unique_ptr<std::mutex>> mutexes;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto& mutex = mutexes[path];
+    if (!mutex) {
+        mutex = std::make_unique<std::mutex>();
+    }
+    return *mutex;
+}
+
+// fsyncs a file, or a directory so that a rename in it is durable
+bool sync_path(const std::string& path, int flags) {
+    int fd = open(path.c_str(), flags);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+}
+
+std::string parent_directory(const std::string& path) {
+    size_t slash = path.rfind('/');
+    if (slash == std::string::npos) {
+        return ".";
+    }
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+} // namespace
+
+bool Snapshot::save(const Cache& cache, const std::string& path) {
+    std::lock_guard<std::mutex> save_lock(save_mutex(path));
+    std::string temp_path = path + ".tmp";
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to open snapshot file " << temp_path << std::endl;
+        return false;
+    }
+    
+    uint32_t section_count = cache.num_shards();
+    std::vector<Section> sections(section_count);
+    auto reference = std::chrono::steady_clock::now();
+    
+    // Reserve space for the header and section table, filled in at the end
+    std::string header(kHeaderSize + section_count * kTableEntrySize, '\0');
+    out.write(header.data(), header.size());
+    uint64_t offset = header.size();
+    
+    for (uint32_t i = 0; i < section_count; ++i) {
+        // Only shard i is locked, and only while its entries are copied
+        auto entries = cache.export_shard(i);
+        std::string buffer = encode_section(entries, reference);
+        out.write(buffer.data(), buffer.size());
+        
+        sections[i] = Section{offset, buffer.size(), entries.size()};
+        offset += buffer.size();
+    }
+    
+    header.clear();
+    header.append(kMagic, sizeof(kMagic));
+    append<uint32_t>(header, kFormatVersion);
+    append<uint32_t>(header, section_count);
+    for (const auto& section : sections) {
+        append<uint64_t>(header, section.offset);
+        append<uint64_t>(header, section.length);
+        append<uint64_t>(header, section.entry_count);
+    }
+    out.seekp(0);
+    out.write(header.data(), header.size());
+    out.close();
+    
+    // The data must be on disk before the rename makes it the snapshot
+    if (!out || !sync_path(temp_path, O_WRONLY)) {
+        std::cerr << "Failed to write snapshot file " << temp_path << std::endl;
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to rename snapshot to " << path << std::endl;
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    
+    // And the rename itself, before the caller relies on it (the write log
+    // deletes the log the snapshot replaces)
+    if (!sync_path(parent_directory(path), O_RDONLY | O_DIRECTORY)) {
+        std::cerr << "Failed to sync the directory of snapshot " << path << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
+std::optional<size_t> Snapshot::load(Cache& cache, const std::string& path, size_t num_threads) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open snapshot file " << path << std::endl;
+        return std::nullopt;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < kHeaderSize) {
+        std::cerr << "Snapshot file " << path << " is truncated" << std::endl;
+        close(fd);
+        return std::nullopt;
+    }
+    
+    size_t file_size = st.st_size;
+    void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map snapshot file " << path << std::endl;
+        return std::nullopt;
+    }
+    madvise(mapping, file_size, MADV_WILLNEED);
+    
+    const char* data = static_cast<const char*>(mapping);
+    std::optional<size_t> result;
+    
+    uint32_t format_version = read_at<uint32_t>(data + sizeof(kMagic));
+    uint32_t section_count = read_at<uint32_t>(data + sizeof(kMagic) + 4);
+    
+    // The section table must fit in the file before it is sized from it
+    bool valid = std::memcmp(data, kMagic, sizeof(kMagic)) == 0 &&
+                 format_version == kFormatVersion &&
+                 kHeaderSize + static_cast<uint64_t>(section_count) * kTableEntrySize <= file_size;
+    std::vector<Section> sections(valid ? section_count : 0);
+    
+    for (uint32_t i = 0; valid && i < section_count; ++i) {
+        const char* entry = data + kHeaderSize + i * kTableEntrySize;
+        sections[i] = Section{read_at<uint64_t>(entry), read_at<uint64_t>(entry + 8),
+                              read_at<uint64_t>(entry + 16)};
+        valid = sections[i].offset <= file_size &&
+                sections[i].length <= file_size - sections[i].offset;
+    }
+    
+    if (valid) {
+        size_t shard_count = cache.num_shards();
+        size_t thread_count = std::max<size_t>(1, std::min<size_t>(num_threads, 
+                                                std::max<size_t>(sections.size(), shard_count)));
+        std::vector<ShardBuckets> buckets(thread_count, ShardBuckets(shard_count));
+        std::atomic<size_t> next_section{0};
+        std::atomic<size_t> next_shard{0};
+        std::atomic<size_t> restored{0};
+        std::atomic<bool> corrupt{false};
+        auto now = std::chrono::steady_clock::now();
+        
+        auto run_parallel = [thread_count](const std::function<void(size_t)>& work) {
+            std::vector<std::thread> threads;
+            for (size_t t = 1; t < thread_count; ++t) {
+                threads.emplace_back(work, t);
+            }
+            work(0);
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        };
+        
+        // Phase 1: decode sections straight out of the mapping, routing each
+        // entry to the shard it will live in
+        run_parallel([&](size_t t) {
+            for (size_t i = next_section++; i < sections.size(); i = next_section++) {
+                if (!decode_section(cache, data, sections[i], now, buckets[t])) {
+                    corrupt = true;
+                }
+            }
+        });
+        
+        // Phase 2: each thread fills whole shards, oldest entries first, so
+        // restores never contend and recency survives a change in shard count
+        if (!corrupt) {
+            run_parallel([&](size_t) {
+                for (size_t shard = next_shard++; shard < shard_count; shard = next_shard++) {
+                    std::vector<Cache::CacheEntry> entries;
+                    for (auto& thread_buckets : buckets) {
+                        auto& bucket = thread_buckets[shard];
+                        std::move(bucket.begin(), bucket.end(), std::back_inserter(entries));
+                        ShardBuckets::value_type().swap(bucket);
+                    }
+                    std::stable_sort(entries.begin(), entries.end(),
+                        [](const Cache::CacheEntry& a, const Cache::CacheEntry& b) {
+                            return a.timestamp < b.timestamp;
+                        });
+                    
+                    size_t local_restored = 0;
+                    for (auto& entry : entries) {
+                        if (cache.restore(std::move(entry))) {
+                            local_restored++;
+                        }
+                    }
+                    restored += local_restored;
+                }
+            });
+        }
+        
+        valid = !corrupt;
+        result = restored.load();
+    }
+    
+    munmap(mapping, file_size);
+    
+    if (!valid) {
+        std::cerr << "Snapshot file " << path << " is corrupt" << std::endl;
+        return std::nullopt;
+    }
+    return result;
+}
+
+SnapshotWriter::SnapshotWriter(const Cache& cache, std::string path, std::chrono::seconds interval)
+    : cache_(cache), path_(std::move(path)), interval_(interval) {
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    stop();
+}
+
+void SnapshotWriter::start() {
+    if (worker_.joinable()) {
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_requested_ = false;
+    }
+    worker_ = std::thread([this] { run(); });
+}
+
+void SnapshotWriter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_requested_ = true;
+    }
+    condition_.notify_all();
+    
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+void SnapshotWriter::request() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        save_requested_ = true;
+    }
+    condition_.notify_all();
+}
+
+size_t SnapshotWriter::snapshots_written() const {
+    return snapshots_written_.load();
+}
+
+size_t SnapshotWriter::snapshot_failures() const {
+    return snapshot_failures_.load();
+}
+
+double SnapshotWriter::last_duration_ms() const {
+    return last_duration_ms_.load();
+}
+
+bool SnapshotWriter::in_progress() const {
+    return in_progress_.load();
+}
+
+void SnapshotWriter::run() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait_for(lock, interval_, [this] { return stop_requested_ || save_requested_; });
+            if (stop_requested_) {
+                return;
+            }
+            save_requested_ = false;
+        }
+        
+        in_progress_ = true;
+        auto start_time = std::chrono::steady_clock::now();
+        bool saved = Snapshot::save(cache_, path_);
+        auto end_time = std::chrono::steady_clock::now();
+        in_progress_ = false;
+        
+        last_duration_ms_ = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+        if (saved) {
+            snapshots_written_++;
+        } else {
+            snapshot_failures_++;
+        }
+    }
+}
+
+} // namespace cache
@@ -1,20 +1,67 @@
 #include "tcp_server.h"
 #include "protocol.h"
+#include "probes.h"
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <cstring>
 #include <iostream>
 #include <sstream>
 #include <chrono>
+#include <algorithm>
+#include <functional>
+#include <iomanip>
 
 namespace cache {
 
+namespace {
+
+// Capacities, relative to the configured one, reported from the miss ratio curve
+constexpr double kCapacityFactors[] = {0.25, 0.5, 1.0, 2.0, 4.0};
+
+// Queued invalidation bytes per connection before they collapse into one
+// INVALIDATE *, for a client whose socket is busy with a long reply
+constexpr size_t kMaxPendingPushes = 64 * 1024;
+
+// Commands whose key a SELECTed namespace applies to
+bool takes_key(Protocol::Command command) {
+    switch (command) {
+        case Protocol::Command::SET:
+        case Protocol::Command::GET:
+        case Protocol::Command::DELETE:
+        case Protocol::Command::INCR:
+        case Protocol::Command::DECR:
+        case Protocol::Command::GETS:
+        case Protocol::Command::CAS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// One distribution over every command's latency buckets
+RequestMetrics::CommandStats merge(const std::vector<RequestMetrics::CommandStats>& commands) {
+    RequestMetrics::CommandStats total;
+    for (const auto& command : commands) {
+        total.count += command.count;
+        total.total_us += command.total_us;
+        for (size_t i = 0; i < total.buckets.size(); ++i) {
+            total.buckets[i] += command.buckets[i];
+        }
+    }
+    return total;
+}
+
+} // namespace
+
 TCPServer::TCPServer(int port, size_t thread_pool_size)
     : port_(port), server_socket_(-1),
       thread_pool_(std::make_unique<ThreadPool>(thread_pool_size)),
       cache_(std::make_unique<Cache>()) {
+    cache_->attach_invalidation_tracker(&invalidation_tracker_);
+    namespace_metrics_.push_back(std::make_unique<RequestMetrics>());
 }
 
 TCPServer::~TCPServer() {
@@ -72,11 +119,16 @@ bool TCPServer::start() {
             continue;
         }
         
+        // Replies are small; don't let Nagle hold one back behind the previous reply's ACK
+        int nodelay = 1;
+        setsockopt(client_socket, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+        
         connections_handled_++;
         
         // Handle client in thread pool
-        thread_pool_->enqueue([this, client_socket]() {
-            handle_client(client_socket);
+        auto accepted_at = std::chrono::steady_clock::now();
+        thread_pool_->enqueue([this, client_socket, accepted_at]() {
+            handle_client(client_socket, accepted_at);
         });
     }
     
@@ -91,7 +143,36 @@ void TCPServer::stop() {
         server_socket_ = -1;
     }
     
+    if (snapshot_writer_) {
+        snapshot_writer_->stop();
+    }
+    if (compactor_) {
+        compactor_->stop();
+    }
+    if (reclaimer_) {
+        reclaimer_->stop();
+    }
+    if (memory_monitor_) {
+        memory_monitor_->stop();
+    }
+    if (replication_) {
+        replication_->stop();
+    }
+    if (replica_) {
+        replica_->stop();
+    }
+    if (metrics_server_) {
+        metrics_server_->stop();
+    }
+    
     thread_pool_->shutdown();
+    
+    if (write_log_) {
+        write_log_->close();
+    }
+    if (flash_tier_) {
+        flash_tier_->close();
+    }
     std::cout << "Cache server stopped" << std::endl;
 }
 
@@ -99,15 +180,70 @@ bool TCPServer::is_running() const {
     return running_.load();
 }
 
-void TCPServer::handle_client(int client_socket) {
+Cache& TCPServer::cache() {
+    return *cache_;
+}
+
+SlowLog& TCPServer::slow_log() {
+    return slow_log_;
+}
+
+void TCPServer::enable_snapshots(const std::string& path, std::chrono::seconds interval) {
+    snapshot_writer_ = std::make_unique<SnapshotWriter>(*cache_, path, interval);
+    snapshot_writer_->start();
+}
+
+void TCPServer::enable_compactor(const Compactor::Options& options) {
+    compactor_ = std::make_unique<Compactor>(*cache_, options);
+    compactor_->start();
+}
+
+void TCPServer::enable_reclaimer(const Reclaimer::Options& options) {
+    reclaimer_ = std::make_unique<Reclaimer>(*cache_, options);
+    cache_->attach_reclaimer(reclaimer_.get());
+    reclaimer_->start();
+}
+
+void TCPServer::enable_memory_monitor(const MemoryMonitor::Options& options) {
+    memory_monitor_ = std::make_unique<MemoryMonitor>(*cache_, options, cache_->capacity());
+    memory_monitor_->start();
+}
+
+bool TCPServer::enable_write_log(const WriteLog::Options& options) {
+    write_log_ = std::make_unique<WriteLog>(*cache_, options);
+    if (!write_log_->open()) {
+        write_log_.reset();
+        return false;
+    }
+    cache_->attach_write_log(write_log_.get());
+    return true;
+}
+
+bool TCPServer::enable_flash_tier(const FlashTier::Options& options) {
+    flash_tier_ = std::make_unique<FlashTier>(options);
+    if (!flash_tier_->open()) {
+        flash_tier_.reset();
+        return false;
+    }
+    cache_->attach_flash_tier(flash_tier_.get());
+    return true;
+}
+
+void TCPServer::handle_client(int client_socket, std::chrono::steady_clock::time_point accepted_at) {
     char buffer[4096];
     std::string request_buffer;
+    Connection connection(client_socket);
+    active_connections_++;
+    
+    // Time spent waiting for a worker is charged to the first request
+    auto pool_wait = std::chrono::steady_clock::now() - accepted_at;
     
     while (running_) {
         ssize_t bytes_received = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
         if (bytes_received <= 0) {
             break;
         }
+        auto received_at = std::chrono::steady_clock::now();
         
         buffer[bytes_received] = '\0';
         request_buffer += std::string(buffer);
@@ -123,44 +259,105 @@ void TCPServer::handle_client(int client_socket) {
                 continue;
             }
             
-            auto start_time = std::chrono::high_resolution_clock::now();
-            std::string response = process_request(request);
-            auto end_time = std::chrono::high_resolution_clock::now();
+            auto start_time = std::chrono::steady_clock::now();
+            uint64_t lock_wait_ns = Cache::lock_wait_ns();
+            Protocol::Request req;
+            std::string response = process_request(request, req, connection);
+            if (connection.replica) {
+                replication_->serve(client_socket, req.key,
+                                    req.key.empty() ? std::nullopt : std::optional<uint64_t>(req.version));
+                break;
+            }
+            auto executed_at = std::chrono::steady_clock::now();
+            send_response(connection, response);
+            auto sent_at = std::chrono::steady_clock::now();
             
-            auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
-            double current_total = total_response_time_.load();
-            while (!total_response_time_.compare_exchange_weak(current_total, current_total + duration.count())) {
-                // Retry on failure
+            auto command = req.valid ? req.command : Protocol::Command::UNKNOWN;
+            auto execute_us = std::chrono::duration_cast<std::chrono::microseconds>(executed_at - start_time).count();
+            auto send_us = std::chrono::duration_cast<std::chrono::microseconds>(sent_at - executed_at).count();
+            request_metrics_.record(command, execute_us);
+            if (req.valid && takes_key(command)) {
+                namespace_metrics_[cache_->namespace_of(req.key)]->record(command, execute_us);
             }
-            requests_processed_++;
+            CACHE_PROBE3(lookup, static_cast<int>(command), req.key.c_str(), execute_us);
+            CACHE_PROBE3(send, static_cast<int>(command), response.size() + 1, send_us);
+            
+            auto queue_wait_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                start_time - received_at + pool_wait).count();
+            pool_wait = std::chrono::steady_clock::duration::zero();
             
-            send_response(client_socket, response);
+            if (slow_log_.should_log(queue_wait_us + execute_us + send_us)) {
+                SlowLog::Entry entry;
+                entry.command = Protocol::command_name(command);
+                entry.key = req.key;
+                // Reads report the size of the value returned
+                entry.value_size = !req.value.empty() ? req.value.size()
+                    : response.rfind("OK ", 0) == 0 ? response.size() - 3 : 0;
+                entry.queue_wait_us = queue_wait_us;
+                entry.lock_wait_us = (Cache::lock_wait_ns() - lock_wait_ns) / 1000;
+                entry.execute_us = execute_us;
+                entry.send_us = send_us;
+                slow_log_.record(entry);
+            }
+        }
+        if (connection.replica) {
+            break;
         }
     }
     
+    // Stops pushes before the descriptor can be reused
+    if (connection.tracking_id != 0) {
+        invalidation_tracker_.remove_client(connection.tracking_id);
+    }
     close(client_socket);
+    active_connections_--;
 }
 
-std::string TCPServer::process_request(const std::string& request) {
-    return parse_and_execute(request);
-}
-
-std::string TCPServer::parse_and_execute(const std::string& command) {
-    auto req = Protocol::parse_request(command);
-    
+std::string TCPServer::process_request(const std::string& request, Protocol::Request& req,
+                                       Connection& connection) {
+    req = Protocol::parse_request(request);
+    CACHE_PROBE3(parse, static_cast<int>(req.command), req.key.c_str(), request.size());
     if (!req.valid) {
         return Protocol::format_error("Invalid command");
     }
+    // SELECT scopes the connection's keys to a namespace
+    if (!connection.key_prefix.empty() && takes_key(req.command)) {
+        req.key.insert(0, connection.key_prefix);
+    }
+    return execute(req, connection);
+}
+
+std::string TCPServer::execute(const Protocol::Request& req, Connection& connection) {
+    // Replicas only change through the replication stream
+    if (replica_) {
+        switch (req.command) {
+            case Protocol::Command::SET:
+            case Protocol::Command::DELETE:
+            case Protocol::Command::INCR:
+            case Protocol::Command::DECR:
+            case Protocol::Command::CAS:
+            case Protocol::Command::CLEAR:
+                return Protocol::format_error("READONLY replica of " + replica_->primary());
+            default:
+                break;
+        }
+    }
     
     switch (req.command) {
         case Protocol::Command::SET:
             if (cache_->set(req.key, req.value)) {
                 return Protocol::format_success();
+            } else if (write_log_failed()) {
+                return Protocol::format_error("WAL_FAILED");
             } else {
                 return Protocol::format_error("Failed to set value");
             }
             
         case Protocol::Command::GET: {
+            // Subscribe before reading, so a write racing the read is pushed
+            if (connection.tracking_id != 0) {
+                invalidation_tracker_.track(connection.tracking_id, req.key);
+            }
             std::string value = cache_->get(req.key);
             if (value.empty()) {
                 return Protocol::format_error("NOT_FOUND");
@@ -171,50 +368,732 @@ std::string TCPServer::parse_and_execute(const std::string& command) {
         
         case Protocol::Command::DELETE:
             if (cache_->remove(req.key)) {
-                return Protocol::format_success();
+                return write_log_failed() ? Protocol::format_error("WAL_FAILED") : Protocol::format_success();
             } else {
                 return Protocol::format_error("NOT_FOUND");
             }
             
+        case Protocol::Command::INCR:
+        case Protocol::Command::DECR: {
+            auto result = req.command == Protocol::Command::INCR
+                ? cache_->incr(req.key, req.delta)
+                : cache_->decr(req.key, req.delta);
+            if (!result) {
+                return Protocol::format_error(write_log_failed() ? "WAL_FAILED" : "NOT_AN_INTEGER");
+            }
+            return Protocol::format_success(std::to_string(*result));
+        }
+        
+        case Protocol::Command::GETS: {
+            if (connection.tracking_id != 0) {
+                invalidation_tracker_.track(connection.tracking_id, req.key);
+            }
+            auto result = cache_->get_versioned(req.key);
+            if (!result) {
+                return Protocol::format_error("NOT_FOUND");
+            }
+            // Version first so values containing spaces stay unambiguous
+            return Protocol::format_success(std::to_string(result->version) + " " + result->value);
+        }
+        
+        case Protocol::Command::CAS:
+            switch (cache_->cas(req.key, req.value, req.version)) {
+                case Cache::CasResult::STORED:
+                    return Protocol::format_success();
+                case Cache::CasResult::EXISTS:
+                    return Protocol::format_error("EXISTS");
+                case Cache::CasResult::NOT_FOUND:
+                    return Protocol::format_error("NOT_FOUND");
+                default:
+                    return Protocol::format_error(write_log_failed() ? "WAL_FAILED" : "Failed to set value");
+            }
+            
         case Protocol::Command::CLEAR:
             cache_->clear();
-            return Protocol::format_success();
+            return write_log_failed() ? Protocol::format_error("WAL_FAILED") : Protocol::format_success();
+            
+        case Protocol::Command::STATS:
+            return stats(req.key);
             
-        case Protocol::Command::STATS: {
-            std::ostringstream stats;
-            stats << "size=" << cache_->size()
-                  << " hits=" << cache_->hits()
-                  << " misses=" << cache_->misses()
-                  << " hit_ratio=" << cache_->hit_ratio()
-                  << " memory_usage=" << cache_->memory_usage()
-                  << " connections=" << connections_handled_
-                  << " requests=" << requests_processed_
-                  << " avg_response_time=" << average_response_time() << "μs";
-            return Protocol::format_success(stats.str());
+        case Protocol::Command::SLOWLOG:
+            return slowlog(req);
+            
+        case Protocol::Command::HOTKEYS:
+        case Protocol::Command::BIGKEYS: {
+            // Highest first, entries separated by "; "
+            bool hot = req.command == Protocol::Command::HOTKEYS;
+            auto keys = hot ? cache_->hot_keys(req.delta) : cache_->big_keys(req.delta);
+            std::ostringstream out;
+            for (const auto& entry : keys) {
+                out << (out.tellp() > 0 ? "; " : "")
+                    << "key=" << entry.key << (hot ? " accesses=" : " bytes=") << entry.count;
+            }
+            return Protocol::format_success(out.str());
         }
         
+        case Protocol::Command::TRACKING:
+            return tracking(req, connection);
+            
+        case Protocol::Command::SELECT:
+            return select(req, connection);
+            
+        case Protocol::Command::SYNC:
+            if (!replication_ || replica_) {
+                return Protocol::format_error("Replication not enabled");
+            }
+            // handle_client hands the connection to the primary, which replies
+            connection.replica = true;
+            return std::string();
+            
+        case Protocol::Command::BGSAVE:
+            if (!snapshot_writer_) {
+                return Protocol::format_error("Snapshots not enabled");
+            }
+            snapshot_writer_->request();
+            return Protocol::format_success("Background saving started");
+        
         default:
             return Protocol::format_error("Unknown command");
     }
 }
 
-void TCPServer::send_response(int client_socket, const std::string& response) {
+std::string TCPServer::tracking(const Protocol::Request& req, Connection& connection) {
+    if (req.key == "ON" && connection.tracking_id == 0) {
+        connection.tracking_id = invalidation_tracker_.add_client([&connection](const std::string& message) {
+            push(connection, message);
+        });
+    } else if (req.key == "OFF" && connection.tracking_id != 0) {
+        invalidation_tracker_.remove_client(connection.tracking_id);
+        connection.tracking_id = 0;
+    }
+    return Protocol::format_success();
+}
+
+std::string TCPServer::select(const Protocol::Request& req, Connection& connection) {
+    if (req.key == Cache::kDefaultNamespace) {
+        connection.key_prefix.clear();
+        return Protocol::format_success();
+    }
+    std::string prefix = req.key + Cache::kNamespaceSeparator;
+    if (cache_->namespace_of(prefix) == 0) {
+        return Protocol::format_error("Unknown namespace " + req.key);
+    }
+    connection.key_prefix = prefix;
+    return Protocol::format_success();
+}
+
+void TCPServer::send_response(Connection& connection, const std::string& response) {
     std::string full_response = response + "\n";
-    send(client_socket, full_response.c_str(), full_response.length(), 0);
+    {
+        std::lock_guard<Mutex> lock(connection.send_mutex);
+        send(connection.socket, full_response.c_str(), full_response.length(), 0);
+    }
+    // Pushes queued while the reply was being sent
+    flush_pushes(connection);
+}
+
+void TCPServer::push(Connection& connection, const std::string& message) {
+    {
+        std::lock_guard<Mutex> lock(connection.push_mutex);
+        if (connection.pushes_overflowed) {
+            // The queued INVALIDATE * already covers this key
+            return;
+        }
+        if (connection.pending_pushes.size() + message.size() + 1 > kMaxPendingPushes) {
+            connection.pending_pushes = "INVALIDATE *\n";
+            connection.pushes_overflowed = true;
+        } else {
+            connection.pending_pushes += message;
+            connection.pending_pushes += '\n';
+        }
+    }
+    flush_pushes(connection);
+}
+
+void TCPServer::flush_pushes(Connection& connection) {
+    while (true) {
+        {
+            // If a reply or another flush holds the socket, its owner checks
+            // the queue again after unlocking; the pusher never waits
+            std::unique_lock<Mutex> send_lock(connection.send_mutex, std::try_to_lock);
+            if (!send_lock.owns_lock()) {
+                return;
+            }
+            std::string lines;
+            {
+                std::lock_guard<Mutex> lock(connection.push_mutex);
+                lines.swap(connection.pending_pushes);
+                connection.pushes_overflowed = false;
+            }
+            ssize_t sent = lines.empty()
+                ? 0 : send(connection.socket, lines.c_str(), lines.length(), MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (sent != static_cast<ssize_t>(lines.length())) {
+                // Dropping a push would leave the client serving a stale value,
+                // and the socket may hold part of a line. Disconnecting makes
+                // the client drop its whole near cache instead.
+                shutdown(connection.socket, SHUT_RDWR);
+            }
+        }
+        
+        std::lock_guard<Mutex> lock(connection.push_mutex);
+        if (connection.pending_pushes.empty()) {
+            return;
+        }
+    }
+}
+
+std::string TCPServer::namespace_stats() const {
+    // Per namespace, e.g. default_memory_usage=... teamA_hits=... teamA_p99_us=...
+    std::ostringstream stats;
+    auto namespaces = cache_->namespace_stats();
+    for (size_t ns = 0; ns < namespaces.size(); ++ns) {
+        const auto& space = namespaces[ns];
+        auto latency = merge(namespace_metrics_[ns]->snapshot());
+        size_t lookups = space.hits + space.misses;
+        const std::string& prefix = space.name;
+        stats << (ns ? " " : "")
+              << prefix << "_quota=" << space.quota
+              << " " << prefix << "_memory_usage=" << space.memory_usage
+              << " " << prefix << "_items=" << space.items
+              << " " << prefix << "_hits=" << space.hits
+              << " " << prefix << "_misses=" << space.misses
+              << " " << prefix << "_hit_ratio=" << (lookups ? static_cast<double>(space.hits) / lookups : 0.0)
+              << " " << prefix << "_evictions=" << space.evictions
+              << " " << prefix << "_requests=" << latency.count
+              << " " << prefix << "_avg_us=" << latency.mean_us()
+              << " " << prefix << "_p99_us=" << latency.percentile_us(99.0);
+    }
+    return stats.str();
+}
+
+std::string TCPServer::slab_stats() const {
+    // Totals, then each size class in use, e.g. chunk96_pages=... chunk96_evictions=...
+    std::ostringstream stats;
+    stats << "fragmentation_ratio=" << cache_->fragmentation_ratio()
+          << " pages_compacted=" << cache_->pages_compacted()
+          << " pages_rebalanced=" << cache_->pages_rebalanced()
+          << " items_relocated=" << cache_->items_relocated();
+    if (compactor_) {
+        stats << " compactor_passes=" << compactor_->passes()
+              << " compactor_pages_freed=" << compactor_->pages_freed()
+              << " last_compaction_ms=" << compactor_->last_duration_ms();
+    }
+    for (const auto& slab : cache_->slab_stats()) {
+        if (slab.pages == 0 && slab.evictions == 0) {
+            continue;
+        }
+        std::string prefix = "chunk" + std::to_string(slab.chunk_size);
+        stats << " " << prefix << "_pages=" << slab.pages
+              << " " << prefix << "_used_chunks=" << slab.used_chunks
+              << " " << prefix << "_free_chunks=" << slab.free_chunks
+              << " " << prefix << "_evictions=" << slab.evictions
+              << " " << prefix << "_pages_compacted=" << slab.pages_compacted;
+    }
+    return stats.str();
+}
+
+std::string TCPServer::memory_stats() const {
+    std::ostringstream stats;
+    stats << "capacity=" << cache_->capacity()
+          << " memory_usage=" << cache_->memory_usage()
+          << " memory_mapped=" << cache_->mapped_memory();
+    if (!memory_monitor_) {
+        stats << " rss=" << MemoryMonitor::resident_bytes() << " monitor=off";
+        return stats.str();
+    }
+    // Readings from the monitor's last check; "none" without cgroup v2 files
+    auto limit = memory_monitor_->limit();
+    auto pressure = memory_monitor_->pressure();
+    stats << " rss=" << memory_monitor_->rss()
+          << " capacity_ceiling=" << memory_monitor_->ceiling()
+          << " cgroup_limit=" << (limit ? std::to_string(*limit) : "none")
+          << " pressure_avg10=" << (pressure ? std::to_string(*pressure) : "none")
+          << " capacity_shrinks=" << memory_monitor_->shrinks()
+          << " capacity_grows=" << memory_monitor_->grows();
+    return stats.str();
+}
+
+std::string TCPServer::replication_stats() const {
+    std::ostringstream stats;
+    if (replica_) {
+        // Lag is against the primary's offset as of its last record or ping
+        stats << "role=replica"
+              << " primary=" << replica_->primary()
+              << " link=" << (replica_->link_up() ? "up" : "down")
+              << " repl_offset=" << replica_->offset()
+              << " primary_offset=" << replica_->primary_offset()
+              << " lag_bytes=" << replica_->primary_offset() - replica_->offset()
+              << " last_io_ms=" << replica_->last_io_ms()
+              << " full_syncs=" << replica_->full_syncs()
+              << " partial_syncs=" << replica_->partial_syncs();
+    } else if (replication_) {
+        auto replicas = replication_->replicas();
+        uint64_t offset = replication_->offset();
+        stats << "role=primary"
+              << " repl_id=" << replication_->id()
+              << " repl_offset=" << offset
+              << " backlog_start=" << replication_->backlog_start()
+              << " full_syncs=" << replication_->full_syncs()
+              << " partial_syncs=" << replication_->partial_syncs()
+              << " connected_replicas=" << replicas.size();
+        for (size_t i = 0; i < replicas.size(); ++i) {
+            std::string prefix = " replica" + std::to_string(i);
+            stats << prefix << "_addr=" << replicas[i].address
+                  << prefix << "_state=" << (replicas[i].loading ? "sync" : "online")
+                  << prefix << "_acked_offset=" << replicas[i].acked_offset
+                  << prefix << "_lag_bytes=" << offset - std::min(offset, replicas[i].acked_offset);
+        }
+    } else {
+        stats << "role=primary replication=off";
+    }
+    return stats.str();
 }
 
 size_t TCPServer::connections_handled() const {
     return connections_handled_.load();
 }
 
+size_t TCPServer::active_connections() const {
+    return active_connections_.load();
+}
+
 size_t TCPServer::requests_processed() const {
-    return requests_processed_.load();
+    return request_metrics_.total_requests();
 }
 
 double TCPServer::average_response_time() const {
-    size_t requests = requests_processed_.load();
+    uint64_t requests = 0;
+    uint64_t total_us = 0;
+    for (const auto& command : request_metrics_.snapshot()) {
+        requests += command.count;
+        total_us += command.total_us;
+    }
     if (requests == 0) return 0.0;
-    return total_response_time_.load() / requests;
+    return static_cast<double>(total_us) / requests;
+}
+
+const RequestMetrics& TCPServer::request_metrics() const {
+    return request_metrics_;
+}
+
+std::string TCPServer::stats(const std::string& section) const {
+    std::string name = section;
+    std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+    std::ostringstream stats;
+    
+    if (name.empty()) {
+        stats << "size=" << cache_->size()
+              << " hits=" << cache_->hits()
+              << " ram_hits=" << cache_->ram_hits()
+              << " flash_hits=" << cache_->flash_hits()
+              << " misses=" << cache_->misses()
+              << " evictions=" << cache_->evictions()
+              << " hit_ratio=" << cache_->hit_ratio()
+              << " memory_usage=" << cache_->memory_usage()
+              << " connections=" << connections_handled_
+              << " requests=" << requests_processed()
+              << " avg_response_time=" << average_response_time() << "μs";
+        if (cache_->compression_threshold() > 0) {
+            stats << " compressed_values=" << cache_->compressed_values()
+                  << " compression_ratio=" << cache_->compression_ratio()
+                  << " compress_time_us=" << cache_->compress_time_us()
+                  << " decompress_time_us=" << cache_->decompress_time_us();
+        }
+        if (snapshot_writer_) {
+            stats << " snapshots=" << snapshot_writer_->snapshots_written()
+                  << " snapshot_failures=" << snapshot_writer_->snapshot_failures()
+                  << " last_snapshot_ms=" << snapshot_writer_->last_duration_ms();
+        }
+        if (flash_tier_) {
+            stats << " flash_items=" << flash_tier_->size()
+                  << " flash_bytes_written=" << flash_tier_->bytes_written()
+                  << " flash_reads=" << flash_tier_->reads()
+                  << " flash_dropped=" << flash_tier_->dropped();
+        }
+        if (write_log_) {
+            stats << " wal_records=" << write_log_->records_appended()
+                  << " wal_bytes=" << write_log_->bytes_written()
+                  << " wal_fsyncs=" << write_log_->fsyncs()
+                  << " wal_compactions=" << write_log_->compactions()
+                  << " wal_errors=" << write_log_->write_errors();
+        }
+    } else if (name == "LATENCY") {
+        // Commands that have been seen, e.g. get_count=10 get_p99_us=23 ...
+        auto commands = request_metrics_.snapshot();
+        for (size_t i = 0; i < commands.size(); ++i) {
+            const auto& command = commands[i];
+            if (command.count == 0) {
+                continue;
+            }
+            std::string prefix = Protocol::command_name(static_cast<Protocol::Command>(i));
+            stats << (stats.tellp() > 0 ? " " : "")
+                  << prefix << "_count=" << command.count
+                  << " " << prefix << "_avg_us=" << command.mean_us()
+                  << " " << prefix << "_p50_us=" << command.percentile_us(50.0)
+                  << " " << prefix << "_p99_us=" << command.percentile_us(99.0)
+                  << " " << prefix << "_p999_us=" << command.percentile_us(99.9)
+                  << " " << prefix << "_max_us=" << command.max_us();
+        }
+    } else if (name == "COMMANDS") {
+        auto commands = request_metrics_.snapshot();
+        for (size_t i = 0; i < commands.size(); ++i) {
+            stats << (i ? " " : "") << Protocol::command_name(static_cast<Protocol::Command>(i))
+                  << "=" << commands[i].count;
+        }
+    } else if (name == "CACHE") {
+        stats << "size=" << cache_->size()
+              << " capacity=" << cache_->capacity()
+              << " memory_usage=" << cache_->memory_usage()
+              << " memory_reserved=" << cache_->reserved_memory()
+              << " memory_mapped=" << cache_->mapped_memory()
+              << " hits=" << cache_->hits()
+              << " misses=" << cache_->misses()
+              << " evictions=" << cache_->evictions()
+              << " evictions_background=" << cache_->background_evictions()
+              << " evictions_inline=" << cache_->inline_evictions()
+              << " inline_eviction_time_us=" << cache_->inline_eviction_time_us()
+              << " hit_ratio=" << cache_->hit_ratio()
+              << " key_samples=" << cache_->key_samples();
+        if (reclaimer_) {
+            stats << " reclaim_passes=" << reclaimer_->passes()
+                  << " reclaim_time_us=" << reclaimer_->time_us()
+                  << " last_reclaim_ms=" << reclaimer_->last_duration_ms();
+        }
+    } else if (name == "SERVER") {
+        stats << "connections=" << connections_handled_
+              << " active_connections=" << active_connections_
+              << " worker_threads=" << thread_pool_->size()
+              << " queued_connections=" << thread_pool_->queue_size()
+              << " requests=" << requests_processed()
+              << " avg_response_time_us=" << average_response_time()
+              << " slowlog_len=" << slow_log_.size()
+              << " slowlog_dropped=" << slow_log_.dropped()
+              << " tracking_clients=" << invalidation_tracker_.clients()
+              << " tracked_keys=" << invalidation_tracker_.tracked_keys()
+              << " invalidations_sent=" << invalidation_tracker_.invalidations_sent();
+    } else if (name == "REPLICATION") {
+        return Protocol::format_success(replication_stats());
+    } else if (name == "NAMESPACES") {
+        return Protocol::format_success(namespace_stats());
+    } else if (name == "SLABS") {
+        return Protocol::format_success(slab_stats());
+    } else if (name == "MEMORY") {
+        return Protocol::format_success(memory_stats());
+    } else if (name == "MRC") {
+        // Predicted LRU hit ratio from 0.25x to 4x the configured capacity
+        const auto& curve = cache_->miss_ratio_curve();
+        stats << "sample_rate=" << curve.sample_rate()
+              << " sampled_keys=" << curve.tracked_keys()
+              << " sampled_accesses=" << curve.sampled_accesses();
+        for (double factor : kCapacityFactors) {
+            uint64_t capacity = static_cast<uint64_t>(factor * cache_->capacity());
+            stats << " capacity_" << factor << "x=" << capacity
+                  << " hit_ratio_" << factor << "x=" << curve.hit_ratio(capacity);
+        }
+    } else if (name == "LOCKS") {
+        // Per lock name, summed over instances; only in CACHE_LOCK_STATS builds
+        auto queue_wait = thread_pool_->queue_wait();
+        stats << "lock_stats=" << (LockRegistry::enabled() ? "on" : "off")
+              << " thread_pool_queue_wait_count=" << queue_wait.count
+              << " thread_pool_queue_wait_avg_ns=" << queue_wait.mean_ns()
+              << " thread_pool_queue_wait_p99_ns=" << queue_wait.percentile_ns(99.0)
+              << " thread_pool_queue_wait_max_ns=" << queue_wait.percentile_ns(100.0);
+        for (const auto& lock : LockRegistry::instance().snapshot()) {
+            const std::string& prefix = lock.name;
+            stats << " " << prefix << "_instances=" << lock.instances
+                  << " " << prefix << "_acquisitions=" << lock.acquisitions
+                  << " " << prefix << "_contended=" << lock.contended
+                  << " " << prefix << "_wait_total_ns=" << lock.wait.total_ns
+                  << " " << prefix << "_wait_p50_ns=" << lock.wait.percentile_ns(50.0)
+                  << " " << prefix << "_wait_p99_ns=" << lock.wait.percentile_ns(99.0)
+                  << " " << prefix << "_hold_avg_ns=" << lock.hold.mean_ns()
+                  << " " << prefix << "_hold_p99_ns=" << lock.hold.percentile_ns(99.0);
+        }
+    } else {
+        return Protocol::format_error(
+            "Unknown STATS section (try LATENCY, COMMANDS, CACHE, SERVER, MRC, LOCKS, REPLICATION, NAMESPACES, SLABS, MEMORY)");
+    }
+    
+    return Protocol::format_success(stats.str());
+}
+
+std::string TCPServer::slowlog(const Protocol::Request& req) {
+    std::string subcommand = req.key;
+    std::transform(subcommand.begin(), subcommand.end(), subcommand.begin(), ::toupper);
+    
+    if (subcommand == "LEN") {
+        return Protocol::format_success(std::to_string(slow_log_.size()));
+    }
+    if (subcommand == "RESET") {
+        slow_log_.reset();
+        return Protocol::format_success();
+    }
+    if (subcommand != "GET") {
+        return Protocol::format_error("Unknown SLOWLOG subcommand (try GET, LEN, RESET)");
+    }
+    
+    // Newest first, entries separated by "; "
+    std::ostringstream out;
+    for (const auto& entry : slow_log_.get(req.delta)) {
+        out << (out.tellp() > 0 ? "; " : "")
+            << "id=" << entry.id
+            << " time_us=" << entry.timestamp_us
+            << " command=" << entry.command
+            << " key=" << entry.key
+            << " value_size=" << entry.value_size
+            << " total_us=" << entry.total_us()
+            << " queue_us=" << entry.queue_wait_us
+            << " lock_us=" << entry.lock_wait_us
+            << " execute_us=" << entry.execute_us
+            << " send_us=" << entry.send_us;
+    }
+    return Protocol::format_success(out.str());
+}
+
+InvalidationTracker& TCPServer::invalidation_tracker() {
+    return invalidation_tracker_;
+}
+
+void TCPServer::enable_replication(const ReplicationPrimary::Options& options) {
+    replication_ = std::make_unique<ReplicationPrimary>(*cache_, options);
+    cache_->attach_replication(replication_.get());
+}
+
+void TCPServer::enable_replica(const ReplicaLink::Options& options) {
+    replica_ = std::make_unique<ReplicaLink>(*cache_, options);
+    replica_->start();
+}
+
+bool TCPServer::add_namespace(const std::string& name, size_t quota) {
+    if (!cache_->add_namespace(name, quota)) {
+        return false;
+    }
+    namespace_metrics_.push_back(std::make_unique<RequestMetrics>());
+    return true;
+}
+
+bool TCPServer::enable_metrics_endpoint(int port) {
+    metrics_server_ = std::make_unique<MetricsHttpServer>(port, [this] { return prometheus_metrics(); });
+    if (!metrics_server_->start()) {
+        metrics_server_.reset();
+        return false;
+    }
+    return true;
+}
+
+std::string TCPServer::prometheus_metrics() const {
+    // Bucket bounds in seconds for the request duration histograms
+    static const double kBounds[] = {0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005, 0.001,
+                                     0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0};
+    std::ostringstream out;
+    out << std::setprecision(15);
+    
+    auto gauge = [&out](const char* name, const char* help, const char* type, double value) {
+        out << "# HELP " << name << " " << help << "\n"
+            << "# TYPE " << name << " " << type << "\n"
+            << name << " " << value << "\n";
+    };
+    
+    auto commands = request_metrics_.snapshot();
+    out << "# HELP hpcache_requests_total Requests processed, by command.\n"
+        << "# TYPE hpcache_requests_total counter\n";
+    for (size_t i = 0; i < commands.size(); ++i) {
+        out << "hpcache_requests_total{command=\"" << Protocol::command_name(static_cast<Protocol::Command>(i))
+            << "\"} " << commands[i].count << "\n";
+    }
+
+    out << "# HELP hpcache_request_duration_seconds Time to parse and execute a request, by command.\n"
+        << "# TYPE hpcache_request_duration_seconds histogram\n";
+    for (size_t i = 0; i < commands.size(); ++i) {
+        const auto& command = commands[i];
+        if (command.count == 0) {
+            continue;
+        }
+        std::string label = std::string("command=\"") + Protocol::command_name(static_cast<Protocol::Command>(i)) + "\"";
+        for (double bound : kBounds) {
+            uint64_t limit_us = static_cast<uint64_t>(bound * 1e6 + 0.5);
+            out << "hpcache_request_duration_seconds_bucket{" << label << ",le=\"" << bound << "\"} "
+                << command.count_at_or_below(limit_us) << "\n";
+        }
+        out << "hpcache_request_duration_seconds_bucket{" << label << ",le=\"+Inf\"} " << command.count << "\n"
+            << "hpcache_request_duration_seconds_sum{" << label << "} " << command.total_us / 1e6 << "\n"
+            << "hpcache_request_duration_seconds_count{" << label << "} " << command.count << "\n";
+    }
+
+    gauge("hpcache_cache_hits_total", "Lookups that found the key.", "counter", cache_->hits());
+    gauge("hpcache_cache_misses_total", "Lookups that did not find the key.", "counter", cache_->misses());
+    gauge("hpcache_cache_evictions_total", "Entries evicted to stay under capacity.", "counter", cache_->evictions());
+    gauge("hpcache_cache_items", "Entries in memory.", "gauge", cache_->size());
+    gauge("hpcache_evictions_background_total", "Entries evicted ahead of demand by the reclaimer.", "counter",
+          cache_->background_evictions());
+    gauge("hpcache_evictions_inline_total", "Entries evicted by writes making room for themselves.", "counter",
+          cache_->inline_evictions());
+    gauge("hpcache_eviction_inline_seconds_total", "Time writes spent evicting.", "counter",
+          cache_->inline_eviction_time_us() / 1e6);
+    if (reclaimer_) {
+        gauge("hpcache_reclaim_passes_total", "Reclaimer passes over the shards.", "counter", reclaimer_->passes());
+        gauge("hpcache_reclaim_seconds_total", "Time the reclaimer spent in passes.", "counter",
+              reclaimer_->time_us() / 1e6);
+    }
+    
+    auto namespaces = cache_->namespace_stats();
+    auto family = [&out, &namespaces](const char* name, const char* help, const char* type,
+                                      const std::function<double(const Cache::NamespaceStats&)>& value) {
+        out << "# HELP " << name << " " << help << "\n"
+            << "# TYPE " << name << " " << type << "\n";
+        for (const auto& space : namespaces) {
+            out << name << "{namespace=\"" << space.name << "\"} " << value(space) << "\n";
+        }
+    };
+    family("hpcache_namespace_quota_bytes", "Memory quota, by namespace.", "gauge",
+           [](const Cache::NamespaceStats& space) { return space.quota; });
+    family("hpcache_namespace_memory_bytes", "Memory used, by namespace.", "gauge",
+           [](const Cache::NamespaceStats& space) { return space.memory_usage; });
+    family("hpcache_namespace_items", "Entries in memory, by namespace.", "gauge",
+           [](const Cache::NamespaceStats& space) { return space.items; });
+    family("hpcache_namespace_hits_total", "Lookups that found the key, by namespace.", "counter",
+           [](const Cache::NamespaceStats& space) { return space.hits; });
+    family("hpcache_namespace_misses_total", "Lookups that did not find the key, by namespace.", "counter",
+           [](const Cache::NamespaceStats& space) { return space.misses; });
+    family("hpcache_namespace_evictions_total", "Entries evicted to stay under quota, by namespace.", "counter",
+           [](const Cache::NamespaceStats& space) { return space.evictions; });
+    out << "# HELP hpcache_namespace_request_duration_seconds Time to parse and execute keyed requests, by namespace.\n"
+        << "# TYPE hpcache_namespace_request_duration_seconds summary\n";
+    for (size_t ns = 0; ns < namespaces.size(); ++ns) {
+        auto latency = merge(namespace_metrics_[ns]->snapshot());
+        out << "hpcache_namespace_request_duration_seconds_sum{namespace=\"" << namespaces[ns].name << "\"} "
+            << latency.total_us / 1e6 << "\n"
+            << "hpcache_namespace_request_duration_seconds_count{namespace=\"" << namespaces[ns].name << "\"} "
+            << latency.count << "\n";
+    }
+    gauge("hpcache_cache_memory_bytes", "Bytes charged against capacity.", "gauge", cache_->memory_usage());
+    gauge("hpcache_cache_memory_reserved_bytes", "Slab pages, large items and index buckets held.", "gauge",
+          cache_->reserved_memory());
+    gauge("hpcache_cache_memory_mapped_bytes", "Arenas mapped for slab pages.", "gauge", cache_->mapped_memory());
+    gauge("hpcache_cache_capacity_bytes", "Configured capacity in bytes.", "gauge", cache_->capacity());
+    if (memory_monitor_) {
+        gauge("hpcache_resident_bytes", "Process resident set size at the last memory check.", "gauge",
+              memory_monitor_->rss());
+        gauge("hpcache_capacity_shrinks_total", "Times memory pressure shrank the capacity.", "counter",
+              memory_monitor_->shrinks());
+        gauge("hpcache_capacity_grows_total", "Times the capacity grew back after pressure cleared.", "counter",
+              memory_monitor_->grows());
+        if (auto limit = memory_monitor_->limit()) {
+            gauge("hpcache_memory_limit_bytes", "cgroup memory.max.", "gauge", *limit);
+        }
+        if (auto pressure = memory_monitor_->pressure()) {
+            gauge("hpcache_memory_pressure_ratio", "Share of time some tasks stalled on memory (PSI some avg10).",
+                  "gauge", *pressure / 100);
+        }
+    }
+    gauge("hpcache_slab_fragmentation_ratio", "Share of slab page bytes not holding items.", "gauge",
+          cache_->fragmentation_ratio());
+    gauge("hpcache_slab_pages_compacted_total", "Slab pages emptied by moving their items.", "counter",
+          cache_->pages_compacted());
+    gauge("hpcache_slab_pages_rebalanced_total", "Slab pages taken from one size class for evicting ones.",
+          "counter", cache_->pages_rebalanced());
+    gauge("hpcache_slab_items_relocated_total", "Items moved to another slab chunk.", "counter",
+          cache_->items_relocated());
+    auto slabs = cache_->slab_stats();
+    auto per_class = [&out, &slabs](const char* name, const char* help, const char* type, auto value) {
+        out << "# HELP " << name << " " << help << "\n"
+            << "# TYPE " << name << " " << type << "\n";
+        for (const auto& slab : slabs) {
+            if (slab.pages > 0 || slab.evictions > 0) {
+                out << name << "{chunk_size=\"" << slab.chunk_size << "\"} " << value(slab) << "\n";
+            }
+        }
+    };
+    per_class("hpcache_slab_class_pages", "Slab pages held, by size class.", "gauge",
+              [](const SlabAllocator::ClassStats& slab) { return slab.pages; });
+    per_class("hpcache_slab_class_used_chunks", "Chunks holding items, by size class.", "gauge",
+              [](const SlabAllocator::ClassStats& slab) { return slab.used_chunks; });
+    per_class("hpcache_slab_class_evictions_total", "Items evicted, by size class.", "counter",
+              [](const SlabAllocator::ClassStats& slab) { return slab.evictions; });
+    gauge("hpcache_connections_total", "Connections accepted.", "counter", connections_handled_.load());
+    gauge("hpcache_connections_active", "Connections being served by a worker.", "gauge", active_connections_.load());
+    gauge("hpcache_thread_pool_threads", "Worker threads.", "gauge", thread_pool_->size());
+    gauge("hpcache_thread_pool_queue_length", "Accepted connections waiting for a worker.", "gauge",
+          thread_pool_->queue_size());
+    if (replica_) {
+        gauge("hpcache_replication_offset", "Replication stream bytes applied.", "counter", replica_->offset());
+        gauge("hpcache_replication_lag_bytes", "Bytes the primary had written that are not applied yet.", "gauge",
+              replica_->primary_offset() - replica_->offset());
+        gauge("hpcache_replication_link_up", "1 while synced with the primary.", "gauge", replica_->link_up());
+    } else if (replication_) {
+        gauge("hpcache_replication_offset", "Replication stream bytes written.", "counter", replication_->offset());
+        gauge("hpcache_connected_replicas", "Replicas streaming from this server.", "gauge",
+              replication_->replicas().size());
+    }
+    gauge("hpcache_tracked_keys", "Keys read by tracking clients and not yet invalidated.", "gauge",
+          invalidation_tracker_.tracked_keys());
+    gauge("hpcache_invalidations_sent_total", "Invalidation messages pushed to tracking clients.", "counter",
+          invalidation_tracker_.invalidations_sent());
+    auto queue_wait = thread_pool_->queue_wait();
+    gauge("hpcache_thread_pool_tasks_total", "Tasks picked up by a worker.", "counter", queue_wait.count);
+    gauge("hpcache_thread_pool_queue_wait_seconds_total", "Time tasks spent queued before a worker picked them up.",
+          "counter", queue_wait.total_ns / 1e9);
+    
+    if (LockRegistry::enabled()) {
+        auto locks = LockRegistry::instance().snapshot();
+        auto per_lock = [&out, &locks](const char* name, const char* help, auto value) {
+            out << "# HELP " << name << " " << help << "\n"
+                << "# TYPE " << name << " counter\n";
+            for (const auto& lock : locks) {
+                out << name << "{lock=\"" << lock.name << "\"} " << value(lock) << "\n";
+            }
+        };
+        per_lock("hpcache_lock_acquisitions_total", "Lock acquisitions.",
+                 [](const LockRegistry::LockStats& lock) { return lock.acquisitions; });
+        per_lock("hpcache_lock_contended_total", "Acquisitions that had to wait.",
+                 [](const LockRegistry::LockStats& lock) { return lock.contended; });
+        per_lock("hpcache_lock_wait_seconds_total", "Time spent waiting for the lock.",
+                 [](const LockRegistry::LockStats& lock) { return lock.wait.total_ns / 1e9; });
+        per_lock("hpcache_lock_hold_seconds_total", "Time the lock was held exclusively.",
+                 [](const LockRegistry::LockStats& lock) { return lock.hold.total_ns / 1e9; });
+    }
+    
+    // Top ten only, to bound label cardinality
+    auto label_value = [](const std::string& key) {
+        std::string escaped;
+        for (char c : key) {
+            if (c == '\\' || c == '"' || c == '\n') {
+                escaped += '\\';
+            }
+            escaped += c == '\n' ? 'n' : c;
+        }
+        return escaped;
+    };
+    out << "# HELP hpcache_hot_key_accesses Estimated recent accesses of the hottest keys.\n"
+        << "# TYPE hpcache_hot_key_accesses gauge\n";
+    for (const auto& entry : cache_->hot_keys(10)) {
+        out << "hpcache_hot_key_accesses{key=\"" << label_value(entry.key) << "\"} " << entry.count << "\n";
+    }
+    out << "# HELP hpcache_big_key_bytes Bytes stored for the largest keys.\n"
+        << "# TYPE hpcache_big_key_bytes gauge\n";
+    for (const auto& entry : cache_->big_keys(10)) {
+        out << "hpcache_big_key_bytes{key=\"" << label_value(entry.key) << "\"} " << entry.count << "\n";
+    }
+    gauge("hpcache_key_samples_total", "Accesses counted by the hot key sketch.", "counter", cache_->key_samples());
+    
+    const auto& curve = cache_->miss_ratio_curve();
+    out << "# HELP hpcache_predicted_hit_ratio Predicted LRU hit ratio at a multiple of the configured capacity.\n"
+        << "# TYPE hpcache_predicted_hit_ratio gauge\n";
+    for (double factor : kCapacityFactors) {
+        out << "hpcache_predicted_hit_ratio{capacity_factor=\"" << factor << "\"} "
+            << curve.hit_ratio(static_cast<uint64_t>(factor * cache_->capacity())) << "\n";
+    }
+    gauge("hpcache_mrc_sample_rate", "Fraction of keys sampled for the miss ratio curve.", "gauge",
+          curve.sample_rate());
+    if (flash_tier_) {
+        gauge("hpcache_flash_hits_total", "Lookups served from the flash tier.", "counter", cache_->flash_hits());
+        gauge("hpcache_flash_items", "Entries in the flash tier.", "gauge", flash_tier_->size());
+    }
+    if (write_log_) {
+        gauge("hpcache_wal_errors_total", "Write log writes and fsyncs that failed.", "counter",
+              write_log_->write_errors());
+    }
+    return out.str();
 }
 
 } // namespace cache
@@ -7,10 +7,10 @@ ThreadPool::ThreadPool(size_t num_threads) {
     for (size_t i = 0; i < num_threads; ++i) {
         workers_.emplace_back([this] {
             while (true) {
-                std::function<void()> task;
+                QueuedTask task;
                 
                 {
-                    std::unique_lock<std::mutex> lock(queue_mutex_);
+                    std::unique_lock<Mutex> lock(queue_mutex_);
                     condition_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
                     
                     if (stop_ && tasks_.empty()) {
@@ -21,7 +21,9 @@ ThreadPool::ThreadPool(size_t num_threads) {
                     tasks_.pop();
                 }
                 
-                task();
+                queue_wait_.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - task.enqueued_at).count());
+                task.run();
             }
         });
     }
@@ -33,7 +35,7 @@ ThreadPool::~ThreadPool() {
 
 void ThreadPool::shutdown() {
     {
-        std::unique_lock<std::mutex> lock(queue_mutex_);
+        std::unique_lock<Mutex> lock(queue_mutex_);
         stop_ = true;
     }
     
@@ -51,8 +53,12 @@ size_t ThreadPool::size() const {
 }
 
 size_t ThreadPool::queue_size() const {
-    std::lock_guard<std::mutex> lock(queue_mutex_);
+    std::lock_guard<Mutex> lock(queue_mutex_);
     return tasks_.size();
 }
 
+DurationHistogram::Snapshot ThreadPool::queue_wait() const {
+    return queue_wait_.snapshot();
+}
+
 } // namespace cache
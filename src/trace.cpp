@@ -0,0 +1,124 @@
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace cache {
+
+namespace {
+
+constexpr char kMagic[8] = {'H', 'P', 'C', 'T', 'R', 'A', 'C', 'E'};
+constexpr uint32_t kFormatVersion = 1;
+constexpr size_t kHeaderSize = sizeof(kMagic) + sizeof(uint32_t);
+constexpr size_t kRecordSize = 2 * sizeof(uint64_t) + 2 * sizeof(uint32_t) + sizeof(uint8_t);
+
+template<typename T>
+void append(std::string& buffer, T value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template<typename T>
+T read_at(const char* data) {
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+std::optional<std::vector<TraceRecord>> Trace::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "Failed to open trace " << path << std::endl;
+        return std::nullopt;
+    }
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    
+    if (data.size() < kHeaderSize || std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0 ||
+        read_at<uint32_t>(data.data() + sizeof(kMagic)) != kFormatVersion) {
+        std::cerr << "Trace " << path << " has a bad header" << std::endl;
+        return std::nullopt;
+    }
+    if ((data.size() - kHeaderSize) % kRecordSize != 0) {
+        std::cerr << "Trace " << path << " ends mid-record" << std::endl;
+        return std::nullopt;
+    }
+    
+    std::vector<TraceRecord> records;
+    records.reserve((data.size() - kHeaderSize) / kRecordSize);
+    for (size_t offset = kHeaderSize; offset < data.size(); offset += kRecordSize) {
+        const char* cursor = data.data() + offset;
+        uint8_t op = read_at<uint8_t>(cursor + 24);
+        if (op > static_cast<uint8_t>(TraceRecord::Op::DELETE)) {
+            std::cerr << "Trace " << path << " has an unknown op " << static_cast<int>(op) << std::endl;
+            return std::nullopt;
+        }
+        records.push_back(TraceRecord{read_at<uint64_t>(cursor), read_at<uint64_t>(cursor + 8),
+                                      read_at<uint32_t>(cursor + 16), read_at<uint32_t>(cursor + 20),
+                                      static_cast<TraceRecord::Op>(op)});
+    }
+    return records;
+}
+
+bool Trace::save(const std::string& path, const std::vector<TraceRecord>& records) {
+    std::string buffer;
+    buffer.reserve(kHeaderSize + records.size() * kRecordSize);
+    buffer.append(kMagic, sizeof(kMagic));
+    append<uint32_t>(buffer, kFormatVersion);
+    for (const auto& record : records) {
+        append<uint64_t>(buffer, record.timestamp_us);
+        append<uint64_t>(buffer, record.key_hash);
+        append<uint32_t>(buffer, record.value_size);
+        append<uint32_t>(buffer, record.ttl_s);
+        append<uint8_t>(buffer, static_cast<uint8_t>(record.op));
+    }
+    
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.write(buffer.data(), buffer.size())) {
+        std::cerr << "Failed to write trace " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::string Trace::key_name(uint64_t key_hash) {
+    static const char digits[] = "0123456789abcdef";
+    std::string key = "t";
+    key.reserve(17);
+    for (int shift = 60; shift >= 0; shift -= 4) {
+        key.push_back(digits[(key_hash >> shift) & 0xf]);
+    }
+    return key;
+}
+
+Trace::SimulationResult Trace::simulate(const std::vector<TraceRecord>& records, Cache& cache) {
+    SimulationResult result;
+    std::string value;
+    
+    for (const auto& record : records) {
+        std::string key = key_name(record.key_hash);
+        switch (record.op) {
+            case TraceRecord::Op::GET:
+                result.gets++;
+                if (!cache.get(key).empty()) {
+                    result.hits++;
+                }
+                break;
+            case TraceRecord::Op::SET:
+                result.sets++;
+                value.assign(std::max<uint32_t>(record.value_size, 1), 'x');
+                cache.set(key, value);
+                break;
+            case TraceRecord::Op::DELETE:
+                result.deletes++;
+                cache.remove(key);
+                break;
+        }
+    }
+    
+    return result;
+}
+
+} // namespace cache
@@ -0,0 +1,299 @@
+#include "workload.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace cache {
+
+namespace {
+
+enum Operation {
+    READ = 0,
+    UPDATE,
+    INSERT,
+    SCAN,
+    READ_MODIFY_WRITE
+};
+
+uint64_t fnv1a64(uint64_t value) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < 8; ++i) {
+        hash ^= value & 0xff;
+        hash *= 1099511628211ULL;
+        value >>= 8;
+    }
+    return hash;
+}
+
+} // namespace
+
+ZipfianGenerator::ZipfianGenerator(uint64_t n, double theta)
+    : theta_(std::clamp(theta, 0.01, 0.9999)),
+      alpha_(1.0 / (1.0 - theta_)),
+      zeta2_(1.0 + std::pow(0.5, theta_)),
+      n_(0),
+      zeta_n_(0.0),
+      eta_(0.0) {
+    grow(std::max<uint64_t>(n, 1));
+}
+
+uint64_t ZipfianGenerator::next(std::mt19937_64& rng) {
+    return next(rng, n_);
+}
+
+uint64_t ZipfianGenerator::next(std::mt19937_64& rng, uint64_t n) {
+    grow(std::max<uint64_t>(n, 1));
+    
+    double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+    double uz = u * zeta_n_;
+    if (uz < 1.0) {
+        return 0;
+    }
+    if (uz < 1.0 + std::pow(0.5, theta_)) {
+        return std::min<uint64_t>(1, n_ - 1);
+    }
+    auto rank = static_cast<uint64_t>(n_ * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+    return std::min(rank, n_ - 1);
+}
+
+void ZipfianGenerator::grow(uint64_t n) {
+    if (n == n_) {
+        return;
+    }
+    if (n < n_) {
+        n_ = 0;
+        zeta_n_ = 0.0;
+    }
+    for (uint64_t i = n_ + 1; i <= n; ++i) {
+        zeta_n_ += 1.0 / std::pow(static_cast<double>(i), theta_);
+    }
+    n_ = n;
+    eta_ = (1.0 - std::pow(2.0 / n_, 1.0 - theta_)) / (1.0 - zeta2_ / zeta_n_);
+}
+
+ValueSizeDistribution ValueSizeDistribution::fixed(size_t size) {
+    return uniform(size, size);
+}
+
+ValueSizeDistribution ValueSizeDistribution::uniform(size_t min_size, size_t max_size) {
+    ValueSizeDistribution distribution;
+    distribution.min_size_ = std::max<size_t>(min_size, 1);
+    distribution.max_size_ = std::max(distribution.min_size_, max_size);
+    return distribution;
+}
+
+std::optional<ValueSizeDistribution> ValueSizeDistribution::parse(const std::string& spec) {
+    try {
+        size_t dash = spec.find('-');
+        if (dash == std::string::npos) {
+            return fixed(std::stoul(spec));
+        }
+        return uniform(std::stoul(spec.substr(0, dash)), std::stoul(spec.substr(dash + 1)));
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+}
+
+std::optional<ValueSizeDistribution> ValueSizeDistribution::from_file(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Failed to open value size histogram " << path << std::endl;
+        return std::nullopt;
+    }
+    
+    std::vector<size_t> sizes;
+    std::vector<double> weights;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        size_t size;
+        double weight;
+        if (!(fields >> size >> weight) || size == 0 || weight < 0) {
+            std::cerr << "Bad value size histogram line: " << line << std::endl;
+            return std::nullopt;
+        }
+        sizes.push_back(size);
+        weights.push_back(weight);
+    }
+    if (sizes.empty()) {
+        return std::nullopt;
+    }
+    
+    ValueSizeDistribution distribution;
+    distribution.sizes_ = std::move(sizes);
+    distribution.weights_ = std::discrete_distribution<size_t>(weights.begin(), weights.end());
+    distribution.min_size_ = *std::min_element(distribution.sizes_.begin(), distribution.sizes_.end());
+    distribution.max_size_ = *std::max_element(distribution.sizes_.begin(), distribution.sizes_.end());
+    return distribution;
+}
+
+size_t ValueSizeDistribution::next(std::mt19937_64& rng) {
+    if (!sizes_.empty()) {
+        return sizes_[weights_(rng)];
+    }
+    if (min_size_ == max_size_) {
+        return min_size_;
+    }
+    return std::uniform_int_distribution<size_t>(min_size_, max_size_)(rng);
+}
+
+size_t ValueSizeDistribution::max_size() const {
+    return max_size_;
+}
+
+std::optional<WorkloadSpec> WorkloadSpec::ycsb(char preset) {
+    WorkloadSpec spec;
+    spec.key_distribution = KeyDistribution::ZIPFIAN;
+    spec.read_proportion = 0.0;
+    spec.update_proportion = 0.0;
+    
+    switch (std::toupper(static_cast<unsigned char>(preset))) {
+        case 'A': // Update heavy
+            spec.read_proportion = 0.5;
+            spec.update_proportion = 0.5;
+            break;
+        case 'B': // Read mostly
+            spec.read_proportion = 0.95;
+            spec.update_proportion = 0.05;
+            break;
+        case 'C': // Read only
+            spec.read_proportion = 1.0;
+            break;
+        case 'D': // Read latest
+            spec.key_distribution = KeyDistribution::LATEST;
+            spec.read_proportion = 0.95;
+            spec.insert_proportion = 0.05;
+            break;
+        case 'E': // Short ranges
+            spec.scan_proportion = 0.95;
+            spec.insert_proportion = 0.05;
+            break;
+        case 'F': // Read-modify-write
+            spec.read_proportion = 0.5;
+            spec.read_modify_write_proportion = 0.5;
+            break;
+        default:
+            return std::nullopt;
+    }
+    return spec;
+}
+
+std::optional<WorkloadSpec::KeyDistribution> WorkloadSpec::parse_distribution(const std::string& name) {
+    if (name == "uniform") {
+        return KeyDistribution::UNIFORM;
+    } else if (name == "zipfian" || name == "zipf") {
+        return KeyDistribution::ZIPFIAN;
+    } else if (name == "hotspot") {
+        return KeyDistribution::HOTSPOT;
+    } else if (name == "latest") {
+        return KeyDistribution::LATEST;
+    }
+    return std::nullopt;
+}
+
+Workload::Workload(const WorkloadSpec& spec, ValueSizeDistribution value_sizes,
+                   uint64_t seed, size_t stream_id, size_t stream_count)
+    : spec_(spec),
+      value_sizes_(std::move(value_sizes)),
+      rng_(seed + stream_id),
+      operations_({spec.read_proportion, spec.update_proportion, spec.insert_proportion,
+                   spec.scan_proportion, spec.read_modify_write_proportion}),
+      zipfian_(std::max<uint64_t>(spec.key_count, 1), spec.zipf_theta),
+      stream_id_(stream_id),
+      stream_count_(std::max<size_t>(stream_count, 1)) {
+    spec_.key_count = std::max<uint64_t>(spec_.key_count, 1);
+    
+    // Values are slices of one random buffer at random offsets
+    const size_t slack = 256;
+    std::uniform_int_distribution<int> letter('a', 'z');
+    value_pool_.resize(value_sizes_.max_size() + slack);
+    for (auto& c : value_pool_) {
+        c = static_cast<char>(letter(rng_));
+    }
+}
+
+void Workload::next(std::vector<std::string>& requests) {
+    switch (operations_(rng_)) {
+        case READ:
+            requests.push_back("GET " + key_name(next_key()));
+            break;
+        case UPDATE:
+            requests.push_back("SET " + key_name(next_key()) + " " + next_value());
+            break;
+        case INSERT: {
+            uint64_t id = spec_.key_count + inserted_ * stream_count_ + stream_id_;
+            inserted_++;
+            requests.push_back("SET " + key_name(id) + " " + next_value());
+            break;
+        }
+        case SCAN: {
+            // The protocol has no range reads; a scan reads consecutive keys one by one
+            uint64_t start = next_key();
+            size_t length = std::uniform_int_distribution<size_t>(
+                1, std::max<size_t>(spec_.max_scan_length, 1))(rng_);
+            for (size_t i = 0; i < length; ++i) {
+                requests.push_back("GET " + key_name((start + i) % key_count()));
+            }
+            break;
+        }
+        case READ_MODIFY_WRITE: {
+            std::string key = key_name(next_key());
+            requests.push_back("GET " + key);
+            requests.push_back("SET " + key + " " + next_value());
+            break;
+        }
+    }
+}
+
+std::vector<std::string> Workload::generate(size_t num_requests) {
+    std::vector<std::string> requests;
+    requests.reserve(num_requests + spec_.max_scan_length);
+    while (requests.size() < num_requests) {
+        next(requests);
+    }
+    requests.resize(num_requests);
+    return requests;
+}
+
+std::string Workload::key_name(uint64_t id) {
+    return "key_" + std::to_string(id);
+}
+
+uint64_t Workload::key_count() const {
+    // Assumes every stream inserts at about the same rate
+    return spec_.key_count + inserted_ * stream_count_;
+}
+
+uint64_t Workload::next_key() {
+    uint64_t n = key_count();
+    switch (spec_.key_distribution) {
+        case WorkloadSpec::KeyDistribution::UNIFORM:
+            return std::uniform_int_distribution<uint64_t>(0, n - 1)(rng_);
+        case WorkloadSpec::KeyDistribution::ZIPFIAN:
+            return fnv1a64(zipfian_.next(rng_, spec_.key_count)) % n;
+        case WorkloadSpec::KeyDistribution::HOTSPOT: {
+            uint64_t hot = std::clamp<uint64_t>(static_cast<uint64_t>(n * spec_.hot_set_fraction), 1, n);
+            if (hot == n || unit_(rng_) < spec_.hot_op_fraction) {
+                return std::uniform_int_distribution<uint64_t>(0, hot - 1)(rng_);
+            }
+            return std::uniform_int_distribution<uint64_t>(hot, n - 1)(rng_);
+        }
+        case WorkloadSpec::KeyDistribution::LATEST:
+            return n - 1 - zipfian_.next(rng_, n);
+    }
+    return 0;
+}
+
+std::string Workload::next_value() {
+    size_t size = value_sizes_.next(rng_);
+    size_t offset = std::uniform_int_distribution<size_t>(0, value_pool_.size() - size)(rng_);
+    return value_pool_.substr(offset, size);
+}
+
+} // namespace cache
@@ -0,0 +1,454 @@
+#include "write_log.h"
+#include "snapshot.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace cache {
+
+namespace {
+
+constexpr char kMagic[8] = {'H', 'P', 'C', 'W', 'A', 'L', '0', '1'};
+constexpr uint8_t kFlagInteger = 1;
+constexpr uint8_t kFlagCompressed = 2;
+constexpr size_t kFrameHeaderSize = 2 * sizeof(uint32_t);
+constexpr size_t kPayloadHeaderSize = 2 * sizeof(uint8_t) + sizeof(uint64_t) + 2 * sizeof(uint32_t);
+
+template<typename T>
+void append_raw(std::string& buffer, T value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template<typename T>
+T read_at(const char* data) {
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+uint32_t fnv1a(const char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// fsyncs the directory holding path, so renames and new files in it persist
+bool sync_directory(const std::string& path) {
+    size_t slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+}
+
+} // namespace
+
+WriteLog::WriteLog(const Cache& cache, Options options)
+    : cache_(cache), options_(std::move(options)) {
+}
+
+WriteLog::~WriteLog() {
+    close();
+}
+
+bool WriteLog::open() {
+    fd_ = ::open(options_.path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Failed to open write log " << options_.path << std::endl;
+        return false;
+    }
+    
+    struct stat st;
+    if (fstat(fd_, &st) < 0) {
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    
+    file_bytes_ = st.st_size;
+    failed_ = false;
+    if (file_bytes_ == 0) {
+        if (!write_all(std::string(kMagic, sizeof(kMagic)))) {
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+    }
+    
+    stop_ = false;
+    compact_stop_ = false;
+    flusher_ = std::thread([this] { run_flusher(); });
+    compactor_ = std::thread([this] { run_compactor(); });
+    
+    // A rotated log left behind by an interrupted compaction is folded in now
+    if (!options_.snapshot_path.empty() && access((options_.path + ".old").c_str(), F_OK) == 0) {
+        std::lock_guard<std::mutex> lock(compact_mutex_);
+        compacting_ = true;
+        compact_requested_ = true;
+        compact_condition_.notify_one();
+    }
+    
+    return true;
+}
+
+void WriteLog::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    flush_condition_.notify_all();
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(compact_mutex_);
+        compact_stop_ = true;
+    }
+    compact_condition_.notify_all();
+    if (compactor_.joinable()) {
+        compactor_.join();
+    }
+    
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+uint64_t WriteLog::append_set(const Cache::CacheEntry& entry) {
+    if (entry.is_integer) {
+        return append(Op::SET, kFlagInteger, entry.version, entry.key,
+                      reinterpret_cast<const char*>(&entry.int_value), sizeof(entry.int_value));
+    }
+    return append(Op::SET, entry.is_compressed ? kFlagCompressed : 0, entry.version, entry.key,
+                  entry.value.data(), entry.value.size());
+}
+
+uint64_t WriteLog::append_remove(const std::string& key) {
+    return append(Op::REMOVE, 0, 0, key, nullptr, 0);
+}
+
+uint64_t WriteLog::append_clear() {
+    return append(Op::CLEAR, 0, 0, std::string(), nullptr, 0);
+}
+
+uint64_t WriteLog::append(Op op, uint8_t flags, uint64_t version,
+                          const std::string& key, const char* value, size_t value_len) {
+    // Encode outside the buffer lock; only the memcpy into buffer_ is serialized
+    std::string record;
+    record.reserve(kFrameHeaderSize + kPayloadHeaderSize + key.size() + value_len);
+    record.resize(kFrameHeaderSize);
+    append_raw<uint8_t>(record, static_cast<uint8_t>(op));
+    append_raw<uint8_t>(record, flags);
+    append_raw<uint64_t>(record, version);
+    append_raw<uint32_t>(record, key.size());
+    append_raw<uint32_t>(record, value_len);
+    record.append(key);
+    record.append(value, value_len);
+    
+    uint32_t payload_len = record.size() - kFrameHeaderSize;
+    uint32_t checksum = fnv1a(record.data() + kFrameHeaderSize, payload_len);
+    std::memcpy(&record[0], &payload_len, sizeof(payload_len));
+    std::memcpy(&record[sizeof(payload_len)], &checksum, sizeof(checksum));
+    
+    records_appended_++;
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer_.append(record);
+    return next_lsn_++;
+}
+
+bool WriteLog::commit(uint64_t lsn) {
+    if (options_.policy != FsyncPolicy::ALWAYS || lsn == 0) {
+        return !failed_;
+    }
+    
+    std::unique_lock<std::mutex> lock(mutex_);
+    commit_waiters_++;
+    flush_condition_.notify_one();
+    durable_condition_.wait(lock, [this, lsn] { return durable_lsn_ >= lsn || stop_ || failed_; });
+    commit_waiters_--;
+    return durable_lsn_ >= lsn;
+}
+
+bool WriteLog::failed() const {
+    return failed_;
+}
+
+std::optional<WriteLog::FsyncPolicy> WriteLog::parse_policy(const std::string& policy,
+                                                            std::chrono::milliseconds& interval) {
+    if (policy == "always") return FsyncPolicy::ALWAYS;
+    if (policy == "never") return FsyncPolicy::NEVER;
+    
+    // Anything else is an interval in milliseconds, e.g. "1000" or "1000ms"
+    char* end = nullptr;
+    long ms = std::strtol(policy.c_str(), &end, 10);
+    if (end == policy.c_str() || ms <= 0 || (*end != '\0' && std::string(end) != "ms")) {
+        return std::nullopt;
+    }
+    interval = std::chrono::milliseconds(ms);
+    return FsyncPolicy::INTERVAL;
+}
+
+size_t WriteLog::records_appended() const {
+    return records_appended_.load();
+}
+
+size_t WriteLog::bytes_written() const {
+    return bytes_written_.load();
+}
+
+size_t WriteLog::fsyncs() const {
+    return fsyncs_.load();
+}
+
+size_t WriteLog::compactions() const {
+    return compactions_.load();
+}
+
+size_t WriteLog::write_errors() const {
+    return write_errors_.load();
+}
+
+void WriteLog::run_flusher() {
+    std::string batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    
+    while (true) {
+        flush_condition_.wait_for(lock, options_.fsync_interval, [this] {
+            return stop_ || (commit_waiters_ > 0 && durable_lsn_ + 1 < next_lsn_);
+        });
+        
+        // Everything appended so far goes out in one write and one fsync
+        batch.swap(buffer_);
+        uint64_t batch_lsn = next_lsn_ - 1;
+        bool stopping = stop_;
+        lock.unlock();
+        
+        // After a failure the file may end in a torn record, which replay
+        // stops at, so later batches are dropped rather than written past it
+        bool ok = !failed_;
+        if (ok && !batch.empty()) {
+            ok = write_all(batch) && (options_.policy == FsyncPolicy::NEVER || sync());
+        }
+        batch.clear();
+        
+        if (ok && !options_.snapshot_path.empty() && file_bytes_ >= options_.compact_bytes && !compacting_) {
+            rotate();
+        }
+        
+        lock.lock();
+        if (ok) {
+            durable_lsn_ = batch_lsn;
+        }
+        durable_condition_.notify_all();
+        
+        if (stopping && buffer_.empty()) {
+            return;
+        }
+    }
+}
+
+void WriteLog::run_compactor() {
+    std::unique_lock<std::mutex> lock(compact_mutex_);
+    
+    while (true) {
+        compact_condition_.wait(lock, [this] { return compact_stop_ || compact_requested_; });
+        if (compact_stop_) {
+            return;
+        }
+        compact_requested_ = false;
+        lock.unlock();
+        
+        // Every mutation after the rotation is in the new log, so a snapshot
+        // taken now (even while writes continue) makes the old log redundant.
+        // save returns once the snapshot and its rename are on disk, so the
+        // old log is only deleted when a crash can no longer lose it.
+        if (Snapshot::save(cache_, options_.snapshot_path)) {
+            std::remove((options_.path + ".old").c_str());
+            compactions_++;
+        }
+        compacting_ = false;
+        
+        lock.lock();
+    }
+}
+
+bool WriteLog::write_all(const std::string& data) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        ssize_t written = ::write(fd_, data.data() + offset, data.size() - offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fail("write");
+            return false;
+        }
+        offset += written;
+    }
+    
+    file_bytes_ += data.size();
+    bytes_written_ += data.size();
+    return true;
+}
+
+bool WriteLog::sync() {
+    fsyncs_++;
+    if (fdatasync(fd_) != 0) {
+        fail("fsync");
+        return false;
+    }
+    return true;
+}
+
+void WriteLog::fail(const char* what) {
+    int error = errno;
+    std::cerr << "Failed to " << what << " write log " << options_.path << ": "
+              << std::strerror(error) << std::endl;
+    write_errors_++;
+    failed_ = true;
+}
+
+bool WriteLog::rotate() {
+    std::string old_path = options_.path + ".old";
+    compacting_ = true;
+    
+    // A previous compaction failed; retry it before rotating again
+    if (access(old_path.c_str(), F_OK) != 0) {
+        if (!sync()) {
+            compacting_ = false;
+            return false;
+        }
+        
+        // Renaming leaves fd_ on the same file, so on failure the log goes
+        // on as it was; a fresh header in the middle of it would end replay
+        if (std::rename(options_.path.c_str(), old_path.c_str()) != 0) {
+            std::cerr << "Failed to rotate write log " << options_.path << ": "
+                      << std::strerror(errno) << std::endl;
+            compacting_ = false;
+            return false;
+        }
+        ::close(fd_);
+        
+        fd_ = ::open(options_.path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND, 0644);
+        if (fd_ < 0) {
+            fail("reopen");
+            compacting_ = false;
+            return false;
+        }
+        file_bytes_ = 0;
+        // The new file and the rename must survive a crash along with the
+        // records acknowledged from it
+        if (!write_all(std::string(kMagic, sizeof(kMagic))) || !sync() || !sync_directory(options_.path)) {
+            if (!failed_) {
+                fail("sync the directory of");
+            }
+            compacting_ = false;
+            return false;
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(compact_mutex_);
+    compact_requested_ = true;
+    compact_condition_.notify_one();
+    return true;
+}
+
+std::optional<size_t> WriteLog::replay(Cache& cache, const std::string& path) {
+    auto old_records = replay_file(cache, path + ".old", false);
+    auto records = replay_file(cache, path, true);
+    if (!old_records || !records) {
+        return std::nullopt;
+    }
+    return *old_records + *records;
+}
+
+std::optional<size_t> WriteLog::replay_file(Cache& cache, const std::string& path, bool truncate_tail) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return 0; // Nothing logged yet
+    }
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    
+    if (data.empty()) {
+        return 0;
+    }
+    if (data.size() < sizeof(kMagic) || std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) {
+        std::cerr << "Write log " << path << " has a bad header" << std::endl;
+        return std::nullopt;
+    }
+    
+    size_t applied = 0;
+    size_t offset = sizeof(kMagic);
+    while (data.size() - offset >= kFrameHeaderSize) {
+        uint32_t payload_len = read_at<uint32_t>(data.data() + offset);
+        uint32_t checksum = read_at<uint32_t>(data.data() + offset + 4);
+        const char* payload = data.data() + offset + kFrameHeaderSize;
+        
+        // Stop at the first torn or corrupt record; nothing after it was acknowledged
+        if (payload_len < kPayloadHeaderSize ||
+            data.size() - offset - kFrameHeaderSize < payload_len ||
+            fnv1a(payload, payload_len) != checksum) {
+            break;
+        }
+        
+        auto op = static_cast<Op>(read_at<uint8_t>(payload));
+        uint8_t flags = read_at<uint8_t>(payload + 1);
+        uint64_t version = read_at<uint64_t>(payload + 2);
+        uint32_t key_len = read_at<uint32_t>(payload + 10);
+        uint32_t value_len = read_at<uint32_t>(payload + 14);
+        if (kPayloadHeaderSize + static_cast<size_t>(key_len) + value_len != payload_len) {
+            break;
+        }
+        
+        std::string key(payload + kPayloadHeaderSize, key_len);
+        const char* value = payload + kPayloadHeaderSize + key_len;
+        
+        switch (op) {
+            case Op::SET:
+                if ((flags & kFlagInteger) && value_len == sizeof(int64_t)) {
+                    cache.restore(Cache::CacheEntry(key, read_at<int64_t>(value), version));
+                } else {
+                    Cache::CacheEntry entry(key, std::string(value, value_len), version);
+                    entry.is_compressed = (flags & kFlagCompressed) != 0;
+                    cache.restore(std::move(entry));
+                }
+                break;
+            case Op::REMOVE:
+                cache.remove(key);
+                break;
+            case Op::CLEAR:
+                cache.clear();
+                break;
+        }
+        
+        applied++;
+        offset += kFrameHeaderSize + payload_len;
+    }
+    
+    if (offset < data.size()) {
+        std::cerr << "Write log " << path << " has " << (data.size() - offset)
+                  << " trailing bytes from an interrupted write" << std::endl;
+        if (truncate_tail && truncate(path.c_str(), offset) != 0) {
+            std::cerr << "Failed to truncate write log " << path << std::endl;
+        }
+    }
+    
+    return applied;
+}
+
+} // namespace cache
@@ -3,6 +3,7 @@
 #include <thread>
 #include <vector>
 #include <random>
+#include <limits>
 
 class CacheTest : public ::testing::Test {
 protected:
@@ -84,6 +85,20 @@ TEST_F(CacheTest, MemoryUsage) {
     EXPECT_EQ(cache_->memory_usage(), 0);
 }
 
+TEST_F(CacheTest, ClearReleasesSlabPages) {
+    size_t empty = cache_->reserved_memory();
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(cache_->set("key" + std::to_string(i), std::string(100, 'v')));
+    }
+    EXPECT_GT(cache_->reserved_memory(), empty);
+    EXPECT_GE(cache_->mapped_memory(), cache_->memory_usage());
+    
+    cache_->clear();
+    EXPECT_EQ(cache_->reserved_memory(), empty);
+    EXPECT_TRUE(cache_->set("key1", "value1"));
+    EXPECT_EQ(cache_->get("key1"), "value1");
+}
+
 TEST_F(CacheTest, CapacityLimit) {
     // Set a very small capacity
     cache_->set_max_capacity(100);
@@ -170,3 +185,177 @@ TEST_F(CacheTest, StatisticsAccuracy) {
     EXPECT_EQ(cache_->misses(), 1);
     EXPECT_DOUBLE_EQ(cache_->hit_ratio(), 2.0 / 3.0);
 }
+
+TEST_F(CacheTest, IncrDecrCounter) {
+    EXPECT_EQ(cache_->incr("counter"), 1);
+    EXPECT_EQ(cache_->incr("counter", 10), 11);
+    EXPECT_EQ(cache_->decr("counter", 3), 8);
+    EXPECT_EQ(cache_->get("counter"), "8");
+}
+
+TEST_F(CacheTest, IncrExistingStringValue) {
+    EXPECT_TRUE(cache_->set("num", "41"));
+    EXPECT_EQ(cache_->incr("num"), 42);
+    
+    EXPECT_TRUE(cache_->set("text", "hello"));
+    EXPECT_FALSE(cache_->incr("text").has_value());
+    EXPECT_EQ(cache_->get("text"), "hello");
+}
+
+TEST_F(CacheTest, IncrOverflow) {
+    EXPECT_TRUE(cache_->set("max", std::to_string(std::numeric_limits<int64_t>::max())));
+    EXPECT_FALSE(cache_->incr("max").has_value());
+}
+
+TEST_F(CacheTest, ConcurrentIncr) {
+    const int num_threads = 4;
+    const int increments_per_thread = 1000;
+    
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([this, increments_per_thread]() {
+            for (int i = 0; i < increments_per_thread; ++i) {
+                cache_->incr("shared");
+            }
+        });
+    }
+    
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    EXPECT_EQ(cache_->get("shared"), std::to_string(num_threads * increments_per_thread));
+}
+
+TEST_F(CacheTest, CompareAndSwap) {
+    EXPECT_EQ(cache_->cas("key1", "value1", 1), cache::Cache::CasResult::NOT_FOUND);
+    
+    EXPECT_TRUE(cache_->set("key1", "value1"));
+    auto versioned = cache_->get_versioned("key1");
+    ASSERT_TRUE(versioned.has_value());
+    EXPECT_EQ(versioned->value, "value1");
+    
+    EXPECT_EQ(cache_->cas("key1", "value2", versioned->version), cache::Cache::CasResult::STORED);
+    EXPECT_EQ(cache_->get("key1"), "value2");
+    
+    // The stale version must be rejected after a successful swap
+    EXPECT_EQ(cache_->cas("key1", "value3", versioned->version), cache::Cache::CasResult::EXISTS);
+    EXPECT_EQ(cache_->get("key1"), "value2");
+}
+
+TEST_F(CacheTest, CompressesLargeValues) {
+    cache_->set_compression_threshold(1024);
+    std::string json;
+    for (int i = 0; i < 200; ++i) {
+        json += "{\"id\":" + std::to_string(i) + ",\"name\":\"item\",\"tags\":[\"a\",\"b\"]},";
+    }
+    
+    EXPECT_TRUE(cache_->set("small", "value"));
+    EXPECT_TRUE(cache_->set("json", json));
+    EXPECT_EQ(cache_->compressed_values(), 1u);
+    EXPECT_GT(cache_->compression_ratio(), 2.0);
+    EXPECT_LT(cache_->memory_usage(), json.size());
+    
+    EXPECT_EQ(cache_->get("small"), "value");
+    EXPECT_EQ(cache_->get("json"), json);
+    
+    auto versioned = cache_->get_versioned("json");
+    ASSERT_TRUE(versioned.has_value());
+    EXPECT_EQ(versioned->value, json);
+    EXPECT_EQ(cache_->cas("json", json + json, versioned->version), cache::Cache::CasResult::STORED);
+    EXPECT_EQ(cache_->get("json"), json + json);
+}
+
+TEST_F(CacheTest, IncompressibleValuesStoredAsIs) {
+    cache_->set_compression_threshold(64);
+    std::mt19937 rng(42);
+    std::string noise(4096, '\0');
+    for (auto& c : noise) {
+        c = static_cast<char>(rng());
+    }
+    
+    EXPECT_TRUE(cache_->set("noise", noise));
+    EXPECT_EQ(cache_->compressed_values(), 0u);
+    EXPECT_EQ(cache_->get("noise"), noise);
+}
+
+TEST_F(CacheTest, NumbersAreNotCompressed) {
+    cache_->set_compression_threshold(16);
+    // Long zero-padded counters compress well, but INCR would then have to
+    // decompress them under the shard lock
+    std::string padded = std::string(100, '0') + "41";
+    EXPECT_TRUE(cache_->set("counter", padded));
+    EXPECT_TRUE(cache_->set("text", std::string(100, 'a')));
+    EXPECT_EQ(cache_->compressed_values(), 1u);
+    
+    EXPECT_EQ(cache_->incr("counter"), 42);
+    EXPECT_EQ(cache_->incr("text"), std::nullopt);
+    EXPECT_EQ(cache_->get("text"), std::string(100, 'a'));
+}
+
+TEST_F(CacheTest, NamespacesByKeyPrefix) {
+    EXPECT_TRUE(cache_->add_namespace("teamA", 256 * 1024));
+    EXPECT_TRUE(cache_->add_namespace("teamB", 256 * 1024));
+    EXPECT_FALSE(cache_->add_namespace("teamA", 1024));
+    EXPECT_FALSE(cache_->add_namespace("default", 1024));
+    EXPECT_FALSE(cache_->add_namespace("a:b", 1024));
+    EXPECT_FALSE(cache_->add_namespace("huge", 1024 * 1024));
+    EXPECT_EQ(cache_->num_namespaces(), 3u);
+    
+    EXPECT_EQ(cache_->namespace_of("teamA:key"), 1u);
+    EXPECT_EQ(cache_->namespace_of("teamB:key"), 2u);
+    EXPECT_EQ(cache_->namespace_of("teamC:key"), 0u);
+    EXPECT_EQ(cache_->namespace_of("teamA"), 0u);
+    EXPECT_EQ(cache_->namespace_of("teamAB:key"), 0u);
+    
+    cache_->set("teamA:key", "a");
+    cache_->set("plain", "p");
+    EXPECT_EQ(cache_->get("teamA:key"), "a");
+    EXPECT_EQ(cache_->get("teamB:key"), "");
+    EXPECT_EQ(cache_->get("plain"), "p");
+    EXPECT_EQ(cache_->size(), 2u);
+    
+    auto stats = cache_->namespace_stats();
+    ASSERT_EQ(stats.size(), 3u);
+    EXPECT_EQ(stats[0].name, "default");
+    EXPECT_EQ(stats[0].quota, 512u * 1024);
+    EXPECT_EQ(stats[0].items, 1u);
+    EXPECT_EQ(stats[1].items, 1u);
+    EXPECT_EQ(stats[1].hits, 1u);
+    EXPECT_EQ(stats[2].misses, 1u);
+    EXPECT_EQ(stats[0].memory_usage + stats[1].memory_usage, cache_->memory_usage());
+    
+    cache_->remove("teamA:key");
+    cache_->clear();
+    stats = cache_->namespace_stats();
+    EXPECT_EQ(stats[0].memory_usage, 0u);
+    EXPECT_EQ(stats[1].memory_usage, 0u);
+}
+
+TEST_F(CacheTest, NamespaceBurstEvictsOnlyItself) {
+    ASSERT_TRUE(cache_->add_namespace("calm", 256 * 1024));
+    ASSERT_TRUE(cache_->add_namespace("bursty", 256 * 1024));
+    std::string value(1000, 'x');
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_TRUE(cache_->set("calm:" + std::to_string(i), value));
+    }
+    
+    // Far more than its quota, and than the whole cache
+    for (int i = 0; i < 2000; ++i) {
+        ASSERT_TRUE(cache_->set("bursty:" + std::to_string(i), value));
+    }
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(cache_->get("calm:" + std::to_string(i)), value);
+    }
+    
+    auto stats = cache_->namespace_stats();
+    EXPECT_EQ(stats[1].evictions, 0u);
+    EXPECT_GT(stats[2].evictions, 0u);
+    EXPECT_LE(stats[2].memory_usage, stats[2].quota);
+    EXPECT_EQ(cache_->get("bursty:1999"), value);
+    EXPECT_EQ(cache_->evictions(), stats[2].evictions);
+    
+    // Entries bigger than their namespace's quota are refused
+    EXPECT_FALSE(cache_->set("calm:big", std::string(300 * 1024, 'x')));
+    EXPECT_TRUE(cache_->set("big", std::string(300 * 1024, 'x')));
+}
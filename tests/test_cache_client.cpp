@@ -0,0 +1,587 @@
+#include <gtest/gtest.h>
+#include "cache_client.h"
+#include "sharded_client.h"
+#include "hash_ring.h"
+#include "near_cache.h"
+#include <map>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+using cache::CacheClient;
+using cache::HashRing;
+using cache::NearCache;
+using cache::ShardedClient;
+
+namespace {
+
+// Line-protocol server on an ephemeral port. The handler's reply is sent
+// unless it is nullopt; close_after_reply drops each connection after one.
+class FakeServer {
+public:
+    using Handler = std::function<std::optional<std::string>(const std::string& request)>;
+    
+    explicit FakeServer(Handler handler, bool close_after_reply = false)
+        : handler_(std::move(handler)), close_after_reply_(close_after_reply) {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        socklen_t length = sizeof(address);
+        getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length);
+        port_ = ntohs(address.sin_port);
+        listen(listen_fd_, 16);
+        accept_thread_ = std::thread([this]() { accept_loop(); });
+    }
+    
+    ~FakeServer() {
+        stopping_ = true;
+        accept_thread_.join();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int fd : client_fds_) {
+                shutdown(fd, SHUT_RDWR);
+            }
+        }
+        for (auto& thread : client_threads_) {
+            thread.join();
+        }
+        for (int fd : client_fds_) {
+            close(fd);
+        }
+        close(listen_fd_);
+    }
+    
+    int port() const { return port_; }
+
+private:
+    Handler handler_;
+    bool close_after_reply_;
+    int listen_fd_ = -1;
+    int port_ = 0;
+    std::atomic<bool> stopping_{false};
+    std::mutex mutex_;
+    std::vector<int> client_fds_;
+    std::vector<std::thread> client_threads_;
+    std::thread accept_thread_;
+    
+    void accept_loop() {
+        while (!stopping_) {
+            pollfd poll_fd{listen_fd_, POLLIN, 0};
+            if (poll(&poll_fd, 1, 20) <= 0) {
+                continue;
+            }
+            int fd = accept(listen_fd_, nullptr, nullptr);
+            if (fd < 0) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            client_fds_.push_back(fd);
+            client_threads_.emplace_back([this, fd]() { serve(fd); });
+        }
+    }
+    
+    void serve(int fd) {
+        std::string buffer;
+        char chunk[4096];
+        ssize_t n;
+        while ((n = recv(fd, chunk, sizeof(chunk), 0)) > 0) {
+            buffer.append(chunk, n);
+            size_t pos;
+            while ((pos = buffer.find('\n')) != std::string::npos) {
+                std::string request = buffer.substr(0, pos);
+                buffer.erase(0, pos + 1);
+                auto reply = handler_(request);
+                if (!reply) {
+                    continue;
+                }
+                std::string line = *reply + "\n";
+                send(fd, line.data(), line.size(), MSG_NOSIGNAL);
+                if (close_after_reply_) {
+                    shutdown(fd, SHUT_RDWR);
+                    return;
+                }
+            }
+        }
+    }
+};
+
+// Serves SET, GET and DELETE from a map
+class MapHandler {
+public:
+    std::optional<std::string> operator()(const std::string& request) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t first = request.find(' ');
+        std::string command = request.substr(0, first);
+        std::string rest = first == std::string::npos ? "" : request.substr(first + 1);
+        if (command == "SET") {
+            size_t space = rest.find(' ');
+            values_[rest.substr(0, space)] = rest.substr(space + 1);
+            return "OK";
+        }
+        auto it = values_.find(rest);
+        if (it == values_.end()) {
+            return "ERROR NOT_FOUND";
+        }
+        if (command == "GET") {
+            return "OK " + it->second;
+        }
+        values_.erase(it);
+        return "OK";
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<std::string, std::string> values_;
+};
+
+CacheClient::Options options_for(int port) {
+    CacheClient::Options options;
+    options.port = port;
+    options.timeout = std::chrono::milliseconds(2000);
+    options.reconnect_delay = std::chrono::milliseconds(10);
+    return options;
+}
+
+} // namespace
+
+TEST(CacheClientTest, SetGetDelete) {
+    auto handler = std::make_shared<MapHandler>();
+    FakeServer server([handler](const std::string& request) { return (*handler)(request); });
+    CacheClient client(options_for(server.port()));
+    ASSERT_TRUE(client.connect());
+    
+    EXPECT_TRUE(client.set("key", "hello world").get());
+    EXPECT_EQ(client.get("key").get(), std::optional<std::string>("hello world"));
+    EXPECT_EQ(client.send_command("GET key"), "OK hello world");
+    EXPECT_TRUE(client.remove("key").get());
+    EXPECT_FALSE(client.remove("key").get());
+    EXPECT_EQ(client.get("key").get(), std::nullopt);
+}
+
+TEST(CacheClientTest, MatchesPipelinedRepliesInOrder) {
+    FakeServer server([](const std::string& request) { return "OK " + request.substr(4); });
+    auto options = options_for(server.port());
+    options.connections = 4;
+    CacheClient client(options);
+    ASSERT_TRUE(client.connect());
+    
+    // Callers on several threads share the pool without waiting for each other
+    constexpr int kThreads = 4;
+    constexpr int kRequests = 500;
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            std::vector<std::future<std::optional<std::string>>> replies;
+            for (int i = 0; i < kRequests; ++i) {
+                replies.push_back(client.get("key" + std::to_string(t * kRequests + i)));
+            }
+            for (int i = 0; i < kRequests; ++i) {
+                if (replies[i].get() != "key" + std::to_string(t * kRequests + i)) {
+                    mismatches++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(mismatches.load(), 0);
+    EXPECT_EQ(client.requests_sent(), static_cast<uint64_t>(kThreads * kRequests));
+}
+
+TEST(CacheClientTest, MgetIsOneWrite) {
+    auto handler = std::make_shared<MapHandler>();
+    FakeServer server([handler](const std::string& request) { return (*handler)(request); });
+    CacheClient client(options_for(server.port()));
+    ASSERT_TRUE(client.connect());
+    
+    std::vector<std::string> keys;
+    for (int i = 0; i < 200; ++i) {
+        keys.push_back("key" + std::to_string(i));
+        if (i % 2 == 0) {
+            client.set(keys.back(), "value" + std::to_string(i)).get();
+        }
+    }
+    uint64_t writes_before = client.writes();
+    auto values = client.mget(keys).get();
+    ASSERT_EQ(values.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (i % 2 == 0) {
+            EXPECT_EQ(values[i], std::optional<std::string>("value" + std::to_string(i)));
+        } else {
+            EXPECT_EQ(values[i], std::nullopt);
+        }
+    }
+    EXPECT_EQ(client.writes() - writes_before, 1u);
+    EXPECT_TRUE(client.mget({}).get().empty());
+}
+
+TEST(CacheClientTest, ReconnectsAfterServerCloses) {
+    FakeServer server([](const std::string&) { return std::string("OK"); }, true);
+    CacheClient client(options_for(server.port()));
+    ASSERT_TRUE(client.connect());
+    
+    EXPECT_EQ(client.send_command("CLEAR"), "OK");
+    // Wait for the I/O thread to see the close
+    for (int i = 0; i < 200 && client.is_connected(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_FALSE(client.is_connected());
+    
+    EXPECT_EQ(client.send_command("CLEAR"), "OK");
+    EXPECT_EQ(client.reconnects(), 1u);
+}
+
+TEST(CacheClientTest, TimesOutMissingReplies) {
+    FakeServer server([](const std::string& request) -> std::optional<std::string> {
+        if (request == "GET slow") {
+            return std::nullopt;
+        }
+        return std::string("OK");
+    });
+    auto options = options_for(server.port());
+    options.timeout = std::chrono::milliseconds(100);
+    CacheClient client(options);
+    ASSERT_TRUE(client.connect());
+    
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(client.send_command("GET slow"), "ERROR Timeout");
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+    
+    // The connection is reopened, since a late reply would be matched to the next request
+    EXPECT_EQ(client.send_command("GET fast"), "OK");
+    EXPECT_EQ(client.reconnects(), 1u);
+}
+
+TEST(CacheClientTest, ReportsUnreachableServer) {
+    int port;
+    {
+        FakeServer server([](const std::string&) { return std::string("OK"); });
+        port = server.port();
+    }
+    CacheClient client(options_for(port));
+    EXPECT_FALSE(client.connect());
+    EXPECT_FALSE(client.is_connected());
+    EXPECT_EQ(client.send_command("GET key"), "ERROR Not connected");
+    EXPECT_FALSE(client.set("key", "value").get());
+}
+
+TEST(CacheClientTest, RejectsEmbeddedNewlines) {
+    auto handler = std::make_shared<MapHandler>();
+    FakeServer server([handler](const std::string& request) { return (*handler)(request); });
+    CacheClient client(options_for(server.port()));
+    ASSERT_TRUE(client.connect());
+    
+    EXPECT_EQ(client.send_command("SET a 1\nSET b 2"), "ERROR Invalid command");
+    EXPECT_TRUE(client.set("a", "1").get());
+    EXPECT_EQ(client.get("a").get(), std::optional<std::string>("1"));
+}
+
+TEST(NearCacheTest, FillsAndInvalidates) {
+    NearCache::Options options;
+    options.capacity = 64;
+    options.ttl = std::chrono::milliseconds(50);
+    NearCache near(options);
+    
+    EXPECT_EQ(near.get("key"), std::nullopt);
+    near.fill("key", "value", near.begin_fill("key"));
+    EXPECT_EQ(near.get("key"), std::optional<std::string>("value"));
+    EXPECT_EQ(near.hits(), 1u);
+    EXPECT_EQ(near.misses(), 1u);
+    
+    near.invalidate("key");
+    EXPECT_EQ(near.get("key"), std::nullopt);
+    
+    // A reply that raced an invalidation is not cached
+    uint64_t token = near.begin_fill("key");
+    near.invalidate("key");
+    near.fill("key", "stale", token);
+    EXPECT_EQ(near.get("key"), std::nullopt);
+    
+    token = near.begin_fill("other");
+    near.invalidate_all();
+    near.fill("other", "stale", token);
+    EXPECT_EQ(near.size(), 0u);
+    
+    // Bounded by capacity, and by ttl
+    for (int i = 0; i < 200; ++i) {
+        std::string key = "key" + std::to_string(i);
+        near.fill(key, "value", near.begin_fill(key));
+    }
+    EXPECT_LE(near.size(), 64u);
+    EXPECT_GT(near.size(), 0u);
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    for (int i = 0; i < 200; ++i) {
+        EXPECT_EQ(near.get("key" + std::to_string(i)), std::nullopt);
+    }
+    
+    NearCache disabled;
+    disabled.fill("key", "value", disabled.begin_fill("key"));
+    EXPECT_EQ(disabled.get("key"), std::nullopt);
+}
+
+TEST(CacheClientTest, NearCacheServesRepeatReads) {
+    auto handler = std::make_shared<MapHandler>();
+    std::atomic<int> gets{0};
+    std::atomic<int> tracking{0};
+    FakeServer server([&, handler](const std::string& request) -> std::optional<std::string> {
+        if (request == "TRACKING ON") {
+            tracking++;
+            return std::string("OK");
+        }
+        if (request.rfind("GET ", 0) == 0) {
+            gets++;
+        }
+        return (*handler)(request);
+    });
+    auto options = options_for(server.port());
+    options.near_cache.capacity = 100;
+    options.near_cache.ttl = std::chrono::seconds(60);
+    CacheClient client(options);
+    ASSERT_TRUE(client.connect());
+    ASSERT_NE(client.near_cache(), nullptr);
+    
+    EXPECT_TRUE(client.set("key", "1").get());
+    EXPECT_EQ(client.get("key").get(), std::optional<std::string>("1"));
+    EXPECT_EQ(client.get("key").get(), std::optional<std::string>("1"));
+    EXPECT_EQ(gets, 1);
+    EXPECT_EQ(tracking, 1);
+    
+    // Own writes are read back, not the cached copy
+    EXPECT_TRUE(client.set("key", "2").get());
+    EXPECT_EQ(client.get("key").get(), std::optional<std::string>("2"));
+    EXPECT_EQ(gets, 2);
+    
+    EXPECT_TRUE(client.set("other", "3").get());
+    auto values = client.mget({"key", "other", "missing"}).get();
+    EXPECT_EQ(values[0], std::optional<std::string>("2"));
+    EXPECT_EQ(values[1], std::optional<std::string>("3"));
+    EXPECT_EQ(values[2], std::nullopt);
+    EXPECT_EQ(gets, 4);     // "key" was a near cache hit
+    
+    EXPECT_TRUE(client.remove("key").get());
+    EXPECT_EQ(client.get("key").get(), std::nullopt);
+    EXPECT_EQ(client.near_cache()->hits(), 2u);
+}
+
+TEST(CacheClientTest, NearCacheAppliesInvalidationPushes) {
+    // "WRITE key value" stands in for another client's write: the server
+    // pushes the invalidation ahead of the reply
+    auto handler = std::make_shared<MapHandler>();
+    std::atomic<int> gets{0};
+    FakeServer server([&, handler](const std::string& request) -> std::optional<std::string> {
+        if (request.rfind("WRITE ", 0) == 0) {
+            std::string rest = request.substr(6);
+            (*handler)("SET " + rest);
+            std::string key = rest.substr(0, rest.find(' '));
+            return key == "all" ? "INVALIDATE *\nOK" : "INVALIDATE " + key + "\nOK";
+        }
+        if (request.rfind("GET ", 0) == 0) {
+            gets++;
+        }
+        return (*handler)(request);
+    });
+    auto options = options_for(server.port());
+    options.near_cache.capacity = 100;
+    options.near_cache.ttl = std::chrono::seconds(60);
+    CacheClient client(options);
+    ASSERT_TRUE(client.connect());
+    
+    EXPECT_EQ(client.send_command("WRITE key 1"), "OK");
+    EXPECT_EQ(client.get("key").get(), std::optional<std::string>("1"));
+    EXPECT_EQ(client.get("key").get(), std::optional<std::string>("1"));
+    EXPECT_EQ(gets, 1);
+    
+    EXPECT_EQ(client.send_command("WRITE key 2"), "OK");
+    EXPECT_EQ(client.get("key").get(), std::optional<std::string>("2"));
+    EXPECT_EQ(gets, 2);
+    
+    EXPECT_EQ(client.send_command("WRITE all x"), "OK");
+    EXPECT_EQ(client.near_cache()->size(), 0u);
+}
+
+TEST(HashRingTest, SpreadsKeysEvenly) {
+    HashRing ring;
+    for (int i = 0; i < 4; ++i) {
+        ring.add("127.0.0.1:" + std::to_string(9000 + i));
+    }
+    std::vector<int> counts(4, 0);
+    for (int i = 0; i < 40000; ++i) {
+        counts[ring.node_for("key" + std::to_string(i))]++;
+    }
+    for (int count : counts) {
+        EXPECT_NEAR(count, 10000, 1500);
+    }
+}
+
+TEST(HashRingTest, AddingANodeMovesOnlyItsShare) {
+    HashRing before;
+    HashRing after;
+    for (int i = 0; i < 4; ++i) {
+        before.add("node" + std::to_string(i));
+        after.add("node" + std::to_string(i));
+    }
+    size_t added = after.add("node4");
+    
+    int moved = 0;
+    for (int i = 0; i < 20000; ++i) {
+        std::string key = "key" + std::to_string(i);
+        size_t owner = after.node_for(key);
+        if (owner != before.node_for(key)) {
+            moved++;
+            EXPECT_EQ(owner, added);    // Keys only move to the new node
+        }
+    }
+    EXPECT_NEAR(moved, 20000 / 5, 800);
+}
+
+TEST(HashRingTest, PreferenceListAndFailover) {
+    HashRing ring(50);
+    for (int i = 0; i < 3; ++i) {
+        ring.add("node" + std::to_string(i));
+    }
+    auto preference = ring.preference_list("some-key", 5);
+    ASSERT_EQ(preference.size(), 3u);
+    EXPECT_EQ(std::set<size_t>(preference.begin(), preference.end()).size(), 3u);
+    EXPECT_EQ(preference[0], ring.node_for("some-key"));
+    
+    // Skipping the owner lands on the next node in ring order
+    size_t owner = preference[0];
+    EXPECT_EQ(ring.node_for("some-key", [owner](size_t node) { return node != owner; }), preference[1]);
+    EXPECT_EQ(ring.node_for("some-key", [](size_t) { return false; }), owner);
+    
+    // Placement does not depend on the standard library's hash
+    EXPECT_EQ(HashRing::hash(""), HashRing::hash(""));
+    EXPECT_NE(HashRing::hash("node0-0"), HashRing::hash("node0-1"));
+}
+
+namespace {
+
+// Map-backed node that records the keys it was asked for
+struct Node {
+    std::shared_ptr<MapHandler> handler = std::make_shared<MapHandler>();
+    std::shared_ptr<std::atomic<int>> requests = std::make_shared<std::atomic<int>>(0);
+    std::unique_ptr<FakeServer> server;
+    
+    Node() {
+        auto map = handler;
+        auto count = requests;
+        server = std::make_unique<FakeServer>([map, count](const std::string& request) {
+            (*count)++;
+            return (*map)(request);
+        });
+    }
+    
+    std::string name() const { return "127.0.0.1:" + std::to_string(server->port()); }
+};
+
+ShardedClient::Options sharded_options(const std::vector<std::unique_ptr<Node>>& nodes) {
+    ShardedClient::Options options;
+    for (const auto& node : nodes) {
+        options.nodes.push_back(node->name());
+    }
+    options.client = options_for(0);
+    options.down_time = std::chrono::milliseconds(60000);
+    return options;
+}
+
+} // namespace
+
+TEST(ShardedClientTest, RoutesKeysByRing) {
+    std::vector<std::unique_ptr<Node>> nodes;
+    for (int i = 0; i < 3; ++i) {
+        nodes.push_back(std::make_unique<Node>());
+    }
+    ShardedClient client(sharded_options(nodes));
+    ASSERT_TRUE(client.connect());
+    ASSERT_EQ(client.node_count(), 3u);
+    
+    std::vector<std::string> keys;
+    for (int i = 0; i < 300; ++i) {
+        keys.push_back("key" + std::to_string(i));
+        EXPECT_TRUE(client.set(keys.back(), "value" + std::to_string(i)).get());
+    }
+    for (const auto& node : nodes) {
+        EXPECT_GT(node->requests->load(), 50);
+    }
+    for (int i = 0; i < 300; ++i) {
+        // Each key lives only on its owner
+        size_t owner = client.node_for(keys[i]);
+        EXPECT_EQ(client.node(owner).send_command("GET " + keys[i]), "OK value" + std::to_string(i));
+        EXPECT_EQ(client.node((owner + 1) % 3).send_command("GET " + keys[i]), "ERROR NOT_FOUND");
+    }
+    
+    keys.push_back("missing");
+    auto values = client.mget(keys).get();
+    ASSERT_EQ(values.size(), keys.size());
+    for (int i = 0; i < 300; ++i) {
+        EXPECT_EQ(values[i], std::optional<std::string>("value" + std::to_string(i)));
+    }
+    EXPECT_EQ(values.back(), std::nullopt);
+    EXPECT_EQ(client.failovers(), 0u);
+}
+
+TEST(ShardedClientTest, FailsOverToNextNode) {
+    std::vector<std::unique_ptr<Node>> nodes;
+    for (int i = 0; i < 3; ++i) {
+        nodes.push_back(std::make_unique<Node>());
+    }
+    ShardedClient client(sharded_options(nodes));
+    ASSERT_TRUE(client.connect());
+    
+    // Find keys owned by node 1, then take it down
+    std::vector<std::string> keys;
+    for (int i = 0; keys.size() < 20; ++i) {
+        std::string key = "key" + std::to_string(i);
+        if (client.node_for(key) == 1) {
+            keys.push_back(key);
+        }
+    }
+    nodes[1]->server.reset();
+    
+    for (const auto& key : keys) {
+        EXPECT_TRUE(client.set(key, "moved").get());
+    }
+    EXPECT_TRUE(client.is_down(1));
+    EXPECT_GE(client.failovers(), 1u);
+    for (const auto& key : keys) {
+        EXPECT_NE(client.node_for(key), 1u);
+        EXPECT_EQ(client.get(key).get(), std::optional<std::string>("moved"));
+    }
+    auto values = client.mget(keys).get();
+    for (const auto& value : values) {
+        EXPECT_EQ(value, std::optional<std::string>("moved"));
+    }
+}
+
+TEST(ShardedClientTest, StartsWithANodeDown) {
+    std::vector<std::unique_ptr<Node>> nodes;
+    for (int i = 0; i < 2; ++i) {
+        nodes.push_back(std::make_unique<Node>());
+    }
+    auto options = sharded_options(nodes);
+    nodes[0]->server.reset();
+    ShardedClient client(options);
+    ASSERT_TRUE(client.connect());
+    EXPECT_TRUE(client.is_down(0));
+    
+    for (int i = 0; i < 50; ++i) {
+        EXPECT_TRUE(client.set("key" + std::to_string(i), "value").get());
+    }
+    EXPECT_EQ(client.failovers(), 0u);     // Skipped up front, not discovered per request
+    
+    ShardedClient::Options bad;
+    bad.nodes = {"no-port"};
+    ShardedClient invalid(bad);
+    EXPECT_FALSE(invalid.connect());
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include "compactor.h"
+#include <string>
+#include <thread>
+
+using cache::Cache;
+using cache::Compactor;
+using cache::SlabAllocator;
+
+TEST(CompactorTest, CompactionKeepsItemsReadable) {
+    Cache cache(64 * 1024 * 1024, 4);
+    ASSERT_TRUE(cache.add_namespace("ns", 16 * 1024 * 1024));
+    for (int i = 0; i < 20000; ++i) {
+        std::string key = (i % 2 ? "ns:key" : "key") + std::to_string(i);
+        ASSERT_TRUE(cache.set(key, std::string(100, static_cast<char>('a' + i % 26))));
+    }
+    // Deleting three keys in four leaves every page a quarter full
+    for (int i = 0; i < 20000; ++i) {
+        if (i % 4 != 0) {
+            std::string key = (i % 2 ? "ns:key" : "key") + std::to_string(i);
+            ASSERT_TRUE(cache.remove(key));
+        }
+    }
+    size_t reserved = cache.reserved_memory();
+    double fragmentation = cache.fragmentation_ratio();
+    EXPECT_GT(fragmentation, 0.5);
+    
+    EXPECT_GT(cache.compact(0.5, SIZE_MAX), 0u);
+    EXPECT_LT(cache.reserved_memory(), reserved);
+    EXPECT_LT(cache.fragmentation_ratio(), fragmentation);
+    EXPECT_GT(cache.items_relocated(), 0u);
+    EXPECT_GT(cache.pages_compacted(), 0u);
+    
+    // Moved items are found through the index and still unlink cleanly
+    EXPECT_EQ(cache.size(), 5000u);
+    for (int i = 0; i < 20000; i += 4) {
+        std::string key = (i % 2 ? "ns:key" : "key") + std::to_string(i);
+        ASSERT_EQ(cache.get(key), std::string(100, static_cast<char>('a' + i % 26))) << key;
+        ASSERT_TRUE(cache.remove(key));
+    }
+    EXPECT_EQ(cache.size(), 0u);
+    EXPECT_EQ(cache.memory_usage(), 0u);
+}
+
+TEST(CompactorTest, RebalancesPagesToEvictingClasses) {
+    Cache cache(1024 * 1024, 1);
+    cache::Arena::Options options;
+    options.arena_size = SlabAllocator::kPageSize;
+    cache.set_memory_options(options);
+    
+    // Fill with small items and touch every other one, so evicting the rest
+    // frees chunks on every page but empties none
+    int count = 0;
+    while (cache.memory_usage() < 1024 * 1024 * 9 / 10) {
+        ASSERT_TRUE(cache.set("small" + std::to_string(count++), std::string(100, 's')));
+    }
+    for (int i = 0; i < count; i += 2) {
+        cache.get("small" + std::to_string(i));
+    }
+    // The large class then keeps mapping new pages while the evictions
+    // leave the small class with spare chunks
+    for (int i = 0; i < 40; ++i) {
+        ASSERT_TRUE(cache.set("large" + std::to_string(i), std::string(4000, 'l')));
+    }
+    ASSERT_GT(cache.evictions(), 0u);
+    size_t mapped = cache.mapped_memory();
+    
+    EXPECT_EQ(cache.compact(0.0, SIZE_MAX), 1u);
+    EXPECT_EQ(cache.pages_rebalanced(), 1u);
+    
+    // The large class grows into the freed page instead of a new arena
+    for (int i = 40; i < 50; ++i) {
+        ASSERT_TRUE(cache.set("large" + std::to_string(i), std::string(4000, 'l')));
+    }
+    EXPECT_EQ(cache.mapped_memory(), mapped);
+    auto stats = cache.slab_stats()[SlabAllocator::class_for(100 + 48 + 6)];
+    EXPECT_GT(stats.evictions, 0u);
+}
+
+TEST(CompactorTest, RunsInTheBackground) {
+    Cache cache(64 * 1024 * 1024, 2);
+    for (int i = 0; i < 10000; ++i) {
+        cache.set("key" + std::to_string(i), std::string(200, 'v'));
+    }
+    for (int i = 0; i < 10000; ++i) {
+        if (i % 8 != 0) {
+            cache.remove("key" + std::to_string(i));
+        }
+    }
+    
+    Compactor::Options options;
+    options.interval = std::chrono::milliseconds(5);
+    Compactor compactor(cache, options);
+    compactor.start();
+    for (int i = 0; i < 200 && compactor.pages_freed() == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    compactor.stop();
+    
+    EXPECT_GT(compactor.passes(), 0u);
+    EXPECT_GT(compactor.pages_freed(), 0u);
+    for (int i = 0; i < 10000; i += 8) {
+        ASSERT_EQ(cache.get("key" + std::to_string(i)), std::string(200, 'v'));
+    }
+}
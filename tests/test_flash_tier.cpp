@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+#include "flash_tier.h"
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+class FlashTierTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        options_.path = ::testing::TempDir() + "cache_flash_tier_test.bin";
+        options_.segment_size = 4096;
+        options_.num_segments = 4;
+        tier_ = std::make_unique<cache::FlashTier>(options_);
+        ASSERT_TRUE(tier_->open());
+    }
+    
+    void TearDown() override {
+        tier_.reset();
+        std::remove(options_.path.c_str());
+    }
+    
+    void wait_for_flush() {
+        for (int i = 0; i < 200 && tier_->bytes_written() == 0; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+    
+    cache::FlashTier::Options options_;
+    std::unique_ptr<cache::FlashTier> tier_;
+};
+
+TEST_F(FlashTierTest, InsertAndFind) {
+    EXPECT_TRUE(tier_->insert(cache::Cache::CacheEntry("key1", "value1", 7)));
+    EXPECT_TRUE(tier_->insert(cache::Cache::CacheEntry("counter", int64_t{42}, 8)));
+    
+    auto found = tier_->find("key1");
+    ASSERT_TRUE(found.has_value());
+    EXPECT_EQ(found->entry.value, "value1");
+    EXPECT_EQ(found->entry.version, 7u);
+    
+    auto counter = tier_->find("counter");
+    ASSERT_TRUE(counter.has_value());
+    EXPECT_TRUE(counter->entry.is_integer);
+    EXPECT_EQ(counter->entry.int_value, 42);
+    
+    EXPECT_FALSE(tier_->find("missing").has_value());
+}
+
+TEST_F(FlashTierTest, ReadsFromDeviceAfterFlush) {
+    std::string value(1000, 'v');
+    for (int i = 0; i < 10; ++i) {
+        tier_->insert(cache::Cache::CacheEntry("key_" + std::to_string(i), value, i));
+    }
+    wait_for_flush();
+    EXPECT_GT(tier_->bytes_written(), 0u);
+    
+    auto found = tier_->find("key_0");
+    ASSERT_TRUE(found.has_value());
+    EXPECT_EQ(found->entry.value, value);
+}
+
+TEST_F(FlashTierTest, FifoReclaimDropsOldestSegment) {
+    std::string value(1000, 'v');
+    for (int i = 0; i < 20; ++i) {
+        tier_->insert(cache::Cache::CacheEntry("key_" + std::to_string(i), value, i));
+        // Give the flusher time so no demotion is shed for backpressure
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    EXPECT_EQ(tier_->dropped(), 0u);
+    
+    // 20 x ~1KB records span five 4KB segments, so the first one was reused
+    EXPECT_FALSE(tier_->find("key_0").has_value());
+    EXPECT_TRUE(tier_->find("key_19").has_value());
+}
+
+TEST_F(FlashTierTest, EraseIfRejectsStaleLocation) {
+    tier_->insert(cache::Cache::CacheEntry("key1", "old", 1));
+    auto found = tier_->find("key1");
+    ASSERT_TRUE(found.has_value());
+    
+    tier_->insert(cache::Cache::CacheEntry("key1", "new", 2));
+    EXPECT_FALSE(tier_->erase_if("key1", found->location));
+    EXPECT_EQ(tier_->find("key1")->entry.value, "new");
+}
+
+TEST_F(FlashTierTest, EraseComparesFullKey) {
+    std::string value(1000, 'v');
+    for (int i = 0; i < 10; ++i) {
+        tier_->insert(cache::Cache::CacheEntry("key_" + std::to_string(i), value, i));
+    }
+    // Past the first segment, so it is only readable from the device
+    for (int i = 0; i < 200 && tier_->bytes_written() < 2 * 3 * 1026; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    ASSERT_GE(tier_->bytes_written(), 2 * 3 * 1026u);
+    
+    // Put a valid record for another key in key_0's slot, as a hash collision would
+    std::string record(12, '\0');
+    record += std::string(1, '\0') + std::string(8, '\0') + "key_x" + std::string(1000, 'w');
+    uint32_t key_len = 5;
+    uint32_t value_len = 1000;
+    std::memcpy(&record[4], &key_len, sizeof(key_len));
+    std::memcpy(&record[8], &value_len, sizeof(value_len));
+    uint32_t checksum = 2166136261u;
+    for (size_t i = 4; i < record.size(); ++i) {
+        checksum ^= static_cast<uint8_t>(record[i]);
+        checksum *= 16777619u;
+    }
+    std::memcpy(&record[0], &checksum, sizeof(checksum));
+    FILE* file = std::fopen(options_.path.c_str(), "r+b");
+    ASSERT_NE(file, nullptr);
+    ASSERT_EQ(std::fwrite(record.data(), 1, record.size(), file), record.size());
+    std::fclose(file);
+    
+    EXPECT_FALSE(tier_->find("key_0").has_value());
+    EXPECT_FALSE(tier_->erase("key_0"));
+    EXPECT_TRUE(tier_->erase("key_1"));
+    EXPECT_FALSE(tier_->contains("key_1"));
+}
+
+TEST_F(FlashTierTest, CacheDemotesAndPromotes) {
+    cache::Cache cache(1024, 1);
+    cache.attach_flash_tier(tier_.get());
+    
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_TRUE(cache.set("key_" + std::to_string(i), "value_" + std::to_string(i)));
+    }
+    EXPECT_LT(cache.size(), 20u);
+    EXPECT_GT(tier_->size(), 0u);
+    
+    // Every key is still readable, the evicted ones from flash
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_EQ(cache.get("key_" + std::to_string(i)), "value_" + std::to_string(i));
+    }
+    EXPECT_GT(cache.flash_hits(), 0u);
+    EXPECT_EQ(cache.ram_hits() + cache.flash_hits(), 20u);
+    
+    cache.attach_flash_tier(nullptr);
+}
+
+TEST_F(FlashTierTest, CacheRemoveDeletesFlashCopy) {
+    cache::Cache cache(1024, 1);
+    cache.attach_flash_tier(tier_.get());
+    
+    for (int i = 0; i < 20; ++i) {
+        cache.set("key_" + std::to_string(i), "value_" + std::to_string(i));
+    }
+    ASSERT_TRUE(tier_->contains("key_0"));
+    
+    EXPECT_TRUE(cache.remove("key_0"));
+    EXPECT_EQ(cache.get("key_0"), "");
+    EXPECT_FALSE(cache.remove("key_0"));
+    
+    cache.attach_flash_tier(nullptr);
+}
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include "hdr_histogram.h"
+
+TEST(HdrHistogramTest, EmptyHistogram) {
+    cache::HdrHistogram histogram;
+    EXPECT_EQ(histogram.count(), 0u);
+    EXPECT_EQ(histogram.min(), 0u);
+    EXPECT_EQ(histogram.max(), 0u);
+    EXPECT_EQ(histogram.percentile(99.0), 0u);
+}
+
+TEST(HdrHistogramTest, SmallValuesAreExact) {
+    cache::HdrHistogram histogram;
+    for (uint64_t v = 1; v <= 1000; ++v) {
+        histogram.record(v);
+    }
+    
+    EXPECT_EQ(histogram.count(), 1000u);
+    EXPECT_EQ(histogram.min(), 1u);
+    EXPECT_EQ(histogram.max(), 1000u);
+    EXPECT_DOUBLE_EQ(histogram.mean(), 500.5);
+    EXPECT_EQ(histogram.percentile(50.0), 500u);
+    EXPECT_EQ(histogram.percentile(99.0), 990u);
+    EXPECT_EQ(histogram.percentile(100.0), 1000u);
+}
+
+TEST(HdrHistogramTest, LargeValuesKeepThreeSignificantDigits) {
+    cache::HdrHistogram histogram;
+    histogram.record(123456789);
+    
+    uint64_t reported = histogram.percentile(50.0);
+    EXPECT_GE(reported, 123456789u);
+    EXPECT_LE(reported, 123456789u + 123456789u / 1000);
+}
+
+TEST(HdrHistogramTest, TailPercentiles) {
+    cache::HdrHistogram histogram;
+    histogram.record(100, 9990);
+    histogram.record(50000, 10);
+    
+    EXPECT_EQ(histogram.percentile(99.0), 100u);
+    EXPECT_GE(histogram.percentile(99.99), 50000u);
+    EXPECT_LE(histogram.percentile(99.99), 50050u);
+}
+
+TEST(HdrHistogramTest, CoordinatedOmissionCorrection) {
+    cache::HdrHistogram histogram;
+    // A 1000us stall with requests due every 100us hides nine more samples
+    histogram.record_corrected(1000, 100);
+    
+    EXPECT_EQ(histogram.count(), 10u);
+    EXPECT_EQ(histogram.min(), 100u);
+    EXPECT_EQ(histogram.max(), 1000u);
+}
+
+TEST(HdrHistogramTest, MergeAndClamp) {
+    cache::HdrHistogram a(1000000);
+    cache::HdrHistogram b(1000000);
+    a.record(10);
+    b.record(20);
+    b.record(5000000); // Clamped to the highest trackable value
+    
+    a.merge(b);
+    EXPECT_EQ(a.count(), 3u);
+    EXPECT_EQ(a.min(), 10u);
+    EXPECT_EQ(a.max(), 1000000u);
+    
+    a.reset();
+    EXPECT_EQ(a.count(), 0u);
+}
@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+#include "hot_keys.h"
+#include "cache.h"
+#include "protocol.h"
+#include <thread>
+#include <vector>
+
+using cache::HotKeys;
+
+namespace {
+
+HotKeys::Options unsampled() {
+    HotKeys::Options options;
+    options.sample_rate = 1;
+    options.top_k = 4;
+    return options;
+}
+
+} // namespace
+
+TEST(HotKeysTest, FindsHottestKeys) {
+    HotKeys tracker(unsampled());
+    for (int round = 0; round < 1000; ++round) {
+        tracker.record_access("hot");
+        if (round % 2 == 0) {
+            tracker.record_access("warm");
+        }
+        tracker.record_access("cold" + std::to_string(round));
+    }
+    
+    auto hot = tracker.hot_keys(2);
+    ASSERT_EQ(hot.size(), 2u);
+    EXPECT_EQ(hot[0].key, "hot");
+    EXPECT_EQ(hot[1].key, "warm");
+    // Count-min estimates never undercount
+    EXPECT_GE(hot[0].count, 1000u);
+    EXPECT_GE(tracker.estimate("warm"), 500u);
+    EXPECT_EQ(tracker.samples(), 2500u);
+}
+
+TEST(HotKeysTest, SamplingScalesEstimates) {
+    HotKeys::Options options;
+    options.sample_rate = 8;
+    HotKeys tracker(options);
+    for (int i = 0; i < 80000; ++i) {
+        tracker.record_access("hot");
+    }
+    
+    // About one access in eight is counted, then scaled back up
+    EXPECT_NEAR(static_cast<double>(tracker.samples()), 10000.0, 1000.0);
+    auto hot = tracker.hot_keys(1);
+    ASSERT_EQ(hot.size(), 1u);
+    EXPECT_NEAR(static_cast<double>(hot[0].count), 80000.0, 8000.0);
+}
+
+TEST(HotKeysTest, DecayFollowsWorkload) {
+    HotKeys::Options options = unsampled();
+    options.decay_interval = 1000;
+    HotKeys tracker(options);
+    for (int i = 0; i < 5000; ++i) {
+        tracker.record_access("old");
+    }
+    for (int i = 0; i < 5000; ++i) {
+        tracker.record_access("new");
+    }
+    
+    auto hot = tracker.hot_keys(2);
+    ASSERT_FALSE(hot.empty());
+    EXPECT_EQ(hot[0].key, "new");
+    EXPECT_LT(tracker.estimate("old"), 1000u);
+}
+
+TEST(HotKeysTest, TracksBigKeys) {
+    HotKeys tracker(unsampled());
+    for (int i = 0; i < 10; ++i) {
+        tracker.record_size("key" + std::to_string(i), 100 * (i + 1));
+    }
+    
+    auto big = tracker.big_keys(10);
+    ASSERT_EQ(big.size(), 4u);
+    EXPECT_EQ(big[0].key, "key9");
+    EXPECT_EQ(big[0].count, 1000u);
+    EXPECT_EQ(big[3].key, "key6");
+    
+    tracker.correct_size("key9", 0);
+    tracker.correct_size("key8", 50);
+    big = tracker.big_keys(10);
+    ASSERT_EQ(big.size(), 3u);
+    EXPECT_EQ(big[0].key, "key7");
+    EXPECT_EQ(big[2].key, "key8");
+    
+    tracker.reset();
+    EXPECT_TRUE(tracker.big_keys(10).empty());
+    EXPECT_TRUE(tracker.hot_keys(10).empty());
+}
+
+TEST(HotKeysTest, ConcurrentAccess) {
+    HotKeys tracker(unsampled());
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&tracker, t]() {
+            for (int i = 0; i < 10000; ++i) {
+                tracker.record_access("shared");
+                tracker.record_access("thread" + std::to_string(t) + "-" + std::to_string(i % 100));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    auto hot = tracker.hot_keys(1);
+    ASSERT_EQ(hot.size(), 1u);
+    EXPECT_EQ(hot[0].key, "shared");
+    EXPECT_GE(tracker.estimate("shared"), 40000u);
+}
+
+TEST(HotKeysTest, CacheReportsCurrentBigKeys) {
+    cache::Cache cache(1024 * 1024);
+    cache.set("small", "x");
+    cache.set("large", std::string(10000, 'x'));
+    cache.set("medium", std::string(1000, 'x'));
+    
+    auto big = cache.big_keys(2);
+    ASSERT_EQ(big.size(), 2u);
+    EXPECT_EQ(big[0].key, "large");
+    EXPECT_EQ(big[1].key, "medium");
+    
+    // Removed and shrunk keys are dropped or re-sized on the next report
+    cache.remove("large");
+    cache.set("medium", "y");
+    big = cache.big_keys(10);
+    ASSERT_FALSE(big.empty());
+    EXPECT_NE(big[0].key, "large");
+    EXPECT_LT(big[0].count, 1000u);
+}
+
+TEST(HotKeysTest, ParsesCommands) {
+    auto hot = cache::Protocol::parse_request("HOTKEYS");
+    EXPECT_TRUE(hot.valid);
+    EXPECT_EQ(hot.command, cache::Protocol::Command::HOTKEYS);
+    EXPECT_EQ(hot.delta, 10);
+    
+    auto big = cache::Protocol::parse_request("bigkeys 3");
+    EXPECT_TRUE(big.valid);
+    EXPECT_EQ(big.command, cache::Protocol::Command::BIGKEYS);
+    EXPECT_EQ(big.delta, 3);
+    
+    EXPECT_FALSE(cache::Protocol::parse_request("HOTKEYS -1").valid);
+    EXPECT_FALSE(cache::Protocol::parse_request("BIGKEYS 1 2").valid);
+}
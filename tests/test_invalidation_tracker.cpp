@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include "invalidation_tracker.h"
+#include "cache.h"
+#include "protocol.h"
+#include <mutex>
+#include <string>
+#include <vector>
+
+using cache::InvalidationTracker;
+
+namespace {
+
+// Records the pushes a client receives
+struct Inbox {
+    std::mutex mutex;
+    std::vector<std::string> messages;
+    
+    InvalidationTracker::Push push() {
+        return [this](const std::string& message) {
+            std::lock_guard<std::mutex> lock(mutex);
+            messages.push_back(message);
+        };
+    }
+    
+    std::vector<std::string> take() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::move(messages);
+    }
+};
+
+} // namespace
+
+TEST(InvalidationTrackerTest, PushesOnceToEachSubscriber) {
+    InvalidationTracker tracker;
+    Inbox a;
+    Inbox b;
+    uint64_t client_a = tracker.add_client(a.push());
+    uint64_t client_b = tracker.add_client(b.push());
+    EXPECT_NE(client_a, 0u);
+    EXPECT_NE(client_a, client_b);
+    EXPECT_EQ(tracker.clients(), 2u);
+    
+    tracker.track(client_a, "key");
+    tracker.track(client_a, "key");
+    tracker.track(client_b, "key");
+    tracker.track(client_b, "other");
+    EXPECT_EQ(tracker.tracked_keys(), 2u);
+    
+    tracker.invalidate("key");
+    EXPECT_EQ(a.take(), std::vector<std::string>{"INVALIDATE key"});
+    EXPECT_EQ(b.take(), std::vector<std::string>{"INVALIDATE key"});
+    EXPECT_EQ(tracker.invalidations_sent(), 2u);
+    EXPECT_EQ(tracker.tracked_keys(), 1u);
+    
+    // One-shot: nobody has read the key since
+    tracker.invalidate("key");
+    tracker.invalidate("untracked");
+    EXPECT_TRUE(a.take().empty());
+    EXPECT_TRUE(b.take().empty());
+}
+
+TEST(InvalidationTrackerTest, RemovedClientsAreNotPushed) {
+    InvalidationTracker tracker;
+    Inbox a;
+    uint64_t client = tracker.add_client(a.push());
+    tracker.track(client, "key");
+    tracker.remove_client(client);
+    EXPECT_EQ(tracker.clients(), 0u);
+    
+    tracker.invalidate("key");
+    tracker.invalidate_all();
+    EXPECT_TRUE(a.take().empty());
+    EXPECT_EQ(tracker.invalidations_sent(), 0u);
+}
+
+TEST(InvalidationTrackerTest, InvalidateAllReachesEveryClient) {
+    InvalidationTracker tracker;
+    Inbox a;
+    Inbox b;
+    uint64_t client_a = tracker.add_client(a.push());
+    tracker.add_client(b.push());
+    tracker.track(client_a, "key");
+    
+    tracker.invalidate_all();
+    EXPECT_EQ(a.take(), std::vector<std::string>{"INVALIDATE *"});
+    EXPECT_EQ(b.take(), std::vector<std::string>{"INVALIDATE *"});
+    EXPECT_EQ(tracker.tracked_keys(), 0u);
+    
+    tracker.invalidate("key");
+    EXPECT_TRUE(a.take().empty());
+}
+
+TEST(InvalidationTrackerTest, ForgetsKeysBeyondTheBound) {
+    InvalidationTracker tracker(4, 1);
+    Inbox a;
+    uint64_t client = tracker.add_client(a.push());
+    for (int i = 0; i < 5; ++i) {
+        tracker.track(client, "key" + std::to_string(i));
+    }
+    EXPECT_EQ(tracker.tracked_keys(), 4u);
+    
+    // The forgotten key was invalidated rather than silently dropped
+    auto messages = a.take();
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_EQ(messages[0].rfind("INVALIDATE key", 0), 0u);
+}
+
+TEST(InvalidationTrackerTest, CacheWritesInvalidateTrackedKeys) {
+    InvalidationTracker tracker;
+    cache::Cache cache(1024 * 1024, 4);
+    cache.attach_invalidation_tracker(&tracker);
+    Inbox a;
+    uint64_t client = tracker.add_client(a.push());
+    
+    cache.set("key", "1");
+    EXPECT_TRUE(a.take().empty());
+    
+    tracker.track(client, "key");
+    EXPECT_EQ(cache.get("key"), "1");
+    EXPECT_TRUE(a.take().empty());
+    cache.set("key", "2");
+    EXPECT_EQ(a.take(), std::vector<std::string>{"INVALIDATE key"});
+    
+    tracker.track(client, "key");
+    cache.incr("key", 1);
+    EXPECT_EQ(a.take(), std::vector<std::string>{"INVALIDATE key"});
+    
+    // A failed CAS changes nothing
+    tracker.track(client, "key");
+    cache.cas("key", "4", 0);
+    EXPECT_TRUE(a.take().empty());
+    cache.cas("key", "4", cache.get_versioned("key")->version);
+    EXPECT_EQ(a.take(), std::vector<std::string>{"INVALIDATE key"});
+    
+    // The client may hold a copy of a key the server no longer has
+    tracker.track(client, "gone");
+    EXPECT_FALSE(cache.remove("gone"));
+    EXPECT_EQ(a.take(), std::vector<std::string>{"INVALIDATE gone"});
+    
+    cache.clear();
+    EXPECT_EQ(a.take(), std::vector<std::string>{"INVALIDATE *"});
+}
+
+TEST(InvalidationTrackerTest, ParsesTrackingCommand) {
+    auto on = cache::Protocol::parse_request("TRACKING on");
+    EXPECT_TRUE(on.valid);
+    EXPECT_EQ(on.command, cache::Protocol::Command::TRACKING);
+    EXPECT_EQ(on.key, "ON");
+    EXPECT_TRUE(cache::Protocol::parse_request("tracking OFF").valid);
+    EXPECT_FALSE(cache::Protocol::parse_request("TRACKING").valid);
+    EXPECT_FALSE(cache::Protocol::parse_request("TRACKING maybe").valid);
+    EXPECT_STREQ(cache::Protocol::command_name(cache::Protocol::Command::TRACKING), "tracking");
+}
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include "item.h"
+#include <string>
+#include <vector>
+
+using cache::Item;
+using cache::ItemTable;
+using cache::SlabAllocator;
+
+namespace {
+
+uint32_t hash_of(const std::string& key) {
+    return static_cast<uint32_t>(std::hash<std::string>{}(key));
+}
+
+Item* make(SlabAllocator& allocator, const std::string& key, const std::string& value) {
+    return Item::create(allocator, key, value, 0, 1, hash_of(key));
+}
+
+} // namespace
+
+TEST(ItemTest, PacksKeyAndValueAfterTheHeader) {
+    SlabAllocator allocator;
+    std::string key(20, 'k');
+    std::string value(50, 'v');
+    Item* item = Item::create(allocator, key, value, Item::kCompressed, 7, hash_of(key));
+    
+    EXPECT_EQ(item->key(), key);
+    EXPECT_EQ(item->value(), value);
+    EXPECT_EQ(item->version, 7u);
+    EXPECT_TRUE(item->is_compressed());
+    EXPECT_FALSE(item->is_integer());
+    EXPECT_EQ(item->total_size(), sizeof(Item) + 70);
+    // Header, key and value share one chunk
+    EXPECT_EQ(item->footprint(), SlabAllocator::allocation_size(sizeof(Item) + 70));
+    EXPECT_EQ(allocator.used_bytes(), item->footprint());
+    
+    Item::destroy(allocator, item);
+    EXPECT_EQ(allocator.used_bytes(), 0u);
+}
+
+TEST(ItemTest, StoresIntegersNatively) {
+    SlabAllocator allocator;
+    Item* item = Item::create(allocator, "counter", int64_t{-42}, 3, hash_of("counter"));
+    EXPECT_TRUE(item->is_integer());
+    EXPECT_EQ(item->int_value(), -42);
+    EXPECT_EQ(item->value_string(), "-42");
+    EXPECT_EQ(item->value_len, sizeof(int64_t));
+    Item::destroy(allocator, item);
+}
+
+TEST(ItemTest, AgesSurviveClockWrap) {
+    EXPECT_EQ(Item::age(UINT32_MAX - 5, 10), 16u);
+    EXPECT_EQ(Item::age(100, 100), 0u);
+}
+
+TEST(ItemTableTest, FindsAcrossGrowth) {
+    SlabAllocator allocator;
+    ItemTable table;
+    std::vector<Item*> items;
+    for (int i = 0; i < 1000; ++i) {
+        std::string key = "key" + std::to_string(i);
+        items.push_back(make(allocator, key, "value" + std::to_string(i)));
+        table.insert(items.back());
+    }
+    EXPECT_EQ(table.size(), 1000u);
+    EXPECT_GE(table.index_bytes(), 1000 * sizeof(Item*));
+    
+    for (int i = 0; i < 1000; ++i) {
+        std::string key = "key" + std::to_string(i);
+        Item* item = table.find(key, hash_of(key));
+        ASSERT_NE(item, nullptr);
+        EXPECT_EQ(item->value(), "value" + std::to_string(i));
+    }
+    EXPECT_EQ(table.find("missing", hash_of("missing")), nullptr);
+    
+    table.clear([&](Item* item) { Item::destroy(allocator, item); });
+    EXPECT_EQ(table.size(), 0u);
+    EXPECT_EQ(table.lru(), nullptr);
+    EXPECT_EQ(allocator.used_bytes(), 0u);
+}
+
+TEST(ItemTableTest, KeepsRecencyOrder) {
+    SlabAllocator allocator;
+    ItemTable table;
+    Item* a = make(allocator, "a", "1");
+    Item* b = make(allocator, "b", "2");
+    Item* c = make(allocator, "c", "3");
+    table.insert(a);
+    table.insert(b);
+    table.insert(c);
+    EXPECT_EQ(table.lru(), a);
+    
+    table.touch(a, 5);
+    EXPECT_EQ(a->last_access, 5u);
+    EXPECT_EQ(table.lru(), b);
+    
+    // A replacement takes over the old item's place
+    Item* b2 = make(allocator, "b", "22");
+    table.replace(b, b2);
+    Item::destroy(allocator, b);
+    EXPECT_EQ(table.lru(), b2);
+    EXPECT_EQ(table.find("b", hash_of("b")), b2);
+    
+    std::string order;
+    table.for_each([&](const Item& item) { order += item.key(); });
+    EXPECT_EQ(order, "bca");
+    
+    table.remove(b2);
+    Item::destroy(allocator, b2);
+    EXPECT_EQ(table.lru(), c);
+    EXPECT_EQ(table.size(), 2u);
+    EXPECT_EQ(table.find("b", hash_of("b")), nullptr);
+    table.clear([&](Item* item) { Item::destroy(allocator, item); });
+}
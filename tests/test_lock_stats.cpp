@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include "lock_stats.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using cache::DurationHistogram;
+using cache::InstrumentedMutex;
+using cache::InstrumentedSharedMutex;
+using cache::LockRegistry;
+
+namespace {
+
+LockRegistry::LockStats find_lock(const std::string& name) {
+    for (const auto& lock : LockRegistry::instance().snapshot()) {
+        if (lock.name == name) {
+            return lock;
+        }
+    }
+    return {};
+}
+
+} // namespace
+
+TEST(LockStatsTest, HistogramBuckets) {
+    for (uint64_t ns : {0ULL, 3ULL, 4ULL, 7ULL, 100ULL, 12345ULL, 1ULL << 40}) {
+        size_t index = DurationHistogram::bucket_index(ns);
+        EXPECT_GE(DurationHistogram::bucket_upper_bound(index), ns);
+        // Within 25% of the value
+        EXPECT_LE(DurationHistogram::bucket_upper_bound(index), ns + ns / 4 + 1);
+    }
+    EXPECT_LT(DurationHistogram::bucket_index(UINT64_MAX), DurationHistogram::kBucketCount);
+    
+    DurationHistogram histogram;
+    for (uint64_t ns = 1; ns <= 1000; ++ns) {
+        histogram.record(ns);
+    }
+    auto snapshot = histogram.snapshot();
+    EXPECT_EQ(snapshot.count, 1000u);
+    EXPECT_DOUBLE_EQ(snapshot.mean_ns(), 500.5);
+    EXPECT_NEAR(static_cast<double>(snapshot.percentile_ns(50.0)), 500.0, 125.0);
+    EXPECT_GE(snapshot.percentile_ns(100.0), 1000u);
+}
+
+TEST(LockStatsTest, CountsAcquisitionsAndContention) {
+    {
+        InstrumentedMutex mutex("test_contended");
+        mutex.lock();
+        std::thread waiter([&mutex]() {
+            std::lock_guard<InstrumentedMutex> lock(mutex);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        mutex.unlock();
+        waiter.join();
+        
+        EXPECT_TRUE(mutex.try_lock());
+        mutex.unlock();
+        
+        auto stats = find_lock("test_contended");
+        EXPECT_EQ(stats.instances, 1u);
+        EXPECT_EQ(stats.acquisitions, 3u);
+        EXPECT_EQ(stats.contended, 1u);
+        EXPECT_GE(stats.wait.total_ns, 10u * 1000 * 1000);
+        EXPECT_EQ(stats.hold.count, 3u);
+        EXPECT_GE(stats.hold.percentile_ns(100.0), 10u * 1000 * 1000);
+    }
+    
+    // Destroyed locks keep contributing to their name's totals
+    auto stats = find_lock("test_contended");
+    EXPECT_EQ(stats.instances, 0u);
+    EXPECT_EQ(stats.acquisitions, 3u);
+}
+
+TEST(LockStatsTest, SharedMutexSumsInstancesByName) {
+    InstrumentedSharedMutex first("test_shared");
+    InstrumentedSharedMutex second("test_shared");
+    {
+        std::shared_lock<InstrumentedSharedMutex> a(first);
+        std::shared_lock<InstrumentedSharedMutex> b(first);
+        std::unique_lock<InstrumentedSharedMutex> c(second);
+    }
+    
+    auto stats = find_lock("test_shared");
+    EXPECT_EQ(stats.instances, 2u);
+    EXPECT_EQ(stats.acquisitions, 3u);
+    EXPECT_EQ(stats.contended, 0u);
+    EXPECT_EQ(stats.hold.count, 1u);   // Shared holds are not timed
+}
+
+TEST(LockStatsTest, ThreadPoolQueueWait) {
+    cache::ThreadPool pool(1);
+    auto blocker = pool.enqueue([]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    });
+    auto queued = pool.enqueue([]() {});
+    blocker.get();
+    queued.get();
+    
+    auto wait = pool.queue_wait();
+    EXPECT_EQ(wait.count, 2u);
+    // The second task waited behind the first
+    EXPECT_GE(wait.percentile_ns(100.0), 10u * 1000 * 1000);
+}
+
+TEST(LockStatsTest, BuildFlagSelectsLockType) {
+    constexpr bool instrumented = std::is_same_v<cache::Mutex, InstrumentedMutex>;
+    EXPECT_EQ(instrumented, LockRegistry::enabled());
+}
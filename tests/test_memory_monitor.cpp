@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+#include "memory_monitor.h"
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+using cache::Cache;
+using cache::MemoryMonitor;
+
+namespace {
+
+const size_t kMB = 1024 * 1024;
+
+std::string pressure_line(double avg10) {
+    return "some avg10=" + std::to_string(avg10) + " avg60=0.00 avg300=0.00 total=12345\n"
+           "full avg10=0.00 avg60=0.00 avg300=0.00 total=678\n";
+}
+
+} // namespace
+
+// A fake cgroup v2 directory with memory.max and memory.pressure
+class MemoryMonitorTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path_ = ::testing::TempDir() + "cache_memory_monitor_cgroup";
+        mkdir(path_.c_str(), 0755);
+        write("memory.max", "max\n");
+        write("memory.pressure", pressure_line(0.0));
+    }
+    
+    void TearDown() override {
+        std::remove((path_ + "/memory.max").c_str());
+        std::remove((path_ + "/memory.pressure").c_str());
+        rmdir(path_.c_str());
+    }
+    
+    void write(const std::string& name, const std::string& contents) {
+        std::ofstream(path_ + "/" + name) << contents;
+    }
+    
+    std::string path_;
+};
+
+TEST_F(MemoryMonitorTest, ReadsLimitAndPressure) {
+    EXPECT_EQ(MemoryMonitor::memory_limit(path_), std::nullopt);
+    write("memory.max", "536870912\n");
+    EXPECT_EQ(MemoryMonitor::memory_limit(path_), 512 * kMB);
+    
+    write("memory.pressure", pressure_line(12.5));
+    auto pressure = MemoryMonitor::memory_pressure(path_);
+    ASSERT_TRUE(pressure.has_value());
+    EXPECT_DOUBLE_EQ(*pressure, 12.5);
+    
+    EXPECT_EQ(MemoryMonitor::memory_limit(""), std::nullopt);
+    EXPECT_EQ(MemoryMonitor::memory_pressure(path_ + "/missing"), std::nullopt);
+    EXPECT_GT(MemoryMonitor::resident_bytes(), 0u);
+}
+
+TEST_F(MemoryMonitorTest, SizesCapacityFromTheLimit) {
+    EXPECT_EQ(MemoryMonitor::capacity_for(1024 * kMB, 0.25, 64 * kMB), 768 * kMB);
+    // Small limits keep the minimum headroom
+    EXPECT_EQ(MemoryMonitor::capacity_for(128 * kMB, 0.25, 64 * kMB), 64 * kMB);
+    EXPECT_EQ(MemoryMonitor::capacity_for(32 * kMB, 0.25, 64 * kMB), 0u);
+}
+
+TEST_F(MemoryMonitorTest, ShrinksUnderPressureAndGrowsBack) {
+    Cache cache(64 * kMB, 4);
+    for (int i = 0; i < 100000; ++i) {
+        cache.set("key" + std::to_string(i), std::string(500, 'v'));
+    }
+    MemoryMonitor::Options options;
+    options.cgroup_path = path_;
+    options.min_capacity = 40 * kMB;
+    MemoryMonitor monitor(cache, options, 64 * kMB);
+    
+    write("memory.pressure", pressure_line(35.0));
+    monitor.check();
+    EXPECT_EQ(cache.capacity(), static_cast<size_t>(64 * kMB * 0.9));
+    EXPECT_LE(cache.memory_usage(), cache.capacity());
+    for (int i = 0; i < 5; ++i) {
+        monitor.check();
+    }
+    // Never below the minimum; the last step is cut short
+    EXPECT_EQ(cache.capacity(), 40 * kMB);
+    EXPECT_EQ(monitor.shrinks(), 5u);
+    EXPECT_EQ(monitor.pressure(), 35.0);
+    
+    // Pressure between half the threshold and the threshold holds steady
+    write("memory.pressure", pressure_line(7.0));
+    monitor.check();
+    EXPECT_EQ(cache.capacity(), 40 * kMB);
+    
+    write("memory.pressure", pressure_line(0.5));
+    for (int i = 0; i < 20; ++i) {
+        monitor.check();
+    }
+    EXPECT_EQ(cache.capacity(), 64 * kMB);
+    EXPECT_EQ(monitor.grows(), 8u);
+}
+
+TEST_F(MemoryMonitorTest, CompactsABoundedNumberOfPagesPerShrink) {
+    Cache cache(64 * kMB, 4);
+    for (int i = 0; i < 90000; ++i) {
+        cache.set("key" + std::to_string(i), std::string(500, 'v'));
+    }
+    // Leave most pages a third full
+    for (int i = 0; i < 90000; ++i) {
+        if (i % 3 != 0) {
+            cache.remove("key" + std::to_string(i));
+        }
+    }
+    MemoryMonitor::Options options;
+    options.cgroup_path = path_;
+    options.compact_pages = 2;
+    MemoryMonitor monitor(cache, options, 64 * kMB);
+    
+    write("memory.pressure", pressure_line(35.0));
+    monitor.check();
+    EXPECT_EQ(monitor.shrinks(), 1u);
+    EXPECT_GT(cache.pages_compacted(), 0u);
+    EXPECT_LE(cache.pages_compacted(), 4u * options.compact_pages);
+}
+
+TEST_F(MemoryMonitorTest, RssNearTheLimitCountsAsPressure) {
+    Cache cache(64 * kMB, 4);
+    MemoryMonitor::Options options;
+    options.cgroup_path = path_;
+    MemoryMonitor monitor(cache, options, 64 * kMB);
+    
+    // This process is already past 90% of a limit just above its RSS
+    write("memory.max", std::to_string(MemoryMonitor::resident_bytes() + 4096) + "\n");
+    monitor.check();
+    EXPECT_LT(cache.capacity(), 64 * kMB);
+    EXPECT_EQ(monitor.shrinks(), 1u);
+    ASSERT_TRUE(monitor.limit().has_value());
+}
+
+TEST(CacheResizeTest, ConcurrentResizesKeepUsageWithinCapacity) {
+    Cache cache(8 * kMB, 8);
+    ASSERT_TRUE(cache.add_namespace("ns", 2 * kMB));
+    std::atomic<bool> done{false};
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&cache, &done, t] {
+            for (int i = 0; !done; ++i) {
+                std::string key = (i % 3 == 0 ? "ns:" : "") + std::to_string(t) + "-" + std::to_string(i);
+                cache.set(key, std::string(300, 'v'));
+            }
+        });
+    }
+    std::vector<std::thread> resizers;
+    for (int t = 0; t < 2; ++t) {
+        resizers.emplace_back([&cache, t] {
+            for (int i = 0; i < 50; ++i) {
+                cache.set_max_capacity((2 + (i + t) % 7) * kMB);
+            }
+        });
+    }
+    for (auto& resizer : resizers) {
+        resizer.join();
+    }
+    cache.set_max_capacity(4 * kMB);
+    done = true;
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    
+    // The namespace quota shrank with the capacity
+    cache.set_max_capacity(4 * kMB);
+    auto stats = cache.namespace_stats();
+    EXPECT_EQ(stats[1].quota, 1 * kMB);
+    EXPECT_EQ(stats[0].quota, 3 * kMB);
+    EXPECT_LE(stats[1].memory_usage, stats[1].quota);
+    EXPECT_LE(cache.memory_usage(), 4 * kMB);
+    
+    cache.set_max_capacity(8 * kMB);
+    EXPECT_EQ(cache.namespace_stats()[1].quota, 2 * kMB);
+}
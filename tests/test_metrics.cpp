@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+#include "metrics.h"
+#include <thread>
+#include <vector>
+
+using cache::Protocol;
+using cache::RequestMetrics;
+
+TEST(RequestMetricsTest, BucketsCoverValues) {
+    // Exact below 16us
+    for (uint64_t value = 0; value < 16; ++value) {
+        EXPECT_EQ(RequestMetrics::bucket_index(value), value);
+        EXPECT_EQ(RequestMetrics::bucket_upper_bound(value), value);
+    }
+
+    // Every value lies at or below its bucket's upper bound and above the previous one's
+    for (uint64_t value : {16ULL, 17ULL, 31ULL, 100ULL, 1000ULL, 123456ULL, 1ULL << 35}) {
+        size_t index = RequestMetrics::bucket_index(value);
+        ASSERT_LT(index, RequestMetrics::kBucketCount);
+        EXPECT_LE(value, RequestMetrics::bucket_upper_bound(index));
+        EXPECT_GT(value, RequestMetrics::bucket_upper_bound(index - 1));
+        // Within 12.5%
+        EXPECT_LE(RequestMetrics::bucket_upper_bound(index), value + value / 8);
+    }
+
+    // Huge values are clamped into the last bucket
+    EXPECT_EQ(RequestMetrics::bucket_index(UINT64_MAX), RequestMetrics::kBucketCount - 1);
+}
+
+TEST(RequestMetricsTest, PerCommandStats) {
+    RequestMetrics metrics;
+    for (uint64_t i = 1; i <= 100; ++i) {
+        metrics.record(Protocol::Command::GET, i);
+    }
+    metrics.record(Protocol::Command::SET, 1000);
+
+    auto stats = metrics.snapshot();
+    ASSERT_EQ(stats.size(), RequestMetrics::kCommandCount);
+    const auto& get = stats[static_cast<size_t>(Protocol::Command::GET)];
+    EXPECT_EQ(get.count, 100u);
+    EXPECT_EQ(get.total_us, 5050u);
+    EXPECT_DOUBLE_EQ(get.mean_us(), 50.5);
+    EXPECT_NEAR(static_cast<double>(get.percentile_us(50.0)), 50.0, 50.0 / 8);
+    EXPECT_NEAR(static_cast<double>(get.percentile_us(99.0)), 99.0, 99.0 / 8);
+    EXPECT_GE(get.max_us(), 100u);
+    EXPECT_EQ(get.count_at_or_below(15), 15u);
+
+    EXPECT_EQ(stats[static_cast<size_t>(Protocol::Command::SET)].count, 1u);
+    EXPECT_EQ(stats[static_cast<size_t>(Protocol::Command::DELETE)].count, 0u);
+    EXPECT_EQ(metrics.total_requests(), 101u);
+    EXPECT_EQ(metrics.total_latency_us(), 6050u);
+}
+
+TEST(RequestMetricsTest, MergesThreads) {
+    RequestMetrics metrics;
+    const int num_threads = 4;
+    const int per_thread = 10000;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&metrics, t]() {
+            for (int i = 0; i < per_thread; ++i) {
+                metrics.record(t % 2 ? Protocol::Command::GET : Protocol::Command::SET, 10);
+            }
+        });
+    }
+    // Scraping while threads record must be safe
+    for (int i = 0; i < 10; ++i) {
+        metrics.snapshot();
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    auto stats = metrics.snapshot();
+    EXPECT_EQ(stats[static_cast<size_t>(Protocol::Command::GET)].count, 2u * per_thread);
+    EXPECT_EQ(stats[static_cast<size_t>(Protocol::Command::SET)].count, 2u * per_thread);
+    EXPECT_EQ(metrics.total_requests(), static_cast<uint64_t>(num_threads) * per_thread);
+}
+
+TEST(RequestMetricsTest, SeparateInstances) {
+    // The per-thread slot cache must not mix up two instances on one thread
+    RequestMetrics first;
+    RequestMetrics second;
+    first.record(Protocol::Command::GET, 5);
+    second.record(Protocol::Command::GET, 5);
+    first.record(Protocol::Command::GET, 5);
+    EXPECT_EQ(first.total_requests(), 2u);
+    EXPECT_EQ(second.total_requests(), 1u);
+}
+
+TEST(RequestMetricsTest, InstancesShareAThreadWithoutLocking) {
+    // As a worker records into the server-wide and a namespace's metrics
+    RequestMetrics server;
+    RequestMetrics space;
+    std::thread([&] {
+        for (int i = 0; i < 100; ++i) {
+            server.record(Protocol::Command::GET, 5);
+            space.record(Protocol::Command::GET, 5);
+        }
+    }).join();
+    
+    EXPECT_EQ(server.total_requests(), 100u);
+    EXPECT_EQ(space.total_requests(), 100u);
+    // Only the first recording into each took the slow path
+    EXPECT_EQ(server.slot_lookups(), 1u);
+    EXPECT_EQ(space.slot_lookups(), 1u);
+}
+
+TEST(ProtocolTest, StatsSection) {
+    auto plain = Protocol::parse_request("STATS");
+    EXPECT_TRUE(plain.valid);
+    EXPECT_TRUE(plain.key.empty());
+
+    auto latency = Protocol::parse_request("STATS latency");
+    EXPECT_TRUE(latency.valid);
+    EXPECT_EQ(latency.command, Protocol::Command::STATS);
+    EXPECT_EQ(latency.key, "latency");
+    EXPECT_STREQ(Protocol::command_name(Protocol::Command::DELETE), "delete");
+}
+
+TEST(ProtocolTest, SelectNamespace) {
+    auto select = Protocol::parse_request("SELECT teamA");
+    EXPECT_TRUE(select.valid);
+    EXPECT_EQ(select.command, Protocol::Command::SELECT);
+    EXPECT_EQ(select.key, "teamA");
+    EXPECT_FALSE(Protocol::parse_request("SELECT").valid);
+    EXPECT_FALSE(Protocol::parse_request("SELECT a b").valid);
+    EXPECT_STREQ(Protocol::command_name(Protocol::Command::SELECT), "select");
+}
@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+#include "miss_ratio_curve.h"
+#include "workload.h"
+#include "cache.h"
+#include <list>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+using cache::MissRatioCurve;
+
+namespace {
+
+// Exact hit ratio of a byte-bounded LRU cache over the given accesses
+double simulate_lru(const std::vector<uint64_t>& keys, size_t entry_size, size_t capacity) {
+    std::list<uint64_t> order;
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> index;
+    size_t hits = 0;
+    for (uint64_t key : keys) {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            hits++;
+            order.splice(order.begin(), order, it->second);
+            continue;
+        }
+        order.push_front(key);
+        index[key] = order.begin();
+        while (order.size() * entry_size > capacity) {
+            index.erase(order.back());
+            order.pop_back();
+        }
+    }
+    return static_cast<double>(hits) / keys.size();
+}
+
+std::vector<uint64_t> zipfian_keys(size_t count, uint64_t key_space) {
+    cache::ZipfianGenerator zipf(key_space);
+    std::mt19937_64 rng(42);
+    std::vector<uint64_t> keys;
+    keys.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        keys.push_back(zipf.next(rng));
+    }
+    return keys;
+}
+
+} // namespace
+
+TEST(MissRatioCurveTest, ExactWhenEveryKeyIsSampled) {
+    MissRatioCurve::Options options;
+    options.initial_rate = 1.0;
+    options.max_keys = 1 << 20;
+    MissRatioCurve curve(options);
+    
+    auto keys = zipfian_keys(100000, 5000);
+    for (uint64_t key : keys) {
+        curve.record("key:" + std::to_string(key), 100);
+    }
+    
+    EXPECT_DOUBLE_EQ(curve.sample_rate(), 1.0);
+    EXPECT_EQ(curve.sampled_accesses(), keys.size());
+    for (size_t capacity : {10000, 50000, 200000}) {
+        EXPECT_NEAR(curve.hit_ratio(capacity), simulate_lru(keys, 100, capacity), 0.01) << capacity;
+    }
+    // Everything but first accesses hits once the whole key space fits
+    EXPECT_NEAR(curve.hit_ratio(1000000), simulate_lru(keys, 100, 1000000), 0.001);
+    EXPECT_DOUBLE_EQ(curve.hit_ratio(0), 0.0);
+}
+
+TEST(MissRatioCurveTest, SampledEstimateTracksExactCurve) {
+    MissRatioCurve::Options options;
+    options.initial_rate = 0.1;
+    options.max_keys = 1 << 20;
+    MissRatioCurve curve(options);
+    
+    auto keys = zipfian_keys(300000, 50000);
+    for (uint64_t key : keys) {
+        curve.record("key:" + std::to_string(key), 100);
+    }
+    
+    EXPECT_LT(curve.sampled_accesses(), keys.size() / 5);
+    for (size_t capacity : {100000, 500000, 2000000}) {
+        EXPECT_NEAR(curve.hit_ratio(capacity), simulate_lru(keys, 100, capacity), 0.05) << capacity;
+    }
+}
+
+TEST(MissRatioCurveTest, FixedSizeLowersRate) {
+    MissRatioCurve::Options options;
+    options.initial_rate = 1.0;
+    options.max_keys = 2000;
+    MissRatioCurve curve(options);
+    
+    auto keys = zipfian_keys(300000, 50000);
+    for (uint64_t key : keys) {
+        curve.record("key:" + std::to_string(key), 100);
+    }
+    
+    EXPECT_LE(curve.tracked_keys(), 2000u);
+    EXPECT_LT(curve.sample_rate(), 0.1);
+    for (size_t capacity : {500000, 2000000}) {
+        EXPECT_NEAR(curve.hit_ratio(capacity), simulate_lru(keys, 100, capacity), 0.08) << capacity;
+    }
+    
+    curve.reset();
+    EXPECT_EQ(curve.tracked_keys(), 0u);
+    EXPECT_EQ(curve.sampled_accesses(), 0u);
+    EXPECT_DOUBLE_EQ(curve.sample_rate(), 1.0);
+}
+
+TEST(MissRatioCurveTest, UnknownSizeUsesLastKnown) {
+    MissRatioCurve::Options options;
+    options.initial_rate = 1.0;
+    MissRatioCurve curve(options);
+    
+    curve.record("a", 1000);
+    curve.record("b", 1000);
+    curve.record("a", 0);
+    
+    // The reuse of "a" needs room for "b" and itself
+    EXPECT_DOUBLE_EQ(curve.hit_ratio(1999), 0.0);
+    EXPECT_NEAR(curve.hit_ratio(2000), 1.0 / 3, 1e-9);
+}
+
+TEST(MissRatioCurveTest, InstancesOnOneThreadCountSeparately) {
+    MissRatioCurve::Options options;
+    options.initial_rate = 1.0;
+    MissRatioCurve first(options);
+    MissRatioCurve second(options);
+    
+    // A new thread starts with an empty reference batch; leave it one
+    // short of a flush
+    std::thread([&] {
+        for (int i = 0; i < 63; ++i) {
+            first.record("key:" + std::to_string(i), 100);
+        }
+        second.record("a", 100);
+        second.record("a", 100);
+    }).join();
+    
+    // Only its own two references count towards the second curve
+    EXPECT_DOUBLE_EQ(second.hit_ratio(99), 0.0);
+    EXPECT_DOUBLE_EQ(second.hit_ratio(100), 0.5);
+}
+
+TEST(MissRatioCurveTest, CacheFeedsCurve) {
+    cache::Cache cache(1024 * 1024);
+    for (int round = 0; round < 5; ++round) {
+        for (int i = 0; i < 20000; ++i) {
+            cache.set("key:" + std::to_string(i), "value");
+        }
+    }
+    
+    const auto& curve = cache.miss_ratio_curve();
+    EXPECT_GT(curve.sampled_accesses(), 0u);
+    EXPECT_LT(curve.sampled_accesses(), 100000u / 10);
+    // Later rounds hit once the key space fits
+    EXPECT_NEAR(curve.hit_ratio(1ULL << 30), 0.8, 0.05);
+    EXPECT_LE(curve.hit_ratio(100000), curve.hit_ratio(1ULL << 30));
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include "reclaimer.h"
+#include "cache.h"
+#include <chrono>
+#include <string>
+#include <thread>
+
+using cache::Cache;
+using cache::Reclaimer;
+
+namespace {
+
+const size_t kCapacity = 1024 * 1024;
+
+// Writes 200-byte values until usage reaches fraction of the capacity
+int fill(Cache& cache, double fraction) {
+    int next = 0;
+    while (cache.memory_usage() < kCapacity * fraction && cache.evictions() == 0) {
+        EXPECT_TRUE(cache.set("key" + std::to_string(next++), std::string(200, 'v')));
+    }
+    return next;
+}
+
+} // namespace
+
+TEST(ReclaimerTest, ReclaimEvictsShardsDownToTheHighWatermark) {
+    Cache cache(kCapacity, 4);
+    fill(cache, 0.97);
+    ASSERT_EQ(cache.evictions(), 0u);
+    
+    size_t evicted = cache.reclaim(0.05, 0.10, 16);
+    EXPECT_GT(evicted, 0u);
+    EXPECT_EQ(cache.background_evictions(), evicted);
+    EXPECT_EQ(cache.inline_evictions(), 0u);
+    EXPECT_LE(cache.memory_usage(), kCapacity * 0.90);
+    
+    // Nothing is below the low watermark any more
+    EXPECT_EQ(cache.reclaim(0.05, 0.10, 16), 0u);
+    // The oldest keys went first
+    EXPECT_EQ(cache.get("key0"), "");
+}
+
+TEST(ReclaimerTest, ReclaimSparesNamespacesWithinTheirShare) {
+    Cache cache(kCapacity, 4);
+    ASSERT_TRUE(cache.add_namespace("calm", kCapacity / 8));
+    
+    // The oldest entries belong to a namespace well inside its quota
+    int calm = 0;
+    while (cache.memory_usage() < kCapacity / 10) {
+        ASSERT_TRUE(cache.set("calm:key" + std::to_string(calm++), std::string(200, 'v')));
+    }
+    // Past the access clock's resolution, so they are strictly older
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    int next = 0;
+    while (cache.memory_usage() < kCapacity * 0.96 && cache.evictions() == 0) {
+        ASSERT_TRUE(cache.set("key" + std::to_string(next++), std::string(200, 'v')));
+    }
+    ASSERT_EQ(cache.evictions(), 0u);
+    
+    EXPECT_GT(cache.reclaim(0.05, 0.10, 16), 0u);
+    for (int i = 0; i < calm; ++i) {
+        EXPECT_NE(cache.get("calm:key" + std::to_string(i)), "") << i;
+    }
+    EXPECT_EQ(cache.get("key0"), "");
+}
+
+TEST(ReclaimerTest, WritesWakeTheReclaimer) {
+    Cache cache(kCapacity, 4);
+    Reclaimer::Options options;
+    options.interval = std::chrono::hours(1);
+    Reclaimer reclaimer(cache, options);
+    cache.attach_reclaimer(&reclaimer);
+    reclaimer.start();
+    
+    fill(cache, 0.97);
+    for (int i = 0; i < 500 && cache.memory_usage() > kCapacity * 0.90; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    reclaimer.stop();
+    
+    EXPECT_LE(cache.memory_usage(), kCapacity * 0.90);
+    EXPECT_GT(reclaimer.passes(), 0u);
+    EXPECT_GT(reclaimer.items_evicted(), 0u);
+    EXPECT_EQ(cache.inline_evictions(), 0u);
+}
+
+TEST(ReclaimerTest, WritesOnlyEvictWhatTheyNeedWhenBehind) {
+    Cache cache(kCapacity, 4);
+    Reclaimer reclaimer(cache, Reclaimer::Options{});
+    cache.attach_reclaimer(&reclaimer);
+    
+    // Not started: every eviction falls to the writers
+    int next = fill(cache, 1.0);
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_TRUE(cache.set("key" + std::to_string(next++), std::string(200, 'v')));
+    }
+    EXPECT_GT(cache.inline_evictions(), 0u);
+    EXPECT_EQ(cache.background_evictions(), 0u);
+    EXPECT_LE(cache.memory_usage(), kCapacity);
+    EXPECT_GT(cache.memory_usage(), kCapacity * 0.99);
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include "regression.h"
+#include <cstdio>
+#include <fstream>
+
+class RegressionTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path_ = ::testing::TempDir() + "cache_regression_test.json";
+    }
+    
+    void TearDown() override {
+        std::remove(path_.c_str());
+    }
+    
+    std::string path_;
+};
+
+TEST_F(RegressionTest, SaveAndLoad) {
+    std::vector<cache::Metric> metrics{
+        {"cache_get.ops_per_sec", true, {1000000.5, 1010000.25, 990000.0}},
+        {"cache_get.p99_ns", false, {250, 260, 255}},
+    };
+    ASSERT_TRUE(cache::Regression::save(path_, metrics));
+    
+    auto loaded = cache::Regression::load(path_);
+    ASSERT_TRUE(loaded.has_value());
+    ASSERT_EQ(loaded->size(), 2u);
+    EXPECT_EQ((*loaded)[0].name, "cache_get.ops_per_sec");
+    EXPECT_TRUE((*loaded)[0].higher_is_better);
+    EXPECT_FALSE((*loaded)[1].higher_is_better);
+    ASSERT_EQ((*loaded)[0].samples.size(), 3u);
+    EXPECT_DOUBLE_EQ((*loaded)[0].samples[1], 1010000.25);
+}
+
+TEST_F(RegressionTest, RejectsMalformedBaseline) {
+    {
+        std::ofstream out(path_);
+        out << "{\"version\": 1, \"metrics\": [{\"name\": \"x\", \"samples\": [1, 2}";
+    }
+    EXPECT_FALSE(cache::Regression::load(path_).has_value());
+    EXPECT_FALSE(cache::Regression::load(path_ + ".missing").has_value());
+    
+    {
+        std::ofstream out(path_);
+        out << "{\"version\": 2, \"metrics\": []}";
+    }
+    EXPECT_FALSE(cache::Regression::load(path_).has_value());
+}
+
+TEST_F(RegressionTest, WelchPValue) {
+    // Identical samples: no evidence of a difference
+    EXPECT_NEAR(cache::Regression::welch_p_value({10, 11, 12}, {10, 11, 12}), 1.0, 1e-9);
+    
+    // t = -3.674, df = 4 (equal sizes and variances): two-sided p = 0.0213
+    EXPECT_NEAR(cache::Regression::welch_p_value({1, 2, 3}, {4, 5, 6}), 0.0213, 1e-3);
+    
+    // Far apart with little noise
+    EXPECT_LT(cache::Regression::welch_p_value({100, 101, 99, 100}, {80, 81, 79, 80}), 1e-4);
+}
+
+TEST_F(RegressionTest, FlagsSignificantRegressions) {
+    std::vector<cache::Metric> baseline{
+        {"throughput", true, {1000, 1010, 990, 1005, 995}},
+        {"p99", false, {100, 102, 98, 101, 99}},
+        {"bytes", false, {200, 200, 200}},
+        {"gone", true, {1, 2, 3}},
+    };
+    std::vector<cache::Metric> current{
+        {"throughput", true, {800, 810, 790, 805, 795}},   // 20% slower
+        {"p99", false, {104, 106, 102, 105, 103}},          // Significant but within tolerance
+        {"bytes", false, {180, 180, 180}},                  // 10% smaller
+    };
+    
+    cache::Regression::Options options;
+    options.tolerance = 0.05;
+    auto comparisons = cache::Regression::compare(baseline, current, options);
+    ASSERT_EQ(comparisons.size(), 4u);
+    
+    EXPECT_TRUE(comparisons[0].regressed);
+    EXPECT_NEAR(comparisons[0].change, 0.2, 1e-9);
+    EXPECT_FALSE(comparisons[1].regressed);
+    EXPECT_FALSE(comparisons[2].regressed);
+    EXPECT_TRUE(comparisons[2].improved);
+    EXPECT_TRUE(comparisons[3].missing);
+}
+
+TEST_F(RegressionTest, IgnoresNoise) {
+    // Means differ by 20% but the spread is far larger
+    std::vector<cache::Metric> baseline{{"throughput", true, {1000, 400, 1600}}};
+    std::vector<cache::Metric> current{{"throughput", true, {800, 200, 1400}}};
+    
+    auto comparisons = cache::Regression::compare(baseline, current, cache::Regression::Options());
+    ASSERT_EQ(comparisons.size(), 1u);
+    EXPECT_GT(comparisons[0].p_value, 0.05);
+    EXPECT_FALSE(comparisons[0].regressed);
+}
@@ -0,0 +1,250 @@
+#include <gtest/gtest.h>
+#include "replication.h"
+#include "cache.h"
+#include "protocol.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+using cache::Cache;
+using cache::ReplicaLink;
+using cache::ReplicationPrimary;
+
+namespace {
+
+// Accepts replicas on an ephemeral port and hands each one to the primary
+// after reading its SYNC line, as TCPServer does
+class PrimaryServer {
+public:
+    explicit PrimaryServer(ReplicationPrimary& primary) : primary_(primary) {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        socklen_t length = sizeof(address);
+        getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length);
+        port_ = ntohs(address.sin_port);
+        listen(listen_fd_, 16);
+        accept_thread_ = std::thread([this]() { accept_loop(); });
+    }
+    
+    ~PrimaryServer() {
+        stopping_ = true;
+        accept_thread_.join();
+        drop_replicas();
+        for (auto& thread : client_threads_) {
+            thread.join();
+        }
+        close(listen_fd_);
+    }
+    
+    int port() const { return port_; }
+    
+    // Cuts every replica link, as if the network dropped
+    void drop_replicas() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int fd : client_fds_) {
+            shutdown(fd, SHUT_RDWR);
+        }
+    }
+
+private:
+    ReplicationPrimary& primary_;
+    int listen_fd_ = -1;
+    int port_ = 0;
+    std::atomic<bool> stopping_{false};
+    std::mutex mutex_;
+    std::vector<int> client_fds_;
+    std::vector<std::thread> client_threads_;
+    std::thread accept_thread_;
+    
+    void accept_loop() {
+        while (!stopping_) {
+            pollfd poll_fd{listen_fd_, POLLIN, 0};
+            if (poll(&poll_fd, 1, 20) <= 0) {
+                continue;
+            }
+            int fd = accept(listen_fd_, nullptr, nullptr);
+            if (fd < 0) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            client_fds_.push_back(fd);
+            client_threads_.emplace_back([this, fd]() { serve(fd); });
+        }
+    }
+    
+    void serve(int fd) {
+        std::string line;
+        char c;
+        while (recv(fd, &c, 1, 0) == 1 && c != '\n') {
+            line += c;
+        }
+        auto req = cache::Protocol::parse_request(line);
+        if (req.valid && req.command == cache::Protocol::Command::SYNC) {
+            primary_.serve(fd, req.key, req.key.empty() ? std::nullopt : std::optional<uint64_t>(req.version));
+        }
+        close(fd);
+    }
+};
+
+bool wait_for(const std::function<bool()>& condition) {
+    for (int i = 0; i < 500; ++i) {
+        if (condition()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return condition();
+}
+
+ReplicationPrimary::Options fast_primary(size_t backlog_bytes = 1024 * 1024) {
+    ReplicationPrimary::Options options;
+    options.backlog_bytes = backlog_bytes;
+    options.ping_interval = std::chrono::milliseconds(20);
+    return options;
+}
+
+ReplicaLink::Options fast_link(int port) {
+    ReplicaLink::Options options;
+    options.host = "127.0.0.1";
+    options.port = port;
+    options.retry_delay = std::chrono::milliseconds(20);
+    options.ack_interval = std::chrono::milliseconds(20);
+    return options;
+}
+
+} // namespace
+
+TEST(ReplicationTest, ParsesSyncCommand) {
+    auto fresh = cache::Protocol::parse_request("SYNC");
+    EXPECT_TRUE(fresh.valid);
+    EXPECT_EQ(fresh.command, cache::Protocol::Command::SYNC);
+    EXPECT_TRUE(fresh.key.empty());
+    
+    auto resume = cache::Protocol::parse_request("sync abc 42");
+    EXPECT_TRUE(resume.valid);
+    EXPECT_EQ(resume.key, "abc");
+    EXPECT_EQ(resume.version, 42u);
+    EXPECT_FALSE(cache::Protocol::parse_request("SYNC abc").valid);
+    EXPECT_FALSE(cache::Protocol::parse_request("SYNC abc x").valid);
+    EXPECT_STREQ(cache::Protocol::command_name(cache::Protocol::Command::SYNC), "sync");
+}
+
+TEST(ReplicationTest, BacklogIsIdleWithoutReplicas) {
+    Cache primary_cache(1024 * 1024, 4);
+    ReplicationPrimary primary(primary_cache, fast_primary());
+    primary_cache.attach_replication(&primary);
+    
+    primary_cache.set("key", "value");
+    primary_cache.remove("key");
+    primary_cache.clear();
+    EXPECT_EQ(primary.offset(), 0u);
+    EXPECT_TRUE(primary.replicas().empty());
+}
+
+TEST(ReplicationTest, FullSyncThenStreamsMutations) {
+    Cache primary_cache(1024 * 1024, 4);
+    ReplicationPrimary primary(primary_cache, fast_primary());
+    primary_cache.attach_replication(&primary);
+    for (int i = 0; i < 100; ++i) {
+        primary_cache.set("key" + std::to_string(i), "value" + std::to_string(i));
+    }
+    primary_cache.set("counter", "10");
+    primary_cache.incr("counter", 5);
+    PrimaryServer server(primary);
+    
+    Cache replica_cache(1024 * 1024, 4);
+    replica_cache.set("stale", "x");
+    ReplicaLink link(replica_cache, fast_link(server.port()));
+    link.start();
+    ASSERT_TRUE(wait_for([&]() { return link.link_up(); }));
+    EXPECT_EQ(link.full_syncs(), 1u);
+    EXPECT_EQ(primary.full_syncs(), 1u);
+    
+    // The snapshot replaced what the replica had
+    EXPECT_EQ(replica_cache.get("stale"), "");
+    EXPECT_EQ(replica_cache.get("key42"), "value42");
+    EXPECT_EQ(replica_cache.get("counter"), "15");
+    EXPECT_EQ(replica_cache.get_versioned("key7")->version, primary_cache.get_versioned("key7")->version);
+    
+    primary_cache.set("key1", "changed");
+    primary_cache.remove("key2");
+    primary_cache.incr("counter", 1);
+    ASSERT_TRUE(wait_for([&]() { return link.offset() == primary.offset(); }));
+    EXPECT_EQ(replica_cache.get("key1"), "changed");
+    EXPECT_EQ(replica_cache.get("key2"), "");
+    EXPECT_EQ(replica_cache.get("counter"), "16");
+    
+    // Acks and pings let both sides see the lag drain to zero
+    ASSERT_TRUE(wait_for([&]() {
+        auto replicas = primary.replicas();
+        return replicas.size() == 1 && !replicas[0].loading && replicas[0].acked_offset == primary.offset();
+    }));
+    EXPECT_EQ(link.primary_offset(), link.offset());
+    EXPECT_GE(link.last_io_ms(), 0);
+    
+    primary_cache.clear();
+    ASSERT_TRUE(wait_for([&]() { return link.offset() == primary.offset(); }));
+    EXPECT_EQ(replica_cache.size(), 0u);
+    link.stop();
+}
+
+TEST(ReplicationTest, ResumesFromTheBacklogAfterADisconnect) {
+    Cache primary_cache(1024 * 1024, 4);
+    ReplicationPrimary primary(primary_cache, fast_primary());
+    primary_cache.attach_replication(&primary);
+    primary_cache.set("before", "1");
+    PrimaryServer server(primary);
+    
+    Cache replica_cache(1024 * 1024, 4);
+    ReplicaLink link(replica_cache, fast_link(server.port()));
+    link.start();
+    ASSERT_TRUE(wait_for([&]() { return link.link_up(); }));
+    
+    server.drop_replicas();
+    ASSERT_TRUE(wait_for([&]() { return !link.link_up(); }));
+    primary_cache.set("during", "2");
+    ASSERT_TRUE(wait_for([&]() { return link.partial_syncs() == 1; }));
+    ASSERT_TRUE(wait_for([&]() { return link.offset() == primary.offset(); }));
+    EXPECT_EQ(replica_cache.get("during"), "2");
+    EXPECT_EQ(link.full_syncs(), 1u);
+    EXPECT_EQ(primary.partial_syncs(), 1u);
+    link.stop();
+}
+
+TEST(ReplicationTest, FullSyncWhenTheBacklogHasMovedOn) {
+    Cache primary_cache(1024 * 1024, 4);
+    ReplicationPrimary primary(primary_cache, fast_primary(256));
+    primary_cache.attach_replication(&primary);
+    PrimaryServer server(primary);
+    
+    Cache replica_cache(1024 * 1024, 4);
+    ReplicaLink link(replica_cache, fast_link(server.port()));
+    link.start();
+    ASSERT_TRUE(wait_for([&]() { return link.link_up(); }));
+    
+    // Overwrites the whole backlog while the replica is away
+    server.drop_replicas();
+    ASSERT_TRUE(wait_for([&]() { return !link.link_up(); }));
+    link.stop();
+    for (int i = 0; i < 20; ++i) {
+        primary_cache.set("key" + std::to_string(i), std::string(32, 'x'));
+    }
+    EXPECT_GT(primary.backlog_start(), link.offset());
+    
+    link.start();
+    ASSERT_TRUE(wait_for([&]() { return link.full_syncs() == 2; }));
+    ASSERT_TRUE(wait_for([&]() { return link.offset() == primary.offset(); }));
+    EXPECT_EQ(replica_cache.get("key19"), std::string(32, 'x'));
+    EXPECT_EQ(replica_cache.size(), 20u);
+    link.stop();
+}
@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+#include "slab_allocator.h"
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using cache::SlabAllocator;
+
+TEST(SlabAllocatorTest, ClassesRoundUpAndGrow) {
+    EXPECT_EQ(SlabAllocator::allocation_size(1), SlabAllocator::kMinChunkSize);
+    EXPECT_EQ(SlabAllocator::allocation_size(64), 64u);
+    EXPECT_EQ(SlabAllocator::allocation_size(65), 80u);
+    EXPECT_EQ(SlabAllocator::allocation_size(SlabAllocator::kMaxChunkSize), SlabAllocator::kMaxChunkSize);
+    EXPECT_EQ(SlabAllocator::class_for(SlabAllocator::kMaxChunkSize + 1), SlabAllocator::kLargeClass);
+    EXPECT_EQ(SlabAllocator::allocation_size(100000), 100000u);
+    
+    // Every size lands in the smallest class that holds it
+    for (size_t size = 1; size <= SlabAllocator::kMaxChunkSize; ++size) {
+        uint8_t slab_class = SlabAllocator::class_for(size);
+        ASSERT_GE(SlabAllocator::chunk_size(slab_class), size);
+        if (slab_class > 0) {
+            ASSERT_LT(SlabAllocator::chunk_size(slab_class - 1), size);
+        }
+    }
+}
+
+TEST(SlabAllocatorTest, RecyclesFreedChunks) {
+    SlabAllocator allocator;
+    void* first = allocator.allocate(100);
+    void* second = allocator.allocate(100);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(allocator.used_bytes(), 2 * SlabAllocator::allocation_size(100));
+    EXPECT_EQ(allocator.reserved_bytes(), SlabAllocator::kPageSize);
+    
+    allocator.deallocate(first, 100);
+    EXPECT_EQ(allocator.allocate(99), first);
+    allocator.deallocate(first, 99);
+    allocator.deallocate(second, 100);
+    EXPECT_EQ(allocator.used_bytes(), 0u);
+    EXPECT_EQ(allocator.reserved_bytes(), SlabAllocator::kPageSize);
+}
+
+TEST(SlabAllocatorTest, ChunksDoNotOverlap) {
+    SlabAllocator allocator;
+    const size_t size = 200;
+    size_t chunk = SlabAllocator::allocation_size(size);
+    std::vector<char*> chunks;
+    for (size_t i = 0; i < 3 * SlabAllocator::chunks_per_page(SlabAllocator::class_for(size)); ++i) {
+        char* ptr = static_cast<char*>(allocator.allocate(size));
+        std::memset(ptr, static_cast<int>(i), size);
+        chunks.push_back(ptr);
+    }
+    
+    std::set<char*> distinct(chunks.begin(), chunks.end());
+    EXPECT_EQ(distinct.size(), chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        ASSERT_EQ(chunks[i][size - 1], static_cast<char>(i));
+    }
+    EXPECT_EQ(allocator.reserved_bytes(), 3 * SlabAllocator::kPageSize);
+    
+    auto stats = allocator.class_stats()[SlabAllocator::class_for(size)];
+    EXPECT_EQ(stats.chunk_size, chunk);
+    EXPECT_EQ(stats.pages, 3u);
+    EXPECT_EQ(stats.used_chunks, chunks.size());
+    for (char* ptr : chunks) {
+        allocator.deallocate(ptr, size);
+    }
+}
+
+TEST(SlabAllocatorTest, CompactionEmptiesSparsePages) {
+    SlabAllocator allocator;
+    const size_t size = 1000;
+    uint8_t slab_class = SlabAllocator::class_for(size);
+    size_t per_page = SlabAllocator::chunks_per_page(slab_class);
+    std::vector<char*> chunks;
+    for (size_t i = 0; i < 4 * per_page; ++i) {
+        chunks.push_back(static_cast<char*>(allocator.allocate(size)));
+        std::snprintf(chunks.back(), size, "chunk%zu", i);
+    }
+    
+    // Keep every fourth chunk: four pages a quarter full
+    std::map<char*, size_t> live;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        if (i % 4 == 0) {
+            live[chunks[i]] = i;
+        } else {
+            allocator.deallocate(chunks[i], size);
+        }
+    }
+    EXPECT_FALSE(allocator.compact(slab_class, 0.1, [](void*, void*) { FAIL(); }));
+    
+    size_t moved = 0;
+    auto relocate = [&](void* from, void* to) {
+        auto it = live.find(static_cast<char*>(from));
+        ASSERT_NE(it, live.end());
+        size_t index = it->second;
+        live.erase(it);
+        live[static_cast<char*>(to)] = index;
+        moved++;
+    };
+    while (allocator.compact(slab_class, 0.5, relocate)) {
+    }
+    auto stats = allocator.class_stats()[slab_class];
+    EXPECT_EQ(stats.pages, 1u);
+    EXPECT_EQ(stats.pages_compacted, 3u);
+    EXPECT_EQ(stats.used_chunks, per_page);
+    EXPECT_GE(moved, 3 * (per_page / 4));
+    EXPECT_EQ(allocator.free_pages(), 3u + 8 * 1024 * 1024 / SlabAllocator::kPageSize - 4);
+    
+    // Moved chunks kept their bytes
+    for (const auto& [ptr, index] : live) {
+        ASSERT_STREQ(ptr, ("chunk" + std::to_string(index)).c_str());
+        allocator.deallocate(ptr, size);
+    }
+    EXPECT_EQ(allocator.used_bytes(), 0u);
+}
+
+TEST(SlabAllocatorTest, LargeAllocationsBypassPages) {
+    SlabAllocator allocator;
+    size_t size = SlabAllocator::kMaxChunkSize * 2;
+    void* ptr = allocator.allocate(size);
+    std::memset(ptr, 'x', size);
+    EXPECT_EQ(allocator.large_bytes(), size);
+    EXPECT_EQ(allocator.reserved_bytes(), size);
+    allocator.deallocate(ptr, size);
+    EXPECT_EQ(allocator.large_bytes(), 0u);
+    EXPECT_EQ(allocator.used_bytes(), 0u);
+}
+
+TEST(ArenaTest, MapsUntouchedMemoryAndReleasesIt) {
+    cache::Arena arena(100000);
+    EXPECT_GE(arena.size(), 100000u);
+    EXPECT_EQ(arena.size() % 4096, 0u);
+    std::memset(arena.data(), 'x', arena.size());
+    
+    // Released pages stay mapped and come back zeroed
+    arena.release();
+    EXPECT_EQ(arena.data()[0], 0);
+    EXPECT_EQ(arena.data()[arena.size() - 1], 0);
+    arena.data()[0] = 'y';
+}
+
+TEST(ArenaTest, HugePageArenasAreAligned) {
+    cache::Arena arena(1, true, true);
+    EXPECT_EQ(arena.size(), cache::Arena::kHugePageSize);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(arena.data()) % cache::Arena::kHugePageSize, 0u);
+    arena.data()[arena.size() - 1] = 'x';
+}
+
+TEST(SlabAllocatorTest, ReservesAndReleasesArenas) {
+    cache::Arena::Options options;
+    options.arena_size = 4 * SlabAllocator::kPageSize;
+    SlabAllocator allocator(options);
+    EXPECT_EQ(allocator.mapped_bytes(), 0u);
+    
+    allocator.reserve(10 * SlabAllocator::kPageSize);
+    EXPECT_EQ(allocator.mapped_bytes(), 12 * SlabAllocator::kPageSize);
+    EXPECT_EQ(allocator.reserved_bytes(), 0u);
+    
+    // Reserved pages are used before another arena is mapped
+    std::vector<void*> chunks;
+    for (size_t i = 0; i < 12; ++i) {
+        chunks.push_back(allocator.allocate(SlabAllocator::kMaxChunkSize * 3 / 4));
+        chunks.push_back(allocator.allocate(100));
+    }
+    EXPECT_EQ(allocator.mapped_bytes(), 12 * SlabAllocator::kPageSize);
+    void* large = allocator.allocate(SlabAllocator::kMaxChunkSize * 2);
+    
+    for (size_t i = 0; i < chunks.size(); i += 2) {
+        allocator.deallocate(chunks[i], SlabAllocator::kMaxChunkSize * 3 / 4);
+        allocator.deallocate(chunks[i + 1], 100);
+    }
+    allocator.release_pages();
+    EXPECT_EQ(allocator.reserved_bytes(), SlabAllocator::kMaxChunkSize * 2);
+    EXPECT_EQ(allocator.mapped_bytes(), 12 * SlabAllocator::kPageSize);
+    
+    // Released pages are handed out again
+    void* chunk = allocator.allocate(100);
+    std::memset(chunk, 'x', 100);
+    EXPECT_EQ(allocator.mapped_bytes(), 12 * SlabAllocator::kPageSize);
+    allocator.deallocate(chunk, 100);
+    allocator.deallocate(large, SlabAllocator::kMaxChunkSize * 2);
+}
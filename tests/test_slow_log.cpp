@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+#include "slow_log.h"
+#include "protocol.h"
+#include <thread>
+#include <vector>
+
+using cache::SlowLog;
+
+namespace {
+
+SlowLog::Entry make_entry(const std::string& key, uint64_t execute_us) {
+    SlowLog::Entry entry;
+    entry.command = "get";
+    entry.key = key;
+    entry.value_size = 100;
+    entry.queue_wait_us = 1;
+    entry.lock_wait_us = 2;
+    entry.execute_us = execute_us;
+    entry.send_us = 3;
+    return entry;
+}
+
+} // namespace
+
+TEST(SlowLogTest, Threshold) {
+    SlowLog log(16, 1000);
+    EXPECT_FALSE(log.should_log(999));
+    EXPECT_TRUE(log.should_log(1000));
+    
+    log.set_threshold_us(0);
+    EXPECT_TRUE(log.should_log(0));
+    
+    log.set_threshold_us(-1);
+    EXPECT_FALSE(log.should_log(UINT64_MAX));
+}
+
+TEST(SlowLogTest, NewestFirst) {
+    SlowLog log(16, 0);
+    log.record(make_entry("a", 10));
+    log.record(make_entry("b", 20));
+    log.record(make_entry("c", 30));
+    
+    auto entries = log.get(10);
+    ASSERT_EQ(entries.size(), 3u);
+    EXPECT_EQ(entries[0].key, "c");
+    EXPECT_EQ(entries[0].id, 2u);
+    EXPECT_EQ(entries[2].key, "a");
+    EXPECT_EQ(entries[0].command, "get");
+    EXPECT_EQ(entries[0].value_size, 100u);
+    EXPECT_EQ(entries[0].lock_wait_us, 2u);
+    EXPECT_EQ(entries[0].total_us(), 34u);
+    EXPECT_GT(entries[0].timestamp_us, 0u);
+    
+    EXPECT_EQ(log.get(2).size(), 2u);
+    EXPECT_EQ(log.size(), 3u);
+}
+
+TEST(SlowLogTest, BoundedAndReset) {
+    SlowLog log(4, 0);
+    for (int i = 0; i < 10; ++i) {
+        log.record(make_entry("key" + std::to_string(i), i));
+    }
+    
+    auto entries = log.get(100);
+    ASSERT_EQ(entries.size(), 4u);
+    EXPECT_EQ(entries[0].key, "key9");
+    EXPECT_EQ(entries[3].key, "key6");
+    EXPECT_EQ(log.size(), 4u);
+    EXPECT_EQ(log.logged(), 10u);
+    
+    log.reset();
+    EXPECT_TRUE(log.get(100).empty());
+    EXPECT_EQ(log.size(), 0u);
+    
+    log.record(make_entry("after", 1));
+    entries = log.get(100);
+    ASSERT_EQ(entries.size(), 1u);
+    EXPECT_EQ(entries[0].key, "after");
+}
+
+TEST(SlowLogTest, TruncatesLongKeys) {
+    SlowLog log(4, 0);
+    log.record(make_entry(std::string(200, 'k'), 1));
+    auto entries = log.get(1);
+    ASSERT_EQ(entries.size(), 1u);
+    EXPECT_EQ(entries[0].key, std::string(SlowLog::kMaxKeyLength, 'k'));
+}
+
+TEST(SlowLogTest, ConcurrentWritersAndReaders) {
+    SlowLog log(64, 0);
+    const int num_threads = 4;
+    const int per_thread = 5000;
+    std::atomic<bool> done{false};
+    
+    std::thread reader([&]() {
+        while (!done) {
+            for (const auto& entry : log.get(64)) {
+                // A torn entry would mix keys and timings from different writers
+                ASSERT_EQ(entry.key.size(), 8u);
+                ASSERT_EQ(entry.execute_us, static_cast<uint64_t>(entry.key[1] - '0'));
+            }
+        }
+    });
+    
+    std::vector<std::thread> writers;
+    for (int t = 0; t < num_threads; ++t) {
+        writers.emplace_back([&log, t]() {
+            std::string key = "t" + std::to_string(t) + "-entry";
+            for (int i = 0; i < per_thread; ++i) {
+                log.record(make_entry(key, t));
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    done = true;
+    reader.join();
+    
+    EXPECT_EQ(log.logged() + log.dropped(), static_cast<uint64_t>(num_threads) * per_thread);
+    EXPECT_EQ(log.get(64).size(), 64u);
+}
+
+TEST(SlowLogTest, ParsesSlowlogCommand) {
+    auto get = cache::Protocol::parse_request("SLOWLOG GET 5");
+    EXPECT_TRUE(get.valid);
+    EXPECT_EQ(get.command, cache::Protocol::Command::SLOWLOG);
+    EXPECT_EQ(get.key, "GET");
+    EXPECT_EQ(get.delta, 5);
+    
+    auto len = cache::Protocol::parse_request("slowlog len");
+    EXPECT_TRUE(len.valid);
+    EXPECT_EQ(len.key, "len");
+    
+    EXPECT_FALSE(cache::Protocol::parse_request("SLOWLOG").valid);
+    EXPECT_FALSE(cache::Protocol::parse_request("SLOWLOG GET x").valid);
+}
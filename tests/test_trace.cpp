@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include "trace.h"
+#include <cstdio>
+#include <fstream>
+
+class TraceTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path_ = ::testing::TempDir() + "cache_trace_test.bin";
+    }
+    
+    void TearDown() override {
+        std::remove(path_.c_str());
+    }
+    
+    // Cycles through num_keys keys, setting each one the first time it is seen
+    static std::vector<cache::TraceRecord> looping_trace(uint64_t num_keys, size_t rounds) {
+        std::vector<cache::TraceRecord> records;
+        uint64_t now = 0;
+        for (size_t round = 0; round < rounds; ++round) {
+            for (uint64_t key = 0; key < num_keys; ++key) {
+                if (round == 0) {
+                    records.push_back({now++, key, 1000, 0, cache::TraceRecord::Op::SET});
+                }
+                records.push_back({now++, key, 0, 0, cache::TraceRecord::Op::GET});
+            }
+        }
+        return records;
+    }
+    
+    std::string path_;
+};
+
+TEST_F(TraceTest, SaveAndLoad) {
+    std::vector<cache::TraceRecord> records{
+        {100, 0xdeadbeef, 512, 60, cache::TraceRecord::Op::SET},
+        {250, 0xdeadbeef, 0, 0, cache::TraceRecord::Op::GET},
+        {300, 42, 0, 0, cache::TraceRecord::Op::DELETE},
+    };
+    ASSERT_TRUE(cache::Trace::save(path_, records));
+    
+    auto loaded = cache::Trace::load(path_);
+    ASSERT_TRUE(loaded.has_value());
+    ASSERT_EQ(loaded->size(), 3u);
+    EXPECT_EQ((*loaded)[0].timestamp_us, 100u);
+    EXPECT_EQ((*loaded)[0].key_hash, 0xdeadbeefu);
+    EXPECT_EQ((*loaded)[0].value_size, 512u);
+    EXPECT_EQ((*loaded)[0].ttl_s, 60u);
+    EXPECT_EQ((*loaded)[2].op, cache::TraceRecord::Op::DELETE);
+}
+
+TEST_F(TraceTest, RejectsTruncatedFile) {
+    ASSERT_TRUE(cache::Trace::save(path_, looping_trace(4, 1)));
+    {
+        std::ofstream out(path_, std::ios::binary | std::ios::app);
+        out << "xx";
+    }
+    EXPECT_FALSE(cache::Trace::load(path_).has_value());
+    EXPECT_FALSE(cache::Trace::load(path_ + ".missing").has_value());
+}
+
+TEST_F(TraceTest, HitRatioGrowsWithCapacity) {
+    // 200 keys of ~1KB cycled in order: LRU thrashes unless all of them fit
+    auto records = looping_trace(200, 5);
+    
+    cache::Cache small(64 * 1024, 4);
+    cache::Cache large(1024 * 1024, 4);
+    auto small_result = cache::Trace::simulate(records, small);
+    auto large_result = cache::Trace::simulate(records, large);
+    
+    EXPECT_EQ(large_result.gets, 1000u);
+    EXPECT_EQ(large_result.sets, 200u);
+    EXPECT_DOUBLE_EQ(large_result.hit_ratio(), 1.0);
+    EXPECT_LT(small_result.hit_ratio(), 0.5);
+}
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include "workload.h"
+#include <cstdio>
+#include <fstream>
+#include <map>
+
+TEST(WorkloadTest, ZipfianFavorsLowRanks) {
+    cache::ZipfianGenerator zipfian(1000, 0.99);
+    std::mt19937_64 rng(7);
+    
+    size_t rank_zero = 0;
+    size_t top_ten = 0;
+    const size_t samples = 100000;
+    for (size_t i = 0; i < samples; ++i) {
+        uint64_t rank = zipfian.next(rng);
+        ASSERT_LT(rank, 1000u);
+        rank_zero += rank == 0;
+        top_ten += rank < 10;
+    }
+    
+    // Under theta 0.99 over 1000 items rank 0 draws about 13% and the top ten about 39%
+    EXPECT_GT(rank_zero, samples / 10);
+    EXPECT_GT(top_ten, samples / 3);
+}
+
+TEST(WorkloadTest, HotspotConcentratesRequests) {
+    cache::WorkloadSpec spec;
+    spec.key_distribution = cache::WorkloadSpec::KeyDistribution::HOTSPOT;
+    spec.key_count = 1000;
+    spec.hot_set_fraction = 0.1;
+    spec.hot_op_fraction = 0.9;
+    spec.read_proportion = 1.0;
+    spec.update_proportion = 0.0;
+    cache::Workload workload(spec, cache::ValueSizeDistribution::fixed(10), 1);
+    
+    size_t hot = 0;
+    auto requests = workload.generate(10000);
+    for (const auto& request : requests) {
+        uint64_t id = std::stoull(request.substr(request.find('_') + 1));
+        hot += id < 100;
+    }
+    EXPECT_GT(hot, 8500u);
+    EXPECT_LT(hot, 9500u);
+}
+
+TEST(WorkloadTest, LatestReadsRecentInserts) {
+    auto spec = cache::WorkloadSpec::ycsb('D');
+    ASSERT_TRUE(spec.has_value());
+    spec->key_count = 1000;
+    cache::Workload workload(*spec, cache::ValueSizeDistribution::fixed(10), 1);
+    
+    size_t recent = 0;
+    size_t reads = 0;
+    for (const auto& request : workload.generate(10000)) {
+        if (request.compare(0, 4, "GET ") == 0) {
+            reads++;
+            recent += std::stoull(request.substr(8)) >= 900;
+        }
+    }
+    EXPECT_GT(reads, 9000u);
+    EXPECT_GT(recent, reads / 2);
+}
+
+TEST(WorkloadTest, YcsbPresets) {
+    for (char preset : std::string("ABCDEF")) {
+        EXPECT_TRUE(cache::WorkloadSpec::ycsb(preset).has_value()) << preset;
+    }
+    EXPECT_FALSE(cache::WorkloadSpec::ycsb('G').has_value());
+    
+    // F issues a GET and a SET of the same key for each read-modify-write
+    auto spec = cache::WorkloadSpec::ycsb('f');
+    spec->read_proportion = 0.0;
+    cache::Workload workload(*spec, cache::ValueSizeDistribution::fixed(10), 1);
+    auto requests = workload.generate(2);
+    EXPECT_EQ(requests[0].substr(4), requests[1].substr(4, requests[0].size() - 4));
+    EXPECT_EQ(requests[1].compare(0, 4, "SET "), 0);
+}
+
+TEST(WorkloadTest, ValueSizes) {
+    std::mt19937_64 rng(3);
+    auto fixed = cache::ValueSizeDistribution::parse("64");
+    ASSERT_TRUE(fixed.has_value());
+    EXPECT_EQ(fixed->next(rng), 64u);
+    
+    auto range = cache::ValueSizeDistribution::parse("10-20");
+    ASSERT_TRUE(range.has_value());
+    for (int i = 0; i < 100; ++i) {
+        size_t size = range->next(rng);
+        EXPECT_GE(size, 10u);
+        EXPECT_LE(size, 20u);
+    }
+    EXPECT_FALSE(cache::ValueSizeDistribution::parse("big").has_value());
+    
+    std::string path = ::testing::TempDir() + "cache_value_sizes.txt";
+    {
+        std::ofstream out(path);
+        out << "# size weight\n100 3\n\n5000 1\n";
+    }
+    auto histogram = cache::ValueSizeDistribution::from_file(path);
+    std::remove(path.c_str());
+    ASSERT_TRUE(histogram.has_value());
+    EXPECT_EQ(histogram->max_size(), 5000u);
+    
+    std::map<size_t, size_t> seen;
+    for (int i = 0; i < 4000; ++i) {
+        seen[histogram->next(rng)]++;
+    }
+    EXPECT_EQ(seen.size(), 2u);
+    EXPECT_GT(seen[100], 2500u);
+}
@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+#include "write_log.h"
+#include "snapshot.h"
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/resource.h>
+
+class WriteLogTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        cache_ = std::make_unique<cache::Cache>(1024 * 1024, 4);
+        options_.path = ::testing::TempDir() + "cache_write_log_test.wal";
+        options_.snapshot_path = options_.path + ".snapshot";
+        options_.fsync_interval = std::chrono::milliseconds(10);
+        cleanup();
+    }
+    
+    void TearDown() override {
+        cache_.reset();
+        cleanup();
+    }
+    
+    void cleanup() {
+        std::remove(options_.path.c_str());
+        std::remove((options_.path + ".old").c_str());
+        std::remove(options_.snapshot_path.c_str());
+    }
+    
+    std::unique_ptr<cache::Cache> cache_;
+    cache::WriteLog::Options options_;
+};
+
+TEST_F(WriteLogTest, ReplayRestoresMutations) {
+    {
+        cache::WriteLog log(*cache_, options_);
+        ASSERT_TRUE(log.open());
+        cache_->attach_write_log(&log);
+        
+        cache_->set("key1", "value1");
+        cache_->set("key2", "value2");
+        cache_->set("gone", "soon");
+        cache_->remove("gone");
+        cache_->incr("counter", 7);
+        log.close();
+        cache_->attach_write_log(nullptr);
+        EXPECT_EQ(log.records_appended(), 5u);
+    }
+    
+    cache::Cache restored(1024 * 1024, 4);
+    auto replayed = cache::WriteLog::replay(restored, options_.path);
+    ASSERT_TRUE(replayed.has_value());
+    EXPECT_EQ(*replayed, 5u);
+    EXPECT_EQ(restored.get("key1"), "value1");
+    EXPECT_EQ(restored.get("key2"), "value2");
+    EXPECT_EQ(restored.get("gone"), "");
+    EXPECT_EQ(restored.incr("counter"), 8);
+}
+
+TEST_F(WriteLogTest, ReplayClear) {
+    {
+        cache::WriteLog log(*cache_, options_);
+        ASSERT_TRUE(log.open());
+        cache_->attach_write_log(&log);
+        
+        cache_->set("key1", "value1");
+        cache_->clear();
+        cache_->set("key2", "value2");
+        log.close();
+        cache_->attach_write_log(nullptr);
+    }
+    
+    cache::Cache restored(1024 * 1024, 4);
+    ASSERT_TRUE(cache::WriteLog::replay(restored, options_.path).has_value());
+    EXPECT_EQ(restored.size(), 1u);
+    EXPECT_EQ(restored.get("key2"), "value2");
+}
+
+TEST_F(WriteLogTest, GroupCommitAlways) {
+    options_.policy = cache::WriteLog::FsyncPolicy::ALWAYS;
+    cache::WriteLog log(*cache_, options_);
+    ASSERT_TRUE(log.open());
+    cache_->attach_write_log(&log);
+    
+    const int num_threads = 4;
+    const int writes_per_thread = 50;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([this, t, writes_per_thread]() {
+            for (int i = 0; i < writes_per_thread; ++i) {
+                cache_->set("key_" + std::to_string(t) + "_" + std::to_string(i), "value");
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    // Every SET returned only after its record was synced, with fsyncs shared across writers
+    EXPECT_GT(log.fsyncs(), 0u);
+    EXPECT_LE(log.fsyncs(), static_cast<size_t>(num_threads * writes_per_thread));
+    
+    cache::Cache restored(1024 * 1024, 4);
+    EXPECT_EQ(cache::WriteLog::replay(restored, options_.path),
+              std::optional<size_t>(num_threads * writes_per_thread));
+    
+    log.close();
+    cache_->attach_write_log(nullptr);
+}
+
+TEST_F(WriteLogTest, TruncatesTornTail) {
+    {
+        cache::WriteLog log(*cache_, options_);
+        ASSERT_TRUE(log.open());
+        cache_->attach_write_log(&log);
+        cache_->set("key1", "value1");
+        log.close();
+        cache_->attach_write_log(nullptr);
+    }
+    
+    {
+        std::ofstream out(options_.path, std::ios::binary | std::ios::app);
+        out.write("\x20\x00\x00\x00partial", 11);
+    }
+    
+    cache::Cache restored(1024 * 1024, 4);
+    EXPECT_EQ(cache::WriteLog::replay(restored, options_.path), std::optional<size_t>(1));
+    EXPECT_EQ(restored.get("key1"), "value1");
+    
+    // The torn record is gone, so a second replay sees a clean log
+    cache::Cache again(1024 * 1024, 4);
+    EXPECT_EQ(cache::WriteLog::replay(again, options_.path), std::optional<size_t>(1));
+}
+
+TEST_F(WriteLogTest, CompactsIntoSnapshot) {
+    options_.compact_bytes = 1024;
+    cache::WriteLog log(*cache_, options_);
+    ASSERT_TRUE(log.open());
+    cache_->attach_write_log(&log);
+    
+    for (int i = 0; i < 100; ++i) {
+        cache_->set("key_" + std::to_string(i), std::string(50, 'x'));
+    }
+    for (int i = 0; i < 200 && log.compactions() == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    cache_->set("after", "compaction");
+    log.close();
+    cache_->attach_write_log(nullptr);
+    
+    EXPECT_GE(log.compactions(), 1u);
+    
+    // Snapshot plus the remaining log reproduce the full cache
+    cache::Cache restored(1024 * 1024, 4);
+    ASSERT_TRUE(cache::Snapshot::load(restored, options_.snapshot_path).has_value());
+    ASSERT_TRUE(cache::WriteLog::replay(restored, options_.path).has_value());
+    EXPECT_EQ(restored.size(), 101u);
+    EXPECT_EQ(restored.get("after"), "compaction");
+}
+
+TEST_F(WriteLogTest, FailedWriteIsNotAcknowledged) {
+    options_.policy = cache::WriteLog::FsyncPolicy::ALWAYS;
+    cache::WriteLog log(*cache_, options_);
+    ASSERT_TRUE(log.open());
+    cache_->attach_write_log(&log);
+    ASSERT_TRUE(cache_->set("before", "limit"));
+    
+    // Cap the file size so the next large record fails with EFBIG, as a full disk would
+    struct rlimit saved;
+    ASSERT_EQ(getrlimit(RLIMIT_FSIZE, &saved), 0);
+    auto previous_handler = std::signal(SIGXFSZ, SIG_IGN);
+    struct rlimit limited = saved;
+    limited.rlim_cur = 4096;
+    ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &limited), 0);
+    
+    bool large_stored = cache_->set("large", std::string(8192, 'x'));
+    bool small_stored = cache_->set("small", "value");
+    auto counter = cache_->incr("counter");
+    
+    setrlimit(RLIMIT_FSIZE, &saved);
+    std::signal(SIGXFSZ, previous_handler);
+    
+    EXPECT_FALSE(large_stored);
+    // Nothing after a failure is replayable, so later writes fail too
+    EXPECT_FALSE(small_stored);
+    EXPECT_FALSE(counter.has_value());
+    EXPECT_TRUE(log.failed());
+    EXPECT_GE(log.write_errors(), 1u);
+    log.close();
+    cache_->attach_write_log(nullptr);
+    
+    cache::Cache restored(1024 * 1024, 4);
+    EXPECT_EQ(cache::WriteLog::replay(restored, options_.path), std::optional<size_t>(1));
+    EXPECT_EQ(restored.get("before"), "limit");
+}